@@ -3,10 +3,26 @@
 #include "esp_camera.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "lcd.h"
+#include "i2c_bus.h"
 #include "wifi.h"
+#include "wifi_http.h"
+#include "img_converters.h"
+#include "rtsp.h"
 #include "sensor.h"
+#include "motion.h"
+#include "pixfmt.h"
+#include "prerec.h"
+#include "stripe.h"
+#include "isp.h"
+#include "fstats.h"
+#include "pipeline.h"
+#include "power.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include <string.h>
 
 static const char *TAG = "camera";
 
@@ -30,16 +46,29 @@ static const char *TAG = "camera";
 #define CAMERA_PIN_PCLK 7
 
 #define DEFAULT_XCLK_FREQ_HZ 24000000  // 使用立创例程的24MHz时钟
+#define CAMERA_POWER_ON_DELAY_MS 10
 
-// LCD显示队列句柄
-static QueueHandle_t xQueueLCDFrame = NULL;
-static TaskHandle_t camera_task_handle = NULL;
-static TaskHandle_t lcd_task_handle = NULL;
+// 高分辨率快照
+#define CAMERA_SNAPSHOT_FRAMESIZE FRAMESIZE_UXGA    // 快照最大分辨率（受传感器限制）
+#define CAMERA_SNAPSHOT_JPEG_QUALITY 12             // 传感器JPEG质量（越小越好）
+#define CAMERA_SNAPSHOT_ENCODE_QUALITY 90           // 设备端编码JPEG质量
+#define CAMERA_SNAPSHOT_SKIP_FRAMES 2               // 切换模式后丢弃的帧（等待曝光稳定）
+#define CAMERA_SNAPSHOT_TIMEOUT_MS 5000
+#define CAMERA_RESTORE_RETRY_MS 100                 // 快照后恢复视频流失败时的首次重试间隔（每次加倍）
+#define CAMERA_RESTORE_RETRY_MAX_MS 2000            // 重试间隔上限
+#define CAMERA_FRAME_INTERVAL_MS 33                 // 视频流帧间隔（30FPS）
+#define CAMERA_OUTAGE_FRAME_INTERVAL_MS 200         // WiFi断线且没有LCD时的采集间隔（预录继续）
+#define CAMERA_OUTAGE_POLL_MS 20                    // 断线期间检查重连的间隔
+
+#define CAMERA_FPS_MONITOR_STOP_TIMEOUT_MS 2000
+
+// 采集流水线（捕获任务 + 可选的LCD显示任务）
+static pipeline_t camera_pipeline;
 static TaskHandle_t fps_monitor_task_handle = NULL;
-static TaskHandle_t fpv_task_handle = NULL;
+static volatile TaskHandle_t fps_monitor_joiner = NULL;
 static bool camera_running = false;
 static bool lcd_display_running = false;
-static bool fps_monitor_running = false;
+static volatile bool fps_monitor_running = false;
 static bool fpv_running = false;
 
 // 帧率统计变量
@@ -49,6 +78,106 @@ static uint32_t last_fps_time = 0;
 static float camera_fps = 0.0f;
 static float lcd_fps = 0.0f;
 
+// 运动检测状态（只在捕获任务中更新）
+static motion_detector_t motion_detector;
+static motion_result_t motion_last;
+static bool motion_enabled = true;
+static uint8_t motion_idle_divider = 0;
+static uint32_t motion_idle_counter = 0;
+static uint32_t motion_frames_gated = 0;
+static uint32_t motion_time_us = 0;
+static uint32_t motion_max_time_us = 0;
+
+// FPV视频流格式转换
+static volatile uint8_t stream_format = CAMERA_STREAM_RGB565;
+static uint8_t *stream_convert_buf = NULL;
+static size_t stream_convert_size = 0;
+static uint16_t stream_convert_warned = 0xFFFF;    // 上次告警的无法转换组合（源格式<<8 | 目标格式）
+
+// 快照状态
+static pixformat_t stream_pixformat = PIXFORMAT_RGB565;    // 视频流实际使用的传感器格式
+static SemaphoreHandle_t snapshot_mutex = NULL;            // 一次只拍一张，持有期间快照数据有效
+static SemaphoreHandle_t snapshot_done = NULL;
+static volatile bool snapshot_requested = false;
+static bool snapshot_ok = false;
+static uint8_t *snapshot_buf = NULL;
+static size_t snapshot_len = 0;
+static camera_snapshot_stats_t snapshot_stats;
+static bool snapshot_gap_pending = false;
+static int64_t last_stream_frame_us = 0;
+static uint32_t stream_frame_interval_us = 0;               // 实测视频流帧间隔（平滑），换算快照中断的缺帧数
+static bool stream_restore_failed = false;                  // 快照后驱动未能恢复为视频流配置
+static uint32_t stream_restore_delay_ms = 0;
+static TickType_t stream_restore_next = 0;
+
+// 预录状态（捕获任务写入，导出任务读取，prerec_mutex保护环形缓冲区）
+#define CAMERA_PREREC_NOTIFY_STOP 0x80000000    // 导出任务通知位：退出
+static const camera_prerec_config_t prerec_default_config = {
+    .arena_size = 4 * 1024 * 1024,
+    .retain_ms = 8000,
+    .pre_event_ms = 5000,
+    .jpeg_quality = 0,
+    .triggers = CAMERA_PREREC_TRIGGER_MOTION | CAMERA_PREREC_TRIGGER_REMOTE,
+    .trigger_gpio = -1,
+    .dump_rate_kbps = 2000,
+};
+static camera_prerec_config_t prerec_config;
+static prerec_ring_t *prerec_ring = NULL;       // 索引约8KB，与数据一起放在PSRAM
+static uint8_t *prerec_arena = NULL;
+static uint8_t *prerec_dump_buf = NULL;
+static SemaphoreHandle_t prerec_mutex = NULL;
+static TaskHandle_t prerec_task_handle = NULL;
+static SemaphoreHandle_t prerec_task_exit = NULL;  // 导出任务退出前释放，停止时等待它再释放缓冲区
+static volatile bool prerec_enabled = false;
+static volatile bool prerec_task_stop = false;
+static portMUX_TYPE prerec_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t prerec_trigger_us = 0;           // 最近一次触发时间（导出截止时间）
+static uint16_t prerec_trigger_pre_ms = 0;      // 最近一次触发要求的导出时长
+static camera_prerec_stats_t prerec_stats;
+
+// ISP后处理（参数修改与逐帧处理用互斥锁串行，重新生成查表约1ms）
+static isp_t isp_state;
+static isp_scratch_t *isp_scratch = NULL;        // 两个条带各一份锐化行缓冲，首次启用锐化时分配
+static uint8_t isp_edge[2][ISP_MAX_WIDTH * 2];  // 双核分界处两行的原始数据
+static SemaphoreHandle_t isp_mutex = NULL;
+static camera_isp_stats_t isp_stats;
+
+// 帧统计与设备端自动曝光（统计和传感器写入都在捕获任务中进行，其他任务只修改配置）
+static fstats_t fstats;
+static bool fstats_enabled = true;
+static portMUX_TYPE fstats_lock = portMUX_INITIALIZER_UNLOCKED;
+static camera_frame_stats_t fstats_published;   // 最近一帧结果（fstats_lock保护）
+static bool fstats_was_blurred = false;
+static bool fstats_was_obstructed = false;
+static camera_ae_config_t ae_config;            // 当前生效的配置（只由捕获任务读写）
+static camera_ae_config_t ae_pending;           // 待生效的配置（fstats_lock保护）
+static volatile bool ae_reconfigure = false;
+static uint16_t ae_exposure = 0;
+static uint16_t ae_gain_x16 = 0;
+static uint8_t ae_settle = 0;
+
+static const camera_ae_config_t ae_default_config = {
+    .enable = true,
+    .target_luma = 110,
+    .deadband = 6,
+    .settle_frames = 2,
+    .max_exposure = 0,
+    .max_gain_x16 = 0,
+};
+
+// 已取出尚未归还的帧缓冲区数量（快照重新初始化驱动前必须全部归还）
+static portMUX_TYPE fb_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile int fb_outstanding = 0;
+
+// ROI状态（控制任务写、捕获/LCD任务读）
+static portMUX_TYPE roi_lock = portMUX_INITIALIZER_UNLOCKED;
+static camera_roi_t fpv_roi = {0};
+static camera_roi_t lcd_roi = {0};
+static camera_roi_t sensor_roi = {0};
+static bool sensor_window_active = false;
+static volatile bool roi_window_pending = false;       // 两路ROI请求：传感器窗口由捕获任务在两帧之间编程
+static camera_roi_t roi_window_request = {0};
+
     // 当前摄像头配置
 static camera_user_config_t current_config = {
     .enable_lcd_display = true,
@@ -58,6 +187,294 @@ static camera_user_config_t current_config = {
     .frame_size = FRAMESIZE_QQVGA  // 默认使用QQVGA
 };
 
+// 传感器寄存器写入项（掩码为0xff时直接写入，否则读-改-写），整张表由 i2c_bus_write_regs 一次加锁写入
+typedef i2c_bus_reg_t camera_sensor_reg_t;
+
+// 传感器预设
+typedef struct {
+    const char *name;
+    uint32_t xclk_freq_hz;              // 0表示使用 camera_set_config 中的时钟
+    uint8_t fb_count;
+    camera_grab_mode_t grab_mode;
+    uint16_t frame_interval_ms;         // 捕获任务限速间隔，0表示不限速（由传感器帧率决定）
+    uint16_t max_exposure;              // 自动曝光的曝光上限（传感器单位），0使用传感器默认上限
+    int8_t gainceiling;                 // 通用传感器AGC增益上限 (gainceiling_t)，-1不修改
+    int8_t aec_night;                   // 通用传感器允许曝光超过一帧 (set_aec2)，-1不修改
+    const camera_sensor_reg_t *gc0308_regs;
+    uint8_t gc0308_reg_count;
+} camera_profile_desc_t;
+
+// GC0308第0页寄存器：0x01/0x02 行/场消隐低8位，0x0f[7:4]/[3:0] 场/行消隐高4位，
+// 0xe4/0xe5 曝光档位1（行数，AEC曝光上限），0xec[5:4] AEC最大曝光档位选择（0=档位1）
+// GC0308没有PLL，像素时钟直接由XCLK决定；QQVGA的子采样由驱动按 CONFIG_GC_SENSOR_SUBSAMPLE_MODE 设置
+static const camera_sensor_reg_t gc0308_low_latency_regs[] = {
+    { 0xfe, 0xff, 0x00 },
+    { 0x0f, 0xf0, 0x00 },
+    { 0x02, 0xff, 0x20 },       // 场消隐32行
+    { 0xe4, 0x0f, 0x01 },
+    { 0xe5, 0xff, 0xf4 },       // 曝光上限500行（约一帧），暗光下提高增益而不是拉长帧
+    { 0xec, 0x30, 0x00 },
+};
+
+static const camera_sensor_reg_t gc0308_max_fps_regs[] = {
+    { 0xfe, 0xff, 0x00 },
+    { 0x0f, 0xff, 0x00 },
+    { 0x01, 0xff, 0x50 },       // 行消隐缩短
+    { 0x02, 0xff, 0x04 },       // 场消隐4行
+    { 0xe4, 0x0f, 0x01 },
+    { 0xe5, 0xff, 0x00 },       // 曝光上限256行
+    { 0xec, 0x30, 0x00 },
+};
+
+static const camera_sensor_reg_t gc0308_quality_regs[] = {
+    { 0xfe, 0xff, 0x00 },
+    { 0xec, 0x30, 0x30 },       // 允许使用最长的曝光档位（暗光下降低帧率换取低噪声）
+};
+
+static const camera_profile_desc_t camera_profiles[CAMERA_PROFILE_MAX] = {
+    [CAMERA_PROFILE_DEFAULT] = {
+        .name = "default",
+        .xclk_freq_hz = 0,
+        .fb_count = 2,
+        .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+        .frame_interval_ms = CAMERA_FRAME_INTERVAL_MS,
+        .max_exposure = 0,
+        .gainceiling = -1,
+        .aec_night = -1,
+    },
+    [CAMERA_PROFILE_LOW_LATENCY] = {
+        .name = "low-latency",
+        .xclk_freq_hz = 24000000,
+        .fb_count = 3,
+        .grab_mode = CAMERA_GRAB_LATEST,       // 总是取最新帧，处理慢时丢弃旧帧而不是排队
+        .frame_interval_ms = 0,
+        .max_exposure = 500,
+        .gainceiling = GAINCEILING_8X,
+        .aec_night = 0,
+        .gc0308_regs = gc0308_low_latency_regs,
+        .gc0308_reg_count = sizeof(gc0308_low_latency_regs) / sizeof(gc0308_low_latency_regs[0]),
+    },
+    [CAMERA_PROFILE_MAX_FPS] = {
+        .name = "max-fps",
+        .xclk_freq_hz = 24000000,
+        .fb_count = 3,
+        .grab_mode = CAMERA_GRAB_LATEST,
+        .frame_interval_ms = 0,
+        .max_exposure = 256,
+        .gainceiling = GAINCEILING_16X,
+        .aec_night = 0,
+        .gc0308_regs = gc0308_max_fps_regs,
+        .gc0308_reg_count = sizeof(gc0308_max_fps_regs) / sizeof(gc0308_max_fps_regs[0]),
+    },
+    [CAMERA_PROFILE_QUALITY] = {
+        .name = "quality",
+        .xclk_freq_hz = 20000000,
+        .fb_count = 2,
+        .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+        .frame_interval_ms = CAMERA_FRAME_INTERVAL_MS,
+        .max_exposure = 0,
+        .gainceiling = GAINCEILING_4X,
+        .aec_night = 1,
+        .gc0308_regs = gc0308_quality_regs,
+        .gc0308_reg_count = sizeof(gc0308_quality_regs) / sizeof(gc0308_quality_regs[0]),
+    },
+};
+
+static camera_profile_t camera_profile = CAMERA_PROFILE_DEFAULT;
+
+// 关闭LCD时，灰度/YUV视频流直接由传感器输出（减少DVP总线数据量）；LCD需要RGB565
+static pixformat_t camera_sensor_pixformat(void)
+{
+    if (current_config.enable_lcd_display) {
+        return PIXFORMAT_RGB565;
+    }
+    switch (current_config.stream_format) {
+        case CAMERA_STREAM_Y8:
+            return PIXFORMAT_GRAYSCALE;
+        case CAMERA_STREAM_YUV420:
+            return PIXFORMAT_YUV422;  // 传感器不支持4:2:0，在设备端做垂直色度抽取
+        default:
+            return PIXFORMAT_RGB565;
+    }
+}
+
+// 视频流格式对应的帧头像素格式
+static uint8_t camera_stream_udp_format(uint8_t format)
+{
+    switch (format) {
+        case CAMERA_STREAM_Y8:
+            return UDP_FMT_GRAY;
+        case CAMERA_STREAM_YUV420:
+            return UDP_FMT_YUV420;
+        default:
+            return UDP_FMT_RGB565;
+    }
+}
+
+// 传感器像素格式对应的帧头像素格式（与camera_fill_frame_desc一致）
+static uint8_t camera_pixformat_udp_format(pixformat_t format)
+{
+    switch (format) {
+        case PIXFORMAT_JPEG:
+            return UDP_FMT_JPEG;
+        case PIXFORMAT_GRAYSCALE:
+            return UDP_FMT_GRAY;
+        case PIXFORMAT_YUV422:
+            return UDP_FMT_YUV422;
+        default:
+            return UDP_FMT_RGB565;
+    }
+}
+
+// 格式转换任务：条带以行对为单元（YUV420色度每两行一组）
+typedef struct {
+    const wifi_frame_desc_t *src;
+    uint8_t format;
+    uint8_t *dst;
+} camera_convert_job_t;
+
+// 转换一个条带（stripe_run的工作函数，两个核各执行一部分行对）
+static void camera_convert_stripe(void *ctx, int start, int end)
+{
+    const camera_convert_job_t *job = (const camera_convert_job_t *)ctx;
+    pixfmt_convert_rows(job->src, job->format, job->dst, start * 2, end * 2);
+}
+
+// 将帧转换为FPV视频流格式；传感器已直接输出或无法转换时原样返回
+static const wifi_frame_desc_t* camera_stream_convert(const wifi_frame_desc_t *desc, wifi_frame_desc_t *converted)
+{
+    uint8_t target = camera_stream_udp_format(stream_format);
+    if (desc->format == target) {
+        return desc;
+    }
+    if (!pixfmt_can_convert(desc->format, target)) {
+        uint16_t key = (uint16_t)((desc->format << 8) | target);
+        if (key != stream_convert_warned) {
+            stream_convert_warned = key;
+            ESP_LOGW(TAG, "Sensor format %d cannot be converted to stream format %d, sending unconverted",
+                     desc->format, target);
+        }
+        return desc;
+    }
+    
+    size_t size = pixfmt_frame_size(target, desc->width, desc->height);
+    if (size > stream_convert_size) {
+        heap_caps_free(stream_convert_buf);
+        stream_convert_size = 0;
+        // 优先使用内部RAM，转换输出是逐字节写入
+        stream_convert_buf = heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+        if (!stream_convert_buf) {
+            stream_convert_buf = heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        }
+        if (!stream_convert_buf) {
+            ESP_LOGW(TAG, "Memory for stream conversion is not enough");
+            return desc;
+        }
+        stream_convert_size = size;
+    }
+    
+    if (!pixfmt_convert_begin(desc, target, stream_convert_buf, stream_convert_size, converted)) {
+        return desc;
+    }
+    
+    // 两个核分别转换上下半帧
+    camera_convert_job_t job = {
+        .src = desc,
+        .format = target,
+        .dst = stream_convert_buf,
+    };
+    stripe_run(STRIPE_STAGE_CONVERT, camera_convert_stripe, &job, desc->height / 2);
+    return converted;
+}
+
+// 填充esp32-camera驱动配置（引脚固定，格式/分辨率/缓冲区数量由调用者决定）
+static void camera_fill_driver_config(camera_config_t *config, pixformat_t format, framesize_t size, size_t fb_count)
+{
+    memset(config, 0, sizeof(*config));
+    config->ledc_channel = LEDC_CHANNEL_1;
+    config->ledc_timer = LEDC_TIMER_1;
+    config->pin_d0 = CAMERA_PIN_D0;
+    config->pin_d1 = CAMERA_PIN_D1;
+    config->pin_d2 = CAMERA_PIN_D2;
+    config->pin_d3 = CAMERA_PIN_D3;
+    config->pin_d4 = CAMERA_PIN_D4;
+    config->pin_d5 = CAMERA_PIN_D5;
+    config->pin_d6 = CAMERA_PIN_D6;
+    config->pin_d7 = CAMERA_PIN_D7;
+    config->pin_xclk = CAMERA_PIN_XCLK;
+    config->pin_pclk = CAMERA_PIN_PCLK;
+    config->pin_vsync = CAMERA_PIN_VSYNC;
+    config->pin_href = CAMERA_PIN_HREF;
+    config->pin_sccb_sda = -1;                // 使用已经初始化的I2C接口
+    config->pin_sccb_scl = CAMERA_PIN_SIOC;   // 使用SCL引脚
+    config->sccb_i2c_port = 0;                // 使用I2C端口0
+    config->pin_pwdn = CAMERA_PIN_PWDN;
+    config->pin_reset = CAMERA_PIN_RESET;
+    config->xclk_freq_hz = current_config.xclk_freq_hz;
+    config->pixel_format = format;
+    config->frame_size = size;
+    config->jpeg_quality = CAMERA_SNAPSHOT_JPEG_QUALITY;
+    config->fb_count = fb_count;
+    config->fb_location = CAMERA_FB_IN_PSRAM;
+    // 取帧模式由预设决定（默认使用立创例程的grab模式），单缓冲区（快照）只能用GRAB_WHEN_EMPTY
+    config->grab_mode = fb_count > 1 ? camera_profiles[camera_profile].grab_mode : CAMERA_GRAB_WHEN_EMPTY;
+}
+
+// GC0308默认ISP参数：传感器输出偏灰、发软，提高饱和度和对比度，轻度提亮暗部并锐化
+static const isp_config_t camera_isp_gc0308_profile = {
+    .enable = true,
+    .wb_gain = { ISP_UNITY, ISP_UNITY, ISP_UNITY },
+    .ccm = { 330, -56, -18,
+             -38, 312, -18,
+             -38, -56, 350 },   // 饱和度约1.3，每行和为1.0
+    .gamma_x100 = 90,
+    .contrast = 10,
+    .brightness = 0,
+    .sharpen = 8,
+};
+
+// 写入当前预设的传感器参数
+static void camera_profile_apply(sensor_t *s)
+{
+    const camera_profile_desc_t *profile = &camera_profiles[camera_profile];
+    
+    if (s->id.PID == GC0308_PID) {
+        if (profile->gc0308_reg_count &&
+            i2c_bus_write_regs(s->slv_addr, profile->gc0308_regs, profile->gc0308_reg_count) != ESP_OK) {
+            ESP_LOGW(TAG, "Profile %s: failed to write sensor registers", profile->name);
+        }
+        return;
+    }
+    
+    if (profile->gainceiling >= 0) {
+        s->set_gainceiling(s, (gainceiling_t)profile->gainceiling);
+    }
+    if (profile->aec_night >= 0) {
+        s->set_aec2(s, profile->aec_night);
+    }
+}
+
+// 传感器参数设置（初始化和快照后重新初始化时使用）
+static void camera_sensor_setup(sensor_t *s)
+{
+    // 驱动的set_*会切换寄存器页，整个配置过程独占总线，避免与PCA9557或曝光写入交错
+    i2c_bus_lock();
+    
+    // GC0308特殊处理 - 使用最简化配置
+    if (s->id.PID == GC0308_PID) {
+        // 只设置镜像，其他所有参数都保持默认
+        s->set_hmirror(s, 1);
+    } else {
+        // 通用摄像头设置
+        s->set_brightness(s, 0);     // 亮度
+        s->set_contrast(s, 0);        // 对比度
+        s->set_saturation(s, 0);      // 饱和度
+    }
+    camera_profile_apply(s);
+    
+    i2c_bus_unlock();
+}
+
 bool camera_init(void)
 {
     ESP_LOGI(TAG, "Initializing camera...");
@@ -65,44 +482,55 @@ bool camera_init(void)
     // 打开摄像头电源
     lcd_dvp_pwdn(0);
     
-    // 等待摄像头电源稳定
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // 等待摄像头退出掉电模式（与esp32-camera驱动自己控制PWDN引脚时的等待时间相同）
+    vTaskDelay(pdMS_TO_TICKS(CAMERA_POWER_ON_DELAY_MS));
     
     // 使用当前配置初始化摄像头
     camera_config_t config;
-    config.ledc_channel = LEDC_CHANNEL_1;
-    config.ledc_timer = LEDC_TIMER_1;
-    config.pin_d0 = CAMERA_PIN_D0;
-    config.pin_d1 = CAMERA_PIN_D1;
-    config.pin_d2 = CAMERA_PIN_D2;
-    config.pin_d3 = CAMERA_PIN_D3;
-    config.pin_d4 = CAMERA_PIN_D4;
-    config.pin_d5 = CAMERA_PIN_D5;
-    config.pin_d6 = CAMERA_PIN_D6;
-    config.pin_d7 = CAMERA_PIN_D7;
-    config.pin_xclk = CAMERA_PIN_XCLK;
-    config.pin_pclk = CAMERA_PIN_PCLK;
-    config.pin_vsync = CAMERA_PIN_VSYNC;
-    config.pin_href = CAMERA_PIN_HREF;
-    config.pin_sccb_sda = -1;                // 使用已经初始化的I2C接口
-    config.pin_sccb_scl = CAMERA_PIN_SIOC;   // 使用SCL引脚
-    config.sccb_i2c_port = 0;                // 使用I2C端口0
-    config.pin_pwdn = CAMERA_PIN_PWDN;
-    config.pin_reset = CAMERA_PIN_RESET;
-    config.xclk_freq_hz = current_config.xclk_freq_hz;
-    config.pixel_format = PIXFORMAT_RGB565;  // 使用原始RGB565格式
-    config.frame_size = current_config.frame_size;  // 使用配置的分辨率
-    config.jpeg_quality = 12;
-    config.fb_count = 2;                     // 使用双缓冲
-    config.fb_location = CAMERA_FB_IN_PSRAM;
-    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;  // 使用立创例程的grab模式
+    camera_fill_driver_config(&config, camera_sensor_pixformat(), (framesize_t)current_config.frame_size,
+                              camera_profiles[camera_profile].fb_count);
 
     // 摄像头初始化
     esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK && config.pixel_format != PIXFORMAT_RGB565) {
+        // 传感器不支持该输出格式，回退到RGB565由设备端转换
+        ESP_LOGW(TAG, "Sensor format %d not supported (0x%x), falling back to RGB565", config.pixel_format, err);
+        config.pixel_format = PIXFORMAT_RGB565;
+        err = esp_camera_init(&config);
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
         return false;
     }
+    stream_pixformat = config.pixel_format;
+
+    if (!snapshot_mutex) {
+        snapshot_mutex = xSemaphoreCreateMutex();
+        snapshot_done = xSemaphoreCreateBinary();
+        if (!snapshot_mutex || !snapshot_done) {
+            ESP_LOGE(TAG, "Failed to create snapshot semaphores");
+            return false;
+        }
+    }
+    
+    if (!isp_mutex) {
+        isp_mutex = xSemaphoreCreateMutex();
+        if (!isp_mutex) {
+            ESP_LOGE(TAG, "Failed to create ISP mutex");
+            return false;
+        }
+        isp_config_t isp_config;
+        isp_default_config(&isp_config);
+        isp_configure(&isp_state, &isp_config);
+    }
+    
+    // 功耗档位：推流时锁定最高频率，门控关闭后降频
+    power_init(NULL);
+    
+    // 另一个核上的常驻工作任务，失败时逐像素处理全部在捕获任务中完成
+    if (!stripe_init()) {
+        ESP_LOGW(TAG, "Stripe worker not available, per-frame work stays on one core");
+    }
 
     // 等待摄像头稳定
     vTaskDelay(pdMS_TO_TICKS(500));
@@ -111,19 +539,11 @@ bool camera_init(void)
     if (s) {
         ESP_LOGI(TAG, "Camera sensor detected, PID: 0x%x", s->id.PID);
         
-        // GC0308特殊处理 - 使用最简化配置
+        camera_sensor_setup(s);
         if (s->id.PID == GC0308_PID) {
-            ESP_LOGI(TAG, "Configuring GC0308 camera with minimal settings...");
-            
-            // 只设置镜像，其他所有参数都保持默认
-            s->set_hmirror(s, 1);
-            
-            ESP_LOGI(TAG, "GC0308 camera configured with mirror only");
-        } else {
-            // 通用摄像头设置
-            s->set_brightness(s, 0);     // 亮度
-            s->set_contrast(s, 0);        // 对比度
-            s->set_saturation(s, 0);      // 饱和度
+            // 传感器只设置镜像，颜色由设备端ISP校正
+            camera_set_isp_config(&camera_isp_gc0308_profile);
+            ESP_LOGI(TAG, "GC0308 camera configured with mirror and ISP profile");
         }
         
         // 设置分辨率 - 先尝试QQVGA，如果失败再尝试其他分辨率
@@ -176,6 +596,7 @@ bool camera_set_config(const camera_user_config_t *config)
     }
     
     current_config = *config;
+    stream_format = config->stream_format;
     ESP_LOGI(TAG, "Camera config updated");
     return true;
 }
@@ -186,43 +607,61 @@ const camera_user_config_t* camera_get_config(void)
     return &current_config;
 }
 
-bool camera_capture(void)
+// 归还帧缓冲区并更新未归还计数
+static void camera_fb_release(camera_fb_t *frame)
 {
-    ESP_LOGI(TAG, "Capturing image...");
-    // TODO: 实现图像捕获逻辑
-    return true;
+    taskENTER_CRITICAL(&fb_lock);
+    fb_outstanding--;
+    taskEXIT_CRITICAL(&fb_lock);
+    esp_camera_fb_return(frame);
 }
 
-uint8_t* camera_get_image_data(void)
+// 把ROI限制在帧内并按2像素对齐（YUV422/YUV420转换按像素对处理），返回false表示全幅
+static bool camera_roi_clamp(camera_roi_t *roi, uint16_t frame_width, uint16_t frame_height)
 {
-    ESP_LOGI(TAG, "Getting image data...");
-    // TODO: 实现获取图像数据逻辑
-    return NULL;
+    if (roi->width == 0 || roi->height == 0) {
+        return false;
+    }
+    
+    roi->x &= ~1;
+    roi->y &= ~1;
+    if (roi->x >= frame_width || roi->y >= frame_height) {
+        return false;
+    }
+    if (roi->x + roi->width > frame_width) {
+        roi->width = frame_width - roi->x;
+    }
+    if (roi->y + roi->height > frame_height) {
+        roi->height = frame_height - roi->y;
+    }
+    roi->width &= ~1;
+    roi->height &= ~1;
+    
+    return roi->width > 0 && roi->height > 0 &&
+           (roi->width < frame_width || roi->height < frame_height);
 }
 
-// LCD处理任务
-static void camera_lcd_task(void *arg)
+// LCD显示（流水线消费者任务中调用，返回后由流水线归还帧）
+static void camera_lcd_consume(void *ctx, void *arg)
 {
-    camera_fb_t *frame = NULL;
+    camera_fb_t *frame = (camera_fb_t *)arg;
     
-    ESP_LOGI(TAG, "LCD display task started");
-    
-    while (lcd_display_running) {
-        if (xQueueReceive(xQueueLCDFrame, &frame, pdMS_TO_TICKS(100))) {
-            if (frame) {
-                // 显示摄像头帧到LCD
-                lcd_draw_camera_frame(0, 0, frame->width, frame->height, frame->buf);
-                lcd_frame_count++;  // 统计LCD显示帧数
-                esp_camera_fb_return(frame);
-            }
-        }
+    // 显示摄像头帧到LCD（设置了LCD ROI时只显示该区域）
+    camera_roi_t roi;
+    taskENTER_CRITICAL(&roi_lock);
+    roi = lcd_roi;
+    taskEXIT_CRITICAL(&roi_lock);
+    if (camera_roi_clamp(&roi, frame->width, frame->height)) {
+        size_t stride = frame->width * 2;
+        lcd_draw_camera_frame_stride(0, 0, roi.width, roi.height,
+                                     frame->buf + roi.y * stride + roi.x * 2, stride);
+    } else {
+        lcd_draw_camera_frame(0, 0, frame->width, frame->height, frame->buf);
     }
-    
-    ESP_LOGI(TAG, "LCD display task stopped");
-    vTaskDelete(NULL);
+    lcd_frame_count++;  // 统计LCD显示帧数
 }
 
-// 帧率监控任务
+// 帧率监控任务（停止时由任务通知唤醒，退出前通知停止者）
 static void fps_monitor_task(void *arg)
 {
     ESP_LOGI(TAG, "FPS monitor task started");
@@ -231,7 +670,10 @@ static void fps_monitor_task(void *arg)
     last_fps_time = xTaskGetTickCount();
     
     while (fps_monitor_running) {
-        vTaskDelay(pdMS_TO_TICKS(1000));  // 每秒计算一次
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));  // 每秒计算一次
+        if (!fps_monitor_running) {
+            break;
+        }
         
         // 计算经过的时间（秒）
         uint32_t current_time = xTaskGetTickCount();
@@ -251,347 +693,1390 @@ static void fps_monitor_task(void *arg)
     }
     
     ESP_LOGI(TAG, "FPS monitor task stopped");
-    vTaskDelete(NULL);
-}
-
-// 摄像头处理任务
-static void camera_capture_task(void *arg)
-{
-    ESP_LOGI(TAG, "Camera capture task started");
-    
-    // 控制帧率 - 目标30FPS，每33ms一帧
-    const TickType_t frame_delay = pdMS_TO_TICKS(33);  // 30 FPS
-    TickType_t last_frame_time = xTaskGetTickCount();
-    
-    while (camera_running) {
-        camera_fb_t *frame = esp_camera_fb_get();
-        if (frame) {
-            camera_frame_count++;  // 统计摄像头捕获帧数
-            
-            // 如果启用了FPV模式，也发送到FPV
-            if (fpv_running) {
-                // 发送帧数据到FPV
-                static uint16_t fpv_frame_id = 0;
-                if (!wifi_send_camera_frame(frame->buf, frame->len, fpv_frame_id)) {
-                    ESP_LOGW(TAG, "Failed to send FPV frame %d", fpv_frame_id);
-                } else {
-                    ESP_LOGD(TAG, "Sent FPV frame %d, size: %d", fpv_frame_id, frame->len);
-                }
-                fpv_frame_id++;
-            }
-            
-            // 将帧发送到LCD显示队列
-            if (!xQueueSend(xQueueLCDFrame, &frame, pdMS_TO_TICKS(10))) {
-                // 如果队列满了，释放帧
-                esp_camera_fb_return(frame);
-            }
-            
-            // 控制帧率 - 等待到下一帧时间
-            TickType_t current_time = xTaskGetTickCount();
-            TickType_t elapsed = current_time - last_frame_time;
-            
-            if (elapsed < frame_delay) {
-                vTaskDelay(frame_delay - elapsed);
-            }
-            
-            last_frame_time = xTaskGetTickCount();
-            
-        } else {
-            ESP_LOGW(TAG, "Failed to get camera frame");
-            vTaskDelay(pdMS_TO_TICKS(50));  // 获取帧失败时的延迟
-        }
+    TaskHandle_t joiner = fps_monitor_joiner;
+    if (joiner) {
+        xTaskNotifyGive(joiner);
     }
-    
-    ESP_LOGI(TAG, "Camera capture task stopped");
     vTaskDelete(NULL);
 }
 
-// 启动摄像头到LCD的实时显示
-bool camera_start_lcd_display(void)
+// 编程传感器窗口（数字变焦）：ROI按当前帧坐标换算到传感器全幅坐标，输出尺寸保持当前帧尺寸
+// roi为NULL时恢复全幅；传感器不支持时返回false
+// set_framesize/set_res_raw会连续写多个寄存器（含切换寄存器页），与传感器设置相同独占共享总线
+static bool camera_sensor_set_window(const camera_roi_t *roi)
 {
-    if (lcd_display_running) {
-        ESP_LOGW(TAG, "Camera LCD display already running");
-        return true;
-    }
-    
-    ESP_LOGI(TAG, "Starting camera LCD display...");
-    
-    // 创建LCD显示队列
-    xQueueLCDFrame = xQueueCreate(2, sizeof(camera_fb_t *));
-    if (xQueueLCDFrame == NULL) {
-        ESP_LOGE(TAG, "Failed to create LCD frame queue");
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s) {
         return false;
     }
     
-    lcd_display_running = true;
-    
-    // 创建摄像头捕获任务
-    BaseType_t ret = xTaskCreatePinnedToCore(
-        camera_capture_task, 
-        "camera_capture", 
-        3 * 1024, 
-        NULL, 
-        5, 
-        &camera_task_handle, 
-        1
-    );
+    if (!roi) {
+        if (!i2c_bus_lock()) {
+            return false;
+        }
+        bool ok = s->set_framesize(s, (framesize_t)current_config.frame_size) == 0;
+        i2c_bus_unlock();
+        return ok;
+    }
     
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create camera capture task");
-        lcd_display_running = false;
-        vQueueDelete(xQueueLCDFrame);
-        xQueueLCDFrame = NULL;
+    camera_sensor_info_t *info = esp_camera_sensor_get_info(&s->id);
+    if (!s->set_res_raw || !info) {
         return false;
     }
     
-    // 创建LCD显示任务
-    ret = xTaskCreatePinnedToCore(
-        camera_lcd_task, 
-        "camera_lcd", 
-        4 * 1024, 
-        NULL, 
-        5, 
-        &lcd_task_handle, 
-        0
-    );
+    const int out_w = resolution[current_config.frame_size].width;
+    const int out_h = resolution[current_config.frame_size].height;
+    const int full_w = resolution[info->max_size].width;
+    const int full_h = resolution[info->max_size].height;
+    int win_x = roi->x * full_w / out_w;
+    int win_y = roi->y * full_h / out_h;
+    int win_w = roi->width * full_w / out_w;
+    int win_h = roi->height * full_h / out_h;
     
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create LCD display task");
-        lcd_display_running = false;
-        vTaskDelete(camera_task_handle);
-        camera_task_handle = NULL;
-        vQueueDelete(xQueueLCDFrame);
-        xQueueLCDFrame = NULL;
-        return false;
+    // 各传感器set_res_raw的参数含义不同（OV3660/OV5640需要HTS/VTS时序），只对已知语义的传感器编程
+    int ret = -1;
+    switch (s->id.PID) {
+        case OV2640_PID:
+            if (!i2c_bus_lock()) {
+                return false;
+            }
+            // startX为传感器模式（0=UXGA），offset/total为窗口位置和大小
+            ret = s->set_res_raw(s, 0, 0, 0, 0, win_x, win_y, win_w, win_h, out_w, out_h, false, false);
+            i2c_bus_unlock();
+            break;
+        default:
+            return false;
     }
     
-    // 创建帧率监控任务
-    ret = xTaskCreatePinnedToCore(
-        fps_monitor_task, 
-        "fps_monitor", 
-        4 * 1024,  // 增加栈大小防止溢出
-        NULL, 
-        4, 
-        &fps_monitor_task_handle, 
-        1
-    );
-    
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create FPS monitor task");
-        lcd_display_running = false;
-        vTaskDelete(camera_task_handle);
-        camera_task_handle = NULL;
-        vTaskDelete(lcd_task_handle);
-        lcd_task_handle = NULL;
-        vQueueDelete(xQueueLCDFrame);
-        xQueueLCDFrame = NULL;
+    if (ret != 0) {
+        ESP_LOGW(TAG, "Sensor window %d,%d %dx%d rejected", win_x, win_y, win_w, win_h);
+        camera_sensor_set_window(NULL);
         return false;
     }
-    
-    ESP_LOGI(TAG, "Camera LCD display started successfully");
     return true;
 }
 
-// 启动摄像头功能（根据配置启动相应功能）
-bool camera_start(void)
+// 两路相同ROI：优先由传感器窗口实现，DVP上只传输ROI对应的画面；宽高为0恢复全幅
+// （捕获任务在两帧之间调用，流水线停止时由调用者直接调用）
+static void camera_roi_apply_all(const camera_roi_t *roi)
 {
-    ESP_LOGI(TAG, "Starting camera with config: LCD=%d, FPS=%d, Capture=%d", 
-               current_config.enable_lcd_display, 
-               current_config.enable_fps_monitor,
-               current_config.enable_capture_task);
-    
-    camera_running = true;
-    
-    // 创建LCD显示队列（如果需要LCD显示）
-    if (current_config.enable_lcd_display && !xQueueLCDFrame) {
-        xQueueLCDFrame = xQueueCreate(2, sizeof(camera_fb_t *));
-        if (xQueueLCDFrame == NULL) {
-            ESP_LOGE(TAG, "Failed to create LCD frame queue");
-            camera_running = false;
-            return false;
-        }
+    camera_roi_t full = {0};
+    bool use_sensor = roi->width && roi->height && camera_sensor_set_window(roi);
+    if (!use_sensor && sensor_window_active) {
+        camera_sensor_set_window(NULL);
     }
     
-    // 如果不需要LCD显示但需要FPV，创建一个小的队列用于帧统计
-    if (!current_config.enable_lcd_display && !xQueueLCDFrame) {
-        xQueueLCDFrame = xQueueCreate(1, sizeof(camera_fb_t *));
-        if (xQueueLCDFrame == NULL) {
-            ESP_LOGE(TAG, "Failed to create FPV frame queue");
-            camera_running = false;
-            return false;
-        }
-    }
+    taskENTER_CRITICAL(&roi_lock);
+    sensor_window_active = use_sensor;
+    sensor_roi = use_sensor ? *roi : full;
+    fpv_roi = use_sensor ? full : *roi;
+    lcd_roi = use_sensor ? full : *roi;
+    taskEXIT_CRITICAL(&roi_lock);
     
-    // 创建摄像头捕获任务
-    if (current_config.enable_capture_task) {
-        BaseType_t ret = xTaskCreatePinnedToCore(
-            camera_capture_task, 
-            "camera_capture", 
-            3 * 1024, 
-            NULL, 
-            5, 
-            &camera_task_handle, 
-            1
-        );
-        
-        if (ret != pdPASS) {
-            ESP_LOGE(TAG, "Failed to create camera capture task");
-            camera_running = false;
-            if (xQueueLCDFrame) {
-                vQueueDelete(xQueueLCDFrame);
-                xQueueLCDFrame = NULL;
-            }
-            return false;
-        }
+    ESP_LOGI(TAG, "ROI (target 0x%x): %d,%d %dx%d%s", CAMERA_ROI_ALL, roi->x, roi->y, roi->width, roi->height,
+             use_sensor ? " [sensor window]" : "");
+}
+
+// 处理两路ROI请求（捕获任务或流水线停止后调用）
+static void camera_roi_apply_pending(void)
+{
+    if (!roi_window_pending) {
+        return;
     }
+    taskENTER_CRITICAL(&roi_lock);
+    camera_roi_t roi = roi_window_request;
+    roi_window_pending = false;
+    taskEXIT_CRITICAL(&roi_lock);
+    camera_roi_apply_all(&roi);
+}
+
+// 根据摄像头帧缓冲区填充发送帧描述
+static void camera_fill_frame_desc(const camera_fb_t *fb, wifi_frame_desc_t *desc)
+{
+    desc->data = fb->buf;
+    desc->len = fb->len;
+    desc->width = fb->width;
+    desc->height = fb->height;
+    desc->timestamp_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    desc->flags = UDP_FLAG_KEYFRAME;
     
-    // 创建LCD显示任务
-    if (current_config.enable_lcd_display) {
-        lcd_display_running = true;
-        BaseType_t ret = xTaskCreatePinnedToCore(
-            camera_lcd_task, 
-            "camera_lcd", 
-            4 * 1024, 
-            NULL, 
-            5, 
-            &lcd_task_handle, 
-            0
-        );
-        
-        if (ret != pdPASS) {
-            ESP_LOGE(TAG, "Failed to create LCD display task");
-            camera_running = false;
-            if (camera_task_handle) {
-                vTaskDelete(camera_task_handle);
-                camera_task_handle = NULL;
-            }
-            if (xQueueLCDFrame) {
-                vQueueDelete(xQueueLCDFrame);
-                xQueueLCDFrame = NULL;
-            }
-            return false;
-        }
+    switch (fb->format) {
+        case PIXFORMAT_JPEG:
+            desc->format = UDP_FMT_JPEG;
+            desc->stride = 0;
+            break;
+        case PIXFORMAT_GRAYSCALE:
+            desc->format = UDP_FMT_GRAY;
+            desc->stride = fb->width;
+            break;
+        case PIXFORMAT_YUV422:
+            desc->format = UDP_FMT_YUV422;
+            desc->stride = fb->width * 2;
+            break;
+        case PIXFORMAT_RGB565:
+        default:
+            desc->format = UDP_FMT_RGB565;
+            desc->stride = fb->width * 2;
+            desc->flags |= UDP_FLAG_BIG_ENDIAN;  // esp32-camera输出大端RGB565
+            break;
     }
+}
+
+// 按ROI裁剪帧描述：只移动数据指针并修改宽高，stride不变（零拷贝）
+static const wifi_frame_desc_t* camera_roi_crop(const wifi_frame_desc_t *desc, wifi_frame_desc_t *cropped)
+{
+    camera_roi_t roi;
+    taskENTER_CRITICAL(&roi_lock);
+    roi = fpv_roi;
+    taskEXIT_CRITICAL(&roi_lock);
     
-    // 创建帧率监控任务
-    if (current_config.enable_fps_monitor) {
-        fps_monitor_running = true;
-        BaseType_t ret = xTaskCreatePinnedToCore(
-            fps_monitor_task, 
-            "fps_monitor", 
-            4 * 1024, 
-            NULL, 
-            4, 
-            &fps_monitor_task_handle, 
-            1
-        );
-        
-        if (ret != pdPASS) {
-            ESP_LOGE(TAG, "Failed to create FPS monitor task");
-            camera_running = false;
-            if (camera_task_handle) {
-                vTaskDelete(camera_task_handle);
-                camera_task_handle = NULL;
-            }
-            if (lcd_task_handle) {
-                vTaskDelete(lcd_task_handle);
-                lcd_task_handle = NULL;
-            }
-            if (xQueueLCDFrame) {
-                vQueueDelete(xQueueLCDFrame);
-                xQueueLCDFrame = NULL;
-            }
-            return false;
-        }
+    if (desc->format == UDP_FMT_JPEG || !camera_roi_clamp(&roi, desc->width, desc->height)) {
+        return desc;
     }
     
-    ESP_LOGI(TAG, "Camera started successfully");
-    return true;
+    size_t bpp = (desc->format == UDP_FMT_GRAY) ? 1 : 2;
+    *cropped = *desc;
+    cropped->data = desc->data + (size_t)roi.y * desc->stride + roi.x * bpp;
+    cropped->width = roi.width;
+    cropped->height = roi.height;
+    cropped->len = (size_t)(roi.height - 1) * desc->stride + roi.width * bpp;
+    return cropped;
 }
 
-// 停止摄像头功能
-bool camera_stop(void)
+// 记录触发时间并唤醒导出任务（任务和ISR中都可调用）
+static void camera_prerec_request(uint8_t source, uint16_t pre_ms, bool from_isr)
 {
-    ESP_LOGI(TAG, "Stopping camera...");
-    
-    camera_running = false;
-    lcd_display_running = false;
-    fps_monitor_running = false;
-    
-    // 等待任务结束
-    if (camera_task_handle) {
-        vTaskDelete(camera_task_handle);
-        camera_task_handle = NULL;
+    TaskHandle_t task = prerec_task_handle;
+    if (!task) {
+        return;
     }
     
-    if (lcd_task_handle) {
-        vTaskDelete(lcd_task_handle);
-        lcd_task_handle = NULL;
+    int64_t now = esp_timer_get_time();
+    if (from_isr) {
+        taskENTER_CRITICAL_ISR(&prerec_lock);
+    } else {
+        taskENTER_CRITICAL(&prerec_lock);
     }
-    
-    if (fps_monitor_task_handle) {
-        vTaskDelete(fps_monitor_task_handle);
-        fps_monitor_task_handle = NULL;
+    prerec_trigger_us = now;
+    prerec_trigger_pre_ms = pre_ms ? pre_ms : prerec_config.pre_event_ms;
+    prerec_stats.triggers++;
+    if (from_isr) {
+        taskEXIT_CRITICAL_ISR(&prerec_lock);
+    } else {
+        taskEXIT_CRITICAL(&prerec_lock);
     }
     
-    // 清理队列
-    if (xQueueLCDFrame) {
-        vQueueDelete(xQueueLCDFrame);
-        xQueueLCDFrame = NULL;
+    if (from_isr) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(task, source, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotify(task, source, eSetBits);
     }
-    
-    ESP_LOGI(TAG, "Camera stopped successfully");
-    return true;
 }
 
-// 启动帧率监控
-bool camera_start_fps_monitor(void)
+static void camera_prerec_gpio_isr(void *arg)
 {
-    if (fps_monitor_running) {
-        ESP_LOGW(TAG, "FPS monitor already running");
-        return true;
-    }
-    
-    fps_monitor_running = true;
-    BaseType_t ret = xTaskCreatePinnedToCore(
-        fps_monitor_task, 
-        "fps_monitor", 
-        4 * 1024, 
-        NULL, 
-        4, 
-        &fps_monitor_task_handle, 
-        1
-    );
-    
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create FPS monitor task");
-        fps_monitor_running = false;
-        return false;
+    if (prerec_enabled) {
+        camera_prerec_request(CAMERA_PREREC_TRIGGER_GPIO, 0, true);
     }
-    
-    ESP_LOGI(TAG, "FPS monitor started successfully");
-    return true;
 }
 
-// 停止帧率监控
-bool camera_stop_fps_monitor(void)
+static int64_t camera_prerec_trigger_time(uint16_t *pre_ms)
 {
-    if (!fps_monitor_running) {
-        ESP_LOGW(TAG, "FPS monitor not running");
-        return true;
+    taskENTER_CRITICAL(&prerec_lock);
+    int64_t t = prerec_trigger_us;
+    if (pre_ms) {
+        *pre_ms = prerec_trigger_pre_ms;
     }
+    taskEXIT_CRITICAL(&prerec_lock);
+    return t;
+}
+
+// JPEG编码输出直接写入环形缓冲区的预留区域
+typedef struct {
+    uint8_t *dst;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+} camera_jpeg_sink_t;
+
+static size_t camera_jpeg_sink_write(void *arg, size_t index, const void *data, size_t len)
+{
+    camera_jpeg_sink_t *sink = (camera_jpeg_sink_t *)arg;
+    if (!data || len == 0) {
+        return 0;
+    }
+    if (index + len > sink->capacity) {
+        sink->overflow = true;
+        return 0;  // 编码器随即中止
+    }
+    memcpy(sink->dst + index, data, len);
+    sink->len = index + len;
+    return len;
+}
+
+// 把一帧写入预录缓冲区（原始帧去掉行填充，或JPEG压缩）
+static void camera_prerec_record(const wifi_frame_desc_t *desc)
+{
+    if (!prerec_enabled) {
+        return;
+    }
+    
+    int64_t start = esp_timer_get_time();
+    xSemaphoreTake(prerec_mutex, portMAX_DELAY);
+    if (!prerec_enabled) {
+        xSemaphoreGive(prerec_mutex);
+        return;
+    }
+    
+    size_t max_len = wifi_frame_packed_size(desc);
+    uint8_t *dst = prerec_reserve(prerec_ring, max_len);
+    wifi_frame_desc_t meta = *desc;
+    size_t len = 0;
+    if (dst && prerec_config.jpeg_quality > 0 && desc->format != UDP_FMT_JPEG) {
+        camera_jpeg_sink_t sink = { .dst = dst, .capacity = max_len };
+        if (fmt2jpg_cb((uint8_t *)desc->data, desc->len, desc->width, desc->height, stream_pixformat,
+                       prerec_config.jpeg_quality, camera_jpeg_sink_write, &sink) && !sink.overflow) {
+            len = sink.len;
+        }
+        meta.format = UDP_FMT_JPEG;
+        meta.stride = 0;
+        meta.flags &= (uint8_t)~UDP_FLAG_BIG_ENDIAN;
+    } else if (dst) {
+        len = wifi_frame_copy_packed(desc, dst);
+        meta.stride = (len == desc->len) ? desc->stride : len / desc->height;
+    }
+    if (!prerec_commit(prerec_ring, len, &meta)) {
+        prerec_stats.frames_dropped++;
+    }
+    xSemaphoreGive(prerec_mutex);
+    
+    prerec_stats.record_time_us = (uint32_t)(esp_timer_get_time() - start);
+}
+
+// 导出任务：触发后按时间戳找到触发前pre_event_ms的第一帧，逐帧拷贝出来限速发送
+static void camera_prerec_task(void *arg)
+{
+    int64_t last_dumped_us = 0;  // 连续触发时不重复导出
+    
+    ESP_LOGI(TAG, "Pre-record dump task started");
+    
+    while (!prerec_task_stop) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        if (prerec_task_stop || (bits & CAMERA_PREREC_NOTIFY_STOP)) {
+            break;
+        }
+        
+        uint16_t pre_ms = 0;
+        int64_t from_us = camera_prerec_trigger_time(&pre_ms) - (int64_t)pre_ms * 1000;
+        if (from_us <= last_dumped_us) {
+            from_us = last_dumped_us + 1;
+        }
+        
+        ESP_LOGI(TAG, "Dumping pre-record frames (trigger 0x%lx, %d ms)", bits, pre_ms);
+        prerec_stats.dumping = true;
+        
+        while (!prerec_task_stop) {
+            // 每帧重新查找：导出期间最旧的帧可能已被覆盖，新的触发会顺延截止时间
+            prerec_entry_t entry;
+            uint32_t seq = 0;
+            bool ok = false;
+            xSemaphoreTake(prerec_mutex, portMAX_DELAY);
+            if (prerec_ring && prerec_find(prerec_ring, from_us, &seq) && prerec_get(prerec_ring, seq, &entry) &&
+                entry.timestamp_us <= camera_prerec_trigger_time(NULL) && entry.len <= MAX_FRAME_SIZE) {
+                memcpy(prerec_dump_buf, prerec_ring->arena + entry.offset, entry.len);
+                ok = true;
+            }
+            xSemaphoreGive(prerec_mutex);
+            if (!ok) {
+                break;
+            }
+            
+            wifi_frame_desc_t desc = {
+                .data = prerec_dump_buf,
+                .len = entry.len,
+                .width = entry.width,
+                .height = entry.height,
+                .stride = entry.stride,
+                .format = entry.format,
+                .flags = entry.flags,
+                .timestamp_us = entry.timestamp_us,
+            };
+            if (wifi_send_recorded_frame(&desc, entry.seq) > 0) {
+                prerec_stats.frames_dumped++;
+                prerec_stats.bytes_dumped += entry.len;
+            }
+            from_us = entry.timestamp_us + 1;
+            last_dumped_us = entry.timestamp_us;
+            
+            // 限速：kbit/s 等于 bit/ms
+            uint32_t delay_ms = entry.len * 8 / prerec_config.dump_rate_kbps;
+            vTaskDelay(pdMS_TO_TICKS(delay_ms) ? pdMS_TO_TICKS(delay_ms) : 1);
+        }
+        
+        prerec_stats.dumping = false;
+        prerec_stats.dumps++;
+    }
+    
+    ESP_LOGI(TAG, "Pre-record dump task stopped");
+    prerec_task_handle = NULL;
+    xSemaphoreGive(prerec_task_exit);
+    vTaskDelete(NULL);
+}
+
+// ISP条带：以行为单元，分界处的两行从事先保存的副本读取
+typedef struct {
+    isp_frame_t frame;
+    int mid;
+} camera_isp_job_t;
+
+static void camera_isp_stripe(void *ctx, int start, int end)
+{
+    const camera_isp_job_t *job = (const camera_isp_job_t *)ctx;
+    // 工作任务处理前半段，调用者处理后半段，各用一份行缓冲
+    isp_scratch_t *scratch = isp_scratch ? &isp_scratch[start == 0 ? 0 : 1] : NULL;
+    const uint8_t *above = (start > 0 && start == job->mid) ? isp_edge[0] : NULL;
+    const uint8_t *below = (end < job->frame.height && end == job->mid) ? isp_edge[1] : NULL;
+    isp_process_rows(&isp_state, scratch, &job->frame, start, end, above, below);
+}
+
+// ISP后处理：在帧缓冲区上原地修改，运动检测、预录、LCD和所有视频流输出都使用处理后的图像
+static void camera_isp_process(camera_fb_t *fb, const wifi_frame_desc_t *desc)
+{
+    if (!isp_state.config.enable) {
+        return;
+    }
+    if (desc->format != UDP_FMT_RGB565) {
+        isp_stats.frames_skipped++;
+        return;
+    }
+    
+    xSemaphoreTake(isp_mutex, portMAX_DELAY);
+    if (isp_state.config.enable) {
+        int64_t start = esp_timer_get_time();
+        camera_isp_job_t job = {
+            .frame = {
+                .data = fb->buf,
+                .width = desc->width,
+                .height = desc->height,
+                .stride = desc->stride,
+                .big_endian = (desc->flags & UDP_FLAG_BIG_ENDIAN) != 0,
+            },
+            .mid = STRIPE_SPLIT(desc->height),
+        };
+        
+        if (isp_state.config.sharpen) {
+            if (isp_scratch && desc->width <= ISP_MAX_WIDTH && job.mid > 0) {
+                // 锐化要读相邻行，另一个核可能先改写分界行，事先保存原始数据
+                memcpy(isp_edge[0], fb->buf + (size_t)(job.mid - 1) * desc->stride, desc->width * 2);
+                memcpy(isp_edge[1], fb->buf + (size_t)job.mid * desc->stride, desc->width * 2);
+            } else {
+                isp_stats.frames_skipped++;   // 只做颜色处理
+            }
+        }
+        
+        stripe_run(STRIPE_STAGE_ISP, camera_isp_stripe, &job, desc->height);
+        
+        isp_stats.frames++;
+        isp_stats.process_time_us = (uint32_t)(esp_timer_get_time() - start);
+        if (isp_stats.process_time_us > isp_stats.max_process_time_us) {
+            isp_stats.max_process_time_us = isp_stats.process_time_us;
+        }
+    }
+    xSemaphoreGive(isp_mutex);
+}
+
+// GC0308寄存器（第0页）：曝光行数0x03[3:0]/0x04，AEC使能0xd2[7]，全局增益0x50[5:0]（0x10为1倍）
+#define GC0308_REG_PAGE 0xfe
+#define GC0308_REG_EXP_H 0x03
+#define GC0308_REG_EXP_L 0x04
+#define GC0308_REG_AEC_MODE 0xd2
+#define GC0308_REG_GLOBAL_GAIN 0x50
+#define GC0308_AE_MAX_EXPOSURE 500      // 约一帧时间（30FPS），更长会降低帧率
+#define GC0308_AE_MAX_GAIN_X16 0x3f
+
+#define CAMERA_AE_GAIN_UNITY 16         // 增益1倍
+#define CAMERA_AE_MAX_EXPOSURE 1200     // 通用接口 aec_value 上限
+#define CAMERA_AE_MAX_GAIN_X16 (31 * CAMERA_AE_GAIN_UNITY)  // 通用接口 agc_gain 0..30 约为1..31倍
+
+// 切换传感器自带AEC/AGC与手动曝光
+static bool camera_ae_set_manual(sensor_t *s, bool manual)
+{
+    if (s->id.PID == GC0308_PID) {
+        // GC0308驱动没有实现通用的曝光/增益接口，直接写寄存器
+        const i2c_bus_reg_t regs[] = {
+            { GC0308_REG_PAGE, 0xff, 0x00 },
+            { GC0308_REG_AEC_MODE, 0x80, manual ? 0x00 : 0x80 },
+        };
+        return i2c_bus_write_regs(s->slv_addr, regs, sizeof(regs) / sizeof(regs[0])) == ESP_OK;
+    }
+    return s->set_exposure_ctrl(s, manual ? 0 : 1) == 0 && s->set_gain_ctrl(s, manual ? 0 : 1) == 0;
+}
+
+static bool camera_ae_write(sensor_t *s, uint16_t exposure, uint16_t gain_x16)
+{
+    if (s->id.PID == GC0308_PID) {
+        // 0x03高4位未使用，整字节写入省去读取；0x50高2位保留，按掩码修改
+        const i2c_bus_reg_t regs[] = {
+            { GC0308_REG_PAGE, 0xff, 0x00 },
+            { GC0308_REG_EXP_H, 0xff, (exposure >> 8) & 0x0f },
+            { GC0308_REG_EXP_L, 0xff, exposure & 0xff },
+            { GC0308_REG_GLOBAL_GAIN, 0x3f, gain_x16 },
+        };
+        return i2c_bus_write_regs(s->slv_addr, regs, sizeof(regs) / sizeof(regs[0])) == ESP_OK;
+    }
+    if (!i2c_bus_lock()) {
+        return false;
+    }
+    bool ok = s->set_aec_value(s, exposure) == 0 && s->set_agc_gain(s, gain_x16 / CAMERA_AE_GAIN_UNITY - 1) == 0;
+    i2c_bus_unlock();
+    return ok;
+}
+
+// 曝光/增益上限：配置值、预设与传感器默认上限取较小者
+static void camera_ae_limits(sensor_t *s, uint16_t *max_exposure, uint16_t *max_gain_x16)
+{
+    const bool gc0308 = s->id.PID == GC0308_PID;
+    *max_exposure = gc0308 ? GC0308_AE_MAX_EXPOSURE : CAMERA_AE_MAX_EXPOSURE;
+    if (camera_profiles[camera_profile].max_exposure && camera_profiles[camera_profile].max_exposure < *max_exposure) {
+        *max_exposure = camera_profiles[camera_profile].max_exposure;
+    }
+    *max_gain_x16 = gc0308 ? GC0308_AE_MAX_GAIN_X16 : CAMERA_AE_MAX_GAIN_X16;
+    if (ae_config.max_exposure && ae_config.max_exposure < *max_exposure) {
+        *max_exposure = ae_config.max_exposure;
+    }
+    if (ae_config.max_gain_x16 && ae_config.max_gain_x16 < *max_gain_x16) {
+        *max_gain_x16 = ae_config.max_gain_x16 < CAMERA_AE_GAIN_UNITY ? CAMERA_AE_GAIN_UNITY : ae_config.max_gain_x16;
+    }
+}
+
+// 快速自动曝光：按测光亮度与目标的比值一步调整总曝光量（曝光 x 增益），优先加曝光，到上限后再加增益
+static void camera_ae_update(const fstats_result_t *result, uint8_t metered)
+{
+    sensor_t *s = NULL;
+    
+    if (ae_reconfigure) {
+        taskENTER_CRITICAL(&fstats_lock);
+        ae_config = ae_pending;
+        ae_reconfigure = false;
+        taskEXIT_CRITICAL(&fstats_lock);
+        
+        s = esp_camera_sensor_get();
+        if (!s || !camera_ae_set_manual(s, ae_config.enable)) {
+            fstats_published.ae_errors++;
+            ESP_LOGW(TAG, "Failed to switch sensor exposure mode");
+            return;
+        }
+        if (!ae_config.enable) {
+            return;
+        }
+        uint16_t max_exposure, max_gain_x16;
+        camera_ae_limits(s, &max_exposure, &max_gain_x16);
+        if (ae_exposure == 0 || ae_exposure > max_exposure || ae_gain_x16 > max_gain_x16) {
+            ae_exposure = max_exposure / 2;
+            ae_gain_x16 = CAMERA_AE_GAIN_UNITY;
+        }
+        if (!camera_ae_write(s, ae_exposure, ae_gain_x16)) {
+            fstats_published.ae_errors++;
+        }
+        ae_settle = ae_config.settle_frames;
+        return;
+    }
+    
+    if (!ae_config.enable) {
+        return;
+    }
+    if (ae_settle > 0) {
+        ae_settle--;
+        return;
+    }
+    
+    const int err = (int)ae_config.target_luma - metered;
+    if (err <= ae_config.deadband && err >= -(int)ae_config.deadband) {
+        return;
+    }
+    
+    // 比值（Q8）限制在0.5-2倍；接近目标时步长减半，避免在死区两侧振荡
+    uint32_t ratio = (uint32_t)ae_config.target_luma * 256 / (metered ? metered : 1);
+    ratio = ratio < 128 ? 128 : (ratio > 512 ? 512 : ratio);
+    if (err <= 3 * ae_config.deadband && err >= -3 * (int)ae_config.deadband) {
+        ratio = (ratio + 256) / 2;
+    }
+    
+    s = esp_camera_sensor_get();
+    if (!s) {
+        return;
+    }
+    uint16_t max_exposure, max_gain_x16;
+    camera_ae_limits(s, &max_exposure, &max_gain_x16);
+    
+    uint32_t total = ((uint32_t)ae_exposure * ae_gain_x16 * ratio) >> 8;
+    uint32_t exposure = total / CAMERA_AE_GAIN_UNITY;
+    exposure = exposure < 1 ? 1 : (exposure > max_exposure ? max_exposure : exposure);
+    uint32_t gain = total / exposure;
+    gain = gain < CAMERA_AE_GAIN_UNITY ? CAMERA_AE_GAIN_UNITY : (gain > max_gain_x16 ? max_gain_x16 : gain);
+    if (exposure == ae_exposure && gain == ae_gain_x16) {
+        return;     // 已到上限/下限
+    }
+    
+    if (!camera_ae_write(s, (uint16_t)exposure, (uint16_t)gain)) {
+        fstats_published.ae_errors++;
+        return;
+    }
+    ESP_LOGD(TAG, "AE: metered %d, mean %d -> exposure %lu, gain %lu/16", metered, result->mean, exposure, gain);
+    ae_exposure = (uint16_t)exposure;
+    ae_gain_x16 = (uint16_t)gain;
+    ae_settle = ae_config.settle_frames;
+    fstats_published.ae_updates++;
+}
+
+// 帧统计（在ISP之前，按传感器原始输出测光），结果发布给 camera_get_frame_stats，并驱动自动曝光
+static void camera_fstats_update(const wifi_frame_desc_t *desc)
+{
+    if (!fstats_enabled) {
+        return;
+    }
+    
+    int64_t start = esp_timer_get_time();
+    fstats_result_t result;
+    if (!fstats_process(&fstats, desc, &result)) {
+        return;
+    }
+    uint8_t metered = fstats_metered_luma(&result);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    
+    taskENTER_CRITICAL(&fstats_lock);
+    fstats_published.result = result;
+    fstats_published.metered_luma = metered;
+    fstats_published.frames++;
+    fstats_published.process_time_us = elapsed;
+    if (elapsed > fstats_published.max_process_time_us) {
+        fstats_published.max_process_time_us = elapsed;
+    }
+    taskEXIT_CRITICAL(&fstats_lock);
+    
+    if (result.obstructed != fstats_was_obstructed) {
+        fstats_was_obstructed = result.obstructed;
+        if (result.obstructed) {
+            ESP_LOGW(TAG, "Lens obstructed: mean %d, p5/p95 %d/%d", result.mean, result.p5, result.p95);
+        } else {
+            ESP_LOGI(TAG, "Lens clear");
+        }
+    }
+    if (result.blurred != fstats_was_blurred) {
+        fstats_was_blurred = result.blurred;
+        if (result.blurred) {
+            ESP_LOGW(TAG, "Image blurred: sharpness %lu (reference %lu)", result.sharpness, result.sharpness_ref);
+        } else {
+            ESP_LOGI(TAG, "Image sharp again");
+        }
+    }
+    
+    camera_ae_update(&result, metered);
+}
+
+// 运动检测与门控：返回本帧是否需要发送到视频流输出
+static bool camera_motion_update(wifi_frame_desc_t *desc)
+{
+    if (!motion_enabled) {
+        return true;
+    }
+    
+    int64_t start = esp_timer_get_time();
+    if (!motion_process(&motion_detector, desc, &motion_last)) {
+        return true;
+    }
+    motion_time_us = (uint32_t)(esp_timer_get_time() - start);
+    if (motion_time_us > motion_max_time_us) {
+        motion_max_time_us = motion_time_us;
+    }
+    
+    if (motion_last.event == MOTION_EVENT_START) {
+        ESP_LOGI(TAG, "Motion started: score %d, %d boxes", motion_last.score, motion_last.box_count);
+        if (prerec_enabled && (prerec_config.triggers & CAMERA_PREREC_TRIGGER_MOTION)) {
+            camera_prerec_request(CAMERA_PREREC_TRIGGER_MOTION, 0, false);
+        }
+    } else if (motion_last.event == MOTION_EVENT_END) {
+        ESP_LOGI(TAG, "Motion ended");
+    }
+    
+    if (motion_last.active) {
+        desc->flags |= UDP_FLAG_MOTION;
+        motion_idle_counter = 0;  // 运动开始的第一帧立即发送
+        return true;
+    }
+    
+    // 空闲模式：每motion_idle_divider帧发送1帧
+    uint8_t divider = motion_idle_divider;
+    if (divider == 0 || (motion_idle_counter++ % divider) == 0) {
+        return true;
+    }
+    motion_frames_gated++;
+    return false;
+}
+
+// 保存快照JPEG（传感器直接输出JPEG时拷贝，否则在设备端编码）
+static bool camera_snapshot_store(camera_fb_t *fb)
+{
+    uint8_t *jpeg = NULL;
+    size_t len = 0;
+    
+    if (fb->format == PIXFORMAT_JPEG) {
+        jpeg = heap_caps_malloc(fb->len, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        if (jpeg) {
+            memcpy(jpeg, fb->buf, fb->len);
+            len = fb->len;
+        }
+    } else if (!frame2jpg(fb, CAMERA_SNAPSHOT_ENCODE_QUALITY, &jpeg, &len)) {
+        jpeg = NULL;
+    }
+    
+    if (!jpeg) {
+        ESP_LOGE(TAG, "Memory for snapshot is not enough");
+        return false;
+    }
+    
+    free(snapshot_buf);
+    snapshot_buf = jpeg;
+    snapshot_len = len;
+    snapshot_stats.last_size = len;
+    snapshot_stats.last_width = fb->width;
+    snapshot_stats.last_height = fb->height;
+    return true;
+}
+
+// 重新初始化驱动为视频流配置
+static bool camera_stream_restore(void)
+{
+    camera_config_t config;
+    camera_fill_driver_config(&config, stream_pixformat, (framesize_t)current_config.frame_size,
+                              camera_profiles[camera_profile].fb_count);
+    esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restore stream mode: 0x%x", err);
+        return false;
+    }
+    
+    sensor_t *s = esp_camera_sensor_get();
+    if (s) {
+        camera_sensor_setup(s);
+    }
+    if (sensor_window_active) {
+        camera_sensor_set_window(&sensor_roi);
+    }
+    motion_reset(&motion_detector);  // 曝光会短暂变化，重新建立背景避免误报
+    if (ae_config.enable) {
+        // 重新初始化后传感器回到自带AEC，重新切换到手动曝光并写回当前值
+        taskENTER_CRITICAL(&fstats_lock);
+        if (!ae_reconfigure) {
+            ae_pending = ae_config;
+            ae_reconfigure = true;
+        }
+        taskEXIT_CRITICAL(&fstats_lock);
+    }
+    return true;
+}
+
+// 切换传感器预设；摄像头已初始化时重新初始化驱动（帧缓冲区数量和时钟只能在初始化时设置）
+bool camera_set_profile(camera_profile_t profile)
+{
+    if (profile >= CAMERA_PROFILE_MAX) {
+        ESP_LOGE(TAG, "Invalid camera profile %d", profile);
+        return false;
+    }
+    if (camera_running) {
+        ESP_LOGW(TAG, "Cannot change profile while camera is running");
+        return false;
+    }
+    if (fb_outstanding > 0) {
+        ESP_LOGW(TAG, "Cannot change profile with %d frame buffers outstanding", fb_outstanding);
+        return false;
+    }
+    
+    camera_profile = profile;
+    if (camera_profiles[profile].xclk_freq_hz) {
+        current_config.xclk_freq_hz = camera_profiles[profile].xclk_freq_hz;
+    }
+    
+    if (esp_camera_sensor_get()) {
+        esp_camera_deinit();
+        if (!camera_stream_restore()) {
+            return false;
+        }
+    }
+    
+    const camera_profile_desc_t *p = &camera_profiles[profile];
+    ESP_LOGI(TAG, "Camera profile %s: XCLK %lu Hz, %d buffers, %s, max exposure %d",
+             p->name, current_config.xclk_freq_hz, p->fb_count,
+             p->grab_mode == CAMERA_GRAB_LATEST ? "grab latest" : "grab when empty", p->max_exposure);
+    return true;
+}
+
+camera_profile_t camera_get_profile(void)
+{
+    return camera_profile;
+}
+
+const char* camera_profile_name(camera_profile_t profile)
+{
+    return profile < CAMERA_PROFILE_MAX ? camera_profiles[profile].name : "unknown";
+}
+
+// 预设基准测试：切换到该预设后连续取帧，统计实际帧率和采集延迟（帧时间戳到取得帧缓冲区）
+bool camera_benchmark_profile(camera_profile_t profile, uint32_t frames, uint32_t work_ms, camera_profile_bench_t *result)
+{
+    if (!result || frames == 0) {
+        ESP_LOGE(TAG, "Invalid benchmark parameters");
+        return false;
+    }
+    if (!camera_set_profile(profile)) {
+        return false;
+    }
+    
+    memset(result, 0, sizeof(*result));
+    result->profile = profile;
+    result->name = camera_profiles[profile].name;
+    
+    // 丢弃切换后的前几帧（曝光稳定、缓冲区中的旧帧）
+    for (int i = 0; i < CAMERA_SNAPSHOT_SKIP_FRAMES + camera_profiles[profile].fb_count; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb) {
+            esp_camera_fb_return(fb);
+        }
+    }
+    
+    uint64_t latency_sum = 0;
+    int64_t first_us = 0;
+    int64_t last_us = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        int64_t now = esp_timer_get_time();
+        if (!fb) {
+            result->failed++;
+            continue;
+        }
+        int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+        uint32_t latency = now > ts ? (uint32_t)(now - ts) : 0;
+        latency_sum += latency;
+        if (latency > result->max_latency_us) {
+            result->max_latency_us = latency;
+        }
+        if (result->frames == 0) {
+            first_us = now;
+        }
+        last_us = now;
+        result->frames++;
+        
+        // 模拟每帧处理耗时（取帧模式对延迟的影响只在处理慢于传感器时体现）
+        if (work_ms) {
+            vTaskDelay(pdMS_TO_TICKS(work_ms));
+        }
+        esp_camera_fb_return(fb);
+    }
+    
+    if (result->frames > 1) {
+        result->fps_x10 = (uint32_t)((uint64_t)(result->frames - 1) * 10000000 / (uint64_t)(last_us - first_us));
+    }
+    if (result->frames) {
+        result->avg_latency_us = (uint32_t)(latency_sum / result->frames);
+    }
+    ESP_LOGI(TAG, "Profile %-11s: %lu.%lu FPS, latency avg %lu us, max %lu us, %lu frames, %lu failed (work %lu ms)",
+             result->name, result->fps_x10 / 10, result->fps_x10 % 10, result->avg_latency_us, result->max_latency_us,
+             result->frames, result->failed, work_ms);
+    return true;
+}
+
+// 切换到快照模式拍摄一张，然后恢复视频流（在捕获任务中调用，或摄像头未运行时直接调用）
+static bool camera_snapshot_run(void)
+{
+    int64_t start = esp_timer_get_time();
+    
+    sensor_t *s = esp_camera_sensor_get();
+    camera_sensor_info_t *info = s ? esp_camera_sensor_get_info(&s->id) : NULL;
+    framesize_t size = CAMERA_SNAPSHOT_FRAMESIZE;
+    if (info && info->max_size < size) {
+        size = info->max_size;
+    }
+    pixformat_t format = (info && info->support_jpeg) ? PIXFORMAT_JPEG : PIXFORMAT_RGB565;
+    
+    // 归还所有帧缓冲区后才能重新初始化驱动
+    pipeline_flush(&camera_pipeline);
+    for (int i = 0; i < 50 && fb_outstanding > 0; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));  // 等待LCD任务画完手上的帧
+    }
+    if (fb_outstanding > 0) {
+        ESP_LOGW(TAG, "Frame buffers still in use, snapshot skipped");
+        return false;
+    }
+    
+    bool ok = false;
+    esp_camera_deinit();
+    
+    camera_config_t config;
+    camera_fill_driver_config(&config, format, size, 1);
+    esp_err_t err = esp_camera_init(&config);
+    if (err == ESP_OK) {
+        s = esp_camera_sensor_get();
+        if (s) {
+            camera_sensor_setup(s);
+        }
+        for (int i = 0; i < CAMERA_SNAPSHOT_SKIP_FRAMES; i++) {
+            camera_fb_t *fb = esp_camera_fb_get();
+            if (fb) {
+                esp_camera_fb_return(fb);
+            }
+        }
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb) {
+            ok = camera_snapshot_store(fb);
+            esp_camera_fb_return(fb);
+        }
+        esp_camera_deinit();
+    } else {
+        ESP_LOGE(TAG, "Snapshot mode init failed: 0x%x", err);
+    }
+    
+    // 恢复失败时驱动处于未初始化状态，由捕获任务按退避间隔重试，期间不取帧
+    stream_restore_failed = !camera_stream_restore();
+    if (stream_restore_failed) {
+        stream_restore_delay_ms = CAMERA_RESTORE_RETRY_MS;
+        stream_restore_next = xTaskGetTickCount() + pdMS_TO_TICKS(stream_restore_delay_ms);
+        snapshot_stats.restore_failures++;
+    }
+    
+    snapshot_stats.last_capture_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    if (ok) {
+        snapshot_stats.count++;
+        ESP_LOGI(TAG, "Snapshot %dx%d, %lu bytes, %lu ms", snapshot_stats.last_width, snapshot_stats.last_height,
+                 snapshot_stats.last_size, snapshot_stats.last_capture_ms);
+    } else {
+        snapshot_stats.failures++;
+    }
+    return ok;
+}
+
+// 拍摄快照（调用者持有snapshot_mutex）
+static bool camera_snapshot_locked(uint32_t timeout_ms)
+{
+    // 摄像头未在采集时直接在调用者上下文切换模式
+    if (!pipeline_is_running(&camera_pipeline)) {
+        return camera_snapshot_run();
+    }
+    
+    xSemaphoreTake(snapshot_done, 0);
+    snapshot_requested = true;
+    if (xSemaphoreTake(snapshot_done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        ESP_LOGW(TAG, "Snapshot timed out");
+        return false;
+    }
+    return snapshot_ok;
+}
+
+bool camera_capture(void)
+{
+    if (!snapshot_mutex || xSemaphoreTake(snapshot_mutex, pdMS_TO_TICKS(CAMERA_SNAPSHOT_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Snapshot busy");
+        return false;
+    }
+    bool ok = camera_snapshot_locked(CAMERA_SNAPSHOT_TIMEOUT_MS);
+    xSemaphoreGive(snapshot_mutex);
+    return ok;
+}
+
+uint8_t* camera_get_image_data(void)
+{
+    return snapshot_buf;
+}
+
+size_t camera_get_image_size(void)
+{
+    return snapshot_len;
+}
+
+bool camera_get_snapshot_stats(camera_snapshot_stats_t *stats)
+{
+    if (!stats) {
+        ESP_LOGE(TAG, "Invalid snapshot stats pointer");
+        return false;
+    }
+    
+    *stats = snapshot_stats;
+    return true;
+}
+
+// HTTP快照回调：持有snapshot_mutex直到发送完成，保证发送期间数据不被下一张快照替换
+static bool camera_http_snapshot_take(wifi_http_snapshot_t *snapshot, uint32_t timeout_ms)
+{
+    if (!snapshot_mutex || xSemaphoreTake(snapshot_mutex, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return false;
+    }
+    if (!camera_snapshot_locked(timeout_ms)) {
+        xSemaphoreGive(snapshot_mutex);
+        return false;
+    }
+    
+    snapshot->data = snapshot_buf;
+    snapshot->len = snapshot_len;
+    snapshot->width = snapshot_stats.last_width;
+    snapshot->height = snapshot_stats.last_height;
+    return true;
+}
+
+static void camera_http_snapshot_release(void)
+{
+    xSemaphoreGive(snapshot_mutex);
+}
+
+#define CAMERA_POWER_POLL_MS 250
+#define CAMERA_POWER_STATIC_IS_RECEIVER 0  // FPV默认目的地址（广播）是否算作接收端（无法知道是否有人在收）
+
+static int64_t power_next_poll_us = 0;
+
+// 当前视频流接收端数：FPV订阅者、HTTP客户端、RTSP播放会话
+static int camera_stream_receivers(void)
+{
+    int receivers = 0;
+    if (!wifi_is_connected()) {
+        return 0;  // 断线期间没有人能收到
+    }
+    if (fpv_running) {
+        wifi_subscriber_info_t subs[WIFI_MAX_SUBSCRIBERS];
+        int count = wifi_get_subscribers(subs, WIFI_MAX_SUBSCRIBERS);
+        for (int i = 0; i < count; i++) {
+            if (!subs[i].is_static || CAMERA_POWER_STATIC_IS_RECEIVER) {
+                receivers++;
+            }
+        }
+    }
+    wifi_http_stats_t http;
+    if (wifi_http_stream_get_stats(&http)) {
+        receivers += http.clients;
+    }
+    rtsp_stats_t rtsp;
+    if (rtsp_server_get_stats(&rtsp)) {
+        receivers += rtsp.playing + rtsp.multicast_viewers;
+    }
+    return receivers;
+}
+
+// 按接收端和运动状态切换功耗档位（捕获任务中每250ms检查一次）
+static void camera_power_poll(int64_t now_us)
+{
+    if (now_us < power_next_poll_us) {
+        return;
+    }
+    power_next_poll_us = now_us + CAMERA_POWER_POLL_MS * 1000;
+    
+    // LCD显示每一帧，不受运动门控影响
+    bool gated = motion_enabled && !motion_last.active;
+    bool active = lcd_display_running || (camera_stream_receivers() > 0 && !gated);
+    power_update(true, active);
+}
+
+// 视频流限速：默认目标30FPS，每33ms一帧；低延迟/最高帧率预设不限速，由传感器帧率决定
+static TickType_t capture_frame_delay = 0;
+static TickType_t capture_last_frame_time = 0;
+
+// 重试恢复视频流配置（捕获任务中调用）：未到重试时间时最多等待50ms后返回，不阻塞流水线停止
+static bool camera_stream_retry_restore(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(stream_restore_next - now) > 0) {
+        TickType_t wait = stream_restore_next - now;
+        vTaskDelay(wait < pdMS_TO_TICKS(50) ? wait : pdMS_TO_TICKS(50));
+        return false;
+    }
+    
+    if (!camera_stream_restore()) {
+        stream_restore_delay_ms = stream_restore_delay_ms * 2 < CAMERA_RESTORE_RETRY_MAX_MS ?
+                                  stream_restore_delay_ms * 2 : CAMERA_RESTORE_RETRY_MAX_MS;
+        stream_restore_next = xTaskGetTickCount() + pdMS_TO_TICKS(stream_restore_delay_ms);
+        ESP_LOGW(TAG, "Stream mode restore failed, retrying in %lu ms", stream_restore_delay_ms);
+        return false;
+    }
+    stream_restore_failed = false;
+    ESP_LOGI(TAG, "Stream mode restored");
+    return true;
+}
+
+// 流水线帧源：处理快照请求、限速后取帧（在捕获任务中调用）
+static void *camera_source_get(void *ctx)
+{
+    // 快照请求：由本任务切换传感器模式，保证切换期间没有其他地方访问驱动
+    if (snapshot_requested) {
+        snapshot_ok = camera_snapshot_run();
+        snapshot_requested = false;
+        snapshot_gap_pending = true;
+        xSemaphoreGive(snapshot_done);
+    }
+    
+    // 快照后驱动未能恢复：重试成功前不调用 esp_camera_fb_get()
+    if (stream_restore_failed && !camera_stream_retry_restore()) {
+        return NULL;
+    }
+    
+    // ROI请求：与快照一样由本任务在两帧之间编程传感器，不与 esp_camera_fb_get() 并发访问驱动
+    camera_roi_apply_pending();
+    
+    // 控制帧率 - 等待到下一帧时间
+    TickType_t elapsed = xTaskGetTickCount() - capture_last_frame_time;
+    if (elapsed < capture_frame_delay) {
+        vTaskDelay(capture_frame_delay - elapsed);
+    }
+    
+    // WiFi断线且没有LCD时降低采集帧率（预录和统计继续），重连后下一次检查即恢复全帧率
+    while (!lcd_display_running && !wifi_is_connected() &&
+           xTaskGetTickCount() - capture_last_frame_time < pdMS_TO_TICKS(CAMERA_OUTAGE_FRAME_INTERVAL_MS)) {
+        vTaskDelay(pdMS_TO_TICKS(CAMERA_OUTAGE_POLL_MS));
+    }
+    capture_last_frame_time = xTaskGetTickCount();
+    
+    camera_fb_t *frame = esp_camera_fb_get();
+    if (!frame) {
+        ESP_LOGW(TAG, "Failed to get camera frame");
+        vTaskDelay(pdMS_TO_TICKS(50));  // 获取帧失败时的延迟
+        return NULL;
+    }
+    taskENTER_CRITICAL(&fb_lock);
+    fb_outstanding++;
+    taskEXIT_CRITICAL(&fb_lock);
+    return frame;
+}
+
+static void camera_source_put(void *ctx, void *frame)
+{
+    camera_fb_release((camera_fb_t *)frame);
+}
+
+// 捕获任务中的逐帧处理，返回true交给LCD显示任务
+static bool camera_process_frame(void *ctx, void *arg)
+{
+    camera_fb_t *frame = (camera_fb_t *)arg;
+    camera_frame_count++;  // 统计摄像头捕获帧数
+    
+    // 记录快照造成的视频流中断（快照前最后一帧到恢复后第一帧）
+    int64_t frame_us = esp_timer_get_time();
+    // 缺帧数按快照前实测的帧间隔换算（不限速的预设由传感器帧率决定，不一定是33ms）
+    if (snapshot_gap_pending) {
+        snapshot_gap_pending = false;
+        uint32_t gap_us = (uint32_t)(frame_us - last_stream_frame_us);
+        uint32_t interval_us = stream_frame_interval_us ? stream_frame_interval_us : CAMERA_FRAME_INTERVAL_MS * 1000;
+        uint32_t gap_ms = gap_us / 1000;
+        snapshot_stats.last_gap_ms = gap_ms;
+        snapshot_stats.last_gap_frames = gap_us > interval_us ? (gap_us + interval_us / 2) / interval_us - 1 : 0;
+        if (gap_ms > snapshot_stats.max_gap_ms) {
+            snapshot_stats.max_gap_ms = gap_ms;
+        }
+        ESP_LOGI(TAG, "Snapshot stream gap: %lu ms (%lu frames at %lu us/frame)", gap_ms,
+                 snapshot_stats.last_gap_frames, interval_us);
+    } else if (last_stream_frame_us) {
+        uint32_t interval_us = (uint32_t)(frame_us - last_stream_frame_us);
+        stream_frame_interval_us = stream_frame_interval_us ?
+                                   stream_frame_interval_us - stream_frame_interval_us / 8 + interval_us / 8 : interval_us;
+    }
+    last_stream_frame_us = frame_us;
+    
+    // 帧描述（尺寸、格式、时间戳取自实际帧缓冲区）
+    wifi_frame_desc_t desc;
+    camera_fill_frame_desc(frame, &desc);
+    
+    // 帧统计和自动曝光（按传感器原始输出测光）
+    camera_fstats_update(&desc);
+    
+    // ISP后处理（白平衡、颜色矩阵、gamma、锐化，一次遍历）
+    camera_isp_process(frame, &desc);
+    
+    // 运动检测（空闲时降低视频流帧率，LCD不受影响）
+    bool stream_frame = camera_motion_update(&desc);
+    
+    // 预录（每帧都写入，不受运动门控影响）
+    camera_prerec_record(&desc);
+    
+    // WiFi断线期间不发送（重连状态机统计断线时长），重连后从最新帧继续
+    if (!wifi_is_connected()) {
+        stream_frame = false;
+    }
+    
+    // 如果启用了FPV模式，也发送到FPV
+    if (fpv_running && stream_frame) {
+        // 按FPV ROI裁剪（零拷贝），再按视频流格式转换（Y8/YUV420）后发送到FPV
+        wifi_frame_desc_t cropped, converted;
+        const wifi_frame_desc_t *fpv_desc = camera_roi_crop(&desc, &cropped);
+        fpv_desc = camera_stream_convert(fpv_desc, &converted);
+        static uint32_t fpv_frame_id = 0;
+        if (!wifi_send_camera_frame(fpv_desc, fpv_frame_id)) {
+            ESP_LOGW(TAG, "Failed to send FPV frame %lu", fpv_frame_id);
+        } else {
+            ESP_LOGD(TAG, "Sent FPV frame %lu, size: %d", fpv_frame_id, fpv_desc->len);
+        }
+        fpv_frame_id++;
+    }
+    
+    if (stream_frame) {
+        // 发布到设备端HTTP视频流（无观看者时立即返回）
+        wifi_http_stream_publish(&desc);
+        
+        // RTP/RTSP输出（无播放会话时立即返回）
+        rtsp_server_send_frame(&desc);
+    }
+    
+    // 按档位统计帧率和处理延迟，并切换功耗档位
+    int64_t done_us = esp_timer_get_time();
+    power_frame(done_us > desc.timestamp_us ? (uint32_t)(done_us - desc.timestamp_us) : 0);
+    camera_power_poll(done_us);
+    
+    // 交给LCD显示任务（没有LCD时流水线直接归还）
+    return true;
+}
+
+// 启动采集流水线，lcd为true时同时启动LCD显示任务
+static bool camera_pipeline_start(bool lcd)
+{
+    motion_init(&motion_detector, NULL);
+    fstats_init(&fstats, FSTATS_DEFAULT_STEP);
+    last_stream_frame_us = 0;       // 停止期间的间隔不计入帧间隔
+    stream_frame_interval_us = 0;
+    capture_frame_delay = pdMS_TO_TICKS(camera_profiles[camera_profile].frame_interval_ms);
+    capture_last_frame_time = xTaskGetTickCount();
+    
+    const pipeline_config_t config = {
+        .get = camera_source_get,
+        .put = camera_source_put,
+        .process = camera_process_frame,
+        .consume = lcd ? camera_lcd_consume : NULL,
+        .ctx = NULL,
+        .queue_len = 2,
+        .capture_name = "camera_capture",
+        .capture_stack = 6 * 1024,      // 快照需要在本任务中重新初始化驱动并编码JPEG
+        .capture_priority = 5,
+        .capture_core = 1,
+        .consumer_name = "camera_lcd",
+        .consumer_stack = 4 * 1024,
+        .consumer_priority = 5,
+        .consumer_core = 0,
+    };
+    // 先切到推流档位（启动后第一次检查接收端时再决定是否降档）
+    power_update(true, true);
+    power_next_poll_us = 0;
+    if (!pipeline_start(&camera_pipeline, &config)) {
+        ESP_LOGE(TAG, "Failed to start camera pipeline");
+        power_update(false, false);
+        return false;
+    }
+    lcd_display_running = lcd;
+    return true;
+}
+
+// 协作停止采集流水线：等待捕获/LCD任务退出，所有帧缓冲区归还后返回
+static bool camera_pipeline_stop(void)
+{
+    if (!pipeline_is_running(&camera_pipeline)) {
+        lcd_display_running = false;
+        return true;
+    }
+    if (pipeline_in_capture_task(&camera_pipeline)) {
+        ESP_LOGE(TAG, "Cannot stop camera pipeline from the capture task");
+        return false;
+    }
+    
+    bool ok = pipeline_stop(&camera_pipeline);
+    lcd_display_running = false;
+    if (ok) {
+        power_update(false, false);   // 任务已退出，可以释放APB/睡眠锁
+    }
+    
+    // 捕获任务已退出，未处理的快照请求不会再被处理，立即让等待者返回
+    if (snapshot_requested) {
+        snapshot_requested = false;
+        snapshot_ok = false;
+        xSemaphoreGive(snapshot_done);
+    }
+    camera_roi_apply_pending();  // 没有任务在取帧，直接编程传感器窗口
+    
+    pipeline_stats_t stats;
+    pipeline_get_stats(&camera_pipeline, &stats);
+    ESP_LOGI(TAG, "Camera pipeline stopped in %lu us (%lu frames drained, %ld outstanding)",
+             stats.last_stop_us, stats.drained, stats.outstanding);
+    return ok;
+}
+
+// LCD只能显示RGB565；开关LCD后按当前配置切换传感器输出格式（流水线停止时调用）
+static void camera_stream_reformat(void)
+{
+    pixformat_t format = camera_sensor_pixformat();
+    if (format == stream_pixformat || !esp_camera_sensor_get()) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Switching sensor format %d -> %d", stream_pixformat, format);
+    esp_camera_deinit();
+    pixformat_t previous = stream_pixformat;
+    stream_pixformat = format;
+    if (!camera_stream_restore()) {
+        stream_pixformat = format == PIXFORMAT_RGB565 ? previous : PIXFORMAT_RGB565;
+        camera_stream_restore();
+    }
+}
+
+// 启动摄像头到LCD的实时显示（正在采集时重启流水线加入LCD显示任务）
+bool camera_start_lcd_display(void)
+{
+    if (lcd_display_running) {
+        ESP_LOGW(TAG, "Camera LCD display already running");
+        return true;
+    }
+    
+    ESP_LOGI(TAG, "Starting camera LCD display...");
+    
+    if (pipeline_is_running(&camera_pipeline) && !camera_pipeline_stop()) {
+        return false;
+    }
+    current_config.enable_lcd_display = true;
+    camera_stream_reformat();
+    if (stream_pixformat != PIXFORMAT_RGB565) {
+        ESP_LOGE(TAG, "LCD display needs RGB565 sensor output");
+        current_config.enable_lcd_display = false;
+        if (camera_running && current_config.enable_capture_task) {
+            camera_pipeline_start(false);
+        }
+        return false;
+    }
+    if (!camera_pipeline_start(true)) {
+        return false;
+    }
+    camera_running = true;
+    
+    if (!fps_monitor_running && !camera_start_fps_monitor()) {
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "Camera LCD display started successfully");
+    return true;
+}
+
+// 启动摄像头功能（根据配置启动相应功能）
+bool camera_start(void)
+{
+    ESP_LOGI(TAG, "Starting camera with config: LCD=%d, FPS=%d, Capture=%d", 
+               current_config.enable_lcd_display, 
+               current_config.enable_fps_monitor,
+               current_config.enable_capture_task);
+    
+    if (camera_running) {
+        ESP_LOGW(TAG, "Camera already running");
+        return true;
+    }
+    
+    // 创建采集流水线（不需要LCD显示时没有LCD任务，帧处理完立即归还）
+    if (current_config.enable_capture_task && !camera_pipeline_start(current_config.enable_lcd_display)) {
+        return false;
+    }
+    
+    // 创建帧率监控任务
+    if (current_config.enable_fps_monitor && !camera_start_fps_monitor()) {
+        camera_pipeline_stop();
+        return false;
+    }
+    
+    camera_running = true;
+    
+    // 通过HTTP /snapshot 提供高分辨率快照
+    wifi_http_set_snapshot_handler(camera_http_snapshot_take, camera_http_snapshot_release);
+    
+    ESP_LOGI(TAG, "Camera started successfully");
+    return true;
+}
+
+// 停止摄像头功能（协作停止，返回后所有帧缓冲区都已归还，可以立即重新启动或切换预设）
+bool camera_stop(void)
+{
+    ESP_LOGI(TAG, "Stopping camera...");
     
-    fps_monitor_running = false;
+    wifi_http_set_snapshot_handler(NULL, NULL);
+    
+    bool ok = camera_stop_fps_monitor();
+    if (!camera_pipeline_stop()) {
+        ok = false;
+    }
+    camera_running = false;
     
+    if (ok) {
+        ESP_LOGI(TAG, "Camera stopped successfully");
+    } else {
+        ESP_LOGE(TAG, "Camera stopped with errors (%d frame buffers outstanding)", fb_outstanding);
+    }
+    return ok;
+}
+
+// 启动帧率监控
+bool camera_start_fps_monitor(void)
+{
+    if (fps_monitor_running) {
+        ESP_LOGW(TAG, "FPS monitor already running");
+        return true;
+    }
     if (fps_monitor_task_handle) {
-        vTaskDelete(fps_monitor_task_handle);
+        ESP_LOGE(TAG, "Previous FPS monitor task did not exit");
+        return false;
+    }
+    
+    fps_monitor_running = true;
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        fps_monitor_task, 
+        "fps_monitor", 
+        4 * 1024, 
+        NULL, 
+        4, 
+        &fps_monitor_task_handle, 
+        1
+    );
+    
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create FPS monitor task");
+        fps_monitor_running = false;
         fps_monitor_task_handle = NULL;
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "FPS monitor started successfully");
+    return true;
+}
+
+// 停止帧率监控：唤醒任务并等待其退出
+bool camera_stop_fps_monitor(void)
+{
+    if (!fps_monitor_running) {
+        return true;
     }
     
+    ulTaskNotifyTake(pdTRUE, 0);    // 清除残留的通知
+    fps_monitor_joiner = xTaskGetCurrentTaskHandle();
+    fps_monitor_running = false;
+    xTaskNotifyGive(fps_monitor_task_handle);
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAMERA_FPS_MONITOR_STOP_TIMEOUT_MS)) == 0) {
+        ESP_LOGE(TAG, "FPS monitor task did not exit");
+        return false;
+    }
+    fps_monitor_joiner = NULL;
+    fps_monitor_task_handle = NULL;
+    
     ESP_LOGI(TAG, "FPS monitor stopped successfully");
     return true;
 }
 
+bool camera_get_pipeline_stats(pipeline_stats_t *stats)
+{
+    if (!stats) {
+        ESP_LOGE(TAG, "Invalid pipeline stats pointer");
+        return false;
+    }
+    
+    pipeline_get_stats(&camera_pipeline, stats);
+    return true;
+}
+
 // 获取当前帧率
 bool camera_get_fps(float *camera_fps_out, float *lcd_fps_out)
 {
@@ -605,38 +2090,503 @@ bool camera_get_fps(float *camera_fps_out, float *lcd_fps_out)
     return true;
 }
 
-// 停止摄像头到LCD的显示
-bool camera_stop_lcd_display(void)
+// 设置ROI
+bool camera_set_roi(uint8_t target, const camera_roi_t *roi)
 {
-    if (!lcd_display_running) {
-        ESP_LOGW(TAG, "Camera LCD display not running");
+    if ((target & CAMERA_ROI_ALL) == 0) {
+        ESP_LOGE(TAG, "Invalid ROI target: %d", target);
+        return false;
+    }
+    
+    camera_roi_t full = {0};
+    if (!roi || roi->width == 0 || roi->height == 0) {
+        roi = &full;
+    }
+    
+    // 两路相同ROI需要编程传感器窗口：采集中交给捕获任务在两帧之间执行（与快照相同），
+    // 不在调用者（WiFi控制任务）中与 esp_camera_fb_get() 并发访问驱动；多个请求只执行最后一个
+    if (target == CAMERA_ROI_ALL) {
+        if (!pipeline_is_running(&camera_pipeline)) {
+            camera_roi_apply_all(roi);
+            return true;
+        }
+        taskENTER_CRITICAL(&roi_lock);
+        roi_window_request = *roi;
+        roi_window_pending = true;
+        taskEXIT_CRITICAL(&roi_lock);
+        ESP_LOGD(TAG, "ROI %d,%d %dx%d queued for the capture task", roi->x, roi->y, roi->width, roi->height);
         return true;
     }
     
-    ESP_LOGI(TAG, "Stopping camera LCD display...");
+    taskENTER_CRITICAL(&roi_lock);
+    if (target & CAMERA_ROI_FPV) {
+        fpv_roi = *roi;
+    }
+    if (target & CAMERA_ROI_LCD) {
+        lcd_roi = *roi;
+    }
+    taskEXIT_CRITICAL(&roi_lock);
     
-    lcd_display_running = false;
+    ESP_LOGI(TAG, "ROI (target 0x%x): %d,%d %dx%d%s", target, roi->x, roi->y, roi->width, roi->height,
+             sensor_window_active ? " [sensor window]" : "");
+    return true;
+}
+
+// 获取某一路实际生效的ROI（全幅坐标）：传感器窗口内又设置了该路ROI时两者叠加，
+// 该路ROI按帧尺寸对齐/裁剪后的结果与捕获和LCD任务使用的一致
+bool camera_get_roi(camera_roi_target_t target, camera_roi_t *roi, bool *sensor_window)
+{
+    if (!roi || (target != CAMERA_ROI_FPV && target != CAMERA_ROI_LCD)) {
+        return false;
+    }
+    
+    taskENTER_CRITICAL(&roi_lock);
+    camera_roi_t path = (target == CAMERA_ROI_FPV) ? fpv_roi : lcd_roi;
+    camera_roi_t window = sensor_roi;
+    bool window_active = sensor_window_active;
+    taskEXIT_CRITICAL(&roi_lock);
+    
+    // 传感器窗口模式下帧尺寸不变，该路ROI是窗口输出画面中的坐标
+    const int out_w = resolution[current_config.frame_size].width;
+    const int out_h = resolution[current_config.frame_size].height;
+    camera_roi_t full = {0};
+    if (!camera_roi_clamp(&path, out_w, out_h)) {
+        path = full;
+    }
     
-    // 等待任务结束
-    if (camera_task_handle) {
-        vTaskDelete(camera_task_handle);
-        camera_task_handle = NULL;
+    if (!window_active) {
+        *roi = path;
+    } else if (path.width == 0) {
+        *roi = window;
+    } else {
+        roi->x = window.x + path.x * window.width / out_w;
+        roi->y = window.y + path.y * window.height / out_h;
+        roi->width = path.width * window.width / out_w;
+        roi->height = path.height * window.height / out_h;
+    }
+    if (sensor_window) {
+        *sensor_window = window_active;
+    }
+    return true;
+}
+
+// 处理接收端发来的控制包（在wifi控制任务中调用）
+static void camera_ctrl_handler(const udp_ctrl_t *ctrl, size_t len)
+{
+    switch (ctrl->type) {
+        case UDP_CTRL_ROI:
+            if (len >= sizeof(udp_ctrl_roi_t)) {
+                const udp_ctrl_roi_t *pkt = (const udp_ctrl_roi_t *)ctrl;
+                camera_roi_t roi = {
+                    .x = pkt->x,
+                    .y = pkt->y,
+                    .width = pkt->width,
+                    .height = pkt->height,
+                };
+                camera_set_roi(pkt->target, &roi);
+            }
+            break;
+        case UDP_CTRL_DUMP:
+            {
+                uint16_t pre_ms = 0;
+                if (len >= sizeof(udp_ctrl_dump_t)) {
+                    pre_ms = ((const udp_ctrl_dump_t *)ctrl)->pre_event_ms;
+                }
+                if (prerec_enabled && (prerec_config.triggers & CAMERA_PREREC_TRIGGER_REMOTE)) {
+                    camera_prerec_request(CAMERA_PREREC_TRIGGER_REMOTE, pre_ms, false);
+                } else {
+                    ESP_LOGW(TAG, "Remote dump ignored: pre-record not enabled");
+                }
+            }
+            break;
+        default:
+            ESP_LOGD(TAG, "Unhandled control packet type: %d", ctrl->type);
+            break;
+    }
+}
+
+// 设置FPV视频流像素格式
+bool camera_set_stream_format(camera_stream_format_t format)
+{
+    if (format > CAMERA_STREAM_YUV420) {
+        ESP_LOGE(TAG, "Invalid stream format: %d", format);
+        return false;
     }
     
-    if (lcd_task_handle) {
-        vTaskDelete(lcd_task_handle);
-        lcd_task_handle = NULL;
+    // 运行中传感器格式不变，只能在设备端转换；无法转换时拒绝，避免按传感器格式静默发出
+    uint8_t sensor_format = camera_pixformat_udp_format(stream_pixformat);
+    uint8_t target = camera_stream_udp_format(format);
+    if (camera_running && sensor_format != target && !pixfmt_can_convert(sensor_format, target)) {
+        ESP_LOGE(TAG, "Stream format %d not available: sensor output %d cannot be converted", format, sensor_format);
+        return false;
     }
     
-    if (fps_monitor_task_handle) {
-        vTaskDelete(fps_monitor_task_handle);
-        fps_monitor_task_handle = NULL;
+    stream_format = format;
+    if (!camera_running) {
+        current_config.stream_format = format;  // 下次初始化时优先由传感器直接输出
+    }
+    ESP_LOGI(TAG, "Stream format set to %s",
+             format == CAMERA_STREAM_Y8 ? "Y8" : (format == CAMERA_STREAM_YUV420 ? "YUV420" : "RGB565"));
+    return true;
+}
+
+// 获取当前FPV视频流像素格式
+camera_stream_format_t camera_get_stream_format(void)
+{
+    return (camera_stream_format_t)stream_format;
+}
+
+// 启用/禁用运动检测
+bool camera_set_motion_detection(bool enable)
+{
+    if (enable && !motion_enabled) {
+        motion_reset(&motion_detector);  // 重新建立背景
+    }
+    motion_enabled = enable;
+    ESP_LOGI(TAG, "Motion detection %s", enable ? "enabled" : "disabled");
+    return true;
+}
+
+// 设置运动门控
+bool camera_set_motion_gating(uint8_t idle_divider)
+{
+    motion_idle_divider = idle_divider;
+    motion_idle_counter = 0;
+    if (idle_divider) {
+        ESP_LOGI(TAG, "Motion gating: 1/%d frames while idle", idle_divider);
+    } else {
+        ESP_LOGI(TAG, "Motion gating disabled");
+    }
+    return true;
+}
+
+// 获取运动检测统计信息
+bool camera_get_motion_stats(camera_motion_stats_t *stats)
+{
+    if (!stats) {
+        ESP_LOGE(TAG, "Invalid motion stats pointer");
+        return false;
+    }
+
+    stats->enabled = motion_enabled;
+    stats->active = motion_last.active;
+    stats->score = motion_last.score;
+    stats->box_count = motion_last.box_count;
+    memcpy(stats->boxes, motion_last.boxes, sizeof(stats->boxes));
+    stats->events = motion_detector.events;
+    stats->frames_gated = motion_frames_gated;
+    stats->process_time_us = motion_time_us;
+    stats->max_process_time_us = motion_max_time_us;
+    stats->idle_divider = motion_idle_divider;
+    return true;
+}
+
+// 启动预录
+bool camera_prerec_start(const camera_prerec_config_t *config)
+{
+    if (prerec_enabled) {
+        ESP_LOGW(TAG, "Pre-record already running");
+        return true;
     }
     
-    // 清理队列
-    if (xQueueLCDFrame) {
-        vQueueDelete(xQueueLCDFrame);
-        xQueueLCDFrame = NULL;
+    prerec_config = config ? *config : prerec_default_config;
+    if (prerec_config.dump_rate_kbps == 0) {
+        prerec_config.dump_rate_kbps = prerec_default_config.dump_rate_kbps;
+    }
+    
+    if (!prerec_mutex) {
+        prerec_mutex = xSemaphoreCreateMutex();
+        if (!prerec_mutex) {
+            ESP_LOGE(TAG, "Failed to create pre-record mutex");
+            return false;
+        }
+    }
+    if (!prerec_task_exit) {
+        prerec_task_exit = xSemaphoreCreateBinary();
+        if (!prerec_task_exit) {
+            ESP_LOGE(TAG, "Failed to create pre-record semaphore");
+            return false;
+        }
+    }
+    
+    // 一次性分配：之后每帧只在arena内移动写指针
+    prerec_ring = heap_caps_malloc(sizeof(prerec_ring_t), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    prerec_arena = heap_caps_malloc(prerec_config.arena_size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    prerec_dump_buf = heap_caps_malloc(MAX_FRAME_SIZE, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (!prerec_ring || !prerec_arena || !prerec_dump_buf) {
+        ESP_LOGE(TAG, "Memory for pre-record is not enough (%lu bytes)", prerec_config.arena_size);
+        camera_prerec_stop();
+        return false;
+    }
+    prerec_init(prerec_ring, prerec_arena, prerec_config.arena_size, prerec_config.retain_ms);
+    memset(&prerec_stats, 0, sizeof(prerec_stats));
+    
+    prerec_task_stop = false;
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        camera_prerec_task, 
+        "camera_prerec", 
+        3 * 1024, 
+        NULL, 
+        3,      // 低于捕获任务，导出不影响实时流
+        &prerec_task_handle, 
+        0
+    );
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create pre-record dump task");
+        camera_prerec_stop();
+        return false;
+    }
+    
+    if (prerec_config.trigger_gpio >= 0 && (prerec_config.triggers & CAMERA_PREREC_TRIGGER_GPIO)) {
+        gpio_config_t io_conf = {
+            .pin_bit_mask = 1ULL << prerec_config.trigger_gpio,
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_ENABLE,
+            .intr_type = GPIO_INTR_NEGEDGE,
+        };
+        esp_err_t err = gpio_config(&io_conf);
+        if (err == ESP_OK) {
+            err = gpio_install_isr_service(0);
+            if (err == ESP_ERR_INVALID_STATE) {
+                err = ESP_OK;  // 其他组件已安装
+            }
+        }
+        if (err == ESP_OK) {
+            err = gpio_isr_handler_add(prerec_config.trigger_gpio, camera_prerec_gpio_isr, NULL);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "GPIO%d trigger not available: 0x%x", prerec_config.trigger_gpio, err);
+        }
+    }
+    
+    prerec_enabled = true;
+    ESP_LOGI(TAG, "Pre-record started: %lu KB arena, %lu ms retain, %d ms pre-event, %s",
+             prerec_config.arena_size / 1024, prerec_config.retain_ms, prerec_config.pre_event_ms,
+             prerec_config.jpeg_quality ? "JPEG" : "raw");
+    return true;
+}
+
+// 停止预录并释放缓冲区
+bool camera_prerec_stop(void)
+{
+    prerec_enabled = false;
+    
+    if (prerec_config.trigger_gpio >= 0 && (prerec_config.triggers & CAMERA_PREREC_TRIGGER_GPIO)) {
+        gpio_isr_handler_remove(prerec_config.trigger_gpio);
+    }
+    
+    // 通知导出任务退出并等到它真正退出：正在发送的帧仍在读取导出缓冲区，发完后才会退出
+    if (prerec_task_handle) {
+        prerec_task_stop = true;
+        xTaskNotify(prerec_task_handle, CAMERA_PREREC_NOTIFY_STOP, eSetBits);
+        xSemaphoreTake(prerec_task_exit, portMAX_DELAY);
+    }
+    
+    if (prerec_mutex) {
+        xSemaphoreTake(prerec_mutex, portMAX_DELAY);
+    }
+    heap_caps_free(prerec_ring);
+    heap_caps_free(prerec_arena);
+    heap_caps_free(prerec_dump_buf);
+    prerec_ring = NULL;
+    prerec_arena = NULL;
+    prerec_dump_buf = NULL;
+    if (prerec_mutex) {
+        xSemaphoreGive(prerec_mutex);
+    }
+    
+    ESP_LOGI(TAG, "Pre-record stopped");
+    return true;
+}
+
+// 手动触发导出
+bool camera_prerec_trigger(uint8_t source)
+{
+    if (!prerec_enabled || !(prerec_config.triggers & source)) {
+        return false;
+    }
+    camera_prerec_request(source, 0, false);
+    return true;
+}
+
+// 获取预录统计信息
+bool camera_get_prerec_stats(camera_prerec_stats_t *stats)
+{
+    if (!stats) {
+        ESP_LOGE(TAG, "Invalid pre-record stats pointer");
+        return false;
+    }
+    
+    *stats = prerec_stats;
+    stats->enabled = false;
+    if (!prerec_mutex) {
+        return true;  // 从未启动过预录
+    }
+    
+    // 先加锁再检查缓冲区：停止预录会在锁内释放缓冲区并清空指针
+    xSemaphoreTake(prerec_mutex, portMAX_DELAY);
+    if (!prerec_ring) {
+        xSemaphoreGive(prerec_mutex);
+        return true;
+    }
+    stats->enabled = prerec_enabled;
+    stats->memory_bytes = prerec_config.arena_size + sizeof(prerec_ring_t) + MAX_FRAME_SIZE;
+    stats->used_bytes = prerec_used_bytes(prerec_ring);
+    stats->frames_retained = prerec_ring->count;
+    stats->frames_recorded = prerec_ring->frames_recorded;
+    stats->retained_ms = 0;
+    if (prerec_ring->count > 1) {
+        prerec_entry_t oldest, newest;
+        uint32_t seq;
+        prerec_find(prerec_ring, INT64_MIN, &seq);
+        prerec_get(prerec_ring, seq, &oldest);
+        prerec_get(prerec_ring, prerec_ring->next_seq - 1, &newest);
+        stats->retained_ms = (uint32_t)((newest.timestamp_us - oldest.timestamp_us) / 1000);
+    }
+    xSemaphoreGive(prerec_mutex);
+    return true;
+}
+
+// 设置ISP参数
+bool camera_set_isp_config(const isp_config_t *config)
+{
+    if (!config || !isp_mutex) {
+        ESP_LOGE(TAG, "Invalid ISP config or camera not initialized");
+        return false;
+    }
+    
+    xSemaphoreTake(isp_mutex, portMAX_DELAY);
+    if (config->enable && config->sharpen && !isp_scratch) {
+        // 锐化行缓冲逐字节随机访问，放在内部RAM
+        isp_scratch = heap_caps_malloc(2 * sizeof(isp_scratch_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+        if (!isp_scratch) {
+            ESP_LOGW(TAG, "Memory for ISP sharpening is not enough, sharpening skipped");
+        }
+    }
+    isp_configure(&isp_state, config);
+    xSemaphoreGive(isp_mutex);
+    
+    ESP_LOGI(TAG, "ISP %s: WB %d/%d/%d, gamma %d, contrast %d, brightness %d, sharpen %d",
+             config->enable ? "enabled" : "disabled",
+             config->wb_gain[0], config->wb_gain[1], config->wb_gain[2],
+             config->gamma_x100, config->contrast, config->brightness, config->sharpen);
+    return true;
+}
+
+// 获取当前ISP参数
+bool camera_get_isp_config(isp_config_t *config)
+{
+    if (!config || !isp_mutex) {
+        ESP_LOGE(TAG, "Invalid ISP config pointer or camera not initialized");
+        return false;
+    }
+    
+    xSemaphoreTake(isp_mutex, portMAX_DELAY);
+    *config = isp_state.config;
+    xSemaphoreGive(isp_mutex);
+    return true;
+}
+
+// 设置自定义色调曲线
+bool camera_set_isp_tone_curve(const uint8_t *curve)
+{
+    if (!isp_mutex) {
+        ESP_LOGE(TAG, "Camera not initialized");
+        return false;
+    }
+    
+    xSemaphoreTake(isp_mutex, portMAX_DELAY);
+    isp_set_tone_curve(&isp_state, curve);
+    isp_configure(&isp_state, &isp_state.config);
+    xSemaphoreGive(isp_mutex);
+    
+    ESP_LOGI(TAG, "ISP tone curve %s", curve ? "set" : "cleared");
+    return true;
+}
+
+// 获取ISP统计信息
+bool camera_get_isp_stats(camera_isp_stats_t *stats)
+{
+    if (!stats) {
+        ESP_LOGE(TAG, "Invalid ISP stats pointer");
+        return false;
+    }
+    
+    *stats = isp_stats;
+    stats->enabled = isp_state.config.enable;
+    stats->sharpen = isp_state.config.enable && isp_state.config.sharpen && isp_scratch != NULL;
+    return true;
+}
+
+// 启用/禁用帧统计
+bool camera_set_frame_stats(bool enable)
+{
+    if (!enable && ae_config.enable) {
+        ESP_LOGW(TAG, "Auto exposure depends on frame statistics, disable it first");
+        return false;
+    }
+    if (enable && !fstats_enabled) {
+        fstats_reset(&fstats);   // 重新建立清晰度参考值
+    }
+    fstats_enabled = enable;
+    ESP_LOGI(TAG, "Frame statistics %s", enable ? "enabled" : "disabled");
+    return true;
+}
+
+// 获取帧统计信息
+bool camera_get_frame_stats(camera_frame_stats_t *stats)
+{
+    if (!stats) {
+        ESP_LOGE(TAG, "Invalid frame stats pointer");
+        return false;
+    }
+    
+    taskENTER_CRITICAL(&fstats_lock);
+    *stats = fstats_published;
+    taskEXIT_CRITICAL(&fstats_lock);
+    stats->enabled = fstats_enabled;
+    stats->ae_enabled = ae_config.enable;
+    stats->ae_exposure = ae_exposure;
+    stats->ae_gain_x16 = ae_gain_x16;
+    return true;
+}
+
+// 设置设备端自动曝光
+bool camera_set_auto_exposure(const camera_ae_config_t *config)
+{
+    const camera_ae_config_t *cfg = config ? config : &ae_default_config;
+    if (cfg->enable && !fstats_enabled) {
+        ESP_LOGW(TAG, "Auto exposure needs frame statistics, enabling them");
+        camera_set_frame_stats(true);
+    }
+    
+    taskENTER_CRITICAL(&fstats_lock);
+    ae_pending = *cfg;
+    ae_reconfigure = true;
+    taskEXIT_CRITICAL(&fstats_lock);
+    
+    ESP_LOGI(TAG, "Auto exposure %s: target %d, deadband %d, settle %d frames",
+             cfg->enable ? "enabled" : "disabled", cfg->target_luma, cfg->deadband, cfg->settle_frames);
+    return true;
+}
+
+// 停止摄像头到LCD的显示（正在采集时不带LCD任务重启流水线，视频流继续）
+bool camera_stop_lcd_display(void)
+{
+    if (!lcd_display_running) {
+        ESP_LOGW(TAG, "Camera LCD display not running");
+        return true;
+    }
+    
+    ESP_LOGI(TAG, "Stopping camera LCD display...");
+    
+    if (!camera_pipeline_stop()) {
+        return false;
+    }
+    current_config.enable_lcd_display = false;
+    camera_stream_reformat();   // 灰度/YUV视频流改由传感器直接输出
+    if (camera_running && current_config.enable_capture_task && !camera_pipeline_start(false)) {
+        return false;
     }
     
     ESP_LOGI(TAG, "Camera LCD display stopped successfully");
@@ -673,6 +2623,9 @@ bool camera_start_fpv_mode(void)
         free(local_ip);
     }
     
+    // 接收端控制包（ROI等）
+    wifi_set_ctrl_handler(camera_ctrl_handler);
+    
     fpv_running = true;
     
     ESP_LOGI(TAG, "FPV mode started successfully");
@@ -689,13 +2642,9 @@ bool camera_stop_fpv_mode(void)
     
     ESP_LOGI(TAG, "Stopping FPV mode...");
     
+    // FPV发送在捕获任务中进行，清除标志后下一帧起不再发送
     fpv_running = false;
-    
-    // 等待任务结束
-    if (fpv_task_handle) {
-        vTaskDelete(fpv_task_handle);
-        fpv_task_handle = NULL;
-    }
+    wifi_set_ctrl_handler(NULL);
     
     ESP_LOGI(TAG, "FPV mode stopped successfully");
     return true;
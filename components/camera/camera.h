@@ -3,6 +3,11 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
+#include "motion.h"
+#include "isp.h"
+#include "fstats.h"
+#include "pipeline.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +16,33 @@ extern "C" {
 // Camera 组件头文件
 // 包含摄像头相关的函数声明和数据结构
 
+// FPV视频流像素格式
+typedef enum {
+    CAMERA_STREAM_RGB565 = 0,   // RGB565，每像素2字节（默认）
+    CAMERA_STREAM_Y8,           // 8位灰度，每像素1字节
+    CAMERA_STREAM_YUV420,       // 平面YUV420，每像素1.5字节
+} camera_stream_format_t;
+
+// 传感器预设（XCLK、帧缓冲区数量、取帧模式、曝光上限、按传感器型号的时序寄存器）
+typedef enum {
+    CAMERA_PROFILE_DEFAULT = 0,     // 立创例程配置：2个缓冲区，GRAB_WHEN_EMPTY，传感器默认寄存器，限速30FPS
+    CAMERA_PROFILE_LOW_LATENCY,     // 低延迟FPV：GRAB_LATEST总是取最新帧，曝光上限约一帧，不限速
+    CAMERA_PROFILE_MAX_FPS,         // 最高帧率：最小行/场消隐，更低曝光上限，不限速
+    CAMERA_PROFILE_QUALITY,         // 画质：较低XCLK，允许更长曝光（暗光下降低帧率换取低噪声）
+    CAMERA_PROFILE_MAX,
+} camera_profile_t;
+
+// 预设基准测试结果
+typedef struct {
+    camera_profile_t profile;
+    const char *name;
+    uint32_t frames;
+    uint32_t failed;            // 取帧失败次数
+    uint32_t fps_x10;           // 实际帧率 x10
+    uint32_t avg_latency_us;    // 帧时间戳到取得帧缓冲区的平均延迟
+    uint32_t max_latency_us;
+} camera_profile_bench_t;
+
 // 摄像头功能配置结构体
 typedef struct {
     bool enable_lcd_display;    // 是否启用LCD显示
@@ -18,8 +50,122 @@ typedef struct {
     bool enable_capture_task;    // 是否启用捕获任务
     uint32_t xclk_freq_hz;      // 摄像头时钟频率
     uint32_t frame_size;        // 帧尺寸
+    uint8_t stream_format;      // FPV视频流格式 (camera_stream_format_t)，关闭LCD时优先由传感器直接输出
 } camera_user_config_t;
 
+// ROI作用路径（位掩码，与 udp_ctrl_roi_t.target 一致）
+typedef enum {
+    CAMERA_ROI_FPV = 0x01,      // FPV UDP视频流
+    CAMERA_ROI_LCD = 0x02,      // LCD显示
+    CAMERA_ROI_ALL = 0x03,      // 两路相同，优先用传感器窗口实现数字变焦
+} camera_roi_target_t;
+
+// ROI区域（当前帧像素坐标，width/height为0表示全幅）
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} camera_roi_t;
+
+// 高分辨率快照统计信息
+typedef struct {
+    uint32_t count;             // 成功快照数
+    uint32_t failures;          // 失败次数
+    uint32_t last_size;         // 最近一张JPEG字节数
+    uint16_t last_width;
+    uint16_t last_height;
+    uint32_t last_capture_ms;   // 最近一次模式切换+拍摄+恢复耗时
+    uint32_t last_gap_ms;       // 最近一次视频流中断时长（前后两帧的间隔）
+    uint32_t last_gap_frames;   // 中断期间缺失的帧数（按快照前实测的帧间隔计算）
+    uint32_t max_gap_ms;        // 最大中断时长
+    uint32_t restore_failures;  // 快照后恢复视频流配置失败次数（捕获任务随后按退避间隔重试）
+} camera_snapshot_stats_t;
+
+// 运动检测统计信息
+typedef struct {
+    bool enabled;               // 是否启用运动检测
+    bool active;                // 当前是否处于运动状态
+    uint16_t score;             // 最近一帧运动分数（千分比）
+    uint8_t box_count;
+    motion_box_t boxes[MOTION_MAX_BOXES];   // 最近一帧的包围框
+    uint32_t events;            // 运动开始事件数
+    uint32_t frames_gated;      // 空闲模式下未发送的帧数
+    uint32_t process_time_us;   // 最近一帧检测耗时
+    uint32_t max_process_time_us;
+    uint8_t idle_divider;       // 空闲模式抽帧比（0=不门控）
+} camera_motion_stats_t;
+
+// 预录触发源
+typedef enum {
+    CAMERA_PREREC_TRIGGER_MOTION = 0x01,    // 运动开始事件
+    CAMERA_PREREC_TRIGGER_GPIO   = 0x02,    // GPIO下降沿
+    CAMERA_PREREC_TRIGGER_REMOTE = 0x04,    // 接收端 UDP_CTRL_DUMP 或 camera_prerec_trigger()
+} camera_prerec_trigger_t;
+
+// 预录配置
+typedef struct {
+    uint32_t arena_size;        // PSRAM环形缓冲区大小（字节）
+    uint32_t retain_ms;         // 只保留最近这段时间的帧，0表示只受容量限制
+    uint16_t pre_event_ms;      // 触发时导出触发前多长时间的帧
+    uint8_t jpeg_quality;       // 0=保存原始帧，1-100=JPEG压缩后保存
+    uint8_t triggers;           // 启用的触发源 (camera_prerec_trigger_t位掩码)
+    int8_t trigger_gpio;        // GPIO触发引脚，-1表示不使用
+    uint32_t dump_rate_kbps;    // 导出速率上限（kbit/s），避免影响实时流
+} camera_prerec_config_t;
+
+// 预录统计信息
+typedef struct {
+    bool enabled;
+    bool dumping;               // 正在导出
+    uint32_t memory_bytes;      // 内存占用（环形缓冲区+索引+导出缓冲区）
+    uint32_t used_bytes;        // 已保存帧占用的字节数
+    uint16_t frames_retained;   // 当前保留的帧数
+    uint32_t retained_ms;       // 保留帧覆盖的时长
+    uint32_t frames_recorded;
+    uint32_t frames_dropped;    // 写入失败（JPEG超出预留空间等）
+    uint32_t record_time_us;    // 最近一帧写入耗时（含JPEG编码）
+    uint32_t triggers;          // 触发次数
+    uint32_t dumps;             // 完成的导出次数
+    uint32_t frames_dumped;
+    uint32_t bytes_dumped;
+} camera_prerec_stats_t;
+
+// ISP后处理统计信息
+typedef struct {
+    bool enabled;
+    bool sharpen;               // 是否启用锐化
+    uint32_t frames;            // 已处理帧数
+    uint32_t frames_skipped;    // 非RGB565或宽度超出锐化行缓冲而未处理（或未锐化）的帧数
+    uint32_t process_time_us;   // 最近一帧耗时
+    uint32_t max_process_time_us;
+} camera_isp_stats_t;
+
+// 设备端快速自动曝光配置
+typedef struct {
+    bool enable;                // 启用（关闭时恢复传感器自带的AEC/AGC）
+    uint8_t target_luma;        // 目标测光亮度（中心加权分区平均）
+    uint8_t deadband;           // 误差不超过该值时不调整
+    uint8_t settle_frames;      // 每次写入后等待的帧数（寄存器生效有1-2帧延迟）
+    uint16_t max_exposure;      // 曝光上限（传感器单位），0使用传感器默认上限（不降低帧率）
+    uint16_t max_gain_x16;      // 增益上限（16=1倍），0使用传感器默认上限
+} camera_ae_config_t;
+
+// 帧统计信息
+typedef struct {
+    bool enabled;
+    fstats_result_t result;     // 最近一帧统计结果
+    uint8_t metered_luma;       // 最近一帧测光亮度
+    uint32_t frames;
+    uint32_t process_time_us;   // 最近一帧统计耗时
+    uint32_t max_process_time_us;
+    bool ae_enabled;
+    uint16_t ae_exposure;       // 当前曝光（传感器单位）
+    uint16_t ae_gain_x16;       // 当前增益（16=1倍）
+    uint32_t ae_updates;        // 写入传感器的次数
+    uint32_t ae_errors;         // 写入失败次数
+} camera_frame_stats_t;
+
 /**
  * @brief 初始化摄像头
  * @return true 成功，false 失败
@@ -39,6 +185,38 @@ bool camera_set_config(const camera_user_config_t *config);
  */
 const camera_user_config_t* camera_get_config(void);
 
+/**
+ * @brief 切换传感器预设，摄像头已初始化时会重新初始化驱动
+ * @param profile 预设 (camera_profile_t)
+ * @return true 成功，false 失败（摄像头正在运行或帧缓冲区未归还）
+ * @note 在 camera_init 之前调用时只记录预设，初始化时生效
+ */
+bool camera_set_profile(camera_profile_t profile);
+
+/**
+ * @brief 获取当前传感器预设
+ * @return 当前预设
+ */
+camera_profile_t camera_get_profile(void);
+
+/**
+ * @brief 获取预设名称
+ * @param profile 预设
+ * @return 名称字符串
+ */
+const char* camera_profile_name(camera_profile_t profile);
+
+/**
+ * @brief 预设基准测试：切换到该预设后连续取帧，统计实际帧率和采集延迟
+ * @param profile 预设
+ * @param frames 取帧数
+ * @param work_ms 每帧模拟处理耗时（毫秒），用于比较处理慢于传感器时各取帧模式的延迟
+ * @param result 结果输出
+ * @return true 成功，false 失败
+ * @note 只能在摄像头未运行时调用（camera_start 之前或 camera_stop 之后），测试后保持该预设
+ */
+bool camera_benchmark_profile(camera_profile_t profile, uint32_t frames, uint32_t work_ms, camera_profile_bench_t *result);
+
 /**
  * @brief 启动摄像头功能（根据配置启动相应功能）
  * @return true 成功，false 失败
@@ -46,8 +224,8 @@ const camera_user_config_t* camera_get_config(void);
 bool camera_start(void);
 
 /**
- * @brief 停止摄像头功能
- * @return true 成功，false 失败
+ * @brief 停止摄像头功能（协作停止捕获/LCD任务并等待退出，返回时所有帧缓冲区都已归还）
+ * @return true 成功，false 任务未在超时内退出或有帧缓冲区未归还
  */
 bool camera_stop(void);
 
@@ -75,6 +253,13 @@ bool camera_start_fps_monitor(void);
  */
 bool camera_stop_fps_monitor(void);
 
+/**
+ * @brief 获取采集流水线统计信息（帧数、LCD队列、启停耗时、未归还的帧缓冲区）
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_pipeline_stats(pipeline_stats_t *stats);
+
 /**
  * @brief 获取当前帧率
  * @param camera_fps 摄像头帧率输出
@@ -84,17 +269,164 @@ bool camera_stop_fps_monitor(void);
 bool camera_get_fps(float *camera_fps, float *lcd_fps);
 
 /**
- * @brief 捕获图像
+ * @brief 拍摄一张高分辨率JPEG快照（最高UXGA，受传感器限制）
+ *        视频流运行时由捕获任务短暂切换传感器模式，拍完立即恢复，中断时长计入快照统计；
+ *        传感器不支持JPEG时以RGB565拍摄后在设备端编码
  * @return true 成功，false 失败
  */
 bool camera_capture(void);
 
 /**
- * @brief 获取图像数据
- * @return 图像数据指针
+ * @brief 获取最近一张快照的JPEG数据（下次快照前有效）
+ * @return 图像数据指针，没有快照时返回NULL
  */
 uint8_t* camera_get_image_data(void);
 
+/**
+ * @brief 获取最近一张快照的JPEG字节数
+ * @return 字节数，没有快照时返回0
+ */
+size_t camera_get_image_size(void);
+
+/**
+ * @brief 获取快照统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_snapshot_stats(camera_snapshot_stats_t *stats);
+
+/**
+ * @brief 设置FPV视频流像素格式（运行中可切换，传感器不直接输出时在设备端转换）
+ * @note 运行中当前传感器输出无法转换到该格式时返回false
+ * @param format 视频流格式
+ * @return true 成功，false 失败
+ */
+bool camera_set_stream_format(camera_stream_format_t format);
+
+/**
+ * @brief 获取当前FPV视频流像素格式
+ * @return 视频流格式
+ */
+camera_stream_format_t camera_get_stream_format(void);
+
+/**
+ * @brief 设置ROI（运行中可调用，也可由接收端通过UDP_CTRL_ROI控制包设置）
+ *        CAMERA_ROI_ALL 时优先编程传感器窗口（set_res_raw），输出尺寸不变、视野缩小；
+ *        传感器不支持或两路ROI不同时，在帧缓冲区内按stride零拷贝裁剪
+ * @param target 作用路径 (camera_roi_target_t)
+ * @param roi ROI区域，NULL或宽高为0表示恢复全幅
+ * @return true 成功，false 失败
+ */
+bool camera_set_roi(uint8_t target, const camera_roi_t *roi);
+
+/**
+ * @brief 获取某一路实际生效的ROI
+ * @param target CAMERA_ROI_FPV 或 CAMERA_ROI_LCD
+ * @param roi ROI输出，全幅坐标（传感器窗口与该路ROI叠加后的结果，全幅时宽高为0）
+ * @param sensor_window 输出是否由传感器窗口实现，可为NULL
+ * @return true 成功，false 失败
+ */
+bool camera_get_roi(camera_roi_target_t target, camera_roi_t *roi, bool *sensor_window);
+
+/**
+ * @brief 启用/禁用运动检测
+ * @param enable 是否启用
+ * @return true 成功，false 失败
+ */
+bool camera_set_motion_detection(bool enable);
+
+/**
+ * @brief 设置运动门控：无运动时每idle_divider帧才向FPV/HTTP/RTSP发送1帧，检测到运动立即恢复全帧率
+ * @param idle_divider 空闲模式抽帧比，0表示不门控（始终全帧率）
+ * @return true 成功，false 失败
+ */
+bool camera_set_motion_gating(uint8_t idle_divider);
+
+/**
+ * @brief 获取运动检测统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_motion_stats(camera_motion_stats_t *stats);
+
+/**
+ * @brief 启动预录：每帧写入PSRAM环形缓冲区，触发时以限速导出触发前的帧
+ * @param config 预录配置，NULL使用默认配置
+ * @return true 成功，false 失败
+ */
+bool camera_prerec_start(const camera_prerec_config_t *config);
+
+/**
+ * @brief 停止预录并释放缓冲区
+ * @return true 成功，false 失败
+ */
+bool camera_prerec_stop(void);
+
+/**
+ * @brief 触发导出（导出期间再次触发会把导出结束时间顺延到本次触发）
+ * @param source 触发源 (camera_prerec_trigger_t)
+ * @return true 已接受，false 预录未启动或该触发源未启用
+ */
+bool camera_prerec_trigger(uint8_t source);
+
+/**
+ * @brief 获取预录统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_prerec_stats(camera_prerec_stats_t *stats);
+
+/**
+ * @brief 设置ISP参数（白平衡、颜色矩阵、gamma/对比度/亮度、锐化），下一帧生效
+ * @param config ISP参数，enable为false时关闭ISP
+ * @return true 成功，false 失败
+ * @note 只处理RGB565视频流，在运动检测、预录和所有输出之前原地修改帧缓冲区
+ */
+bool camera_set_isp_config(const isp_config_t *config);
+
+/**
+ * @brief 获取当前ISP参数
+ * @param config 参数输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_isp_config(isp_config_t *config);
+
+/**
+ * @brief 设置自定义色调曲线（在gamma/对比度/亮度之后应用）
+ * @param curve 256项曲线，NULL取消
+ * @return true 成功，false 失败
+ */
+bool camera_set_isp_tone_curve(const uint8_t *curve);
+
+/**
+ * @brief 获取ISP统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_isp_stats(camera_isp_stats_t *stats);
+
+/**
+ * @brief 启用/禁用帧统计（直方图、分区亮度、清晰度，模糊/遮挡检测）
+ * @param enable 是否启用（自动曝光依赖帧统计）
+ * @return true 成功，false 失败
+ */
+bool camera_set_frame_stats(bool enable);
+
+/**
+ * @brief 获取帧统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool camera_get_frame_stats(camera_frame_stats_t *stats);
+
+/**
+ * @brief 设置设备端快速自动曝光：按帧统计的测光亮度直接写传感器曝光和增益
+ * @param config 自动曝光配置，NULL使用默认配置（启用，目标亮度110）
+ * @return true 成功，false 失败
+ * @note 在捕获任务中下一帧生效；传感器写入通过 sensor_t 接口完成
+ */
+bool camera_set_auto_exposure(const camera_ae_config_t *config);
+
 /**
  * @brief 启动FPV模式（WiFi UDP传输）
  * @return true 成功，false 失败
@@ -0,0 +1,198 @@
+#include "fstats.h"
+#include "motion.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "fstats";
+
+// 4个字节并行求和：相邻字节两两相加到16位通道，每次最多累加128个字（每通道不超过65535）
+static uint32_t fstats_sum_bytes(const uint8_t* p, int n)
+{
+    uint32_t total = 0;
+    int i = 0;
+    while (i + 4 <= n) {
+        uint32_t acc = 0;
+        for (int k = 0; k < 128 && i + 4 <= n; k++, i += 4) {
+            uint32_t w;
+            memcpy(&w, p + i, 4);
+            acc += (w & 0x00FF00FFu) + ((w >> 8) & 0x00FF00FFu);
+        }
+        total += (acc & 0xFFFFu) + (acc >> 16);
+    }
+    for (; i < n; i++) {
+        total += p[i];
+    }
+    return total;
+}
+
+static uint32_t fstats_sum_squares(const uint8_t* p, int n)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < n; i++) {
+        total += (uint32_t)p[i] * p[i];
+    }
+    return total;
+}
+
+// 取第y行每隔step个像素的亮度
+static void fstats_sample_row(const wifi_frame_desc_t* frame, int y, int step, uint8_t* out, int n)
+{
+    const uint8_t *p = frame->data + (size_t)y * frame->stride;
+
+    switch (frame->format) {
+        case UDP_FMT_RGB565:
+            {
+                const bool big_endian = (frame->flags & UDP_FLAG_BIG_ENDIAN) != 0;
+                const int inc = step * 2;
+                for (int i = 0; i < n; i++, p += inc) {
+                    uint16_t v = big_endian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+                    // 与motion.c相同：Y = (77R + 150G + 29B) / 256，分量先展开到8bit
+                    out[i] = (uint8_t)((77 * ((v >> 11) << 3) + 150 * (((v >> 5) & 0x3F) << 2) + 29 * ((v & 0x1F) << 3)) >> 8);
+                }
+            }
+            break;
+        case UDP_FMT_YUV422:
+            // YUYV中Y位于偶数字节
+            for (int i = 0; i < n; i++, p += step * 2) {
+                out[i] = *p;
+            }
+            break;
+        case UDP_FMT_GRAY:
+        default:
+            if (step == 1) {
+                memcpy(out, p, n);
+            } else {
+                for (int i = 0; i < n; i++, p += step) {
+                    out[i] = *p;
+                }
+            }
+            break;
+    }
+}
+
+void fstats_init(fstats_t* fs, uint8_t step)
+{
+    memset(fs, 0, sizeof(*fs));
+    fs->step = (step == 1 || step == 2 || step == 4) ? step : FSTATS_DEFAULT_STEP;
+}
+
+void fstats_reset(fstats_t* fs)
+{
+    fs->frames = 0;
+    fs->sharpness_ref = 0;
+}
+
+// 按直方图求分位数（返回该档中间的亮度值）
+static uint8_t fstats_percentile(const fstats_result_t* result, uint32_t permille)
+{
+    const uint32_t target = (uint32_t)((uint64_t)result->samples * permille / 1000);
+    uint32_t acc = 0;
+    for (int b = 0; b < FSTATS_HIST_BINS; b++) {
+        acc += result->hist[b];
+        if (acc > target) {
+            return (uint8_t)(b * 4 + 2);
+        }
+    }
+    return 255;
+}
+
+bool fstats_process(fstats_t* fs, const wifi_frame_desc_t* frame, fstats_result_t* result)
+{
+    if (frame->format != UDP_FMT_RGB565 && frame->format != UDP_FMT_GRAY && frame->format != UDP_FMT_YUV422) {
+        return false;
+    }
+
+    const int step = fs->step;
+    const int cols = frame->width / step;
+    const int rows = frame->height / step;
+    if (cols < FSTATS_ZONES_X || rows < FSTATS_ZONES_Y || cols > FSTATS_MAX_SAMPLES) {
+        ESP_LOGD(TAG, "Unsupported frame size %dx%d", frame->width, frame->height);
+        return false;
+    }
+
+    memset(result, 0, sizeof(*result));
+    uint32_t zone_sum[FSTATS_ZONES] = {0};
+    uint32_t zone_count[FSTATS_ZONES] = {0};
+    int zone_x0[FSTATS_ZONES_X + 1];
+    for (int zx = 0; zx <= FSTATS_ZONES_X; zx++) {
+        zone_x0[zx] = zx * cols / FSTATS_ZONES_X;
+    }
+
+    uint64_t energy = 0;
+    uint32_t luma_sum = 0;
+    uint8_t *cur = fs->row[0];
+    uint8_t *prev = fs->row[1];
+
+    for (int sy = 0; sy < rows; sy++) {
+        fstats_sample_row(frame, sy * step, step, cur, cols);
+
+        for (int i = 0; i < cols; i++) {
+            result->hist[cur[i] >> 2]++;
+        }
+
+        const int zy = sy * FSTATS_ZONES_Y / rows;
+        for (int zx = 0; zx < FSTATS_ZONES_X; zx++) {
+            const int n = zone_x0[zx + 1] - zone_x0[zx];
+            uint32_t s = fstats_sum_bytes(cur + zone_x0[zx], n);
+            zone_sum[zy * FSTATS_ZONES_X + zx] += s;
+            zone_count[zy * FSTATS_ZONES_X + zx] += n;
+            luma_sum += s;
+        }
+
+        // 梯度能量：水平相邻样本差和与上一抽样行的差（SWAR绝对差），再求平方和
+        motion_absdiff(cur, cur + 1, fs->diff, cols - 1);
+        energy += fstats_sum_squares(fs->diff, cols - 1);
+        if (sy > 0) {
+            motion_absdiff(cur, prev, fs->diff, cols);
+            energy += fstats_sum_squares(fs->diff, cols);
+        }
+
+        uint8_t *t = prev;
+        prev = cur;
+        cur = t;
+    }
+
+    result->samples = (uint32_t)cols * rows;
+    result->mean = (uint8_t)(luma_sum / result->samples);
+    for (int z = 0; z < FSTATS_ZONES; z++) {
+        result->zone_mean[z] = zone_count[z] ? (uint8_t)(zone_sum[z] / zone_count[z]) : 0;
+    }
+    result->p5 = fstats_percentile(result, 50);
+    result->p50 = fstats_percentile(result, 500);
+    result->p95 = fstats_percentile(result, 950);
+    result->sharpness = (uint32_t)(energy / result->samples);
+
+    result->obstructed = result->mean < FSTATS_DARK_LUMA || (result->p95 - result->p5) < FSTATS_FLAT_RANGE;
+
+    // 先用已有参考值判断，再更新参考值：遮挡时不更新（避免挡住镜头后参考值被拉低），
+    // 模糊时以1/256缓慢跟随（持续模糊仍能报告，低纹理场景最终被接受为新的参考）
+    fs->frames++;
+    result->blurred = !result->obstructed && fs->frames > FSTATS_WARMUP_FRAMES &&
+                      result->sharpness * FSTATS_BLUR_RATIO < fs->sharpness_ref;
+    if (!result->obstructed) {
+        if (fs->sharpness_ref == 0) {
+            fs->sharpness_ref = result->sharpness ? result->sharpness : 1;
+        } else {
+            const int shift = result->blurred ? 8 : FSTATS_REF_SHIFT;
+            fs->sharpness_ref = (uint32_t)((int32_t)fs->sharpness_ref +
+                                ((int32_t)result->sharpness - (int32_t)fs->sharpness_ref) / (1 << shift));
+        }
+    }
+    result->sharpness_ref = fs->sharpness_ref;
+    return true;
+}
+
+uint8_t fstats_metered_luma(const fstats_result_t* result)
+{
+    uint32_t sum = 0;
+    uint32_t weight = 0;
+    for (int zy = 0; zy < FSTATS_ZONES_Y; zy++) {
+        for (int zx = 0; zx < FSTATS_ZONES_X; zx++) {
+            const bool center = zx > 0 && zx < FSTATS_ZONES_X - 1 && zy > 0 && zy < FSTATS_ZONES_Y - 1;
+            const uint32_t w = center ? 2 : 1;
+            sum += result->zone_mean[zy * FSTATS_ZONES_X + zx] * w;
+            weight += w;
+        }
+    }
+    return (uint8_t)(sum / weight);
+}
@@ -0,0 +1,87 @@
+#ifndef FSTATS_H
+#define FSTATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 帧统计头文件
+// 按 step x step 抽样（不做平均，保留高频边缘）计算亮度直方图、分区平均亮度和梯度能量清晰度，
+// 并据此判断画面模糊（清晰度远低于长期参考值）和遮挡（画面过暗或几乎没有明暗变化）
+// 分区求和与梯度差值用32位SWAR每次处理4字节
+// 不依赖FreeRTOS，可在Linux主机上编译并做基准测试（host/fstats_bench.c）
+
+#define FSTATS_DEFAULT_STEP 2           // 默认抽样间隔（QQVGA得到80x60个样本）
+#define FSTATS_MAX_SAMPLES 320          // 每行最多样本数
+#define FSTATS_HIST_BINS 64             // 直方图分档（每档4级亮度）
+#define FSTATS_ZONES_X 4                // 分区网格
+#define FSTATS_ZONES_Y 4
+#define FSTATS_ZONES (FSTATS_ZONES_X * FSTATS_ZONES_Y)
+#define FSTATS_REF_SHIFT 5              // 清晰度长期参考值的滑动平均系数 1/32
+#define FSTATS_WARMUP_FRAMES 32         // 参考值建立前不判断模糊
+#define FSTATS_BLUR_RATIO 4             // 清晰度低于参考值的1/4判为模糊
+#define FSTATS_DARK_LUMA 12             // 平均亮度低于该值判为遮挡
+#define FSTATS_FLAT_RANGE 10            // 5%-95%亮度分位差低于该值判为遮挡
+
+// 单帧统计结果
+typedef struct {
+    uint32_t hist[FSTATS_HIST_BINS];    // 亮度直方图（样本数）
+    uint32_t samples;                   // 样本总数
+    uint8_t mean;                       // 平均亮度
+    uint8_t p5;                         // 亮度分位数（按直方图分档，精度4级）
+    uint8_t p50;
+    uint8_t p95;
+    uint8_t zone_mean[FSTATS_ZONES];    // 分区平均亮度（按行优先）
+    uint32_t sharpness;                 // 平均梯度能量（水平和垂直相邻样本差的平方和）
+    uint32_t sharpness_ref;             // 清晰度长期参考值
+    bool blurred;                       // 模糊（失焦、镜头起雾）
+    bool obstructed;                    // 遮挡（镜头被挡住或画面全暗）
+} fstats_result_t;
+
+// 统计器状态（约1KB，由调用者静态分配）
+typedef struct {
+    uint8_t step;
+    uint32_t frames;
+    uint32_t sharpness_ref;
+    uint8_t row[2][FSTATS_MAX_SAMPLES];     // 当前/上一抽样行的亮度
+    uint8_t diff[FSTATS_MAX_SAMPLES];       // 相邻样本差
+} fstats_t;
+
+/**
+ * @brief 初始化统计器
+ * @param fs 统计器
+ * @param step 抽样间隔（1/2/4），0使用默认值
+ */
+void fstats_init(fstats_t* fs, uint8_t step);
+
+/**
+ * @brief 清除清晰度参考值（分辨率或场景变化后调用）
+ * @param fs 统计器
+ */
+void fstats_reset(fstats_t* fs);
+
+/**
+ * @brief 统计一帧
+ * @param fs 统计器
+ * @param frame 帧描述（支持RGB565/灰度/YUV422）
+ * @param result 统计结果输出
+ * @return true 成功，false 格式或尺寸不支持
+ */
+bool fstats_process(fstats_t* fs, const wifi_frame_desc_t* frame, fstats_result_t* result);
+
+/**
+ * @brief 计算分区加权平均亮度（中心4个分区权重加倍），供自动曝光测光使用
+ * @param result 统计结果
+ * @return 加权平均亮度
+ */
+uint8_t fstats_metered_luma(const fstats_result_t* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FSTATS_H
@@ -0,0 +1,227 @@
+#include "isp.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "isp";
+
+static inline int isp_clamp(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// 两个像素一次读写（与pixfmt.c相同，低16位=左像素），大端时两个像素同时交换字节
+static inline uint32_t isp_swap16x2(uint32_t w)
+{
+    return ((w & 0x00FF00FFu) << 8) | ((w >> 8) & 0x00FF00FFu);
+}
+
+void isp_default_config(isp_config_t* config)
+{
+    memset(config, 0, sizeof(*config));
+    config->wb_gain[0] = ISP_UNITY;
+    config->wb_gain[1] = ISP_UNITY;
+    config->wb_gain[2] = ISP_UNITY;
+    config->ccm[0] = ISP_UNITY;
+    config->ccm[4] = ISP_UNITY;
+    config->ccm[8] = ISP_UNITY;
+    config->gamma_x100 = 100;
+}
+
+void isp_set_tone_curve(isp_t* isp, const uint8_t* curve)
+{
+    isp->has_tone_curve = curve != NULL;
+    if (curve) {
+        memcpy(isp->tone_curve, curve, sizeof(isp->tone_curve));
+    }
+}
+
+void isp_configure(isp_t* isp, const isp_config_t* config)
+{
+    isp->config = *config;
+
+    // 白平衡作用在输入分量上，等价于颜色矩阵各列乘以对应增益
+    int coeff[3][3];
+    isp->diagonal = true;
+    for (int o = 0; o < 3; o++) {
+        for (int i = 0; i < 3; i++) {
+            int c = config->ccm[o * 3 + i] * config->wb_gain[i] / ISP_UNITY;
+            coeff[o][i] = isp_clamp(c, -ISP_MAX_COEFF, ISP_MAX_COEFF);
+            if (o != i && coeff[o][i] != 0) {
+                isp->diagonal = false;
+            }
+        }
+    }
+
+    // 贡献表：5/6bit分量先扩展到8bit，再乘系数，保留2位小数
+    for (int o = 0; o < 3; o++) {
+        for (int v = 0; v < 32; v++) {
+            int v8 = (v << 3) | (v >> 2);
+            isp->mat_r[o][v] = (int16_t)(coeff[o][0] * v8 * 4 / ISP_UNITY);
+            isp->mat_b[o][v] = (int16_t)(coeff[o][2] * v8 * 4 / ISP_UNITY);
+        }
+        for (int v = 0; v < 64; v++) {
+            int v8 = (v << 2) | (v >> 4);
+            isp->mat_g[o][v] = (int16_t)(coeff[o][1] * v8 * 4 / ISP_UNITY);
+        }
+    }
+
+    // gamma -> 对比度/亮度 -> 自定义色调曲线，合成一张LUT
+    const float gamma = (config->gamma_x100 ? config->gamma_x100 : 100) / 100.0f;
+    for (int v = 0; v < 256; v++) {
+        int g = (int)lroundf(255.0f * powf(v / 255.0f, gamma));
+        int t = (g - 128) * (100 + config->contrast) / 100 + 128 + config->brightness;
+        t = isp_clamp(t, 0, 255);
+        isp->tone[v] = isp->has_tone_curve ? isp->tone_curve[t] : (uint8_t)t;
+    }
+
+    for (int v = 0; v < 256; v++) {
+        isp->pack_r[v] = (uint16_t)((v >> 3) << 11);
+        isp->pack_g[v] = (uint16_t)((v >> 2) << 5);
+        isp->pack_b[v] = (uint16_t)(v >> 3);
+    }
+
+    // 对角阵时每个输出分量只取决于同名输入分量，直接查到RGB565的位
+    for (int v = 0; v < 32; v++) {
+        isp->fast8_r[v] = isp->tone[isp_clamp(isp->mat_r[0][v] >> 2, 0, 255)];
+        isp->fast8_b[v] = isp->tone[isp_clamp(isp->mat_b[2][v] >> 2, 0, 255)];
+        isp->fast_r[v] = isp->pack_r[isp->fast8_r[v]];
+        isp->fast_b[v] = isp->pack_b[isp->fast8_b[v]];
+    }
+    for (int v = 0; v < 64; v++) {
+        isp->fast8_g[v] = isp->tone[isp_clamp(isp->mat_g[1][v] >> 2, 0, 255)];
+        isp->fast_g[v] = isp->pack_g[isp->fast8_g[v]];
+    }
+
+    ESP_LOGD(TAG, "Configured: %s matrix, gamma %d, contrast %d, brightness %d, sharpen %d",
+             isp->diagonal ? "diagonal" : "full", config->gamma_x100, config->contrast,
+             config->brightness, config->sharpen);
+}
+
+// 颜色处理一个像素，输出tone后的8bit RGB
+static inline void isp_color(const isp_t* isp, uint16_t v, uint8_t* rgb)
+{
+    const int r5 = v >> 11;
+    const int g6 = (v >> 5) & 0x3F;
+    const int b5 = v & 0x1F;
+    if (isp->diagonal) {
+        rgb[0] = isp->fast8_r[r5];
+        rgb[1] = isp->fast8_g[g6];
+        rgb[2] = isp->fast8_b[b5];
+        return;
+    }
+    for (int o = 0; o < 3; o++) {
+        int c = (isp->mat_r[o][r5] + isp->mat_g[o][g6] + isp->mat_b[o][b5]) >> 2;
+        rgb[o] = isp->tone[isp_clamp(c, 0, 255)];
+    }
+}
+
+static inline uint16_t isp_pixel(const isp_t* isp, uint16_t v)
+{
+    const int r5 = v >> 11;
+    const int g6 = (v >> 5) & 0x3F;
+    const int b5 = v & 0x1F;
+    if (isp->diagonal) {
+        return isp->fast_r[r5] | isp->fast_g[g6] | isp->fast_b[b5];
+    }
+    uint8_t rgb[3];
+    isp_color(isp, v, rgb);
+    return isp->pack_r[rgb[0]] | isp->pack_g[rgb[1]] | isp->pack_b[rgb[2]];
+}
+
+// 不锐化：逐行原地处理，两个像素一次32位读写
+static void isp_row_inplace(const isp_t* isp, uint8_t* p, int width, bool big_endian)
+{
+    int x = 0;
+    for (; x + 2 <= width; x += 2, p += 4) {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        if (big_endian) {
+            w = isp_swap16x2(w);
+        }
+        w = isp_pixel(isp, (uint16_t)w) | ((uint32_t)isp_pixel(isp, (uint16_t)(w >> 16)) << 16);
+        if (big_endian) {
+            w = isp_swap16x2(w);
+        }
+        memcpy(p, &w, 4);
+    }
+    if (x < width) {
+        uint16_t v = big_endian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+        v = isp_pixel(isp, v);
+        p[0] = big_endian ? (uint8_t)(v >> 8) : (uint8_t)v;
+        p[1] = big_endian ? (uint8_t)v : (uint8_t)(v >> 8);
+    }
+}
+
+// 一行原始RGB565 -> tone后的8bit RGB（锐化输入）
+static void isp_row_color(const isp_t* isp, const uint8_t* p, int width, bool big_endian, uint8_t* out)
+{
+    for (int x = 0; x < width; x++, p += 2, out += 3) {
+        uint16_t v = big_endian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+        isp_color(isp, v, out);
+    }
+}
+
+// 十字拉普拉斯锐化一行并打包写回：out = c + k * (4c - 上 - 下 - 左 - 右) / 4
+static void isp_row_sharpen(const isp_t* isp, const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                            int width, bool big_endian, uint8_t* dst)
+{
+    const int k = isp->config.sharpen;
+    for (int x = 0; x < width; x++, dst += 2) {
+        const int c = x * 3;
+        const int l = x > 0 ? c - 3 : c;
+        const int r = x < width - 1 ? c + 3 : c;
+        const int lap_r = 4 * cur[c] - cur[l] - cur[r] - up[c] - down[c];
+        const int lap_g = 4 * cur[c + 1] - cur[l + 1] - cur[r + 1] - up[c + 1] - down[c + 1];
+        const int lap_b = 4 * cur[c + 2] - cur[l + 2] - cur[r + 2] - up[c + 2] - down[c + 2];
+        const int out_r = isp_clamp(cur[c] + ((k * lap_r) >> 6), 0, 255);
+        const int out_g = isp_clamp(cur[c + 1] + ((k * lap_g) >> 6), 0, 255);
+        const int out_b = isp_clamp(cur[c + 2] + ((k * lap_b) >> 6), 0, 255);
+        uint16_t v = isp->pack_r[out_r] | isp->pack_g[out_g] | isp->pack_b[out_b];
+        dst[0] = big_endian ? (uint8_t)(v >> 8) : (uint8_t)v;
+        dst[1] = big_endian ? (uint8_t)v : (uint8_t)(v >> 8);
+    }
+}
+
+void isp_process_rows(const isp_t* isp, isp_scratch_t* scratch, const isp_frame_t* frame,
+                      int row_start, int row_end, const uint8_t* above, const uint8_t* below)
+{
+    const int w = frame->width;
+    const bool be = frame->big_endian;
+
+    if (!isp->config.sharpen || !scratch || w > ISP_MAX_WIDTH) {
+        for (int y = row_start; y < row_end; y++) {
+            isp_row_inplace(isp, frame->data + (size_t)y * frame->stride, w, be);
+        }
+        return;
+    }
+
+    // 三行环形缓冲保存颜色处理后的相邻行：先读入第y+1行，再锐化写回第y行，每行只读写帧缓冲区一次
+    uint8_t *ring[3] = { scratch->rows[0], scratch->rows[1], scratch->rows[2] };
+    if (row_start > 0) {
+        isp_row_color(isp, above ? above : frame->data + (size_t)(row_start - 1) * frame->stride, w, be, ring[0]);
+    }
+    isp_row_color(isp, frame->data + (size_t)row_start * frame->stride, w, be, ring[1]);
+    if (row_start == 0) {
+        memcpy(ring[0], ring[1], (size_t)w * 3);   // 上边缘复制
+    }
+
+    for (int y = row_start; y < row_end; y++) {
+        uint8_t *up = ring[(y - row_start) % 3];
+        uint8_t *cur = ring[(y - row_start + 1) % 3];
+        uint8_t *down = ring[(y - row_start + 2) % 3];
+        if (y + 1 < row_end) {
+            isp_row_color(isp, frame->data + (size_t)(y + 1) * frame->stride, w, be, down);
+        } else if (y + 1 < frame->height) {
+            isp_row_color(isp, below ? below : frame->data + (size_t)(y + 1) * frame->stride, w, be, down);
+        } else {
+            memcpy(down, cur, (size_t)w * 3);       // 下边缘复制
+        }
+        isp_row_sharpen(isp, up, cur, down, w, be, frame->data + (size_t)y * frame->stride);
+    }
+}
+
+void isp_process(const isp_t* isp, isp_scratch_t* scratch, const isp_frame_t* frame)
+{
+    isp_process_rows(isp, scratch, frame, 0, frame->height, NULL, NULL);
+}
@@ -0,0 +1,114 @@
+#ifndef ISP_H
+#define ISP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ISP后处理头文件
+// 在RGB565帧缓冲区上原地做：白平衡增益 -> 3x3颜色矩阵 -> gamma/色调曲线 -> 可选锐化
+// 白平衡与颜色矩阵预先合并成按输入分量查表的贡献表，gamma与色调曲线合并成一张LUT，
+// 所有阶段在一次遍历中完成（每个像素只读写帧缓冲区一次）
+// 不依赖FreeRTOS，可在Linux主机上编译并做基准测试（host/isp_bench.c）
+
+#define ISP_MAX_WIDTH 320               // 锐化行缓冲支持的最大宽度
+#define ISP_UNITY 256                   // 增益/矩阵系数的1.0（Q8）
+#define ISP_MAX_COEFF (8 * ISP_UNITY)   // 合并后系数绝对值上限
+
+// ISP参数
+typedef struct {
+    bool enable;
+    uint16_t wb_gain[3];        // 白平衡增益 R/G/B（Q8，256=1.0）
+    int16_t ccm[9];             // 颜色矩阵（Q8，按行：输出R/G/B = 行 · 输入RGB）
+    uint16_t gamma_x100;        // gamma值x100，100=线性，小于100提亮暗部
+    int8_t contrast;            // 对比度 -100..100（以128为中心的线性拉伸）
+    int8_t brightness;          // 亮度偏移 -128..127
+    uint8_t sharpen;            // 锐化强度（Q4，16=1.0），0关闭
+} isp_config_t;
+
+// ISP状态（由 isp_configure 生成的查表，调用者静态分配）
+typedef struct {
+    isp_config_t config;
+    bool diagonal;                  // 矩阵为对角阵：每个输出通道只取决于同名输入，走逐通道查表
+    bool has_tone_curve;            // 使用自定义色调曲线
+    uint8_t tone_curve[256];        // 自定义色调曲线（在gamma之后）
+    uint8_t tone[256];              // gamma∘对比度/亮度∘色调曲线 合成的8bit LUT
+    int16_t mat_r[3][32];           // 输入R(5bit)对输出R/G/B的贡献（8bit刻度 x4）
+    int16_t mat_g[3][64];           // 输入G(6bit)
+    int16_t mat_b[3][32];           // 输入B(5bit)
+    uint16_t pack_r[256];           // tone后的8bit值 -> RGB565中R的位
+    uint16_t pack_g[256];
+    uint16_t pack_b[256];
+    uint16_t fast_r[32];            // 对角阵快速路径：输入分量 -> 输出RGB565位
+    uint16_t fast_g[64];
+    uint16_t fast_b[32];
+    uint8_t fast8_r[32];            // 对角阵快速路径：输入分量 -> tone后的8bit值（锐化输入）
+    uint8_t fast8_g[64];
+    uint8_t fast8_b[32];
+} isp_t;
+
+// 锐化行缓冲（每个并行条带一份）
+typedef struct {
+    uint8_t rows[3][ISP_MAX_WIDTH * 3];     // 处理后的8bit RGB，环形使用
+} isp_scratch_t;
+
+// 一帧处理参数
+typedef struct {
+    uint8_t *data;          // RGB565帧缓冲区（原地修改）
+    uint16_t width;
+    uint16_t height;
+    uint16_t stride;
+    bool big_endian;        // esp32-camera输出为大端
+} isp_frame_t;
+
+/**
+ * @brief 填入默认参数（不启用，增益和矩阵为单位阵，线性gamma）
+ * @param config 参数输出
+ */
+void isp_default_config(isp_config_t* config);
+
+/**
+ * @brief 根据参数生成查表
+ * @param isp ISP状态
+ * @param config 参数
+ */
+void isp_configure(isp_t* isp, const isp_config_t* config);
+
+/**
+ * @brief 设置自定义色调曲线（在gamma之后应用），需要重新调用 isp_configure 生效
+ * @param isp ISP状态
+ * @param curve 256项曲线，NULL取消
+ */
+void isp_set_tone_curve(isp_t* isp, const uint8_t* curve);
+
+/**
+ * @brief 处理 [row_start, row_end) 行
+ * @param isp ISP状态
+ * @param scratch 锐化行缓冲（不锐化时可为NULL）
+ * @param frame 帧参数
+ * @param row_start 起始行
+ * @param row_end 结束行（不含）
+ * @param above row_start上一行的原始数据，NULL表示从帧缓冲区读取（帧首行时复制边缘）
+ * @param below row_end行的原始数据，NULL表示从帧缓冲区读取（帧末行时复制边缘）
+ * @note 并行处理相邻条带时，分界处的两行必须事先保存并通过above/below传入，
+ *       否则会读到另一个条带已经改写的数据
+ */
+void isp_process_rows(const isp_t* isp, isp_scratch_t* scratch, const isp_frame_t* frame,
+                      int row_start, int row_end, const uint8_t* above, const uint8_t* below);
+
+/**
+ * @brief 处理整帧
+ * @param isp ISP状态
+ * @param scratch 锐化行缓冲
+ * @param frame 帧参数
+ */
+void isp_process(const isp_t* isp, isp_scratch_t* scratch, const isp_frame_t* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ISP_H
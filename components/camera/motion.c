@@ -0,0 +1,269 @@
+#include "motion.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "motion";
+
+static const motion_config_t motion_default_config = {
+    .threshold = MOTION_DEFAULT_THRESHOLD,
+    .learn_shift = MOTION_DEFAULT_LEARN_SHIFT,
+    .trigger = MOTION_DEFAULT_TRIGGER,
+    .min_area = MOTION_DEFAULT_MIN_AREA,
+    .hold_frames = MOTION_DEFAULT_HOLD_FRAMES,
+};
+
+// 4个字节并行求 |a-b|（Hacker's Delight 2-18 逐字节减法 + 借位掩码取反）
+static inline uint32_t motion_absdiff4(uint32_t a, uint32_t b)
+{
+    uint32_t d = ((a | 0x80808080u) - (b & 0x7F7F7F7Fu)) ^ ((a ^ ~b) & 0x80808080u);
+    uint32_t borrow = ((~a & b) | ((~a | b) & d)) & 0x80808080u;   // a<b 的字节
+    uint32_t m = (borrow >> 7) * 0xFFu;
+    return (d ^ m) + (m & 0x01010101u);
+}
+
+void motion_absdiff(const uint8_t* a, const uint8_t* b, uint8_t* out, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t wa, wb, wd;
+        memcpy(&wa, a + i, 4);
+        memcpy(&wb, b + i, 4);
+        wd = motion_absdiff4(wa, wb);
+        memcpy(out + i, &wd, 4);
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+}
+
+bool motion_downsample_luma(const wifi_frame_desc_t* frame, uint8_t* out)
+{
+    const int cols = frame->width / MOTION_SCALE;
+    const int rows = frame->height / MOTION_SCALE;
+
+    switch (frame->format) {
+        case UDP_FMT_RGB565:
+            {
+                // 先分别累加4x4块内的R/G/B，每块只做一次亮度换算
+                const bool big_endian = (frame->flags & UDP_FLAG_BIG_ENDIAN) != 0;
+                for (int by = 0; by < rows; by++) {
+                    for (int bx = 0; bx < cols; bx++) {
+                        uint32_t sum_r = 0, sum_g = 0, sum_b = 0;
+                        for (int y = 0; y < MOTION_SCALE; y++) {
+                            const uint8_t *p = frame->data + (size_t)(by * MOTION_SCALE + y) * frame->stride
+                                               + (size_t)bx * MOTION_SCALE * 2;
+                            for (int x = 0; x < MOTION_SCALE; x++, p += 2) {
+                                uint16_t v = big_endian ? (uint16_t)((p[0] << 8) | p[1])
+                                                        : (uint16_t)((p[1] << 8) | p[0]);
+                                sum_r += v >> 11;
+                                sum_g += (v >> 5) & 0x3F;
+                                sum_b += v & 0x1F;
+                            }
+                        }
+                        // Y = (77R + 150G + 29B) / 256，R/B左移3位、G左移2位展开到8bit，再除以16个像素
+                        *out++ = (uint8_t)((77 * (sum_r << 3) + 150 * (sum_g << 2) + 29 * (sum_b << 3)) >> 12);
+                    }
+                }
+            }
+            return true;
+        case UDP_FMT_GRAY:
+        case UDP_FMT_YUV422:
+            {
+                // YUYV中Y位于偶数字节
+                const int step = (frame->format == UDP_FMT_YUV422) ? 2 : 1;
+                for (int by = 0; by < rows; by++) {
+                    for (int bx = 0; bx < cols; bx++) {
+                        uint32_t sum = 0;
+                        for (int y = 0; y < MOTION_SCALE; y++) {
+                            const uint8_t *p = frame->data + (size_t)(by * MOTION_SCALE + y) * frame->stride
+                                               + (size_t)bx * MOTION_SCALE * step;
+                            for (int x = 0; x < MOTION_SCALE; x++, p += step) {
+                                sum += *p;
+                            }
+                        }
+                        *out++ = (uint8_t)(sum >> 4);
+                    }
+                }
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+void motion_init(motion_detector_t* md, const motion_config_t* config)
+{
+    memset(md, 0, sizeof(*md));
+    md->config = config ? *config : motion_default_config;
+}
+
+void motion_reset(motion_detector_t* md)
+{
+    md->has_background = false;
+    md->active = false;
+    md->quiet_frames = 0;
+}
+
+// 插入一个候选包围框，只保留面积最大的MOTION_MAX_BOXES个
+static void motion_add_box(motion_result_t* result, const motion_box_t* box)
+{
+    if (result->box_count < MOTION_MAX_BOXES) {
+        result->boxes[result->box_count++] = *box;
+        return;
+    }
+    int smallest = 0;
+    for (int i = 1; i < MOTION_MAX_BOXES; i++) {
+        if (result->boxes[i].cells < result->boxes[smallest].cells) {
+            smallest = i;
+        }
+    }
+    if (box->cells > result->boxes[smallest].cells) {
+        result->boxes[smallest] = *box;
+    }
+}
+
+// 在运动掩码上做4连通域搜索，生成包围框（掩码1=未访问，2=已访问）
+static void motion_find_boxes(motion_detector_t* md, motion_result_t* result)
+{
+    const int w = md->width;
+    const int h = md->height;
+
+    for (int start = 0; start < w * h; start++) {
+        if (md->mask[start] != 1) {
+            continue;
+        }
+
+        int sp = 0;
+        int min_x = w, min_y = h, max_x = 0, max_y = 0;
+        uint16_t cells = 0;
+        md->stack[sp++] = start;
+        md->mask[start] = 2;
+
+        while (sp > 0) {
+            int idx = md->stack[--sp];
+            int x = idx % w;
+            int y = idx / w;
+            cells++;
+            if (x < min_x) min_x = x;
+            if (x > max_x) max_x = x;
+            if (y < min_y) min_y = y;
+            if (y > max_y) max_y = y;
+
+            // 每个单元入栈前标记为已访问，栈深度不会超过单元总数
+            if (x > 0 && md->mask[idx - 1] == 1) {
+                md->mask[idx - 1] = 2;
+                md->stack[sp++] = idx - 1;
+            }
+            if (x < w - 1 && md->mask[idx + 1] == 1) {
+                md->mask[idx + 1] = 2;
+                md->stack[sp++] = idx + 1;
+            }
+            if (y > 0 && md->mask[idx - w] == 1) {
+                md->mask[idx - w] = 2;
+                md->stack[sp++] = idx - w;
+            }
+            if (y < h - 1 && md->mask[idx + w] == 1) {
+                md->mask[idx + w] = 2;
+                md->stack[sp++] = idx + w;
+            }
+        }
+
+        if (cells < md->config.min_area) {
+            continue;
+        }
+
+        motion_box_t box = {
+            .x = min_x * MOTION_SCALE,
+            .y = min_y * MOTION_SCALE,
+            .width = (max_x - min_x + 1) * MOTION_SCALE,
+            .height = (max_y - min_y + 1) * MOTION_SCALE,
+            .cells = cells,
+        };
+        motion_add_box(result, &box);
+    }
+}
+
+bool motion_process(motion_detector_t* md, const wifi_frame_desc_t* frame, motion_result_t* result)
+{
+    memset(result, 0, sizeof(*result));
+
+    if (!frame || !frame->data) {
+        return false;
+    }
+
+    const int w = frame->width / MOTION_SCALE;
+    const int h = frame->height / MOTION_SCALE;
+    if (w == 0 || h == 0 || w > MOTION_MAX_WIDTH || h > MOTION_MAX_HEIGHT) {
+        ESP_LOGW(TAG, "Unsupported frame size for motion detection: %dx%d", frame->width, frame->height);
+        return false;
+    }
+
+    // 分辨率变化后重新建立背景
+    if (frame->width != md->frame_width || frame->height != md->frame_height) {
+        md->frame_width = frame->width;
+        md->frame_height = frame->height;
+        md->width = w;
+        md->height = h;
+        motion_reset(md);
+    }
+
+    if (!motion_downsample_luma(frame, md->luma)) {
+        return false;
+    }
+
+    const int n = w * h;
+    md->frames++;
+
+    if (!md->has_background) {
+        for (int i = 0; i < n; i++) {
+            md->background[i] = (uint16_t)(md->luma[i] << 8);
+            md->background_u8[i] = md->luma[i];
+        }
+        md->has_background = true;
+        result->active = md->active;
+        return true;
+    }
+
+    motion_absdiff(md->luma, md->background_u8, md->diff, n);
+
+    // 阈值化并更新背景：运动单元学习更慢，避免运动物体很快被吸收进背景
+    const uint8_t threshold = md->config.threshold;
+    const int learn = md->config.learn_shift;
+    int moving = 0;
+    for (int i = 0; i < n; i++) {
+        uint8_t m = md->diff[i] > threshold;
+        md->mask[i] = m;
+        moving += m;
+
+        int32_t bg = md->background[i];
+        bg += (((int32_t)md->luma[i] << 8) - bg) >> (m ? learn + 2 : learn);
+        md->background[i] = (uint16_t)bg;
+        md->background_u8[i] = (uint8_t)(bg >> 8);
+    }
+
+    result->score = (uint16_t)(moving * 1000 / n);
+
+    if (moving > 0) {
+        motion_find_boxes(md, result);
+    }
+
+    // 事件：超过触发阈值开始，低于一半阈值持续hold_frames帧后结束
+    if (result->score >= md->config.trigger) {
+        md->quiet_frames = 0;
+        if (!md->active) {
+            md->active = true;
+            md->events++;
+            result->event = MOTION_EVENT_START;
+        }
+    } else if (md->active) {
+        if (result->score >= md->config.trigger / 2) {
+            md->quiet_frames = 0;
+        } else if (++md->quiet_frames >= md->config.hold_frames) {
+            md->active = false;
+            result->event = MOTION_EVENT_END;
+        }
+    }
+
+    result->active = md->active;
+    return true;
+}
@@ -0,0 +1,125 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 运动检测头文件
+// 降采样亮度 + 自适应背景 + 帧差，输出运动分数、包围框和开始/结束事件
+// 不依赖FreeRTOS，可在Linux主机上编译并做基准测试（host/motion_bench.c）
+
+#define MOTION_SCALE 4                  // 降采样倍数（每4x4像素一个单元）
+#define MOTION_MAX_WIDTH 80             // 降采样后最大宽度（支持到320像素宽）
+#define MOTION_MAX_HEIGHT 60            // 降采样后最大高度（支持到240像素高）
+#define MOTION_MAX_CELLS (MOTION_MAX_WIDTH * MOTION_MAX_HEIGHT)
+#define MOTION_MAX_BOXES 4              // 每帧最多输出的包围框数
+
+#define MOTION_DEFAULT_THRESHOLD 24     // 单元亮度差阈值
+#define MOTION_DEFAULT_LEARN_SHIFT 4    // 背景学习率 1/16
+#define MOTION_DEFAULT_TRIGGER 20       // 运动开始阈值（千分比，运动单元占比）
+#define MOTION_DEFAULT_MIN_AREA 2       // 包围框最小单元数（过滤噪点）
+#define MOTION_DEFAULT_HOLD_FRAMES 30   // 低于阈值持续多少帧后结束运动事件
+
+// 运动事件
+typedef enum {
+    MOTION_EVENT_NONE = 0,
+    MOTION_EVENT_START,     // 运动开始
+    MOTION_EVENT_END,       // 运动结束
+} motion_event_t;
+
+// 包围框（原始帧像素坐标）
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t cells;         // 框内运动单元数
+} motion_box_t;
+
+// 检测参数
+typedef struct {
+    uint8_t threshold;      // 单元亮度差阈值
+    uint8_t learn_shift;    // 背景学习率 1/2^n
+    uint16_t trigger;       // 运动开始阈值（千分比）
+    uint16_t min_area;      // 包围框最小单元数
+    uint16_t hold_frames;   // 运动结束前的保持帧数
+} motion_config_t;
+
+// 单帧检测结果
+typedef struct {
+    uint16_t score;         // 运动分数（运动单元千分比）
+    bool active;            // 当前是否处于运动状态
+    motion_event_t event;   // 本帧产生的事件
+    uint8_t box_count;
+    motion_box_t boxes[MOTION_MAX_BOXES];
+} motion_result_t;
+
+// 检测器状态（约38KB，由调用者静态分配）
+typedef struct {
+    motion_config_t config;
+    uint16_t width;                             // 降采样后尺寸
+    uint16_t height;
+    uint16_t frame_width;                       // 原始帧尺寸
+    uint16_t frame_height;
+    bool has_background;
+    uint16_t quiet_frames;
+    bool active;
+    uint32_t frames;
+    uint32_t events;
+    uint8_t luma[MOTION_MAX_CELLS];             // 当前帧降采样亮度
+    uint8_t diff[MOTION_MAX_CELLS];             // 与背景的绝对差
+    uint8_t mask[MOTION_MAX_CELLS];             // 运动掩码 / 连通域标记
+    uint16_t background[MOTION_MAX_CELLS];      // 背景（Q8定点）
+    uint8_t background_u8[MOTION_MAX_CELLS];    // 背景整数部分（供帧差核使用）
+    uint16_t stack[MOTION_MAX_CELLS];           // 连通域搜索栈
+} motion_detector_t;
+
+/**
+ * @brief 初始化运动检测器
+ * @param md 检测器
+ * @param config 检测参数，NULL使用默认值
+ */
+void motion_init(motion_detector_t* md, const motion_config_t* config);
+
+/**
+ * @brief 重置背景（分辨率变化或场景切换后调用）
+ * @param md 检测器
+ */
+void motion_reset(motion_detector_t* md);
+
+/**
+ * @brief 处理一帧
+ * @param md 检测器
+ * @param frame 帧描述（支持RGB565/灰度/YUV422）
+ * @param result 检测结果输出
+ * @return true 成功，false 格式或尺寸不支持
+ */
+bool motion_process(motion_detector_t* md, const wifi_frame_desc_t* frame, motion_result_t* result);
+
+/**
+ * @brief 将帧降采样为亮度图（每MOTION_SCALE x MOTION_SCALE像素取均值）
+ * @param frame 帧描述
+ * @param out 输出亮度，宽高为帧尺寸/MOTION_SCALE
+ * @return true 成功，false 格式或尺寸不支持
+ */
+bool motion_downsample_luma(const wifi_frame_desc_t* frame, uint8_t* out);
+
+/**
+ * @brief 逐字节绝对差（每次处理4字节的SWAR实现）
+ * @param a 输入a
+ * @param b 输入b
+ * @param out 输出|a-b|
+ * @param n 字节数
+ */
+void motion_absdiff(const uint8_t* a, const uint8_t* b, uint8_t* out, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_H
@@ -0,0 +1,456 @@
+#include "pipeline.h"
+#include "esp_log.h"
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#else
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#endif
+
+static const char *TAG = "pipeline";
+
+#ifdef ESP_PLATFORM
+// 系统对象：任务退出前通知停止者（joiner），停止者按退出的任务数等待通知
+typedef struct {
+    TaskHandle_t capture;
+    TaskHandle_t consumer;
+    QueueHandle_t queue;
+    volatile TaskHandle_t joiner;
+} pipeline_os_t;
+
+static int64_t pipeline_now_us(void)
+{
+    return esp_timer_get_time();
+}
+#else
+// 主机实现：有界环形队列 + 互斥锁/条件变量，pthread_join 等待任务退出
+typedef struct {
+    pthread_t capture;
+    pthread_t consumer;
+    bool has_capture;
+    bool has_consumer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    void **ring;
+    int head;
+    int count;
+    int cap;
+} pipeline_os_t;
+
+static int64_t pipeline_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+static void pipeline_outstanding_add(pipeline_t* p, int32_t n)
+{
+    __atomic_add_fetch(&p->stats.outstanding, n, __ATOMIC_SEQ_CST);
+}
+
+static void pipeline_put(pipeline_t* p, void* frame)
+{
+    p->config.put(p->config.ctx, frame);
+    pipeline_outstanding_add(p, -1);
+}
+
+// ---- 队列 ----
+
+static bool pipeline_queue_create(pipeline_os_t* os, int len)
+{
+#ifdef ESP_PLATFORM
+    os->queue = xQueueCreate(len, sizeof(void *));
+    return os->queue != NULL;
+#else
+    os->ring = calloc(len, sizeof(void *));
+    os->cap = len;
+    os->head = 0;
+    os->count = 0;
+    return os->ring != NULL;
+#endif
+}
+
+static void pipeline_queue_delete(pipeline_os_t* os)
+{
+#ifdef ESP_PLATFORM
+    if (os->queue) {
+        vQueueDelete(os->queue);
+        os->queue = NULL;
+    }
+#else
+    free(os->ring);
+    os->ring = NULL;
+#endif
+}
+
+static bool pipeline_queue_send(pipeline_os_t* os, void* frame, uint32_t timeout_ms)
+{
+#ifdef ESP_PLATFORM
+    return xQueueSend(os->queue, &frame, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&os->lock);
+    while (os->count == os->cap) {
+        if (timeout_ms == 0 || pthread_cond_timedwait(&os->changed, &os->lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&os->lock);
+            return false;
+        }
+    }
+    os->ring[(os->head + os->count) % os->cap] = frame;
+    os->count++;
+    pthread_cond_broadcast(&os->changed);
+    pthread_mutex_unlock(&os->lock);
+    return true;
+#endif
+}
+
+static bool pipeline_queue_receive(pipeline_os_t* os, void** frame, uint32_t timeout_ms)
+{
+#ifdef ESP_PLATFORM
+    return xQueueReceive(os->queue, frame, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&os->lock);
+    while (os->count == 0) {
+        if (timeout_ms == 0 || pthread_cond_timedwait(&os->changed, &os->lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&os->lock);
+            return false;
+        }
+    }
+    *frame = os->ring[os->head];
+    os->head = (os->head + 1) % os->cap;
+    os->count--;
+    pthread_cond_broadcast(&os->changed);
+    pthread_mutex_unlock(&os->lock);
+    return true;
+#endif
+}
+
+// 回收队列中的帧（NULL是唤醒消费者用的哨兵，丢弃）
+static int pipeline_drain(pipeline_t* p)
+{
+    pipeline_os_t *os = (pipeline_os_t *)p->os;
+    void *frame;
+    int n = 0;
+    while (pipeline_queue_receive(os, &frame, 0)) {
+        if (frame) {
+            pipeline_put(p, frame);
+            n++;
+        }
+    }
+    return n;
+}
+
+// ---- 任务主体 ----
+
+static void pipeline_capture_loop(pipeline_t* p)
+{
+    pipeline_os_t *os = (pipeline_os_t *)p->os;
+    const pipeline_config_t *c = &p->config;
+
+    while (!p->stop) {
+        void *frame = c->get(c->ctx);
+        if (!frame) {
+            continue;
+        }
+        pipeline_outstanding_add(p, 1);
+        p->stats.frames++;
+
+        bool forward = c->process ? c->process(c->ctx, frame) : true;
+        // 停止过程中不再交给消费者，保证停止者回收队列之后不会有新的帧进入
+        if (forward && c->consume && !p->stop) {
+            if (pipeline_queue_send(os, frame, PIPELINE_FORWARD_TIMEOUT_MS)) {
+                p->stats.forwarded++;
+                continue;
+            }
+            p->stats.dropped++;
+        }
+        pipeline_put(p, frame);
+    }
+}
+
+static void pipeline_consumer_loop(pipeline_t* p)
+{
+    pipeline_os_t *os = (pipeline_os_t *)p->os;
+    const pipeline_config_t *c = &p->config;
+
+    while (!p->stop) {
+        void *frame;
+        if (!pipeline_queue_receive(os, &frame, PIPELINE_RECEIVE_TIMEOUT_MS) || !frame) {
+            continue;
+        }
+        c->consume(c->ctx, frame);
+        pipeline_put(p, frame);
+    }
+}
+
+#ifdef ESP_PLATFORM
+// 任务退出：通知停止者后自行删除，此后不再访问流水线
+static void pipeline_task_exit(pipeline_t* p)
+{
+    pipeline_os_t *os = (pipeline_os_t *)p->os;
+    TaskHandle_t joiner = os->joiner;
+    if (joiner) {
+        xTaskNotifyGive(joiner);
+    }
+    vTaskDelete(NULL);
+}
+
+static void pipeline_capture_task(void *arg)
+{
+    pipeline_t *p = (pipeline_t *)arg;
+    ESP_LOGI(TAG, "%s task started", p->config.capture_name);
+    pipeline_capture_loop(p);
+    ESP_LOGI(TAG, "%s task stopped", p->config.capture_name);
+    pipeline_task_exit(p);
+}
+
+static void pipeline_consumer_task(void *arg)
+{
+    pipeline_t *p = (pipeline_t *)arg;
+    ESP_LOGI(TAG, "%s task started", p->config.consumer_name);
+    pipeline_consumer_loop(p);
+    ESP_LOGI(TAG, "%s task stopped", p->config.consumer_name);
+    pipeline_task_exit(p);
+}
+
+static bool pipeline_task_create(pipeline_t* p, TaskFunction_t fn, const char* name, uint32_t stack,
+                                 uint8_t priority, int8_t core, TaskHandle_t* handle)
+{
+    BaseType_t ret = xTaskCreatePinnedToCore(fn, name, stack, p, priority, handle,
+                                             core < 0 ? tskNO_AFFINITY : core);
+    if (ret != pdPASS) {
+        *handle = NULL;
+        return false;
+    }
+    return true;
+}
+#else
+static void *pipeline_capture_thread(void *arg)
+{
+    pipeline_capture_loop((pipeline_t *)arg);
+    return NULL;
+}
+
+static void *pipeline_consumer_thread(void *arg)
+{
+    pipeline_consumer_loop((pipeline_t *)arg);
+    return NULL;
+}
+#endif
+
+// ---- 启动/停止 ----
+
+// 唤醒并等待所有已创建的任务退出，返回是否全部退出
+static bool pipeline_join(pipeline_t* p)
+{
+    pipeline_os_t *os = (pipeline_os_t *)p->os;
+
+#ifdef ESP_PLATFORM
+    int tasks = (os->capture ? 1 : 0) + (os->consumer ? 1 : 0);
+    ulTaskNotifyTake(pdTRUE, 0);     // 清除停止者之前残留的通知
+    os->joiner = xTaskGetCurrentTaskHandle();
+    p->stop = true;
+    if (os->consumer) {
+        void *wake = NULL;
+        xQueueSend(os->queue, &wake, 0);    // 消费者正在等待队列时立即唤醒
+    }
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(PIPELINE_STOP_TIMEOUT_MS);
+    while (tasks > 0) {
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0 || ulTaskNotifyTake(pdFALSE, deadline - now) == 0) {
+            return false;
+        }
+        tasks--;
+    }
+    os->capture = NULL;
+    os->consumer = NULL;
+    return true;
+#else
+    p->stop = true;
+    if (os->has_consumer) {
+        pipeline_queue_send(os, NULL, 0);
+    }
+    if (os->has_capture) {
+        pthread_join(os->capture, NULL);
+        os->has_capture = false;
+    }
+    if (os->has_consumer) {
+        pthread_join(os->consumer, NULL);
+        os->has_consumer = false;
+    }
+    return true;
+#endif
+}
+
+static void pipeline_release_os(pipeline_t* p)
+{
+    pipeline_os_t *os = (pipeline_os_t *)p->os;
+    pipeline_queue_delete(os);
+#ifndef ESP_PLATFORM
+    pthread_cond_destroy(&os->changed);
+    pthread_mutex_destroy(&os->lock);
+#endif
+    free(os);
+    p->os = NULL;
+}
+
+bool pipeline_start(pipeline_t* p, const pipeline_config_t* config)
+{
+    if (p->running) {
+        ESP_LOGW(TAG, "Pipeline already running");
+        return true;
+    }
+    if (p->os) {
+        ESP_LOGE(TAG, "Previous pipeline tasks did not exit, cannot restart");
+        return false;
+    }
+    if (!config || !config->get || !config->put) {
+        ESP_LOGE(TAG, "Invalid pipeline config");
+        return false;
+    }
+
+    pipeline_os_t *os = calloc(1, sizeof(pipeline_os_t));
+    if (!os) {
+        ESP_LOGE(TAG, "Out of memory");
+        return false;
+    }
+    p->config = *config;
+    p->os = os;
+    p->stop = false;
+#ifndef ESP_PLATFORM
+    pthread_mutex_init(&os->lock, NULL);
+    pthread_cond_init(&os->changed, NULL);
+#endif
+
+    bool ok = !config->consume || pipeline_queue_create(os, config->queue_len ? config->queue_len : 1);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to create frame queue");
+    }
+
+#ifdef ESP_PLATFORM
+    // 先创建消费者，捕获任务开始取帧时消费者已在等待
+    if (ok && config->consume) {
+        ok = pipeline_task_create(p, pipeline_consumer_task, config->consumer_name, config->consumer_stack,
+                                  config->consumer_priority, config->consumer_core, &os->consumer);
+    }
+    if (ok) {
+        ok = pipeline_task_create(p, pipeline_capture_task, config->capture_name, config->capture_stack,
+                                  config->capture_priority, config->capture_core, &os->capture);
+    }
+#else
+    if (ok && config->consume) {
+        ok = os->has_consumer = pthread_create(&os->consumer, NULL, pipeline_consumer_thread, p) == 0;
+    }
+    if (ok) {
+        ok = os->has_capture = pthread_create(&os->capture, NULL, pipeline_capture_thread, p) == 0;
+    }
+#endif
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to start pipeline tasks");
+        if (pipeline_join(p)) {
+            pipeline_drain(p);
+            pipeline_release_os(p);
+        }
+        return false;
+    }
+
+    p->running = true;
+    p->stats.starts++;
+    return true;
+}
+
+bool pipeline_stop(pipeline_t* p)
+{
+    if (!p->running) {
+        return true;
+    }
+
+    int64_t start = pipeline_now_us();
+    bool joined = pipeline_join(p);
+    p->running = false;
+    if (!joined) {
+        // 任务仍可能访问队列，保留系统对象，下次启动会失败而不是破坏内存
+        p->stats.stop_timeouts++;
+        ESP_LOGE(TAG, "Pipeline tasks did not exit within %d ms", PIPELINE_STOP_TIMEOUT_MS);
+        return false;
+    }
+
+    if (p->config.consume) {
+        p->stats.drained += pipeline_drain(p);
+    }
+    pipeline_release_os(p);
+
+    uint32_t elapsed = (uint32_t)(pipeline_now_us() - start);
+    p->stats.stops++;
+    p->stats.last_stop_us = elapsed;
+    if (elapsed > p->stats.max_stop_us) {
+        p->stats.max_stop_us = elapsed;
+    }
+
+    int32_t outstanding = __atomic_load_n(&p->stats.outstanding, __ATOMIC_SEQ_CST);
+    if (outstanding != 0) {
+        p->stats.leaks++;
+        ESP_LOGE(TAG, "%ld frames not returned after stop", (long)outstanding);
+        return false;
+    }
+    return true;
+}
+
+int pipeline_flush(pipeline_t* p)
+{
+    if (!p->os || !p->config.consume) {
+        return 0;
+    }
+    int n = pipeline_drain(p);
+    p->stats.drained += n;
+    return n;
+}
+
+bool pipeline_is_running(const pipeline_t* p)
+{
+    return p->running;
+}
+
+bool pipeline_in_capture_task(const pipeline_t* p)
+{
+    const pipeline_os_t *os = (const pipeline_os_t *)p->os;
+    if (!os) {
+        return false;
+    }
+#ifdef ESP_PLATFORM
+    return os->capture == xTaskGetCurrentTaskHandle();
+#else
+    return os->has_capture && pthread_equal(os->capture, pthread_self());
+#endif
+}
+
+void pipeline_get_stats(const pipeline_t* p, pipeline_stats_t* stats)
+{
+    *stats = p->stats;
+    stats->outstanding = __atomic_load_n(&p->stats.outstanding, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,111 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 采集流水线头文件
+// 捕获任务取帧 -> 处理 -> 交给可选的消费者任务（LCD），消费者用完后归还
+// 停止是协作式的：置停止标志并唤醒各任务，任务处理完手上的帧后自行退出并通知停止者（join），
+// 最后回收队列中剩余的帧，保证每个帧缓冲区都归还给帧源，不使用 vTaskDelete 强制删除任务
+// ESP-IDF下使用FreeRTOS任务/队列/任务通知，Linux主机上使用pthread（host/pipeline_stress.c）
+
+#define PIPELINE_STOP_TIMEOUT_MS 5000      // 等待任务退出的上限（帧源取帧超时应小于该值）
+#define PIPELINE_FORWARD_TIMEOUT_MS 10     // 交给消费者时等待队列空位的时间，超时则直接归还
+#define PIPELINE_RECEIVE_TIMEOUT_MS 100    // 消费者等待帧的超时
+
+// 帧源与处理回调（frame由帧源定义，如 camera_fb_t*）
+typedef struct {
+    void* (*get)(void* ctx);                        // 取帧，可阻塞（需有超时），失败返回NULL
+    void (*put)(void* ctx, void* frame);            // 归还帧
+    bool (*process)(void* ctx, void* frame);        // 捕获任务中处理，返回true交给消费者；NULL表示直接交给消费者
+    void (*consume)(void* ctx, void* frame);        // 消费者任务中使用帧（返回后自动归还）；NULL表示没有消费者任务
+    void *ctx;
+    uint8_t queue_len;                              // 捕获任务到消费者的队列长度
+    const char *capture_name;
+    uint32_t capture_stack;
+    uint8_t capture_priority;
+    int8_t capture_core;                            // -1表示不绑定
+    const char *consumer_name;
+    uint32_t consumer_stack;
+    uint8_t consumer_priority;
+    int8_t consumer_core;
+} pipeline_config_t;
+
+// 统计信息
+typedef struct {
+    uint32_t starts;
+    uint32_t stops;
+    uint32_t frames;            // 取得的帧数
+    uint32_t forwarded;         // 交给消费者的帧数
+    uint32_t dropped;           // 消费者队列满、直接归还的帧数
+    uint32_t drained;           // 停止时从队列中回收的帧数
+    int32_t outstanding;        // 当前已取出未归还的帧数
+    uint32_t leaks;             // 停止后仍有帧未归还的次数（应为0）
+    uint32_t stop_timeouts;     // 任务未在超时内退出的次数（应为0）
+    uint32_t last_stop_us;      // 最近一次停止耗时
+    uint32_t max_stop_us;
+} pipeline_stats_t;
+
+// 流水线（由调用者静态分配）
+typedef struct {
+    pipeline_config_t config;
+    volatile bool running;
+    volatile bool stop;
+    void *os;                   // 任务、队列等系统对象，启动时分配，停止时释放
+    pipeline_stats_t stats;
+} pipeline_t;
+
+/**
+ * @brief 启动流水线（创建队列、捕获任务和可选的消费者任务）
+ * @param p 流水线
+ * @param config 配置
+ * @return true 成功，false 失败（已创建的任务会被协作停止）
+ */
+bool pipeline_start(pipeline_t* p, const pipeline_config_t* config);
+
+/**
+ * @brief 协作停止：通知任务退出并等待（join），回收队列中的帧后释放队列
+ * @param p 流水线
+ * @return true 所有任务已退出且所有帧已归还，false 超时或有帧未归还
+ * @note 不能在流水线自己的任务中调用
+ */
+bool pipeline_stop(pipeline_t* p);
+
+/**
+ * @brief 归还消费者队列中排队的帧（在捕获任务中调用，如快照前重新初始化驱动）
+ * @param p 流水线
+ * @return 回收的帧数
+ */
+int pipeline_flush(pipeline_t* p);
+
+/**
+ * @brief 流水线是否正在运行
+ * @param p 流水线
+ * @return true 运行中
+ */
+bool pipeline_is_running(const pipeline_t* p);
+
+/**
+ * @brief 当前任务是否是流水线的捕获任务
+ * @param p 流水线
+ * @return true 是
+ */
+bool pipeline_in_capture_task(const pipeline_t* p);
+
+/**
+ * @brief 获取统计信息
+ * @param p 流水线
+ * @param stats 统计信息输出
+ */
+void pipeline_get_stats(const pipeline_t* p, pipeline_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PIPELINE_H
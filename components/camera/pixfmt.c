@@ -0,0 +1,203 @@
+#include "pixfmt.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "pixfmt";
+
+// 一次读取两个RGB565像素，展开为两个16位通道（低16位=左像素）
+static inline uint32_t pixfmt_load_rgb565x2(const uint8_t *p, bool big_endian)
+{
+    uint32_t w;
+    memcpy(&w, p, 4);
+    if (big_endian) {
+        w = ((w & 0x00FF00FFu) << 8) | ((w >> 8) & 0x00FF00FFu);  // 两个像素同时交换字节
+    }
+    return w;
+}
+
+// 两个像素的8bit R/G/B分量，各占一个16位通道
+static inline uint32_t pixfmt_r8x2(uint32_t w) { return (w >> 8) & 0x00F800F8u; }
+static inline uint32_t pixfmt_g8x2(uint32_t w) { return (w >> 3) & 0x00FC00FCu; }
+static inline uint32_t pixfmt_b8x2(uint32_t w) { return (w << 3) & 0x00F800F8u; }
+
+// 全范围亮度（Y8），两个通道同时计算，通道内最大值不超过16位
+static inline uint32_t pixfmt_y_full_x2(uint32_t w)
+{
+    uint32_t y = 77 * pixfmt_r8x2(w) + 150 * pixfmt_g8x2(w) + 29 * pixfmt_b8x2(w) + 0x00800080u;
+    return (y >> 8) & 0x00FF00FFu;
+}
+
+// BT.601 有限范围亮度（YUV420，与rtp.c一致）
+static inline uint32_t pixfmt_y_limited_x2(uint32_t w)
+{
+    uint32_t y = 66 * pixfmt_r8x2(w) + 129 * pixfmt_g8x2(w) + 25 * pixfmt_b8x2(w) + 0x00800080u;
+    return ((y >> 8) & 0x00FF00FFu) + 0x00100010u;
+}
+
+static inline uint32_t pixfmt_lane_sum(uint32_t v)
+{
+    return (v & 0xFFFF) + (v >> 16);
+}
+
+size_t pixfmt_frame_size(uint8_t format, uint16_t width, uint16_t height)
+{
+    switch (format) {
+        case UDP_FMT_RGB565:
+        case UDP_FMT_YUV422:
+            return (size_t)width * height * 2;
+        case UDP_FMT_GRAY:
+            return (size_t)width * height;
+        case UDP_FMT_YUV420:
+            return (size_t)width * height + 2 * (size_t)(width / 2) * (height / 2);
+        default:
+            return 0;
+    }
+}
+
+bool pixfmt_can_convert(uint8_t src_format, uint8_t dst_format)
+{
+    if (src_format != UDP_FMT_RGB565 && src_format != UDP_FMT_YUV422) {
+        return false;
+    }
+    return dst_format == UDP_FMT_GRAY || dst_format == UDP_FMT_YUV420;
+}
+
+static void pixfmt_rgb565_to_y8(const wifi_frame_desc_t *src, uint8_t *dst, int y0, int y1)
+{
+    const bool big_endian = (src->flags & UDP_FLAG_BIG_ENDIAN) != 0;
+    dst += (size_t)y0 * src->width;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *p = src->data + (size_t)y * src->stride;
+        for (int x = 0; x < src->width; x += 2, p += 4) {
+            uint32_t luma = pixfmt_y_full_x2(pixfmt_load_rgb565x2(p, big_endian));
+            *dst++ = (uint8_t)luma;
+            *dst++ = (uint8_t)(luma >> 16);
+        }
+    }
+}
+
+static void pixfmt_rgb565_to_yuv420(const wifi_frame_desc_t *src, uint8_t *dst, int y0, int y1)
+{
+    const bool big_endian = (src->flags & UDP_FLAG_BIG_ENDIAN) != 0;
+    const int w = src->width;
+    uint8_t *y_plane = dst;
+    uint8_t *u_plane = dst + (size_t)w * src->height + (size_t)(w / 2) * (y0 / 2);
+    uint8_t *v_plane = dst + (size_t)w * src->height + (size_t)(w / 2) * (src->height / 2) + (size_t)(w / 2) * (y0 / 2);
+
+    // 每次处理2x2块：4个亮度 + 1对色度（取4个像素RGB均值）
+    for (int y = y0; y < y1; y += 2) {
+        const uint8_t *p0 = src->data + (size_t)y * src->stride;
+        const uint8_t *p1 = p0 + src->stride;
+        uint8_t *y_row0 = y_plane + (size_t)y * w;
+        uint8_t *y_row1 = y_row0 + w;
+        for (int x = 0; x < w; x += 2, p0 += 4, p1 += 4) {
+            uint32_t a = pixfmt_load_rgb565x2(p0, big_endian);
+            uint32_t b = pixfmt_load_rgb565x2(p1, big_endian);
+
+            uint32_t la = pixfmt_y_limited_x2(a);
+            uint32_t lb = pixfmt_y_limited_x2(b);
+            *y_row0++ = (uint8_t)la;
+            *y_row0++ = (uint8_t)(la >> 16);
+            *y_row1++ = (uint8_t)lb;
+            *y_row1++ = (uint8_t)(lb >> 16);
+
+            int r = (int)(pixfmt_lane_sum(pixfmt_r8x2(a) + pixfmt_r8x2(b)) >> 2);
+            int g = (int)(pixfmt_lane_sum(pixfmt_g8x2(a) + pixfmt_g8x2(b)) >> 2);
+            int bl = (int)(pixfmt_lane_sum(pixfmt_b8x2(a) + pixfmt_b8x2(b)) >> 2);
+            *u_plane++ = (uint8_t)(((-38 * r - 74 * g + 112 * bl + 128) >> 8) + 128);
+            *v_plane++ = (uint8_t)(((112 * r - 94 * g - 18 * bl + 128) >> 8) + 128);
+        }
+    }
+}
+
+// 传感器YUV422为YUYV排列
+static void pixfmt_yuv422_to_y8(const wifi_frame_desc_t *src, uint8_t *dst, int y0, int y1)
+{
+    dst += (size_t)y0 * src->width;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *p = src->data + (size_t)y * src->stride;
+        for (int x = 0; x < src->width; x += 2, p += 4) {
+            *dst++ = p[0];
+            *dst++ = p[2];
+        }
+    }
+}
+
+static void pixfmt_yuv422_to_yuv420(const wifi_frame_desc_t *src, uint8_t *dst, int y0, int y1)
+{
+    const int w = src->width;
+    uint8_t *y_plane = dst;
+    uint8_t *u_plane = dst + (size_t)w * src->height + (size_t)(w / 2) * (y0 / 2);
+    uint8_t *v_plane = dst + (size_t)w * src->height + (size_t)(w / 2) * (src->height / 2) + (size_t)(w / 2) * (y0 / 2);
+
+    // 色度垂直方向两行取平均
+    for (int y = y0; y < y1; y += 2) {
+        const uint8_t *p0 = src->data + (size_t)y * src->stride;
+        const uint8_t *p1 = p0 + src->stride;
+        uint8_t *y_row0 = y_plane + (size_t)y * w;
+        uint8_t *y_row1 = y_row0 + w;
+        for (int x = 0; x < w; x += 2, p0 += 4, p1 += 4) {
+            *y_row0++ = p0[0];
+            *y_row0++ = p0[2];
+            *y_row1++ = p1[0];
+            *y_row1++ = p1[2];
+            *u_plane++ = (uint8_t)((p0[1] + p1[1] + 1) >> 1);
+            *v_plane++ = (uint8_t)((p0[3] + p1[3] + 1) >> 1);
+        }
+    }
+}
+
+bool pixfmt_convert_begin(const wifi_frame_desc_t* src, uint8_t dst_format,
+                          uint8_t* dst, size_t dst_size, wifi_frame_desc_t* out)
+{
+    if (!src || !src->data || !dst || !out) {
+        return false;
+    }
+
+    if (!pixfmt_can_convert(src->format, dst_format) || (src->width & 1) || (src->height & 1)) {
+        ESP_LOGW(TAG, "Unsupported conversion %d -> %d for %dx%d",
+                 src->format, dst_format, src->width, src->height);
+        return false;
+    }
+
+    size_t size = pixfmt_frame_size(dst_format, src->width, src->height);
+    if (size > dst_size) {
+        ESP_LOGW(TAG, "Conversion buffer too small: %d < %d", (int)dst_size, (int)size);
+        return false;
+    }
+
+    *out = *src;
+    out->data = dst;
+    out->len = size;
+    out->format = dst_format;
+    out->stride = src->width;                       // 平面格式的stride指亮度平面
+    out->flags &= (uint8_t)~UDP_FLAG_BIG_ENDIAN;    // 8bit平面数据无字节序
+    return true;
+}
+
+void pixfmt_convert_rows(const wifi_frame_desc_t* src, uint8_t dst_format, uint8_t* dst, int row_start, int row_end)
+{
+    if (src->format == UDP_FMT_RGB565) {
+        if (dst_format == UDP_FMT_GRAY) {
+            pixfmt_rgb565_to_y8(src, dst, row_start, row_end);
+        } else {
+            pixfmt_rgb565_to_yuv420(src, dst, row_start, row_end);
+        }
+    } else {
+        if (dst_format == UDP_FMT_GRAY) {
+            pixfmt_yuv422_to_y8(src, dst, row_start, row_end);
+        } else {
+            pixfmt_yuv422_to_yuv420(src, dst, row_start, row_end);
+        }
+    }
+}
+
+bool pixfmt_convert(const wifi_frame_desc_t* src, uint8_t dst_format,
+                    uint8_t* dst, size_t dst_size, wifi_frame_desc_t* out)
+{
+    if (!pixfmt_convert_begin(src, dst_format, dst, dst_size, out)) {
+        return false;
+    }
+    pixfmt_convert_rows(src, dst_format, dst, 0, src->height);
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef PIXFMT_H
+#define PIXFMT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 像素格式转换头文件
+// 把摄像头帧（RGB565/YUV422）转换为更省带宽的 Y8 或平面 YUV420 (I420)
+// 每次32位读取两个像素、2x2块一起处理；不依赖FreeRTOS，可在Linux主机上编译测试
+
+/**
+ * @brief 计算指定格式一帧的字节数
+ * @param format 像素格式 (udp_pixel_format_t)
+ * @param width 宽度
+ * @param height 高度
+ * @return 字节数，不支持的格式返回0
+ */
+size_t pixfmt_frame_size(uint8_t format, uint16_t width, uint16_t height);
+
+/**
+ * @brief 判断能否把src_format转换为dst_format
+ * @param src_format 源格式
+ * @param dst_format 目标格式
+ * @return true 支持，false 不支持
+ */
+bool pixfmt_can_convert(uint8_t src_format, uint8_t dst_format);
+
+/**
+ * @brief 转换一帧
+ * @param src 源帧描述（RGB565/YUV422，宽高需为偶数）
+ * @param dst_format 目标格式（UDP_FMT_GRAY 或 UDP_FMT_YUV420）
+ * @param dst 目标缓冲区
+ * @param dst_size 目标缓冲区大小
+ * @param out 输出帧描述（data指向dst，时间戳和标志位沿用源帧）
+ * @return true 成功，false 格式不支持或缓冲区不足
+ */
+bool pixfmt_convert(const wifi_frame_desc_t* src, uint8_t dst_format,
+                    uint8_t* dst, size_t dst_size, wifi_frame_desc_t* out);
+
+/**
+ * @brief 检查参数并填写输出帧描述，不做转换（与 pixfmt_convert_rows 配合分条带转换）
+ * @param src 源帧描述（RGB565/YUV422，宽高需为偶数）
+ * @param dst_format 目标格式（UDP_FMT_GRAY 或 UDP_FMT_YUV420）
+ * @param dst 目标缓冲区
+ * @param dst_size 目标缓冲区大小
+ * @param out 输出帧描述
+ * @return true 可以转换，false 格式不支持或缓冲区不足
+ */
+bool pixfmt_convert_begin(const wifi_frame_desc_t* src, uint8_t dst_format,
+                          uint8_t* dst, size_t dst_size, wifi_frame_desc_t* out);
+
+/**
+ * @brief 转换 [row_start, row_end) 行，不同行区间可在不同核上并行
+ * @param src 源帧描述（已由 pixfmt_convert_begin 检查）
+ * @param dst_format 目标格式
+ * @param dst 整帧目标缓冲区起始地址
+ * @param row_start 起始行（YUV420需为偶数）
+ * @param row_end 结束行（不含，YUV420需为偶数）
+ */
+void pixfmt_convert_rows(const wifi_frame_desc_t* src, uint8_t dst_format, uint8_t* dst, int row_start, int row_end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PIXFMT_H
@@ -0,0 +1,262 @@
+#include "power.h"
+#include "wifi.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "power";
+
+// 电流估计（mA，3.3V，ESP32-S3手册典型值取整）：CPU双核运行、WiFi接收常开/modem sleep（DTIM1平均）、
+// 摄像头模组、自动轻度睡眠（含WiFi信标唤醒的平均值）
+#define POWER_CPU_MA_240 65
+#define POWER_CPU_MA_160 45
+#define POWER_CPU_MA_80 30
+#define POWER_WIFI_ACTIVE_MA 75
+#define POWER_WIFI_MODEM_SLEEP_MA 15
+#define POWER_CAMERA_MA 20
+#define POWER_LIGHT_SLEEP_MA 3
+
+static power_config_t power_config = {
+    .max_cpu_mhz = POWER_DEFAULT_MAX_CPU_MHZ,
+    .min_cpu_mhz = POWER_DEFAULT_MIN_CPU_MHZ,
+    .idle_hold_ms = POWER_DEFAULT_IDLE_HOLD_MS,
+    .light_sleep = true,
+};
+
+static SemaphoreHandle_t power_mutex = NULL;
+static esp_pm_lock_handle_t lock_cpu = NULL;        // 推流：CPU最高频率
+static esp_pm_lock_handle_t lock_apb = NULL;        // 采集运行：APB 80MHz（LEDC XCLK）
+static esp_pm_lock_handle_t lock_sleep = NULL;      // 采集运行：禁止自动轻度睡眠
+static bool pm_enabled = false;
+static bool light_sleep_enabled = false;
+
+static power_state_t power_state = POWER_STATE_OFF;
+static int64_t state_since_us = 0;
+static int64_t inactive_since_us = 0;
+static uint32_t power_transitions = 0;
+static uint64_t state_time_us[POWER_STATE_MAX];
+static uint32_t state_frames[POWER_STATE_MAX];
+static uint64_t state_latency_sum[POWER_STATE_MAX];
+static uint32_t state_latency_max[POWER_STATE_MAX];
+
+static uint16_t power_cpu_ma(uint16_t mhz)
+{
+    return mhz >= 240 ? POWER_CPU_MA_240 : (mhz >= 160 ? POWER_CPU_MA_160 : POWER_CPU_MA_80);
+}
+
+// 档位对应的CPU频率上限
+static uint16_t power_state_mhz(power_state_t state)
+{
+    if (!pm_enabled) {
+        return CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    }
+    return state == POWER_STATE_STREAMING ? power_config.max_cpu_mhz : power_config.min_cpu_mhz;
+}
+
+static uint16_t power_state_current(power_state_t state)
+{
+    switch (state) {
+        case POWER_STATE_STREAMING:
+            return power_cpu_ma(power_state_mhz(state)) + POWER_WIFI_ACTIVE_MA + POWER_CAMERA_MA;
+        case POWER_STATE_IDLE:
+            return power_cpu_ma(power_state_mhz(state)) + POWER_WIFI_MODEM_SLEEP_MA + POWER_CAMERA_MA;
+        default:
+            return (light_sleep_enabled ? POWER_LIGHT_SLEEP_MA : power_cpu_ma(power_state_mhz(state))) +
+                   POWER_WIFI_MODEM_SLEEP_MA;
+    }
+}
+
+static void power_lock(esp_pm_lock_handle_t lock, bool acquire)
+{
+    if (!lock) {
+        return;
+    }
+    if (acquire) {
+        esp_pm_lock_acquire(lock);
+    } else {
+        esp_pm_lock_release(lock);
+    }
+}
+
+// 切换档位（调用者持有power_mutex）：先取得新档位需要的锁，再释放不再需要的锁
+static void power_enter(power_state_t next)
+{
+    const power_state_t prev = power_state;
+    if (next == prev) {
+        return;
+    }
+
+    const bool was_running = prev != POWER_STATE_OFF;
+    const bool running = next != POWER_STATE_OFF;
+    if (running && !was_running) {
+        power_lock(lock_apb, true);
+        power_lock(lock_sleep, true);
+    }
+    if (next == POWER_STATE_STREAMING) {
+        power_lock(lock_cpu, true);
+    }
+    if (prev == POWER_STATE_STREAMING) {
+        power_lock(lock_cpu, false);
+    }
+    if (was_running && !running) {
+        power_lock(lock_sleep, false);
+        power_lock(lock_apb, false);
+    }
+
+    // 推流时关闭modem sleep，否则下行控制包和TCP应答要等到下一个信标才收到
+    if ((next == POWER_STATE_STREAMING) != (prev == POWER_STATE_STREAMING)) {
+        wifi_set_power_save(next != POWER_STATE_STREAMING);
+    }
+
+    int64_t now = esp_timer_get_time();
+    state_time_us[prev] += now - state_since_us;
+    state_since_us = now;
+    power_state = next;
+    power_transitions++;
+    ESP_LOGI(TAG, "Power profile %s -> %s (CPU %d MHz, est. %d mA)", power_state_name(prev), power_state_name(next),
+             power_state_mhz(next), power_state_current(next));
+}
+
+bool power_init(const power_config_t* config)
+{
+    if (power_mutex) {
+        return true;
+    }
+    if (config) {
+        power_config = *config;
+    }
+    power_mutex = xSemaphoreCreateMutex();
+    if (!power_mutex) {
+        ESP_LOGE(TAG, "Failed to create power mutex");
+        return false;
+    }
+    state_since_us = esp_timer_get_time();
+
+#if CONFIG_PM_ENABLE
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    light_sleep_enabled = power_config.light_sleep;
+#endif
+    const esp_pm_config_t pm_config = {
+        .max_freq_mhz = power_config.max_cpu_mhz,
+        .min_freq_mhz = power_config.min_cpu_mhz,
+        .light_sleep_enable = light_sleep_enabled,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "stream", &lock_cpu);
+    }
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "camera_apb", &lock_apb);
+    }
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "camera", &lock_sleep);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Power management unavailable: %s", esp_err_to_name(err));
+        light_sleep_enabled = false;
+    } else {
+        pm_enabled = true;
+    }
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE not set, only WiFi power save is managed");
+#endif
+
+    ESP_LOGI(TAG, "Power management: CPU %d-%d MHz, light sleep %s, idle after %lu ms",
+             power_state_mhz(POWER_STATE_IDLE), power_state_mhz(POWER_STATE_STREAMING),
+             light_sleep_enabled ? "on" : "off", power_config.idle_hold_ms);
+    return true;
+}
+
+void power_update(bool running, bool active)
+{
+    if (!power_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    power_state_t next;
+    if (!running) {
+        next = POWER_STATE_OFF;
+    } else if (active) {
+        inactive_since_us = 0;
+        next = POWER_STATE_STREAMING;
+    } else {
+        // 门控关闭持续一段时间才降档，避免运动断续时频繁切换
+        if (inactive_since_us == 0) {
+            inactive_since_us = now;
+        }
+        next = (power_state == POWER_STATE_STREAMING &&
+                now - inactive_since_us < (int64_t)power_config.idle_hold_ms * 1000) ? POWER_STATE_STREAMING : POWER_STATE_IDLE;
+    }
+    if (!running) {
+        inactive_since_us = 0;
+    }
+    power_enter(next);
+    xSemaphoreGive(power_mutex);
+}
+
+void power_frame(uint32_t latency_us)
+{
+    if (!power_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    state_frames[power_state]++;
+    state_latency_sum[power_state] += latency_us;
+    if (latency_us > state_latency_max[power_state]) {
+        state_latency_max[power_state] = latency_us;
+    }
+    xSemaphoreGive(power_mutex);
+}
+
+bool power_get_stats(power_stats_t* stats)
+{
+    if (!stats || !power_mutex) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    uint64_t total_us = 0;
+    uint64_t charge = 0;
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        uint64_t t = state_time_us[i] + (i == power_state ? (uint64_t)(now - state_since_us) : 0);
+        power_profile_stats_t *p = &stats->profiles[i];
+        p->time_ms = (uint32_t)(t / 1000);
+        p->frames = state_frames[i];
+        p->fps_x10 = t ? (uint32_t)((uint64_t)state_frames[i] * 10000000 / t) : 0;
+        p->avg_latency_us = state_frames[i] ? (uint32_t)(state_latency_sum[i] / state_frames[i]) : 0;
+        p->max_latency_us = state_latency_max[i];
+        p->cpu_mhz = power_state_mhz((power_state_t)i);
+        p->est_current_ma = power_state_current((power_state_t)i);
+        total_us += t;
+        charge += t * p->est_current_ma;
+    }
+    stats->state = power_state;
+    stats->pm_enabled = pm_enabled;
+    stats->transitions = power_transitions;
+    stats->avg_current_ma = total_us ? (uint16_t)(charge / total_us) : 0;
+    xSemaphoreGive(power_mutex);
+    return true;
+}
+
+const char* power_state_name(power_state_t state)
+{
+    switch (state) {
+        case POWER_STATE_OFF:
+            return "off";
+        case POWER_STATE_IDLE:
+            return "idle";
+        case POWER_STATE_STREAMING:
+            return "streaming";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 功耗/性能管理头文件
+// 按采集和推流状态切换功耗档位：
+//   推流（有接收端且画面有运动）：CPU锁定最高频率，禁止自动轻度睡眠，WiFi关闭modem sleep
+//   空闲（无接收端或无运动持续一段时间）：释放CPU频率锁（动态调频降到最低），WiFi恢复modem sleep
+//   停止（采集流水线未运行）：再释放APB频率锁和禁止睡眠锁，允许自动轻度睡眠（需启用tickless idle）
+// 摄像头运行时始终持有APB频率锁和禁止睡眠锁：XCLK由LEDC产生，DVP使用DMA，都不能降频或睡眠
+// 需要 CONFIG_PM_ENABLE，未启用时只切换WiFi省电模式，统计照常输出
+
+#define POWER_DEFAULT_MAX_CPU_MHZ 240
+#define POWER_DEFAULT_MIN_CPU_MHZ 80    // 低于80MHz时APB时钟随之降低
+#define POWER_DEFAULT_IDLE_HOLD_MS 3000 // 无接收端/无运动持续该时间后进入空闲
+
+// 功耗档位
+typedef enum {
+    POWER_STATE_OFF = 0,        // 采集停止
+    POWER_STATE_IDLE,           // 采集运行，推流门控关闭
+    POWER_STATE_STREAMING,      // 推流
+    POWER_STATE_MAX,
+} power_state_t;
+
+// 配置
+typedef struct {
+    uint16_t max_cpu_mhz;
+    uint16_t min_cpu_mhz;
+    uint32_t idle_hold_ms;
+    bool light_sleep;           // 停止时允许自动轻度睡眠
+} power_config_t;
+
+// 各档位统计（电流为按芯片手册典型值的粗略估计，不是测量值）
+typedef struct {
+    uint32_t time_ms;           // 处于该档位的累计时间
+    uint32_t frames;            // 该档位下处理的帧数
+    uint32_t fps_x10;           // 平均帧率x10
+    uint32_t avg_latency_us;    // 帧时间戳到处理完成的平均延迟
+    uint32_t max_latency_us;
+    uint16_t cpu_mhz;           // 该档位的CPU频率上限
+    uint16_t est_current_ma;    // 估计电流
+} power_profile_stats_t;
+
+// 统计信息
+typedef struct {
+    power_state_t state;
+    bool pm_enabled;            // 动态调频/自动睡眠是否可用
+    uint32_t transitions;       // 档位切换次数
+    uint16_t avg_current_ma;    // 按各档位时间加权的估计平均电流
+    power_profile_stats_t profiles[POWER_STATE_MAX];
+} power_stats_t;
+
+/**
+ * @brief 初始化功耗管理（配置动态调频，创建电源锁），初始为停止档位
+ * @param config 配置，NULL使用默认值
+ * @return true 成功，false 失败（动态调频不可用时仍返回true，只管理WiFi省电模式）
+ */
+bool power_init(const power_config_t* config);
+
+/**
+ * @brief 更新采集/推流状态并切换档位（推流立即切换，进入空闲需持续 idle_hold_ms）
+ * @param running 采集流水线是否运行
+ * @param active 是否需要推流（有接收端且未被运动门控）
+ */
+void power_update(bool running, bool active);
+
+/**
+ * @brief 记录一帧处理完成（计入当前档位的帧率和延迟）
+ * @param latency_us 帧时间戳到处理完成的延迟
+ */
+void power_frame(uint32_t latency_us);
+
+/**
+ * @brief 获取统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 未初始化
+ */
+bool power_get_stats(power_stats_t* stats);
+
+/**
+ * @brief 档位名称
+ * @param state 档位
+ * @return 名称字符串
+ */
+const char* power_state_name(power_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POWER_H
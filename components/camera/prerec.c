@@ -0,0 +1,153 @@
+#include "prerec.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "prerec";
+
+static inline size_t prerec_align(size_t n)
+{
+    return (n + PREREC_ALIGN - 1) & ~(size_t)(PREREC_ALIGN - 1);
+}
+
+static inline prerec_entry_t* prerec_oldest(prerec_ring_t* ring)
+{
+    return &ring->index[ring->first];
+}
+
+static void prerec_evict_oldest(prerec_ring_t* ring)
+{
+    ring->first = (ring->first + 1) % PREREC_MAX_FRAMES;
+    ring->count--;
+    ring->frames_evicted++;
+}
+
+void prerec_init(prerec_ring_t* ring, uint8_t* arena, size_t size, uint32_t retain_ms)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->arena = arena;
+    ring->arena_size = size;
+    ring->retain_us = (int64_t)retain_ms * 1000;
+}
+
+void prerec_reset(prerec_ring_t* ring)
+{
+    ring->first = 0;
+    ring->count = 0;
+    ring->head = 0;
+    ring->reserve_len = 0;
+}
+
+uint8_t* prerec_reserve(prerec_ring_t* ring, size_t max_len)
+{
+    if (max_len == 0 || max_len > ring->arena_size) {
+        ESP_LOGW(TAG, "Frame of %d bytes does not fit in %d byte arena", (int)max_len, (int)ring->arena_size);
+        return NULL;
+    }
+
+    if (ring->count == 0) {
+        ring->head = 0;
+    }
+
+    // 帧数据总是按写入顺序排列：head之后的帧属于上一圈，比head之前的帧更旧
+    size_t start = ring->head;
+    if (start + max_len > ring->arena_size) {
+        // 回绕：上一圈末尾剩余的帧最旧，全部淘汰后从头开始写
+        while (ring->count > 0 && prerec_oldest(ring)->offset >= start) {
+            prerec_evict_oldest(ring);
+        }
+        start = 0;
+    }
+
+    // 淘汰与预留区域重叠的旧帧
+    while (ring->count > 0 && prerec_oldest(ring)->offset >= start &&
+           prerec_oldest(ring)->offset < start + max_len) {
+        prerec_evict_oldest(ring);
+    }
+
+    ring->reserve_offset = start;
+    ring->reserve_len = max_len;
+    return ring->arena + start;
+}
+
+bool prerec_commit(prerec_ring_t* ring, size_t len, const wifi_frame_desc_t* meta)
+{
+    if (ring->reserve_len == 0 || len == 0 || len > ring->reserve_len) {
+        ring->reserve_len = 0;
+        return false;
+    }
+
+    if (ring->count == PREREC_MAX_FRAMES) {
+        prerec_evict_oldest(ring);
+    }
+
+    prerec_entry_t *entry = &ring->index[(ring->first + ring->count) % PREREC_MAX_FRAMES];
+    entry->offset = (uint32_t)ring->reserve_offset;
+    entry->len = (uint32_t)len;
+    entry->timestamp_us = meta->timestamp_us;
+    entry->seq = ring->next_seq++;
+    entry->width = meta->width;
+    entry->height = meta->height;
+    entry->stride = meta->stride;
+    entry->format = meta->format;
+    entry->flags = meta->flags;
+    ring->count++;
+    ring->frames_recorded++;
+
+    ring->head = prerec_align(ring->reserve_offset + len);
+    if (ring->head > ring->arena_size) {
+        ring->head = ring->arena_size;  // 下一帧会回绕
+    }
+    ring->reserve_len = 0;
+
+    // 按时长淘汰，至少保留最新一帧
+    if (ring->retain_us > 0) {
+        while (ring->count > 1 && meta->timestamp_us - prerec_oldest(ring)->timestamp_us > ring->retain_us) {
+            prerec_evict_oldest(ring);
+        }
+    }
+    return true;
+}
+
+bool prerec_find(const prerec_ring_t* ring, int64_t timestamp_us, uint32_t* seq)
+{
+    // 时间戳按写入顺序单调递增，二分查找第一帧 >= timestamp_us
+    int lo = 0;
+    int hi = ring->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ring->index[(ring->first + mid) % PREREC_MAX_FRAMES].timestamp_us < timestamp_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == ring->count) {
+        *seq = ring->next_seq;
+        return false;
+    }
+    *seq = ring->index[ring->first].seq + (uint32_t)lo;
+    return true;
+}
+
+bool prerec_get(const prerec_ring_t* ring, uint32_t seq, prerec_entry_t* entry)
+{
+    if (ring->count == 0) {
+        return false;
+    }
+    uint32_t pos = seq - ring->index[ring->first].seq;
+    if (pos >= ring->count) {
+        return false;
+    }
+    *entry = ring->index[(ring->first + pos) % PREREC_MAX_FRAMES];
+    return true;
+}
+
+size_t prerec_used_bytes(const prerec_ring_t* ring)
+{
+    size_t used = 0;
+    for (int i = 0; i < ring->count; i++) {
+        used += prerec_align(ring->index[(ring->first + i) % PREREC_MAX_FRAMES].len);
+    }
+    return used;
+}
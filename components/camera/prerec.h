@@ -0,0 +1,112 @@
+#ifndef PREREC_H
+#define PREREC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 预录环形缓冲区头文件
+// 帧数据顺序写入一块连续内存（PSRAM），写到末尾回绕，覆盖最旧的帧；不做逐帧malloc
+// 索引按写入顺序保存每帧的偏移/长度/时间戳，序号连续，可按时间戳二分查找
+// 不依赖FreeRTOS，调用者负责加锁
+
+#define PREREC_MAX_FRAMES 256       // 索引容量（30FPS约8.5秒）
+#define PREREC_ALIGN 4              // 帧数据起始地址对齐
+
+// 索引项
+typedef struct {
+    uint32_t offset;        // 在arena中的偏移
+    uint32_t len;           // 数据长度
+    int64_t timestamp_us;   // 采集时间戳
+    uint32_t seq;           // 写入序号（连续递增）
+    uint16_t width;
+    uint16_t height;
+    uint16_t stride;
+    uint8_t format;         // 像素格式 (udp_pixel_format_t)
+    uint8_t flags;          // 标志位 (UDP_FLAG_*)
+} prerec_entry_t;
+
+// 环形缓冲区状态
+typedef struct {
+    uint8_t *arena;
+    size_t arena_size;
+    size_t head;                // 下一帧写入偏移
+    int64_t retain_us;          // 只保留最近这段时间的帧，0表示只受容量限制
+    prerec_entry_t index[PREREC_MAX_FRAMES];
+    uint16_t first;             // 最旧一帧在index中的位置
+    uint16_t count;
+    uint32_t next_seq;
+    size_t reserve_offset;      // 当前预留区域
+    size_t reserve_len;
+    uint32_t frames_recorded;
+    uint32_t frames_evicted;
+} prerec_ring_t;
+
+/**
+ * @brief 初始化环形缓冲区
+ * @param ring 缓冲区状态
+ * @param arena 帧数据内存（调用者分配）
+ * @param size 内存大小
+ * @param retain_ms 保留时长（毫秒），0表示只受容量限制
+ */
+void prerec_init(prerec_ring_t* ring, uint8_t* arena, size_t size, uint32_t retain_ms);
+
+/**
+ * @brief 清空所有帧（序号继续递增）
+ * @param ring 缓冲区状态
+ */
+void prerec_reset(prerec_ring_t* ring);
+
+/**
+ * @brief 为下一帧预留连续空间，与预留区域重叠的旧帧被淘汰
+ * @param ring 缓冲区状态
+ * @param max_len 最大数据长度
+ * @return 写入地址，max_len超过容量时返回NULL
+ * @note 预留后可在锁外写入，写入期间其他任务读取的已提交帧不会被覆盖
+ */
+uint8_t* prerec_reserve(prerec_ring_t* ring, size_t max_len);
+
+/**
+ * @brief 提交已写入预留区域的帧
+ * @param ring 缓冲区状态
+ * @param len 实际长度（不超过预留长度）
+ * @param meta 帧参数（宽高、格式、标志、时间戳；data/len不使用）
+ * @return true 成功，false 没有预留或长度超出
+ */
+bool prerec_commit(prerec_ring_t* ring, size_t len, const wifi_frame_desc_t* meta);
+
+/**
+ * @brief 查找时间戳不早于timestamp_us的最旧一帧
+ * @param ring 缓冲区状态
+ * @param timestamp_us 时间戳
+ * @param seq 输出序号；所有帧都更早时为下一个待写入的序号
+ * @return true 找到，false 没有满足条件的帧
+ */
+bool prerec_find(const prerec_ring_t* ring, int64_t timestamp_us, uint32_t* seq);
+
+/**
+ * @brief 按序号取索引项
+ * @param ring 缓冲区状态
+ * @param seq 序号
+ * @param entry 输出索引项（数据位于 ring->arena + entry->offset）
+ * @return true 成功，false 该帧已被淘汰或尚未写入
+ */
+bool prerec_get(const prerec_ring_t* ring, uint32_t seq, prerec_entry_t* entry);
+
+/**
+ * @brief 已提交帧占用的字节数（含对齐填充）
+ * @param ring 缓冲区状态
+ * @return 字节数
+ */
+size_t prerec_used_bytes(const prerec_ring_t* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PREREC_H
@@ -0,0 +1,190 @@
+#include "stripe.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "stripe";
+
+// 分派给工作任务的条带
+typedef struct {
+    stripe_fn_t fn;
+    void *ctx;
+    int start;
+    int end;
+    TaskHandle_t caller;    // 完成后通知的任务
+} stripe_job_t;
+
+// 阶段状态（只由调用者任务更新）
+typedef struct {
+    uint32_t calls;
+    uint32_t split_calls;
+    uint32_t single_us;
+    uint32_t split_us;
+    bool split_preferred;
+} stripe_stage_state_t;
+
+static const char *stage_names[STRIPE_STAGE_MAX] = {
+    [STRIPE_STAGE_CONVERT] = "convert",
+    [STRIPE_STAGE_ISP] = "isp",
+};
+
+static stripe_stage_state_t stages[STRIPE_STAGE_MAX];
+static stripe_job_t job;
+static TaskHandle_t worker_handle = NULL;
+static SemaphoreHandle_t stripe_mutex = NULL;   // 同一时刻只有一个调用者使用工作任务
+static volatile bool worker_stop = false;
+
+// 常驻工作任务：等待分派通知，处理完通知调用者
+static void stripe_worker_task(void *arg)
+{
+    ESP_LOGI(TAG, "Stripe worker started on core %d", xPortGetCoreID());
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (worker_stop) {
+            break;
+        }
+        job.fn(job.ctx, job.start, job.end);
+        xTaskNotifyGive(job.caller);
+    }
+
+    ESP_LOGI(TAG, "Stripe worker stopped");
+    worker_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+bool stripe_init(void)
+{
+    if (worker_handle) {
+        return true;
+    }
+
+    if (!stripe_mutex) {
+        stripe_mutex = xSemaphoreCreateMutex();
+        if (!stripe_mutex) {
+            ESP_LOGE(TAG, "Failed to create stripe mutex");
+            return false;
+        }
+    }
+
+    worker_stop = false;
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        stripe_worker_task,
+        "stripe_worker",
+        3 * 1024,
+        NULL,
+        STRIPE_WORKER_PRIORITY,
+        &worker_handle,
+        STRIPE_WORKER_CORE
+    );
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create stripe worker task");
+        worker_handle = NULL;
+        return false;
+    }
+    return true;
+}
+
+void stripe_deinit(void)
+{
+    if (!worker_handle) {
+        return;
+    }
+
+    // 等待正在进行的分条带处理结束后再通知退出
+    xSemaphoreTake(stripe_mutex, portMAX_DELAY);
+    worker_stop = true;
+    xTaskNotifyGive(worker_handle);
+    for (int i = 0; i < 100 && worker_handle; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    xSemaphoreGive(stripe_mutex);
+}
+
+// 滑动平均（1/8），首个样本直接使用
+static void stripe_average(uint32_t *avg, uint32_t sample)
+{
+    if (*avg == 0) {
+        *avg = sample ? sample : 1;
+    } else {
+        *avg = (uint32_t)((int32_t)*avg + ((int32_t)sample - (int32_t)*avg) / 8);
+    }
+}
+
+// 选择本次是否双核：两种耗时都测到后选更快的，每STRIPE_PROBE_INTERVAL次用另一种方式测一次
+static bool stripe_choose_split(stripe_stage_state_t *st)
+{
+    if (st->single_us == 0) {
+        return false;
+    }
+    if (st->split_us == 0) {
+        return true;
+    }
+    st->split_preferred = st->split_us < st->single_us;
+    if (st->calls % STRIPE_PROBE_INTERVAL == 0) {
+        return !st->split_preferred;
+    }
+    return st->split_preferred;
+}
+
+void stripe_run(stripe_stage_t stage, stripe_fn_t fn, void* ctx, int units)
+{
+    if (units <= 0) {
+        return;
+    }
+    if (stage >= STRIPE_STAGE_MAX) {
+        fn(ctx, 0, units);
+        return;
+    }
+
+    stripe_stage_state_t *st = &stages[stage];
+    st->calls++;
+
+    bool split = worker_handle && units >= STRIPE_MIN_UNITS && stripe_choose_split(st) &&
+                 xSemaphoreTake(stripe_mutex, 0) == pdTRUE;
+
+    int64_t start = esp_timer_get_time();
+    if (split) {
+        // fork：前半段交给另一个核，调用者处理后半段；join：等待工作任务的完成通知
+        int mid = STRIPE_SPLIT(units);
+        job.fn = fn;
+        job.ctx = ctx;
+        job.start = 0;
+        job.end = mid;
+        job.caller = xTaskGetCurrentTaskHandle();
+        xTaskNotifyGive(worker_handle);
+        fn(ctx, mid, units);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xSemaphoreGive(stripe_mutex);
+    } else {
+        fn(ctx, 0, units);
+    }
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    if (split) {
+        st->split_calls++;
+        stripe_average(&st->split_us, elapsed);
+    } else {
+        stripe_average(&st->single_us, elapsed);
+    }
+}
+
+bool stripe_get_stats(stripe_stage_t stage, stripe_stage_stats_t* stats)
+{
+    if (stage >= STRIPE_STAGE_MAX || !stats) {
+        return false;
+    }
+
+    const stripe_stage_state_t *st = &stages[stage];
+    stats->name = stage_names[stage];
+    stats->calls = st->calls;
+    stats->split_calls = st->split_calls;
+    stats->single_us = st->single_us;
+    stats->split_us = st->split_us;
+    stats->speedup_x100 = (st->single_us && st->split_us) ?
+                          (uint16_t)(st->single_us * 100 / st->split_us) : 0;
+    stats->split_preferred = st->split_preferred;
+    return true;
+}
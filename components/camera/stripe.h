@@ -0,0 +1,76 @@
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 双核分条带调度头文件
+// 把一帧的逐像素处理按行切成两段：另一个核上的常驻工作任务处理前半段，调用者处理后半段，
+// 用任务通知分派和汇合（fork-join），不为每帧创建任务
+// 每个阶段分别统计单核/双核耗时，双核更慢时（另一核被WiFi等任务占用）自动回退到单核
+
+#define STRIPE_WORKER_CORE 0            // 工作任务所在核（捕获任务在核1）
+#define STRIPE_WORKER_PRIORITY 5        // 与捕获任务相同
+#define STRIPE_PROBE_INTERVAL 32        // 每隔多少次调用用另一种方式运行一次，持续更新两种耗时
+#define STRIPE_MIN_UNITS 8              // 少于该单元数时直接单核处理
+#define STRIPE_SPLIT(units) ((units) / 2)   // 双核时的分界：工作任务处理 [0, 分界)，调用者处理 [分界, units)
+
+// 处理阶段（各自独立统计和决策）
+typedef enum {
+    STRIPE_STAGE_CONVERT = 0,   // 视频流像素格式转换
+    STRIPE_STAGE_ISP,           // ISP后处理
+    STRIPE_STAGE_MAX,
+} stripe_stage_t;
+
+// 条带处理函数：处理 [start, end) 单元（单元由调用者定义，如行或行对）
+typedef void (*stripe_fn_t)(void* ctx, int start, int end);
+
+// 阶段统计信息
+typedef struct {
+    const char *name;
+    uint32_t calls;
+    uint32_t split_calls;       // 双核执行次数
+    uint32_t single_us;         // 单核平均耗时（滑动平均）
+    uint32_t split_us;          // 双核平均耗时（滑动平均）
+    uint16_t speedup_x100;      // 单核/双核耗时比 x100，两种耗时都已测得后有效
+    bool split_preferred;       // 当前是否选择双核
+} stripe_stage_stats_t;
+
+/**
+ * @brief 创建常驻工作任务
+ * @return true 成功，false 失败
+ */
+bool stripe_init(void);
+
+/**
+ * @brief 停止工作任务（等待正在处理的条带完成）
+ */
+void stripe_deinit(void);
+
+/**
+ * @brief 分条带执行，返回时所有单元都已处理完
+ * @param stage 阶段 (stripe_stage_t)
+ * @param fn 条带处理函数
+ * @param ctx 传给fn的参数
+ * @param units 单元总数
+ * @note 调用者任务的通知值（索引0）在汇合时使用，调用者不能同时用它做其他用途
+ */
+void stripe_run(stripe_stage_t stage, stripe_fn_t fn, void* ctx, int units);
+
+/**
+ * @brief 获取阶段统计信息
+ * @param stage 阶段
+ * @param stats 统计信息输出
+ * @return true 成功，false 阶段无效
+ */
+bool stripe_get_stats(stripe_stage_t stage, stripe_stage_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STRIPE_H
@@ -0,0 +1,196 @@
+#include "i2c_bus.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "i2c_bus";
+
+static int bus_port = -1;
+static SemaphoreHandle_t bus_mutex = NULL;
+static i2c_bus_stats_t bus_stats;
+
+bool i2c_bus_init(int port, int sda, int scl, uint32_t freq_hz)
+{
+    if (bus_port >= 0) {
+        return true;
+    }
+
+    bus_mutex = xSemaphoreCreateRecursiveMutex();
+    if (!bus_mutex) {
+        ESP_LOGE(TAG, "Failed to create bus mutex");
+        return false;
+    }
+
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = sda,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = scl,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = freq_hz,
+    };
+    i2c_param_config(port, &conf);
+
+    esp_err_t ret = i2c_driver_install(port, conf.mode, 0, 0, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2C driver install failed: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(bus_mutex);
+        bus_mutex = NULL;
+        return false;
+    }
+
+    bus_port = port;
+    return true;
+}
+
+bool i2c_bus_lock(void)
+{
+    if (!bus_mutex) {
+        return false;
+    }
+
+    int64_t start = esp_timer_get_time();
+    if (xSemaphoreTakeRecursive(bus_mutex, pdMS_TO_TICKS(I2C_BUS_LOCK_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Bus busy");
+        return false;
+    }
+    uint32_t wait = (uint32_t)(esp_timer_get_time() - start);
+    if (wait > bus_stats.max_wait_us) {
+        bus_stats.max_wait_us = wait;
+    }
+    return true;
+}
+
+void i2c_bus_unlock(void)
+{
+    xSemaphoreGiveRecursive(bus_mutex);
+}
+
+// 以下函数在持有总线锁时调用
+static esp_err_t i2c_bus_xfer_write(uint8_t addr, const uint8_t *data, size_t len)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = i2c_master_write_to_device(bus_port, addr, data, len, pdMS_TO_TICKS(I2C_BUS_XFER_TIMEOUT_MS));
+    bus_stats.busy_us += (uint32_t)(esp_timer_get_time() - start);
+    bus_stats.transactions++;
+    if (ret != ESP_OK) {
+        bus_stats.errors++;
+    }
+    return ret;
+}
+
+static esp_err_t i2c_bus_read_locked(uint8_t addr, uint8_t reg, uint8_t *value)
+{
+    esp_err_t ret = i2c_bus_xfer_write(addr, &reg, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    int64_t start = esp_timer_get_time();
+    ret = i2c_master_read_from_device(bus_port, addr, value, 1, pdMS_TO_TICKS(I2C_BUS_XFER_TIMEOUT_MS));
+    bus_stats.busy_us += (uint32_t)(esp_timer_get_time() - start);
+    bus_stats.transactions++;
+    if (ret != ESP_OK) {
+        bus_stats.errors++;
+        return ret;
+    }
+    bus_stats.reads++;
+    return ESP_OK;
+}
+
+static esp_err_t i2c_bus_write_locked(uint8_t addr, uint8_t reg, uint8_t value)
+{
+    const uint8_t buf[2] = { reg, value };
+    esp_err_t ret = i2c_bus_xfer_write(addr, buf, sizeof(buf));
+    if (ret == ESP_OK) {
+        bus_stats.writes++;
+    }
+    return ret;
+}
+
+esp_err_t i2c_bus_read_reg(uint8_t addr, uint8_t reg, uint8_t *value)
+{
+    if (!i2c_bus_lock()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t ret = i2c_bus_read_locked(addr, reg, value);
+    i2c_bus_unlock();
+    return ret;
+}
+
+esp_err_t i2c_bus_write_reg(uint8_t addr, uint8_t reg, uint8_t value)
+{
+    if (!i2c_bus_lock()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t ret = i2c_bus_write_locked(addr, reg, value);
+    i2c_bus_unlock();
+    return ret;
+}
+
+esp_err_t i2c_bus_write_regs(uint8_t addr, const i2c_bus_reg_t *regs, size_t count)
+{
+    int64_t start = esp_timer_get_time();
+    if (!i2c_bus_lock()) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        uint8_t value = regs[i].value;
+        if (regs[i].mask != 0xff) {
+            uint8_t current;
+            ret = i2c_bus_read_locked(addr, regs[i].reg, &current);
+            if (ret != ESP_OK) {
+                break;
+            }
+            value = (current & ~regs[i].mask) | (value & regs[i].mask);
+        }
+        ret = i2c_bus_write_locked(addr, regs[i].reg, value);
+    }
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    bus_stats.batches++;
+    bus_stats.last_batch_us = elapsed;
+    if (elapsed > bus_stats.max_batch_us) {
+        bus_stats.max_batch_us = elapsed;
+    }
+    i2c_bus_unlock();
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Register write to 0x%02x failed: %s", addr, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+esp_err_t i2c_bus_update_reg(uint8_t addr, uint8_t reg, uint8_t mask, uint8_t value, uint8_t *shadow)
+{
+    if (!i2c_bus_lock()) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint8_t next = (*shadow & ~mask) | (value & mask);
+    if (next == *shadow) {
+        bus_stats.skipped++;
+    } else {
+        ret = i2c_bus_write_locked(addr, reg, next);
+        if (ret == ESP_OK) {
+            *shadow = next;
+        }
+    }
+    i2c_bus_unlock();
+    return ret;
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats)
+{
+    if (i2c_bus_lock()) {
+        *stats = bus_stats;
+        i2c_bus_unlock();
+    } else {
+        *stats = bus_stats;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 共享I2C总线头文件
+// I2C端口0同时连接PCA9557 IO扩展芯片和摄像头SCCB，本模块用递归互斥锁仲裁，
+// 多个寄存器的写入（传感器寄存器表、曝光/增益）在一次加锁内连续完成，只有带掩码的写入才先读寄存器
+// 摄像头驱动自己的SCCB访问只受驱动内部的单次传输锁保护，需要连续访问时用 i2c_bus_lock() 包住
+
+#define I2C_BUS_XFER_TIMEOUT_MS 20     // 单次传输超时（400kHz下3字节写入约80us）
+#define I2C_BUS_LOCK_TIMEOUT_MS 200    // 等待总线的上限
+
+// 寄存器写入项：mask为0xff时直接写入，否则读-改-写
+typedef struct {
+    uint8_t reg;
+    uint8_t mask;
+    uint8_t value;
+} i2c_bus_reg_t;
+
+// 统计信息
+typedef struct {
+    uint32_t transactions;      // 总线传输次数（读寄存器计2次：写地址+读数据）
+    uint32_t writes;            // 写入的寄存器数
+    uint32_t reads;             // 读取的寄存器数
+    uint32_t skipped;           // 影子寄存器未变化而省去的写入
+    uint32_t batches;           // 批量写入次数
+    uint32_t errors;
+    uint32_t busy_us;           // 累计传输耗时
+    uint32_t last_batch_us;     // 最近一次批量写入耗时（含等待总线）
+    uint32_t max_batch_us;
+    uint32_t max_wait_us;       // 等待总线的最长时间
+} i2c_bus_stats_t;
+
+/**
+ * @brief 初始化I2C总线（主机模式）
+ * @param port I2C端口
+ * @param sda SDA引脚
+ * @param scl SCL引脚
+ * @param freq_hz 时钟频率
+ * @return true 成功，false 失败
+ */
+bool i2c_bus_init(int port, int sda, int scl, uint32_t freq_hz);
+
+/**
+ * @brief 独占总线（可嵌套），用于包住摄像头驱动的连续寄存器访问
+ * @return true 成功，false 超时
+ */
+bool i2c_bus_lock(void);
+
+/**
+ * @brief 释放总线
+ */
+void i2c_bus_unlock(void);
+
+/**
+ * @brief 读取一个寄存器（SCCB方式：写寄存器地址后停止，再单独读取）
+ * @param addr 7位设备地址
+ * @param reg 寄存器地址
+ * @param value 读取结果
+ * @return ESP_OK 成功
+ */
+esp_err_t i2c_bus_read_reg(uint8_t addr, uint8_t reg, uint8_t *value);
+
+/**
+ * @brief 写入一个寄存器
+ * @param addr 7位设备地址
+ * @param reg 寄存器地址
+ * @param value 写入值
+ * @return ESP_OK 成功
+ */
+esp_err_t i2c_bus_write_reg(uint8_t addr, uint8_t reg, uint8_t value);
+
+/**
+ * @brief 在一次加锁内按顺序写入寄存器表（遇到错误立即停止）
+ * @param addr 7位设备地址
+ * @param regs 寄存器表
+ * @param count 项数
+ * @return ESP_OK 成功
+ */
+esp_err_t i2c_bus_write_regs(uint8_t addr, const i2c_bus_reg_t *regs, size_t count);
+
+/**
+ * @brief 按影子寄存器修改输出类寄存器：只在值变化时写入，不读总线
+ * @param addr 7位设备地址
+ * @param reg 寄存器地址
+ * @param mask 修改的位
+ * @param value 新值（只取mask中的位）
+ * @param shadow 影子寄存器（该寄存器最近写入的值，成功写入后更新）
+ * @return ESP_OK 成功
+ * @note 只适用于芯片不会自行改变的寄存器（如PCA9557输出端口），影子寄存器由本函数在总线锁内修改
+ */
+esp_err_t i2c_bus_update_reg(uint8_t addr, uint8_t reg, uint8_t mask, uint8_t value, uint8_t *shadow);
+
+/**
+ * @brief 获取统计信息
+ * @param stats 统计信息输出
+ */
+void i2c_bus_get_stats(i2c_bus_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // I2C_BUS_H
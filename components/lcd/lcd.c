@@ -1,6 +1,7 @@
 #include "lcd.h"
+#include "i2c_bus.h"
 #include "esp_log.h"
-#include "driver/i2c.h"
+#include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "driver/ledc.h"
 #include "esp_lcd_panel_io.h"
@@ -28,8 +29,6 @@ static const char *TAG = "lcd";
 #define PA_EN_GPIO                  BIT(1)    // PCA9557_GPIO_NUM_2
 #define DVP_PWDN_GPIO               BIT(2)    // PCA9557_GPIO_NUM_3
 
-#define SET_BITS(_m, _s, _v)  ((_v) ? (_m)|((_s)) : (_m)&~((_s)))
-
 // LCD配置
 #define BSP_LCD_PIXEL_CLOCK_HZ     (80 * 1000 * 1000)
 #define BSP_LCD_SPI_NUM            (SPI3_HOST)
@@ -51,24 +50,15 @@ static const char *TAG = "lcd";
 static esp_lcd_panel_handle_t panel_handle = NULL;
 static esp_lcd_panel_io_handle_t io_handle = NULL;
 
-// 初始化I2C接口
+// PCA9557输出端口的影子寄存器（输出端口只由本模块写入，切换引脚时不需要先读）
+static uint8_t pca9557_output = 0;
+
+// 初始化I2C接口（PCA9557和摄像头SCCB共用，由 i2c_bus 仲裁）
 bool lcd_i2c_init(void)
 {
     ESP_LOGI(TAG, "Initializing I2C...");
     
-    i2c_config_t i2c_conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = BSP_I2C_SDA,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = BSP_I2C_SCL,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = BSP_I2C_FREQ_HZ
-    };
-    i2c_param_config(BSP_I2C_NUM, &i2c_conf);
-
-    esp_err_t ret = i2c_driver_install(BSP_I2C_NUM, i2c_conf.mode, 0, 0, 0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2C driver install failed: %s", esp_err_to_name(ret));
+    if (!i2c_bus_init(BSP_I2C_NUM, BSP_I2C_SDA, BSP_I2C_SCL, BSP_I2C_FREQ_HZ)) {
         return false;
     }
     
@@ -76,28 +66,10 @@ bool lcd_i2c_init(void)
     return true;
 }
 
-// 读取PCA9557寄存器
-static esp_err_t pca9557_register_read(uint8_t reg_addr, uint8_t *data, size_t len)
-{
-    return i2c_master_write_read_device(BSP_I2C_NUM, PCA9557_SENSOR_ADDR, &reg_addr, 1, data, len, 1000 / portTICK_PERIOD_MS);
-}
-
-// 写入PCA9557寄存器
-static esp_err_t pca9557_register_write_byte(uint8_t reg_addr, uint8_t data)
-{
-    uint8_t write_buf[2] = {reg_addr, data};
-    return i2c_master_write_to_device(BSP_I2C_NUM, PCA9557_SENSOR_ADDR, write_buf, sizeof(write_buf), 1000 / portTICK_PERIOD_MS);
-}
-
-// 设置PCA9557输出状态
+// 设置PCA9557输出状态（值未变化时不访问总线）
 static esp_err_t pca9557_set_output_state(uint8_t gpio_bit, uint8_t level)
 {
-    uint8_t data;
-    esp_err_t res = pca9557_register_read(PCA9557_OUTPUT_PORT, &data, 1);
-    if (res != ESP_OK) {
-        return res;
-    }
-    return pca9557_register_write_byte(PCA9557_OUTPUT_PORT, SET_BITS(data, gpio_bit, level));
+    return i2c_bus_update_reg(PCA9557_SENSOR_ADDR, PCA9557_OUTPUT_PORT, gpio_bit, level ? gpio_bit : 0, &pca9557_output);
 }
 
 // 控制LCD CS引脚
@@ -117,25 +89,21 @@ bool lcd_pca9557_init(void)
 {
     ESP_LOGI(TAG, "Initializing PCA9557...");
     
-    // 写入控制引脚默认值 DVP_PWDN=1  PA_EN = 0  LCD_CS = 1
-    esp_err_t ret = pca9557_register_write_byte(PCA9557_OUTPUT_PORT, 0x05);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "PCA9557 output port config failed: %s", esp_err_to_name(ret));
-        return false;
-    }
-    
-    // 把PCA9557芯片的IO1 IO1 IO2设置为输出 其它引脚保持默认的输入
-    ret = pca9557_register_write_byte(PCA9557_CONFIGURATION_PORT, 0xf8);
+    // 写入控制引脚默认值 DVP_PWDN=1  PA_EN = 0  LCD_CS = 1，
+    // 再把PCA9557芯片的IO0 IO1 IO2设置为输出 其它引脚保持默认的输入（一次加锁连续写入）
+    const i2c_bus_reg_t regs[] = {
+        { PCA9557_OUTPUT_PORT, 0xff, DVP_PWDN_GPIO | LCD_CS_GPIO },
+        { PCA9557_CONFIGURATION_PORT, 0xff, 0xf8 },
+    };
+    esp_err_t ret = i2c_bus_write_regs(PCA9557_SENSOR_ADDR, regs, sizeof(regs) / sizeof(regs[0]));
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "PCA9557 configuration port config failed: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "PCA9557 config failed: %s", esp_err_to_name(ret));
         return false;
     }
+    pca9557_output = DVP_PWDN_GPIO | LCD_CS_GPIO;
     
+    // 输出在写入应答时即更新，不需要额外等待
     ESP_LOGI(TAG, "PCA9557 initialized successfully");
-    
-    // 等待PCA9557稳定
-    vTaskDelay(pdMS_TO_TICKS(50));
-    
     return true;
 }
 
@@ -372,3 +340,22 @@ void lcd_draw_camera_frame(int x_start, int y_start, int width, int height, cons
     
     esp_lcd_panel_draw_bitmap(panel_handle, x_start, y_start, width, height, (uint16_t *)frame_buf);
 }
+
+void lcd_draw_camera_frame_stride(int x_start, int y_start, int width, int height, const uint8_t *frame_buf, int stride)
+{
+    if (!panel_handle || !frame_buf) {
+        ESP_LOGE(TAG, "LCD panel or frame buffer not available");
+        return;
+    }
+    
+    // 行连续时一次发送
+    if (stride == width * 2) {
+        esp_lcd_panel_draw_bitmap(panel_handle, x_start, y_start, x_start + width, y_start + height, (uint16_t *)frame_buf);
+        return;
+    }
+    
+    for (int y = 0; y < height; y++) {
+        esp_lcd_panel_draw_bitmap(panel_handle, x_start, y_start + y, x_start + width, y_start + y + 1,
+                                  (uint16_t *)(frame_buf + (size_t)y * stride));
+    }
+}
@@ -59,6 +59,17 @@ void lcd_draw_picture(int x_start, int y_start, int x_end, int y_end, const unsi
  */
 void lcd_draw_camera_frame(int x_start, int y_start, int width, int height, const uint8_t *frame_buf);
 
+/**
+ * @brief 显示帧缓冲区中的一块区域（ROI裁剪，逐行发送，不拷贝）
+ * @param x_start 起始X坐标
+ * @param y_start 起始Y坐标
+ * @param width 宽度
+ * @param height 高度
+ * @param frame_buf 区域左上角像素指针
+ * @param stride 帧缓冲区每行字节数
+ */
+void lcd_draw_camera_frame_stride(int x_start, int y_start, int width, int height, const uint8_t *frame_buf, int stride);
+
 /**
  * @brief 初始化LCD背光
  * @return true 成功，false 失败
@@ -0,0 +1,81 @@
+#include "mpsc.h"
+#include <string.h>
+
+static inline atomic_uint* mpsc_cell_seq(const mpsc_queue_t* q, uint32_t pos)
+{
+    return (atomic_uint *)(q->cells + (size_t)(pos & q->mask) * q->cell_size);
+}
+
+static inline uint8_t* mpsc_cell_item(const mpsc_queue_t* q, uint32_t pos)
+{
+    return q->cells + (size_t)(pos & q->mask) * q->cell_size + sizeof(atomic_uint);
+}
+
+bool mpsc_init(mpsc_queue_t* q, void* storage, uint32_t capacity, size_t item_size)
+{
+    if (!q || !storage || capacity < 2 || (capacity & (capacity - 1)) || item_size == 0 ||
+        ((uintptr_t)storage & 3)) {
+        return false;
+    }
+
+    q->cells = storage;
+    q->mask = capacity - 1;
+    q->cell_size = MPSC_CELL_SIZE(item_size);
+    q->item_size = item_size;
+    // 单元i初始序号为i：等于写入位置表示空闲，等于位置+1表示已写好
+    for (uint32_t i = 0; i < capacity; i++) {
+        atomic_init(mpsc_cell_seq(q, i), i);
+    }
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->full, 0);
+    return true;
+}
+
+bool mpsc_push(mpsc_queue_t* q, const void* item)
+{
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    while (1) {
+        uint32_t seq = atomic_load_explicit(mpsc_cell_seq(q, pos), memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // 单元空闲，抢占该位置；失败时pos更新为最新的写入位置
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 单元还没被消费者读走，队列已满
+            atomic_fetch_add_explicit(&q->full, 1, memory_order_relaxed);
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);  // 其他生产者已抢占
+        }
+    }
+
+    memcpy(mpsc_cell_item(q, pos), item, q->item_size);
+    atomic_store_explicit(mpsc_cell_seq(q, pos), pos + 1, memory_order_release);
+    return true;
+}
+
+bool mpsc_pop(mpsc_queue_t* q, void* item)
+{
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t seq = atomic_load_explicit(mpsc_cell_seq(q, pos), memory_order_acquire);
+    if ((int32_t)(seq - (pos + 1)) < 0) {
+        return false;
+    }
+
+    memcpy(item, mpsc_cell_item(q, pos), q->item_size);
+    // 单元序号推进一圈，下一轮写入该单元的生产者可以使用
+    atomic_store_explicit(mpsc_cell_seq(q, pos), pos + q->mask + 1, memory_order_release);
+    atomic_store_explicit(&q->tail, pos + 1, memory_order_relaxed);
+    return true;
+}
+
+uint32_t mpsc_count(const mpsc_queue_t* q)
+{
+    uint32_t head = atomic_load_explicit(&((mpsc_queue_t *)q)->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&((mpsc_queue_t *)q)->tail, memory_order_relaxed);
+    return head - tail;
+}
@@ -0,0 +1,70 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 无锁多生产者单消费者队列头文件
+// 有界环形队列，每个单元带序号（Vyukov算法）：生产者用CAS抢占写入位置，写完后发布序号，
+// 唯一的消费者按序号判断单元是否已写好，不需要互斥锁，生产者之间也不会互相阻塞
+// 元素按值拷贝进单元，队列满时 mpsc_push() 立即返回false，由调用者决定丢弃还是重试
+// 不依赖FreeRTOS，可在Linux主机上编译测试（host/mpsc_stress.c）
+
+// 单元大小：4字节序号 + 元素（按4字节对齐）
+#define MPSC_CELL_SIZE(item_size) ((sizeof(atomic_uint) + (item_size) + 3) & ~(size_t)3)
+
+// 队列（由调用者静态分配，单元存储区大小为 capacity * MPSC_CELL_SIZE(item_size)）
+typedef struct {
+    uint8_t *cells;
+    uint32_t mask;              // capacity - 1
+    uint32_t cell_size;
+    uint32_t item_size;
+    atomic_uint head;           // 下一个写入位置（生产者）
+    atomic_uint tail;           // 下一个读取位置（消费者）
+    atomic_uint full;           // 队列满被拒绝的次数
+} mpsc_queue_t;
+
+/**
+ * @brief 初始化队列
+ * @param q 队列
+ * @param storage 单元存储区（4字节对齐）
+ * @param capacity 容量，必须是2的幂
+ * @param item_size 元素大小
+ * @return true 成功，false 参数错误
+ */
+bool mpsc_init(mpsc_queue_t* q, void* storage, uint32_t capacity, size_t item_size);
+
+/**
+ * @brief 拷贝一个元素入队（任意任务/线程可并发调用）
+ * @param q 队列
+ * @param item 元素
+ * @return true 成功，false 队列已满
+ */
+bool mpsc_push(mpsc_queue_t* q, const void* item);
+
+/**
+ * @brief 取出一个元素（只能由一个消费者调用）
+ * @param q 队列
+ * @param item 元素输出
+ * @return true 成功，false 队列为空（或最早的元素还在写入中）
+ */
+bool mpsc_pop(mpsc_queue_t* q, void* item);
+
+/**
+ * @brief 当前队列长度（并发时为近似值，用于统计）
+ * @param q 队列
+ * @return 元素个数
+ */
+uint32_t mpsc_count(const mpsc_queue_t* q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MPSC_H
@@ -0,0 +1,202 @@
+#include "pacer.h"
+#include <string.h>
+
+// kbps换算为字节/微秒：rate_kbps * 1000 / 8 / 1000000 = rate_kbps / 8000
+#define PACER_US_PER_BYTE_KBPS 8000
+
+static void pacer_refill(pacer_t* p, int64_t now_us)
+{
+    int64_t elapsed = now_us - p->last_refill_us;
+    if (elapsed <= 0) {
+        return;
+    }
+    int64_t add = elapsed * p->rate_kbps / PACER_US_PER_BYTE_KBPS;
+    if (add <= 0) {
+        return;  // 不足1字节，保留时间差，下次一起计算
+    }
+    // 只推进换算出整字节的时间，避免高频调用时截断丢失令牌
+    p->last_refill_us += add * PACER_US_PER_BYTE_KBPS / p->rate_kbps;
+    p->tokens += add;
+    if (p->tokens > p->config.burst_bytes) {
+        p->tokens = p->config.burst_bytes;
+        p->last_refill_us = now_us;
+    }
+}
+
+void pacer_init(pacer_t* p, const pacer_config_t* config, int64_t now_us)
+{
+    memset(p, 0, sizeof(*p));
+    if (config) {
+        p->config = *config;
+    } else {
+        p->config.rate_kbps = PACER_DEFAULT_RATE_KBPS;
+        p->config.min_kbps = PACER_DEFAULT_MIN_KBPS;
+        p->config.max_kbps = PACER_DEFAULT_MAX_KBPS;
+        p->config.burst_bytes = PACER_DEFAULT_BURST_BYTES;
+    }
+    if (p->config.min_kbps == 0) {
+        p->config.min_kbps = PACER_DEFAULT_MIN_KBPS;
+    }
+    if (p->config.max_kbps < p->config.min_kbps) {
+        p->config.max_kbps = p->config.min_kbps;
+    }
+    if (p->config.burst_bytes == 0) {
+        p->config.burst_bytes = PACER_DEFAULT_BURST_BYTES;
+    }
+    p->rate_kbps = p->config.rate_kbps;
+    if (p->rate_kbps < p->config.min_kbps) {
+        p->rate_kbps = p->config.min_kbps;
+    }
+    if (p->rate_kbps > p->config.max_kbps) {
+        p->rate_kbps = p->config.max_kbps;
+    }
+    p->enabled = true;
+    p->tokens = p->config.burst_bytes;
+    p->last_refill_us = now_us;
+    p->last_adjust_us = now_us;
+}
+
+void pacer_set_enabled(pacer_t* p, bool enabled)
+{
+    p->enabled = enabled;
+}
+
+void pacer_set_capacity(pacer_t* p, uint32_t capacity_kbps)
+{
+    if (capacity_kbps < p->config.min_kbps) {
+        capacity_kbps = p->config.min_kbps;
+    }
+    // 从实测容量的3/4开始，无拥塞时逐步升到实测值
+    p->config.max_kbps = capacity_kbps;
+    p->rate_kbps = capacity_kbps - capacity_kbps / 4;
+    if (p->rate_kbps < p->config.min_kbps) {
+        p->rate_kbps = p->config.min_kbps;
+    }
+}
+
+// 各优先级发送前需要的令牌数（bulk_due：后台数据已等待过久，由它先发送）
+static int64_t pacer_threshold(const pacer_t* p, size_t bytes, pacer_prio_t prio, bool bulk_due)
+{
+    int64_t burst = p->config.burst_bytes;
+    int64_t need = (int64_t)bytes < burst ? (int64_t)bytes : burst;
+    // 透支有上限：透支越多，之后普通数据和后台数据要等得越久
+    int64_t keyframe = need - (burst >> PACER_KEYFRAME_BORROW_SHIFT);
+    if (bulk_due) {
+        // 后台数据按关键帧门限放行，实时流要等到满桶，令牌先留给后台数据
+        return prio == PACER_PRIO_BULK ? keyframe : burst;
+    }
+    switch (prio) {
+        case PACER_PRIO_KEYFRAME:
+            return keyframe;
+        case PACER_PRIO_BULK:
+            return need + burst / 2 < burst ? need + burst / 2 : burst;
+        case PACER_PRIO_NORMAL:
+        default:
+            return need;
+    }
+}
+
+uint32_t pacer_reserve(pacer_t* p, size_t bytes, pacer_prio_t prio, int64_t now_us)
+{
+    if (!p->enabled) {
+        return 0;
+    }
+
+    pacer_refill(p, now_us);
+    if (prio != PACER_PRIO_CONTROL) {
+        // 后台数据的门限最高，负载重时总被实时流抢先：连续等待超过PACER_BULK_MAX_WAIT_MS后
+        // 优先放行一个后台数据报，保证预录导出在链路满载时也能推进。
+        // 等待超过两倍仍未放行说明后台发送者已放弃（超时），不再让实时流让路
+        const int64_t max_wait_us = PACER_BULK_MAX_WAIT_MS * 1000;
+        int64_t bulk_waited = p->bulk_wait_start_us ? now_us - p->bulk_wait_start_us : 0;
+        if (bulk_waited >= 2 * max_wait_us) {
+            p->bulk_wait_start_us = 0;
+            bulk_waited = 0;
+        }
+        bool bulk_due = bulk_waited >= max_wait_us;
+        int64_t threshold = pacer_threshold(p, bytes, prio, bulk_due);
+        if (p->tokens < threshold) {
+            int64_t wait_us = (threshold - p->tokens) * PACER_US_PER_BYTE_KBPS / p->rate_kbps + 1;
+            if (prio == PACER_PRIO_BULK && !bulk_due) {
+                // 最迟在可以优先放行时醒来
+                if (!p->bulk_wait_start_us) {
+                    p->bulk_wait_start_us = now_us;
+                }
+                int64_t due_us = p->bulk_wait_start_us + max_wait_us - now_us;
+                if (wait_us > due_us) {
+                    wait_us = due_us;
+                }
+            }
+            return (uint32_t)wait_us;
+        }
+        if (prio == PACER_PRIO_BULK) {
+            p->bulk_wait_start_us = 0;
+            if (bulk_due) {
+                p->stats.bulk_boosts++;
+            }
+        }
+    }
+    p->tokens -= (int64_t)bytes;
+    return 0;
+}
+
+void pacer_complete(pacer_t* p, size_t bytes, pacer_prio_t prio, bool backpressure, int64_t now_us)
+{
+    pacer_counter_t *counter = p->enabled ? &p->stats.paced : &p->stats.unpaced;
+    counter->sends++;
+    if (backpressure) {
+        counter->backpressure++;
+    } else {
+        counter->bytes += bytes;
+    }
+    if (prio < PACER_PRIO_MAX) {
+        p->stats.prio_sends[prio]++;
+    }
+
+    if (!p->enabled) {
+        return;
+    }
+    if (backpressure) {
+        // 发送缓冲区已满：乘性降速，并清掉剩余令牌让缓冲区先排空
+        p->rate_kbps -= p->rate_kbps >> PACER_DECREASE_SHIFT;
+        if (p->rate_kbps < p->config.min_kbps) {
+            p->rate_kbps = p->config.min_kbps;
+        }
+        if (p->tokens > 0) {
+            p->tokens = 0;
+        }
+        p->stats.decreases++;
+        p->last_adjust_us = now_us;
+    } else if (now_us - p->last_adjust_us >= PACER_INCREASE_INTERVAL_MS * 1000) {
+        // 无拥塞：每个间隔提高1/16（至少100kbps），不超过链路容量
+        uint32_t step = p->rate_kbps / 16 > 100 ? p->rate_kbps / 16 : 100;
+        p->rate_kbps += step;
+        if (p->rate_kbps > p->config.max_kbps) {
+            p->rate_kbps = p->config.max_kbps;
+        }
+        p->last_adjust_us = now_us;
+    }
+}
+
+void pacer_note_wait(pacer_t* p, uint32_t wait_us, bool dropped)
+{
+    if (dropped) {
+        p->stats.drops++;
+    }
+    if (wait_us == 0) {
+        return;
+    }
+    p->stats.waits++;
+    p->wait_us_total += wait_us;
+    if (wait_us > p->stats.max_wait_us) {
+        p->stats.max_wait_us = wait_us;
+    }
+}
+
+void pacer_get_stats(const pacer_t* p, pacer_stats_t* stats)
+{
+    *stats = p->stats;
+    stats->enabled = p->enabled;
+    stats->rate_kbps = p->rate_kbps;
+    stats->avg_wait_us = p->stats.waits ? (uint32_t)(p->wait_us_total / p->stats.waits) : 0;
+}
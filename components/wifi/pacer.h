@@ -0,0 +1,141 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 发送节奏控制（令牌桶）头文件
+// 所有UDP发送路径（FPV帧、RTP包、预录导出、控制应答）共用一个令牌桶，
+// 把突发摊到帧间隔内，避免一次占满WiFi驱动的发送缓冲区（CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM）
+// 速率按实测链路容量设置，遇到发送缓冲区不足（ENOMEM/超时）时乘性降低，无拥塞时缓慢回升
+// 只做令牌计算，不加锁也不休眠：调用者加锁后调用 pacer_reserve()，按返回值等待后重试
+// 不依赖FreeRTOS，可在Linux主机上编译测试（host/pacer_bench.c）
+
+#define PACER_DEFAULT_RATE_KBPS 8000        // 未测量链路容量时的初始速率
+#define PACER_DEFAULT_MIN_KBPS 1000
+#define PACER_DEFAULT_MAX_KBPS 20000        // HT20下UDP实际可达的上限
+#define PACER_DEFAULT_BURST_BYTES (16 * 1472)   // 桶容量：驱动32个发送缓冲区的一半（按IP分片大小）
+#define PACER_INCREASE_INTERVAL_MS 100      // 无拥塞时每隔该时间提高速率
+#define PACER_DECREASE_SHIFT 2              // 拥塞时速率降低1/4
+#define PACER_KEYFRAME_BORROW_SHIFT 1       // 关键帧最多透支半个桶（桶容量 >> 1）
+#define PACER_BULK_MAX_WAIT_MS 200          // 后台数据连续等待超过该时间后按关键帧门限放行（保证最低份额）
+
+// 发送优先级
+typedef enum {
+    PACER_PRIO_CONTROL = 0,     // 控制包（时钟同步应答等）：不等待，令牌可透支
+    PACER_PRIO_KEYFRAME,        // 关键帧：最多可透支半个桶容量
+    PACER_PRIO_NORMAL,          // 普通数据（RTP包等）：令牌足够才发送
+    PACER_PRIO_BULK,            // 后台数据（预录导出）：为实时流保留半个桶，等待过久时与关键帧同等放行
+    PACER_PRIO_MAX,
+} pacer_prio_t;
+
+// 配置
+typedef struct {
+    uint32_t rate_kbps;         // 初始速率
+    uint32_t min_kbps;
+    uint32_t max_kbps;
+    uint32_t burst_bytes;       // 桶容量（一次最多连续发送的字节数）
+} pacer_config_t;
+
+// 发送计数（分别统计开启和关闭节奏控制时的发送，用于对比）
+typedef struct {
+    uint32_t sends;
+    uint32_t bytes;
+    uint32_t backpressure;      // 发送缓冲区不足导致失败的次数
+} pacer_counter_t;
+
+// 统计信息
+typedef struct {
+    bool enabled;
+    uint32_t rate_kbps;         // 当前速率
+    pacer_counter_t paced;      // 开启节奏控制时
+    pacer_counter_t unpaced;    // 关闭节奏控制时
+    uint32_t waits;             // 需要等待令牌的发送次数
+    uint32_t avg_wait_us;
+    uint32_t max_wait_us;
+    uint32_t drops;             // 等待超时放弃发送的次数
+    uint32_t decreases;         // 拥塞降速次数
+    uint32_t bulk_boosts;       // 后台数据等待超过PACER_BULK_MAX_WAIT_MS后提前放行的次数
+    uint32_t prio_sends[PACER_PRIO_MAX];
+} pacer_stats_t;
+
+// 令牌桶（由调用者静态分配）
+typedef struct {
+    pacer_config_t config;
+    bool enabled;
+    uint32_t rate_kbps;
+    int64_t tokens;             // 字节，可为负（透支）
+    int64_t last_refill_us;
+    int64_t last_adjust_us;
+    int64_t bulk_wait_start_us;     // 后台数据开始被拒绝的时间，0表示没有在等待
+    uint64_t wait_us_total;
+    pacer_stats_t stats;
+} pacer_t;
+
+/**
+ * @brief 初始化令牌桶（初始为满桶，开启节奏控制）
+ * @param p 令牌桶
+ * @param config 配置，NULL使用默认值
+ * @param now_us 当前时间
+ */
+void pacer_init(pacer_t* p, const pacer_config_t* config, int64_t now_us);
+
+/**
+ * @brief 开启/关闭节奏控制（关闭时 pacer_reserve() 总是返回0，计数记入unpaced）
+ * @param p 令牌桶
+ * @param enabled 是否开启
+ */
+void pacer_set_enabled(pacer_t* p, bool enabled);
+
+/**
+ * @brief 按实测链路容量设置速率和上限
+ * @param p 令牌桶
+ * @param capacity_kbps 链路容量（如链路探测的有效吞吐）
+ */
+void pacer_set_capacity(pacer_t* p, uint32_t capacity_kbps);
+
+/**
+ * @brief 申请发送bytes字节
+ * @param p 令牌桶
+ * @param bytes 本次发送的字节数（超过桶容量的数据报按满桶发送，之后按透支补足）
+ * @param prio 优先级
+ * @param now_us 当前时间
+ * @return 0 可以立即发送（已扣除令牌），否则为建议等待的微秒数，等待后再次申请
+ */
+uint32_t pacer_reserve(pacer_t* p, size_t bytes, pacer_prio_t prio, int64_t now_us);
+
+/**
+ * @brief 记录一次发送结果并调整速率
+ * @param p 令牌桶
+ * @param bytes 发送的字节数
+ * @param prio 优先级
+ * @param backpressure 是否因发送缓冲区不足失败
+ * @param now_us 当前时间
+ */
+void pacer_complete(pacer_t* p, size_t bytes, pacer_prio_t prio, bool backpressure, int64_t now_us);
+
+/**
+ * @brief 记录一次发送前等待令牌的时间
+ * @param p 令牌桶
+ * @param wait_us 等待时间
+ * @param dropped 是否等待超时放弃发送
+ */
+void pacer_note_wait(pacer_t* p, uint32_t wait_us, bool dropped);
+
+/**
+ * @brief 获取统计信息
+ * @param p 令牌桶
+ * @param stats 统计信息输出
+ */
+void pacer_get_stats(const pacer_t* p, pacer_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PACER_H
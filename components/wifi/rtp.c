@@ -0,0 +1,232 @@
+#include "rtp.h"
+#include "esp_log.h"
+#include <sys/socket.h>
+#include <string.h>
+#include <errno.h>
+
+static const char *TAG = "rtp";
+
+#define RFC4175_EXT_SEQ_SIZE 2
+#define RFC4175_LINE_HEADER_SIZE 6
+#define RTP_MAX_SEGMENTS 16
+
+// 一个包内的行片段
+typedef struct {
+    uint16_t line;
+    uint16_t offset;    // 行内起始像素
+    uint16_t pixels;    // 像素数（偶数）
+} rtp_segment_t;
+
+// BT.601 有限范围 RGB -> YCbCr（定点）
+static inline uint8_t rgb_to_y(int r, int g, int b)
+{
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t rgb_to_cb(int r, int g, int b)
+{
+    return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uint8_t rgb_to_cr(int r, int g, int b)
+{
+    return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// 读取一个RGB565像素并展开为8bit分量
+static inline void rgb565_unpack(const uint8_t *p, bool big_endian, int *r, int *g, int *b)
+{
+    uint16_t v = big_endian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+    *r = ((v >> 11) & 0x1F) << 3;
+    *g = ((v >> 5) & 0x3F) << 2;
+    *b = (v & 0x1F) << 3;
+}
+
+// 将一段像素转换为 Cb Y0 Cr Y1 pgroup
+static void rtp_convert_segment(const wifi_frame_desc_t *frame, const rtp_segment_t *seg, uint8_t *out)
+{
+    const uint8_t *row = frame->data + (size_t)seg->line * frame->stride;
+
+    switch (frame->format) {
+        case UDP_FMT_YUV422:
+            {
+                // 传感器输出YUYV，重排为UYVY
+                const uint8_t *src = row + (size_t)seg->offset * 2;
+                for (int i = 0; i < seg->pixels; i += 2, src += 4, out += 4) {
+                    out[0] = src[1];
+                    out[1] = src[0];
+                    out[2] = src[3];
+                    out[3] = src[2];
+                }
+            }
+            break;
+        case UDP_FMT_GRAY:
+            {
+                const uint8_t *src = row + seg->offset;
+                for (int i = 0; i < seg->pixels; i += 2, src += 2, out += 4) {
+                    out[0] = 128;
+                    out[1] = (uint8_t)(16 + ((src[0] * 219) >> 8));
+                    out[2] = 128;
+                    out[3] = (uint8_t)(16 + ((src[1] * 219) >> 8));
+                }
+            }
+            break;
+        case UDP_FMT_RGB565:
+        default:
+            {
+                bool big_endian = (frame->flags & UDP_FLAG_BIG_ENDIAN) != 0;
+                const uint8_t *src = row + (size_t)seg->offset * 2;
+                for (int i = 0; i < seg->pixels; i += 2, src += 4, out += 4) {
+                    int r0, g0, b0, r1, g1, b1;
+                    rgb565_unpack(src, big_endian, &r0, &g0, &b0);
+                    rgb565_unpack(src + 2, big_endian, &r1, &g1, &b1);
+                    int r = (r0 + r1) >> 1, g = (g0 + g1) >> 1, b = (b0 + b1) >> 1;
+                    out[0] = rgb_to_cb(r, g, b);
+                    out[1] = rgb_to_y(r0, g0, b0);
+                    out[2] = rgb_to_cr(r, g, b);
+                    out[3] = rgb_to_y(r1, g1, b1);
+                }
+            }
+            break;
+    }
+}
+
+static rtp_pace_wait_t pace_wait = NULL;
+static rtp_pace_done_t pace_done = NULL;
+
+void rtp_set_pacer(rtp_pace_wait_t wait, rtp_pace_done_t done)
+{
+    pace_wait = wait;
+    pace_done = done;
+}
+
+void rtp_session_init(rtp_session_t* session, int sock, const struct sockaddr_in* dest, uint32_t ssrc)
+{
+    memset(session, 0, sizeof(*session));
+    session->sock = sock;
+    session->dest = *dest;
+    session->ssrc = ssrc;
+}
+
+uint32_t rtp_timestamp(int64_t timestamp_us)
+{
+    return (uint32_t)((uint64_t)timestamp_us * 9 / 100);  // 90kHz
+}
+
+bool rtp_format_supported(uint8_t format)
+{
+    return format == UDP_FMT_RGB565 || format == UDP_FMT_YUV422 || format == UDP_FMT_GRAY;
+}
+
+int rtp_send_frame(rtp_session_t* session, const wifi_frame_desc_t* frame)
+{
+    if (!session || !frame || !frame->data || session->sock < 0) {
+        return -1;
+    }
+
+    if (!rtp_format_supported(frame->format) || (frame->width & 1) || frame->width == 0) {
+        ESP_LOGW(TAG, "Unsupported frame for RFC 4175: format=%d width=%d", frame->format, frame->width);
+        return -1;
+    }
+
+    const uint32_t timestamp = rtp_timestamp(frame->timestamp_us);
+    uint16_t line = 0;
+    uint16_t offset = 0;
+    int packets = 0;
+
+    while (line < frame->height) {
+        // 规划本包包含的行片段
+        rtp_segment_t segs[RTP_MAX_SEGMENTS];
+        int nsegs = 0;
+        size_t used = RTP_HEADER_SIZE + RFC4175_EXT_SEQ_SIZE;
+
+        while (line < frame->height && nsegs < RTP_MAX_SEGMENTS) {
+            size_t space = RTP_MAX_PACKET - used;
+            if (space <= RFC4175_LINE_HEADER_SIZE + RTP_RFC4175_PGROUP) {
+                break;
+            }
+            uint16_t fit = ((space - RFC4175_LINE_HEADER_SIZE) / RTP_RFC4175_PGROUP) * 2;
+            uint16_t pixels = frame->width - offset;
+            if (pixels > fit) {
+                pixels = fit;
+            }
+
+            segs[nsegs].line = line;
+            segs[nsegs].offset = offset;
+            segs[nsegs].pixels = pixels;
+            nsegs++;
+            used += RFC4175_LINE_HEADER_SIZE + (size_t)pixels * 2;
+
+            offset += pixels;
+            if (offset >= frame->width) {
+                offset = 0;
+                line++;
+            }
+        }
+
+        bool last_packet = (line >= frame->height);
+        uint8_t *p = session->packet;
+
+        // RTP头
+        p[0] = 0x80;                                                    // V=2
+        p[1] = (last_packet ? 0x80 : 0x00) | RTP_PAYLOAD_TYPE;          // M=帧结束
+        p[2] = (session->seq >> 8) & 0xFF;
+        p[3] = session->seq & 0xFF;
+        p[4] = (timestamp >> 24) & 0xFF;
+        p[5] = (timestamp >> 16) & 0xFF;
+        p[6] = (timestamp >> 8) & 0xFF;
+        p[7] = timestamp & 0xFF;
+        p[8] = (session->ssrc >> 24) & 0xFF;
+        p[9] = (session->ssrc >> 16) & 0xFF;
+        p[10] = (session->ssrc >> 8) & 0xFF;
+        p[11] = session->ssrc & 0xFF;
+        p += RTP_HEADER_SIZE;
+
+        // RFC 4175 扩展序号
+        p[0] = (session->seq >> 24) & 0xFF;
+        p[1] = (session->seq >> 16) & 0xFF;
+        p += RFC4175_EXT_SEQ_SIZE;
+
+        // 行头：长度 | F+行号 | C+偏移，C=1表示后面还有行头
+        for (int i = 0; i < nsegs; i++) {
+            uint16_t length = segs[i].pixels * 2;
+            uint16_t cont = (i + 1 < nsegs) ? 0x8000 : 0;
+            p[0] = length >> 8;
+            p[1] = length & 0xFF;
+            p[2] = (segs[i].line >> 8) & 0x7F;
+            p[3] = segs[i].line & 0xFF;
+            p[4] = ((cont | segs[i].offset) >> 8) & 0xFF;
+            p[5] = segs[i].offset & 0xFF;
+            p += RFC4175_LINE_HEADER_SIZE;
+        }
+
+        // 像素数据：从帧缓冲区直接转换到包缓冲区
+        for (int i = 0; i < nsegs; i++) {
+            rtp_convert_segment(frame, &segs[i], p);
+            p += segs[i].pixels * 2;
+        }
+
+        size_t packet_len = p - session->packet;
+        if (pace_wait && !pace_wait(packet_len, RTP_PACE_MAX_WAIT_MS)) {
+            ESP_LOGD(TAG, "RTP frame dropped: pacing timeout");
+            return -1;  // 链路跟不上，本帧剩余部分已过时
+        }
+        int sent = sendto(session->sock, session->packet, packet_len, 0,
+                          (const struct sockaddr *)&session->dest, sizeof(session->dest));
+        if (pace_done) {
+            pace_done(packet_len, sent);
+        }
+        session->seq++;
+        if (sent < 0) {
+            session->send_errors++;
+            ESP_LOGD(TAG, "RTP send failed: errno=%d", errno);
+            return -1;  // 丢弃本帧剩余部分，接收端按帧边界重新同步
+        }
+
+        session->packets_sent++;
+        session->bytes_sent += sent;
+        packets++;
+    }
+
+    return packets;
+}
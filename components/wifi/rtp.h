@@ -0,0 +1,83 @@
+#ifndef RTP_H
+#define RTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RTP 打包头文件
+// RFC 4175 无压缩视频（YCbCr-4:2:2, 8bit），直接从帧缓冲区逐包转换发送，不做整帧拷贝
+// 不依赖FreeRTOS，可在Linux主机上编译测试
+
+#define RTP_PAYLOAD_TYPE 96
+#define RTP_CLOCK_RATE 90000
+#define RTP_MAX_PACKET 1400              // 单个RTP包最大字节数（避免IP分片）
+#define RTP_HEADER_SIZE 12
+#define RTP_RFC4175_PGROUP 4             // 4:2:2 8bit: 2个像素占4字节 (Cb Y0 Cr Y1)
+#define RTP_PACE_MAX_WAIT_MS 33          // 单包等待令牌的上限（一帧间隔），超时丢弃本帧剩余部分
+
+// 发送节奏控制钩子（设备端接到 wifi_pace_wait()/wifi_pace_done()，主机测试不设置）
+typedef bool (*rtp_pace_wait_t)(size_t bytes, uint32_t max_wait_ms);
+typedef void (*rtp_pace_done_t)(size_t bytes, int sent);
+
+// RTP发送会话（单个目的地址，单播或组播）
+typedef struct {
+    int sock;                   // 发送socket
+    struct sockaddr_in dest;    // 目的地址
+    uint32_t ssrc;              // 同步源标识
+    uint32_t seq;               // 扩展序号（低16位在RTP头，高16位在RFC 4175负载头）
+    uint32_t packets_sent;      // 已发送包数
+    uint32_t bytes_sent;        // 已发送字节数
+    uint32_t send_errors;       // 发送失败次数
+    uint8_t packet[RTP_MAX_PACKET];  // 单包转换缓冲区
+} rtp_session_t;
+
+/**
+ * @brief 初始化RTP发送会话
+ * @param session 会话
+ * @param sock 已创建的UDP socket
+ * @param dest 目的地址（单播或组播）
+ * @param ssrc 同步源标识
+ */
+void rtp_session_init(rtp_session_t* session, int sock, const struct sockaddr_in* dest, uint32_t ssrc);
+
+/**
+ * @brief 设置所有会话共用的发送节奏控制钩子
+ * @param wait 发送每个包之前调用，返回false时丢弃本帧剩余部分，NULL表示不控制
+ * @param done 发送每个包之后调用（传入sendto的返回值）
+ */
+void rtp_set_pacer(rtp_pace_wait_t wait, rtp_pace_done_t done);
+
+/**
+ * @brief 按RFC 4175打包并发送一帧
+ * @param session 会话
+ * @param frame 帧描述（支持RGB565/YUV422/灰度）
+ * @return 发送的RTP包数，-1表示失败
+ */
+int rtp_send_frame(rtp_session_t* session, const wifi_frame_desc_t* frame);
+
+/**
+ * @brief 将设备微秒时间戳换算为90kHz RTP时间戳
+ * @param timestamp_us 微秒时间戳
+ * @return RTP时间戳
+ */
+uint32_t rtp_timestamp(int64_t timestamp_us);
+
+/**
+ * @brief 判断帧格式能否按RFC 4175发送
+ * @param format 像素格式 (udp_pixel_format_t)
+ * @return true 支持，false 不支持
+ */
+bool rtp_format_supported(uint8_t format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTP_H
@@ -0,0 +1,514 @@
+#include "rtsp.h"
+#include "rtp.h"
+#include "esp_log.h"
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+static const char *TAG = "rtsp";
+
+#define RTSP_RX_BUF_SIZE 1024
+#define RTSP_TX_BUF_SIZE 1024
+#define RTSP_SESSION_TIMEOUT_S 60
+
+// RTSP连接状态
+typedef struct {
+    int ctrl_fd;                // RTSP TCP连接，-1表示空闲
+    char rx[RTSP_RX_BUF_SIZE];
+    size_t rx_len;
+    uint32_t session_id;
+    bool multicast;
+    volatile bool playing;      // 采集任务只读该标志，置位前RTP会话已准备好
+    rtp_session_t rtp;          // 单播RTP会话
+} rtsp_conn_t;
+
+static int listen_fd = -1;
+static int rtp_fd = -1;
+static uint16_t rtsp_port = RTSP_PORT;
+static rtsp_conn_t conns[RTSP_MAX_SESSIONS];
+static rtp_session_t multicast_rtp;      // 组播会话：所有组播观看者共享一次发送
+static volatile uint16_t stream_width = 160;
+static volatile uint16_t stream_height = 120;
+static rtsp_stats_t rtsp_stats;
+
+// 从请求中取出指定头部的值
+static bool rtsp_get_header(const char *req, const char *name, char *value, size_t value_len)
+{
+    size_t name_len = strlen(name);
+    const char *line = req;
+
+    while ((line = strstr(line, "\r\n")) != NULL) {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *v = line + name_len + 1;
+            while (*v == ' ') {
+                v++;
+            }
+            const char *end = strstr(v, "\r\n");
+            size_t len = end ? (size_t)(end - v) : strlen(v);
+            if (len >= value_len) {
+                len = value_len - 1;
+            }
+            memcpy(value, v, len);
+            value[len] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+// 本端IP（用于SDP和Content-Base）
+static void rtsp_local_ip(int fd, char *ip, size_t ip_len)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr *)&addr, &addr_len) == 0) {
+        inet_ntop(AF_INET, &addr.sin_addr, ip, ip_len);
+    } else {
+        snprintf(ip, ip_len, "0.0.0.0");
+    }
+}
+
+static int rtsp_build_sdp(int fd, char *sdp, size_t sdp_len)
+{
+    char ip[16];
+    rtsp_local_ip(fd, ip, sizeof(ip));
+
+    return snprintf(sdp, sdp_len,
+                    "v=0\r\n"
+                    "o=- 0 0 IN IP4 %s\r\n"
+                    "s=ESP32 FPV\r\n"
+                    "c=IN IP4 0.0.0.0\r\n"
+                    "t=0 0\r\n"
+                    "m=video 0 RTP/AVP %d\r\n"
+                    "a=rtpmap:%d raw/%d\r\n"
+                    "a=fmtp:%d sampling=YCbCr-4:2:2; width=%d; height=%d; depth=8; colorimetry=BT601-5\r\n"
+                    "a=control:track0\r\n",
+                    ip, RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE, RTP_CLOCK_RATE,
+                    RTP_PAYLOAD_TYPE, stream_width, stream_height);
+}
+
+static void rtsp_stop_playing(rtsp_conn_t *conn)
+{
+    if (!conn->playing) {
+        return;
+    }
+    conn->playing = false;
+    if (conn->multicast) {
+        rtsp_stats.multicast_viewers--;
+    } else {
+        rtsp_stats.playing--;
+    }
+}
+
+static void rtsp_close(rtsp_conn_t *conn)
+{
+    rtsp_stop_playing(conn);
+    close(conn->ctrl_fd);
+    conn->ctrl_fd = -1;
+    conn->rx_len = 0;
+    conn->session_id = 0;
+    rtsp_stats.sessions--;
+    ESP_LOGI(TAG, "RTSP client disconnected");
+}
+
+// SETUP：解析Transport，准备单播或组播RTP会话
+static int rtsp_handle_setup(rtsp_conn_t *conn, const char *req, char *transport_out, size_t out_len)
+{
+    char transport[128];
+    if (!rtsp_get_header(req, "Transport", transport, sizeof(transport))) {
+        return 400;
+    }
+    if (strstr(transport, "RTP/AVP/TCP") || strstr(transport, "interleaved")) {
+        return 461;  // 只支持UDP传输
+    }
+
+    if (conn->session_id == 0) {
+        conn->session_id = (uint32_t)rand() | 1;
+    }
+
+    if (strstr(transport, "multicast")) {
+        conn->multicast = true;
+        snprintf(transport_out, out_len,
+                 "RTP/AVP;multicast;destination=%s;port=%d-%d;ttl=%d",
+                 RTSP_MULTICAST_GROUP, RTSP_MULTICAST_PORT, RTSP_MULTICAST_PORT + 1, RTSP_MULTICAST_TTL);
+        return 200;
+    }
+
+    const char *cp = strstr(transport, "client_port=");
+    if (!cp) {
+        return 461;
+    }
+    int rtp_port = atoi(cp + strlen("client_port="));
+    if (rtp_port <= 0 || rtp_port > 65535) {
+        return 400;
+    }
+
+    // 单播目的地址 = RTSP对端地址 + client_port
+    struct sockaddr_in dest;
+    socklen_t dest_len = sizeof(dest);
+    if (getpeername(conn->ctrl_fd, (struct sockaddr *)&dest, &dest_len) != 0) {
+        return 500;
+    }
+    dest.sin_port = htons(rtp_port);
+
+    conn->multicast = false;
+    rtp_session_init(&conn->rtp, rtp_fd, &dest, conn->session_id);
+    snprintf(transport_out, out_len,
+             "RTP/AVP;unicast;client_port=%d-%d;server_port=%d-%d;ssrc=%08lX",
+             rtp_port, rtp_port + 1, RTSP_RTP_PORT, RTSP_RTP_PORT + 1, (unsigned long)conn->session_id);
+    return 200;
+}
+
+static const char* rtsp_status_text(int code)
+{
+    switch (code) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 454: return "Session Not Found";
+        case 461: return "Unsupported Transport";
+        default: return "Internal Server Error";
+    }
+}
+
+// 处理一个完整的RTSP请求，返回false表示需要关闭连接
+static bool rtsp_handle_request(rtsp_conn_t *conn, const char *req)
+{
+    char method[16] = {0};
+    char uri[128] = {0};
+    char cseq[16] = "0";
+    char tx[RTSP_TX_BUF_SIZE];
+    char extra[256] = "";
+    char body[512] = "";
+    int code = 200;
+    bool keep_open = true;
+
+    if (sscanf(req, "%15s %127s", method, uri) != 2) {
+        return false;
+    }
+    rtsp_get_header(req, "CSeq", cseq, sizeof(cseq));
+    ESP_LOGD(TAG, "RTSP %s %s", method, uri);
+
+    if (strcmp(method, "OPTIONS") == 0) {
+        snprintf(extra, sizeof(extra), "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN\r\n");
+    } else if (strcmp(method, "DESCRIBE") == 0) {
+        if (!strstr(uri, RTSP_STREAM_PATH)) {
+            code = 404;
+        } else {
+            char ip[16];
+            rtsp_local_ip(conn->ctrl_fd, ip, sizeof(ip));
+            int body_len = rtsp_build_sdp(conn->ctrl_fd, body, sizeof(body));
+            snprintf(extra, sizeof(extra),
+                     "Content-Base: rtsp://%s:%d%s/\r\n"
+                     "Content-Type: application/sdp\r\n"
+                     "Content-Length: %d\r\n",
+                     ip, rtsp_port, RTSP_STREAM_PATH, body_len);
+        }
+    } else if (strcmp(method, "SETUP") == 0) {
+        char transport[160];
+        code = rtsp_handle_setup(conn, req, transport, sizeof(transport));
+        if (code == 200) {
+            snprintf(extra, sizeof(extra), "Transport: %s\r\nSession: %08lX;timeout=%d\r\n",
+                     transport, (unsigned long)conn->session_id, RTSP_SESSION_TIMEOUT_S);
+        }
+    } else if (strcmp(method, "PLAY") == 0) {
+        if (conn->session_id == 0) {
+            code = 454;
+        } else {
+            if (!conn->playing) {
+                conn->playing = true;
+                if (conn->multicast) {
+                    rtsp_stats.multicast_viewers++;
+                } else {
+                    rtsp_stats.playing++;
+                }
+            }
+            snprintf(extra, sizeof(extra), "Session: %08lX\r\nRange: npt=0.000-\r\n",
+                     (unsigned long)conn->session_id);
+            ESP_LOGI(TAG, "RTSP PLAY (%s)", conn->multicast ? "multicast" : "unicast");
+        }
+    } else if (strcmp(method, "TEARDOWN") == 0) {
+        rtsp_stop_playing(conn);
+        snprintf(extra, sizeof(extra), "Session: %08lX\r\n", (unsigned long)conn->session_id);
+        keep_open = false;
+    } else if (strcmp(method, "GET_PARAMETER") == 0) {
+        // 客户端保活
+        snprintf(extra, sizeof(extra), "Session: %08lX\r\n", (unsigned long)conn->session_id);
+    } else {
+        code = 405;
+    }
+
+    int len = snprintf(tx, sizeof(tx), "RTSP/1.0 %d %s\r\nCSeq: %s\r\n%s\r\n%s",
+                       code, rtsp_status_text(code), cseq, extra, body);
+    if (len > 0 && send(conn->ctrl_fd, tx, len, 0) < 0) {
+        return false;
+    }
+    return keep_open;
+}
+
+// 读取连接上的数据，按空行切分请求
+static void rtsp_service_conn(rtsp_conn_t *conn)
+{
+    int n = recv(conn->ctrl_fd, conn->rx + conn->rx_len, sizeof(conn->rx) - 1 - conn->rx_len, 0);
+    if (n <= 0) {
+        rtsp_close(conn);
+        return;
+    }
+    conn->rx_len += n;
+    conn->rx[conn->rx_len] = '\0';
+
+    char *end;
+    while ((end = strstr(conn->rx, "\r\n\r\n")) != NULL) {
+        end += 4;
+        char saved = *end;
+        *end = '\0';
+        bool keep_open = rtsp_handle_request(conn, conn->rx);
+        *end = saved;
+
+        size_t consumed = end - conn->rx;
+        memmove(conn->rx, end, conn->rx_len - consumed + 1);
+        conn->rx_len -= consumed;
+
+        if (!keep_open) {
+            rtsp_close(conn);
+            return;
+        }
+    }
+
+    // 请求过长，丢弃连接
+    if (conn->rx_len >= sizeof(conn->rx) - 1) {
+        ESP_LOGW(TAG, "RTSP request too large");
+        rtsp_close(conn);
+    }
+}
+
+bool rtsp_server_init(uint16_t port)
+{
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        conns[i].ctrl_fd = -1;
+    }
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        ESP_LOGE(TAG, "Failed to create RTSP socket: %s", strerror(errno));
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, RTSP_MAX_SESSIONS) < 0) {
+        ESP_LOGE(TAG, "Failed to listen on RTSP port %d: %s", port, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    // RTP发送socket（单播/组播共用）
+    rtp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rtp_fd < 0) {
+        ESP_LOGE(TAG, "Failed to create RTP socket: %s", strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    addr.sin_port = htons(RTSP_RTP_PORT);
+    if (bind(rtp_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGW(TAG, "Failed to bind RTP port %d: %s", RTSP_RTP_PORT, strerror(errno));
+    }
+    unsigned char ttl = RTSP_MULTICAST_TTL;
+    if (setsockopt(rtp_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+        ESP_LOGW(TAG, "Failed to set multicast TTL: %s", strerror(errno));
+    }
+
+    struct sockaddr_in group = {
+        .sin_family = AF_INET,
+        .sin_port = htons(RTSP_MULTICAST_PORT),
+    };
+    inet_pton(AF_INET, RTSP_MULTICAST_GROUP, &group.sin_addr);
+    rtp_session_init(&multicast_rtp, rtp_fd, &group, 0x46505600);  // "FPV\0"
+
+    rtsp_port = port;
+    ESP_LOGI(TAG, "RTSP server listening on port %d (rtsp://<ip>:%d%s)", port, port, RTSP_STREAM_PATH);
+    return true;
+}
+
+void rtsp_server_poll(int timeout_ms)
+{
+    if (listen_fd < 0) {
+        return;
+    }
+
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(listen_fd, &readfds);
+    int max_fd = listen_fd;
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        if (conns[i].ctrl_fd >= 0) {
+            FD_SET(conns[i].ctrl_fd, &readfds);
+            if (conns[i].ctrl_fd > max_fd) {
+                max_fd = conns[i].ctrl_fd;
+            }
+        }
+    }
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    if (select(max_fd + 1, &readfds, NULL, NULL, &tv) <= 0) {
+        return;
+    }
+
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        if (conns[i].ctrl_fd >= 0 && FD_ISSET(conns[i].ctrl_fd, &readfds)) {
+            rtsp_service_conn(&conns[i]);
+        }
+    }
+
+    if (FD_ISSET(listen_fd, &readfds)) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+            if (conns[i].ctrl_fd < 0) {
+                conns[i].ctrl_fd = fd;
+                conns[i].rx_len = 0;
+                conns[i].session_id = 0;
+                conns[i].multicast = false;
+                conns[i].playing = false;
+                rtsp_stats.sessions++;
+                ESP_LOGI(TAG, "RTSP client connected");
+                return;
+            }
+        }
+        ESP_LOGW(TAG, "Too many RTSP clients");
+        close(fd);
+    }
+}
+
+#ifdef ESP_PLATFORM
+// RTP包与FPV帧共用WiFi发送节奏控制
+static bool rtsp_pace_wait(size_t bytes, uint32_t max_wait_ms)
+{
+    return wifi_pace_wait(bytes, PACER_PRIO_NORMAL, max_wait_ms);
+}
+
+static void rtsp_pace_done(size_t bytes, int sent)
+{
+    wifi_pace_done(bytes, PACER_PRIO_NORMAL, sent);
+}
+
+// RTSP服务器任务
+static void rtsp_server_task(void *arg)
+{
+    ESP_LOGI(TAG, "RTSP server task started");
+
+    while (1) {
+        rtsp_server_poll(1000);
+    }
+}
+
+bool rtsp_server_start(uint16_t port)
+{
+    if (listen_fd >= 0) {
+        ESP_LOGW(TAG, "RTSP server already running");
+        return true;
+    }
+
+    if (!rtsp_server_init(port)) {
+        return false;
+    }
+    rtp_set_pacer(rtsp_pace_wait, rtsp_pace_done);
+
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        rtsp_server_task,
+        "rtsp_server",
+        4 * 1024,
+        NULL,
+        4,
+        NULL,
+        0
+    );
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create RTSP server task");
+        return false;
+    }
+    return true;
+}
+#endif
+
+void rtsp_server_send_frame(const wifi_frame_desc_t* frame)
+{
+    if (!frame) {
+        return;
+    }
+
+    // 记录当前分辨率供DESCRIBE生成SDP
+    stream_width = frame->width;
+    stream_height = frame->height;
+
+    if (rtsp_stats.playing == 0 && rtsp_stats.multicast_viewers == 0) {
+        return;
+    }
+
+    bool sent_any = false;
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        rtsp_conn_t *conn = &conns[i];
+        if (conn->playing && !conn->multicast) {
+            rtp_session_t *rtp = &conn->rtp;
+            uint32_t packets = rtp->packets_sent, bytes = rtp->bytes_sent, errors = rtp->send_errors;
+            rtp_send_frame(rtp, frame);
+            rtsp_stats.packets_sent += rtp->packets_sent - packets;
+            rtsp_stats.bytes_sent += rtp->bytes_sent - bytes;
+            rtsp_stats.send_errors += rtp->send_errors - errors;
+            sent_any = true;
+        }
+    }
+
+    // 组播：无论多少观看者只发送一次
+    if (rtsp_stats.multicast_viewers > 0) {
+        uint32_t packets = multicast_rtp.packets_sent, bytes = multicast_rtp.bytes_sent;
+        uint32_t errors = multicast_rtp.send_errors;
+        rtp_send_frame(&multicast_rtp, frame);
+        rtsp_stats.packets_sent += multicast_rtp.packets_sent - packets;
+        rtsp_stats.bytes_sent += multicast_rtp.bytes_sent - bytes;
+        rtsp_stats.send_errors += multicast_rtp.send_errors - errors;
+        sent_any = true;
+    }
+
+    if (sent_any) {
+        rtsp_stats.frames_sent++;
+    }
+}
+
+bool rtsp_server_get_stats(rtsp_stats_t* stats)
+{
+    if (!stats) {
+        return false;
+    }
+
+    *stats = rtsp_stats;
+    return true;
+}
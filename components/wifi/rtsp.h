@@ -0,0 +1,73 @@
+#ifndef RTSP_H
+#define RTSP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RTSP 服务器头文件
+// 最简RTSP会话处理（OPTIONS/DESCRIBE/SETUP/PLAY/TEARDOWN），配合rtp.c输出RFC 4175视频
+// VLC/ffmpeg/NVR 可直接拉流: rtsp://<设备IP>:8554/stream
+// 除 rtsp_server_start() 外不依赖FreeRTOS，可在Linux主机上用合成帧源测试
+
+#define RTSP_PORT 8554
+#define RTSP_RTP_PORT 5004                    // 单播RTP源端口
+#define RTSP_MAX_SESSIONS 2                   // 同时连接的RTSP客户端数
+#define RTSP_STREAM_PATH "/stream"
+#define RTSP_MULTICAST_GROUP "239.255.0.1"    // 组播地址
+#define RTSP_MULTICAST_PORT 5006              // 组播RTP端口
+#define RTSP_MULTICAST_TTL 4
+
+// RTSP/RTP统计信息
+typedef struct {
+    uint8_t sessions;           // 当前RTSP连接数
+    uint8_t playing;            // 正在播放的单播会话数
+    uint8_t multicast_viewers;  // 正在播放的组播会话数
+    uint32_t frames_sent;       // 已发送帧数（组播每帧只计一次）
+    uint32_t packets_sent;      // 已发送RTP包数
+    uint32_t bytes_sent;        // 已发送RTP字节数
+    uint32_t send_errors;       // 发送失败次数
+} rtsp_stats_t;
+
+/**
+ * @brief 初始化RTSP服务器（创建监听socket和RTP发送socket）
+ * @param port RTSP TCP端口
+ * @return true 成功，false 失败
+ */
+bool rtsp_server_init(uint16_t port);
+
+/**
+ * @brief 处理RTSP连接和请求，最多阻塞timeout_ms
+ * @param timeout_ms 等待超时（毫秒）
+ */
+void rtsp_server_poll(int timeout_ms);
+
+/**
+ * @brief 初始化RTSP服务器并创建后台任务（仅设备端）
+ * @param port RTSP TCP端口
+ * @return true 成功，false 失败
+ */
+bool rtsp_server_start(uint16_t port);
+
+/**
+ * @brief 向所有正在播放的会话发送一帧（无会话时立即返回）
+ * @param frame 帧描述
+ */
+void rtsp_server_send_frame(const wifi_frame_desc_t* frame);
+
+/**
+ * @brief 获取RTSP/RTP统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool rtsp_server_get_stats(rtsp_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTSP_H
@@ -4,21 +4,151 @@
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "lwip/sockets.h"
 #include "lwip/inet.h"
+#include "esp_heap_caps.h"
+#include "esp_pm.h"
+#include "ping/ping_sock.h"
+#include "sdkconfig.h"
+#include "mpsc.h"
+#include <stdatomic.h>
 #include <string.h>
 
 static const char *TAG = "wifi";
 
 static esp_netif_t *sta_netif = NULL;
-static int udp_socket = -1;
+static volatile int udp_socket = -1;
+static volatile int retired_socket = -1;        // 发送任务换下的旧socket，由控制任务在两次recvfrom之间关闭
+static uint16_t udp_port = UDP_PORT;
 static struct sockaddr_in broadcast_addr;
-static SemaphoreHandle_t wifi_mutex = NULL;
 static bool wifi_connected = false;
-static uint16_t current_frame_id = 0;
+static TaskHandle_t ctrl_task_handle = NULL;
+static TaskHandle_t tx_task_handle = NULL;
+static bool wifi_started = false;
+static uint32_t device_id = 0;                  // v2帧头中的设备ID，0表示初始化时由MAC生成
+
+// 链路配置参数
+typedef struct {
+    const char *name;
+    wifi_ps_type_t ps;
+    wifi_bandwidth_t bandwidth;             // 只在协议集包含11n时设置
+    uint8_t protocol;
+    int8_t tx_power_qdbm;                   // 0.25dBm单位，驱动允许8~84
+} wifi_link_config_t;
+
+#define WIFI_PROTOCOL_BGN (WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N)
+
+static const wifi_link_config_t link_configs[WIFI_LINK_MAX] = {
+    [WIFI_LINK_LOW_LATENCY]    = { "low-latency",    WIFI_PS_NONE,      WIFI_BW_HT20, WIFI_PROTOCOL_BGN, 84 },
+    [WIFI_LINK_MAX_RANGE]      = { "max-range",      WIFI_PS_NONE,      WIFI_BW_HT20, WIFI_PROTOCOL_11B, 84 },
+    [WIFI_LINK_MAX_THROUGHPUT] = { "max-throughput", WIFI_PS_NONE,      WIFI_BW_HT40, WIFI_PROTOCOL_BGN, 84 },
+    [WIFI_LINK_POWER_SAVE]     = { "power-save",     WIFI_PS_MAX_MODEM, WIFI_BW_HT20, WIFI_PROTOCOL_BGN, 44 },
+};
+
+static wifi_link_profile_t link_profile = WIFI_LINK_LOW_LATENCY;
+static bool link_power_save = false;            // 功耗管理要求省电（空闲/停止档位）
+static volatile bool link_reconfiguring = false; // 正在切换协议集/带宽，断开事件中设置新参数后重连
+
+// 断线重连：前几次立即重试并只扫描缓存的信道（漫游/AP短暂掉线），之后退避并全信道扫描
+#define WIFI_RECONNECT_CHANNEL_ATTEMPTS 3
+static const uint16_t reconnect_backoff_ms[] = { 0, 0, 100, 250, 500, 1000, 2000 };
+
+static wifi_conn_state_t conn_state = WIFI_STATE_CONNECTING;
+static esp_timer_handle_t reconnect_timer = NULL;
+static uint8_t ap_channel = 0;                  // 最近连接的AP信道
+static uint32_t reconnect_attempt = 0;          // 本次断线的重连次数
+static int64_t outage_start_us = 0;             // 断线时间（已获取IP后断开）
+static volatile int64_t resume_start_us = 0;    // 重连后获取IP的时间，第一帧发出后清零
+static wifi_reconnect_stats_t reconnect_stats;
+
+// 发送节奏控制（所有UDP发送路径共用）
+static pacer_t wifi_pacer;
+static portMUX_TYPE pacer_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool pacer_ready = false;
+static bool pacing_enabled = true;
+static uint32_t link_capacity_kbps[WIFI_LINK_MAX];  // 链路探测测得的各配置吞吐，0表示未测量
+
+// 发送请求：其他任务不直接使用socket，把请求放入无锁队列，由发送任务（socket唯一所有者）发送
+#define WIFI_SEND_STAMP_T3 0x01             // 发送前填入时钟同步应答的t3
+
+// 同步发送的完成通知（静态槽位，send_done_lock保护）：调用者等待超时后使代号失效，
+// 发送任务跳过代号不符的请求，调用者返回后外部数据不会再被读取
+#define WIFI_SEND_DONE_SLOTS 4
+#define WIFI_SEND_DONE_NONE 0xFF
+typedef struct {
+    StaticSemaphore_t sem_buf;
+    SemaphoreHandle_t sem;
+    uint16_t gen;                           // 代号，调用者放弃等待或用完后递增
+    bool in_use;
+    bool sending;                           // 发送任务正在发送该槽位的请求
+    int pending;                            // 未完成的请求数 + 调用者自己的1个引用
+    int sent_count;                         // 发送成功的请求数
+    int result;                             // 最后一次发送的返回值
+    int err;                                // 最后一次失败的errno
+} wifi_send_done_t;
+
+static wifi_send_done_t send_done_slots[WIFI_SEND_DONE_SLOTS];
+static portMUX_TYPE send_done_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+    struct sockaddr_in dest;
+    const uint8_t *ext;                     // 外部数据（不拷贝，发送完成前调用者不得修改）
+    uint32_t ext_len;
+    uint16_t len;                           // 内联数据长度（放在外部数据之前）
+    uint8_t prio;                           // pacer_prio_t，发送后记入节奏控制
+    uint8_t flags;
+    int64_t enqueue_us;
+    uint8_t done_slot;                      // 完成通知槽位 + 1，0表示不等待结果
+    uint16_t done_gen;
+    uint8_t data[WIFI_SENDQ_INLINE_SIZE];
+} wifi_send_req_t;
+
+static uint8_t sendq_cells[WIFI_SENDQ_DEPTH * MPSC_CELL_SIZE(sizeof(wifi_send_req_t))] __attribute__((aligned(4)));
+static mpsc_queue_t send_queue;
+// 控制包（时钟同步应答等）单独排队，发送任务每发一个请求前先清空，不排在导出和普通数据后面
+static uint8_t ctrl_sendq_cells[WIFI_CTRL_SENDQ_DEPTH * MPSC_CELL_SIZE(sizeof(wifi_send_req_t))] __attribute__((aligned(4)));
+static mpsc_queue_t ctrl_send_queue;
+static bool sendq_ready = false;
+static volatile bool rebind_pending = false;    // 重连后由发送任务重建socket
+static volatile bool flush_pending = false;     // 断线后由发送任务清空订阅者队列
+static wifi_sendq_stats_t sendq_stats;
+static uint64_t sendq_wait_sum_us = 0;
+static uint64_t frame_wait_sum_us = 0;
+
+// 共享帧缓冲：每帧只拷贝一次，按订阅者需要的版本预先生成帧头
+typedef struct {
+    uint8_t *data;                          // 帧数据（PSRAM）
+    size_t len;
+    int64_t queued_us;                      // 放入订阅者队列的时间
+    uint8_t v1_hdr[sizeof(udp_frame_t) - 1];
+    uint8_t v2_hdr[sizeof(udp_frame_v2_t) - 1];
+    int refs;                               // 引用该缓冲的订阅者队列项数量
+} wifi_tx_packet_t;
+
+// 订阅者：独立的发送队列、帧头版本和抽帧比
+typedef struct {
+    bool active;
+    bool is_static;                         // 默认目的地址，不会过期
+    struct sockaddr_in addr;
+    uint8_t version;                        // 协商的帧头版本（默认v1）
+    uint8_t frame_divider;                  // 每N帧发送1帧
+    uint32_t frame_counter;
+    TickType_t last_hello_tick;
+    wifi_tx_packet_t *queue[WIFI_SUB_QUEUE_DEPTH];
+    uint8_t queue_head;
+    uint8_t queue_count;
+    uint32_t frames_sent;
+    uint32_t frames_dropped;
+} wifi_subscriber_t;
+
+static wifi_tx_packet_t tx_pool[WIFI_TX_POOL_SIZE];
+static wifi_subscriber_t subscribers[WIFI_MAX_SUBSCRIBERS];
+static SemaphoreHandle_t tx_mutex = NULL;   // 保护订阅者表和缓冲引用计数
+static volatile wifi_ctrl_handler_t ctrl_handler = NULL;
 
 // 统计信息变量
 static uint32_t stats_frames_sent = 0;
@@ -26,6 +156,7 @@ static uint32_t stats_packets_sent = 0;
 static uint32_t stats_bytes_sent = 0;
 static float stats_fps = 0.0f;
 static uint32_t stats_last_time = 0;
+static uint32_t stats_sync_pings = 0;
 
 // 更新统计信息的函数（在wifi_send_camera_frame中调用）
 static void wifi_update_stats(uint16_t packets, size_t bytes)
@@ -48,6 +179,64 @@ static void wifi_update_stats(uint16_t packets, size_t bytes)
     }
 }
 
+static void wifi_subscriber_flush_locked(wifi_subscriber_t *sub);
+static bool wifi_udp_rebind(void);
+static void wifi_udp_request_rebind(void);
+static esp_err_t wifi_link_apply_phy(const wifi_link_config_t *link);
+
+static void wifi_reconnect_timer_cb(void *arg)
+{
+    esp_wifi_connect();
+}
+
+// 安排下一次重连
+static void wifi_schedule_reconnect(void)
+{
+    // 前几次只扫描缓存的信道，找不到再全信道扫描（AP可能换了信道或漫游到其他信道的AP）
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK) {
+        uint8_t channel = reconnect_attempt < WIFI_RECONNECT_CHANNEL_ATTEMPTS ? ap_channel : 0;
+        if (config.sta.channel != channel) {
+            config.sta.channel = channel;
+            esp_wifi_set_config(WIFI_IF_STA, &config);
+        }
+    }
+    
+    const size_t steps = sizeof(reconnect_backoff_ms) / sizeof(reconnect_backoff_ms[0]);
+    uint16_t delay_ms = reconnect_backoff_ms[reconnect_attempt < steps ? reconnect_attempt : steps - 1];
+    reconnect_attempt++;
+    reconnect_stats.attempts++;
+    
+    if (delay_ms == 0 || !reconnect_timer) {
+        esp_wifi_connect();
+    } else {
+        esp_timer_stop(reconnect_timer);
+        esp_timer_start_once(reconnect_timer, (uint64_t)delay_ms * 1000);
+    }
+}
+
+// 断线：丢弃各订阅者队列中的旧帧，重连后第一帧就是最新帧（只在发送任务中调用）
+static void wifi_flush_tx_queues(void)
+{
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active) {
+            wifi_subscriber_flush_locked(&subscribers[i]);
+        }
+    }
+    xSemaphoreGive(tx_mutex);
+}
+
+// 请求发送任务清空订阅者队列（在事件任务中调用，不在事件任务中等待tx_mutex）
+static void wifi_request_flush(void)
+{
+    if (!tx_task_handle) {
+        return;
+    }
+    flush_pending = true;
+    xTaskNotifyGive(tx_task_handle);
+}
+
 // WiFi事件处理函数
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                              int32_t event_id, void* event_data)
@@ -58,10 +247,42 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                 ESP_LOGI(TAG, "WiFi started, connecting to AP...");
                 esp_wifi_connect();
                 break;
+            case WIFI_EVENT_STA_CONNECTED:
+                ap_channel = ((wifi_event_sta_connected_t*)event_data)->channel;
+                break;
             case WIFI_EVENT_STA_DISCONNECTED:
-                ESP_LOGI(TAG, "WiFi disconnected, trying to reconnect...");
-                wifi_connected = false;
-                esp_wifi_connect();
+                {
+                    wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+                    wifi_connected = false;
+                    reconnect_stats.last_reason = event->reason;
+                    if (link_reconfiguring) {
+                        // wifi_set_link_profile() 主动断开：不算断线，不清空发送队列，按新协议集/带宽重连
+                        link_reconfiguring = false;
+                        conn_state = WIFI_STATE_RECONNECTING;
+                        outage_start_us = 0;
+                        reconnect_attempt = 0;
+                        esp_err_t err = wifi_link_apply_phy(&link_configs[link_profile]);
+                        if (err != ESP_OK) {
+                            ESP_LOGW(TAG, "Failed to apply link PHY: %s", esp_err_to_name(err));
+                        }
+                        ESP_LOGI(TAG, "WiFi disconnected for link reconfiguration, reconnecting...");
+                        esp_wifi_connect();
+                        break;
+                    }
+                    if (conn_state == WIFI_STATE_CONNECTED) {
+                        conn_state = WIFI_STATE_RECONNECTING;
+                        outage_start_us = esp_timer_get_time();
+                        resume_start_us = 0;
+                        reconnect_attempt = 0;
+                        reconnect_stats.outages++;
+                        wifi_request_flush();
+                        ESP_LOGW(TAG, "WiFi disconnected (reason %d), reconnecting on channel %d...",
+                                 event->reason, ap_channel);
+                    } else {
+                        ESP_LOGD(TAG, "Connect attempt %lu failed (reason %d)", reconnect_attempt, event->reason);
+                    }
+                    wifi_schedule_reconnect();
+                }
                 break;
             default:
                 break;
@@ -72,7 +293,6 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                 {
                     ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
                     ESP_LOGI(TAG, "Got IP address: " IPSTR, IP2STR(&event->ip_info.ip));
-                    wifi_connected = true;
                     
                     // 设置目标地址 - 直接发送到192.168.1.113（接收端）
                     broadcast_addr.sin_family = AF_INET;
@@ -81,6 +301,27 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                     broadcast_addr.sin_addr.s_addr = inet_addr("192.168.1.113");
                     
                     ESP_LOGI(TAG, "Target address: 192.168.1.113:%d", UDP_PORT);
+                    
+                    reconnect_attempt = 0;
+                    if (conn_state == WIFI_STATE_RECONNECTING && outage_start_us) {
+                        // 断线到重新获取IP的时间；之后重建socket，发送任务记录第一帧发出的时间
+                        int64_t now = esp_timer_get_time();
+                        uint32_t outage_ms = (uint32_t)((now - outage_start_us) / 1000);
+                        reconnect_stats.last_outage_ms = outage_ms;
+                        reconnect_stats.total_outage_ms += outage_ms;
+                        if (outage_ms > reconnect_stats.max_outage_ms) {
+                            reconnect_stats.max_outage_ms = outage_ms;
+                        }
+                        outage_start_us = 0;
+                        wifi_udp_request_rebind();
+                        resume_start_us = now;
+                        ESP_LOGI(TAG, "WiFi reconnected after %lu ms", outage_ms);
+                    } else if (conn_state == WIFI_STATE_RECONNECTING) {
+                        // 切换链路配置后的重连：只重建socket，不计入断线统计
+                        wifi_udp_request_rebind();
+                    }
+                    conn_state = WIFI_STATE_CONNECTED;
+                    wifi_connected = true;  // socket由发送任务随后重建
                 }
                 break;
             default:
@@ -89,19 +330,72 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     }
 }
 
+// 当前应使用的省电模式：功耗管理要求省电时至少使用modem sleep
+static wifi_ps_type_t wifi_link_ps_mode(void)
+{
+    wifi_ps_type_t ps = link_configs[link_profile].ps;
+    if (link_power_save && ps == WIFI_PS_NONE) {
+        ps = WIFI_PS_MIN_MODEM;
+    }
+    return ps;
+}
+
+// 设置协议集和带宽（连接AP之前调用）
+static esp_err_t wifi_link_apply_phy(const wifi_link_config_t *link)
+{
+    esp_err_t err = esp_wifi_set_protocol(WIFI_IF_STA, link->protocol);
+    if (err == ESP_OK && (link->protocol & WIFI_PROTOCOL_11N)) {
+        err = esp_wifi_set_bandwidth(WIFI_IF_STA, link->bandwidth);
+    }
+    return err;
+}
+
+// 设置发射功率和省电模式（启动后随时可调用）
+static esp_err_t wifi_link_apply_radio(const wifi_link_config_t *link)
+{
+    esp_err_t err = esp_wifi_set_max_tx_power(link->tx_power_qdbm);
+    if (err == ESP_OK) {
+        err = esp_wifi_set_ps(wifi_link_ps_mode());
+    }
+    return err;
+}
+
+// 与AP协商的PHY模式和信号强度
+static const char* wifi_link_phy_mode(int8_t *rssi)
+{
+    wifi_ap_record_t ap_info;
+    *rssi = 0;
+    if (!wifi_connected || esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return "-";
+    }
+    *rssi = ap_info.rssi;
+    
+    wifi_phy_mode_t mode;
+    if (esp_wifi_sta_get_negotiated_phymode(&mode) != ESP_OK) {
+        return "?";
+    }
+    switch (mode) {
+        case WIFI_PHY_MODE_11B:
+            return "11b";
+        case WIFI_PHY_MODE_11G:
+            return "11g";
+        case WIFI_PHY_MODE_HT20:
+            return "HT20";
+        case WIFI_PHY_MODE_HT40:
+            return "HT40";
+        case WIFI_PHY_MODE_LR:
+            return "LR";
+        default:
+            return "?";
+    }
+}
+
 bool wifi_init_sta(const char* ssid, const char* password)
 {
     ESP_LOGI(TAG, "Initializing WiFi in STA mode...");
     
     esp_err_t ret;
     
-    // 创建互斥锁
-    wifi_mutex = xSemaphoreCreateMutex();
-    if (!wifi_mutex) {
-        ESP_LOGE(TAG, "Failed to create WiFi mutex");
-        return false;
-    }
-    
     // 初始化NVS
     ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -141,6 +435,25 @@ bool wifi_init_sta(const char* ssid, const char* password)
         return false;
     }
     
+    // 未指定设备ID时使用STA MAC后4字节，同一现场的多台设备不会重复
+    if (device_id == 0) {
+        uint8_t mac[6];
+        if (esp_wifi_get_mac(WIFI_IF_STA, mac) == ESP_OK) {
+            device_id = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+        }
+    }
+    ESP_LOGI(TAG, "Device ID: %08lx", (unsigned long)device_id);
+    
+    // 重连退避定时器
+    const esp_timer_create_args_t timer_args = {
+        .callback = wifi_reconnect_timer_cb,
+        .name = "wifi_reconnect",
+    };
+    if (esp_timer_create(&timer_args, &reconnect_timer) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to create reconnect timer, retrying without backoff");
+        reconnect_timer = NULL;
+    }
+    
     // 注册事件处理函数
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT,
                                              ESP_EVENT_ANY_ID,
@@ -162,32 +475,581 @@ bool wifi_init_sta(const char* ssid, const char* password)
     
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+    
+    // 协议集和带宽在关联时与AP协商，必须在连接之前设置
+    const wifi_link_config_t *link = &link_configs[link_profile];
+    ret = wifi_link_apply_phy(link);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to apply link profile %s: %s", link->name, esp_err_to_name(ret));
+    }
+    
     ESP_ERROR_CHECK(esp_wifi_start());
+    wifi_started = true;
+    
+    // 发射功率只能在启动后设置
+    ret = wifi_link_apply_radio(link);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to apply link profile %s: %s", link->name, esp_err_to_name(ret));
+    }
+    ESP_LOGI(TAG, "Link profile: %s", link->name);
     
     ESP_LOGI(TAG, "WiFi initialization completed");
     return true;
 }
 
-bool wifi_udp_broadcast_init(uint16_t port)
+// 释放共享帧缓冲引用（调用者持有tx_mutex）
+static void wifi_packet_release_locked(wifi_tx_packet_t *pkt)
 {
-    if (udp_socket >= 0) {
-        close(udp_socket);
+    if (pkt && pkt->refs > 0) {
+        pkt->refs--;
     }
+}
+
+// 清空订阅者队列（调用者持有tx_mutex）
+static void wifi_subscriber_flush_locked(wifi_subscriber_t *sub)
+{
+    while (sub->queue_count > 0) {
+        wifi_packet_release_locked(sub->queue[sub->queue_head]);
+        sub->queue_head = (sub->queue_head + 1) % WIFI_SUB_QUEUE_DEPTH;
+        sub->queue_count--;
+    }
+}
+
+// 查找订阅者，不存在时分配空闲槽位（调用者持有tx_mutex）
+static wifi_subscriber_t* wifi_subscriber_get_locked(const struct sockaddr_in *addr, bool create)
+{
+    wifi_subscriber_t *free_slot = NULL;
     
-    // 创建UDP socket
-    udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
-    if (udp_socket < 0) {
-        ESP_LOGE(TAG, "Failed to create UDP socket: %s", strerror(errno));
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        wifi_subscriber_t *sub = &subscribers[i];
+        if (sub->active) {
+            if (sub->addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+                sub->addr.sin_port == addr->sin_port) {
+                return sub;
+            }
+        } else if (!free_slot) {
+            free_slot = sub;
+        }
+    }
+    
+    if (!create || !free_slot) {
+        return NULL;
+    }
+    
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->active = true;
+    free_slot->addr = *addr;
+    free_slot->version = UDP_FRAME_VERSION_1;
+    free_slot->frame_divider = 1;
+    return free_slot;
+}
+
+// 处理HELLO：新增/刷新订阅者，协商帧头版本和抽帧比
+static void wifi_handle_hello(const udp_ctrl_t* ctrl, size_t len, const struct sockaddr_in* from)
+{
+    // 取双方都支持的最高版本
+    uint8_t version = ctrl->version;
+    if (version > UDP_FRAME_VERSION_MAX) {
+        version = UDP_FRAME_VERSION_MAX;
+    }
+    if (version < UDP_FRAME_VERSION_1) {
+        version = UDP_FRAME_VERSION_1;
+    }
+    
+    uint8_t divider = 1;
+    if (len >= sizeof(udp_ctrl_hello_t)) {
+        divider = ((const udp_ctrl_hello_t*)ctrl)->frame_divider;
+        if (divider == 0) {
+            divider = 1;
+        }
+    }
+    
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    wifi_subscriber_t *sub = wifi_subscriber_get_locked(from, true);
+    if (sub) {
+        if (sub->version != version || sub->frame_divider != divider) {
+            ESP_LOGI(TAG, "Subscriber " IPSTR ":%d: header v%d, 1/%d frames",
+                     IP2STR((esp_ip4_addr_t*)&from->sin_addr.s_addr), ntohs(from->sin_port), version, divider);
+        }
+        sub->version = version;
+        sub->frame_divider = divider;
+        sub->last_hello_tick = xTaskGetTickCount();
+    } else {
+        ESP_LOGW(TAG, "Subscriber table full, ignoring HELLO");
+    }
+    xSemaphoreGive(tx_mutex);
+}
+
+// 订阅者超时：动态订阅者移除，默认目的地址回退到v1全帧率
+static void wifi_expire_subscribers(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        wifi_subscriber_t *sub = &subscribers[i];
+        if (!sub->active || now - sub->last_hello_tick <= pdMS_TO_TICKS(UDP_HELLO_TIMEOUT_MS)) {
+            continue;
+        }
+        if (sub->is_static) {
+            if (sub->version != UDP_FRAME_VERSION_1 || sub->frame_divider != 1) {
+                ESP_LOGI(TAG, "No HELLO for %d ms, falling back to frame header v1", UDP_HELLO_TIMEOUT_MS);
+                sub->version = UDP_FRAME_VERSION_1;
+                sub->frame_divider = 1;
+            }
+        } else {
+            ESP_LOGI(TAG, "Subscriber " IPSTR ":%d expired",
+                     IP2STR((esp_ip4_addr_t*)&sub->addr.sin_addr.s_addr), ntohs(sub->addr.sin_port));
+            wifi_subscriber_flush_locked(sub);
+            sub->active = false;
+        }
+    }
+    xSemaphoreGive(tx_mutex);
+}
+
+// 放入发送请求并唤醒发送任务（任意任务可调用，不加锁）
+static bool wifi_sendq_push(wifi_send_req_t *req)
+{
+    if (!sendq_ready) {
+        return false;
+    }
+    req->enqueue_us = esp_timer_get_time();
+    if (!mpsc_push(req->prio == PACER_PRIO_CONTROL ? &ctrl_send_queue : &send_queue, req)) {
         return false;
     }
+    xTaskNotifyGive(tx_task_handle);
+    return true;
+}
+
+// 分配同步发送的完成通知，调用者持有一个引用；槽位用完时返回WIFI_SEND_DONE_NONE
+static uint8_t wifi_send_done_alloc(void)
+{
+    uint8_t slot = WIFI_SEND_DONE_NONE;
+    taskENTER_CRITICAL(&send_done_lock);
+    for (int i = 0; i < WIFI_SEND_DONE_SLOTS; i++) {
+        wifi_send_done_t *done = &send_done_slots[i];
+        if (!done->in_use) {
+            done->in_use = true;
+            done->pending = 1;
+            done->sent_count = 0;
+            done->result = -1;
+            done->err = 0;
+            slot = i;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&send_done_lock);
+    if (slot != WIFI_SEND_DONE_NONE) {
+        xSemaphoreTake(send_done_slots[slot].sem, 0);  // 清除上一个使用者超时后迟到的通知
+    }
+    return slot;
+}
+
+// 放入需要等待结果的请求：先增加引用再入队，避免发送任务先处理完时提前发出通知
+static bool wifi_sendq_push_done(wifi_send_req_t *req, uint8_t slot)
+{
+    if (slot == WIFI_SEND_DONE_NONE) {
+        return false;
+    }
+    wifi_send_done_t *done = &send_done_slots[slot];
+    taskENTER_CRITICAL(&send_done_lock);
+    done->pending++;
+    req->done_slot = slot + 1;
+    req->done_gen = done->gen;
+    taskEXIT_CRITICAL(&send_done_lock);
+    if (!wifi_sendq_push(req)) {
+        taskENTER_CRITICAL(&send_done_lock);
+        done->pending--;
+        taskEXIT_CRITICAL(&send_done_lock);
+        return false;
+    }
+    return true;
+}
+
+// 释放调用者的引用，最多等待WIFI_SEND_WAIT_MS让已入队的请求发送完，然后释放槽位。
+// 超时后未发送的请求作废，正在发送的请求发完才返回，调用者之后可以复用外部数据。
+// 返回是否全部完成；sent_count/result/err 可为NULL
+static bool wifi_send_done_wait(uint8_t slot, int *sent_count, int *result, int *err)
+{
+    if (slot == WIFI_SEND_DONE_NONE) {
+        if (sent_count) *sent_count = 0;
+        if (result) *result = -1;
+        if (err) *err = 0;
+        return false;
+    }
+    wifi_send_done_t *done = &send_done_slots[slot];
+    
+    taskENTER_CRITICAL(&send_done_lock);
+    bool complete = --done->pending == 0;
+    taskEXIT_CRITICAL(&send_done_lock);
+    if (!complete) {
+        complete = xSemaphoreTake(done->sem, pdMS_TO_TICKS(WIFI_SEND_WAIT_MS)) == pdTRUE;
+    }
+    
+    // 使代号失效：发送任务不再处理该槽位的请求，再等正在进行的那次发送结束
+    bool sending;
+    taskENTER_CRITICAL(&send_done_lock);
+    done->gen++;
+    sending = done->sending;
+    taskEXIT_CRITICAL(&send_done_lock);
+    while (sending) {
+        vTaskDelay(1);
+        taskENTER_CRITICAL(&send_done_lock);
+        sending = done->sending;
+        taskEXIT_CRITICAL(&send_done_lock);
+    }
+    
+    taskENTER_CRITICAL(&send_done_lock);
+    if (sent_count) *sent_count = done->sent_count;
+    if (result) *result = done->result;
+    if (err) *err = done->err;
+    done->in_use = false;
+    taskEXIT_CRITICAL(&send_done_lock);
+    
+    if (!complete) {
+        sendq_stats.timeouts++;
+        ESP_LOGW(TAG, "Send request timed out after %d ms", WIFI_SEND_WAIT_MS);
+    }
+    return complete;
+}
+
+// 发送一个请求（只在发送任务中调用）
+static void wifi_sendq_send(wifi_send_req_t *req)
+{
+    // 调用者已放弃等待的请求不再发送：外部数据可能已被复用
+    wifi_send_done_t *done = NULL;
+    if (req->done_slot) {
+        done = &send_done_slots[req->done_slot - 1];
+        taskENTER_CRITICAL(&send_done_lock);
+        bool valid = done->in_use && done->gen == req->done_gen;
+        if (valid) {
+            done->sending = true;
+        }
+        taskEXIT_CRITICAL(&send_done_lock);
+        if (!valid) {
+            sendq_stats.cancelled++;
+            return;
+        }
+    }
+    
+    int64_t start = esp_timer_get_time();
+    uint32_t wait_us = (uint32_t)(start - req->enqueue_us);
+    sendq_stats.requests++;
+    sendq_wait_sum_us += wait_us;
+    sendq_stats.avg_wait_us = (uint32_t)(sendq_wait_sum_us / sendq_stats.requests);
+    if (wait_us > sendq_stats.max_wait_us) {
+        sendq_stats.max_wait_us = wait_us;
+    }
+    if (req->prio == PACER_PRIO_CONTROL && wait_us > sendq_stats.ctrl_max_wait_us) {
+        sendq_stats.ctrl_max_wait_us = wait_us;
+    }
+    
+    int sent = -1;
+    int err = ENOTCONN;
+    if (udp_socket >= 0 && wifi_connected) {
+        if (req->flags & WIFI_SEND_STAMP_T3) {
+            // t3尽量贴近实际发送时刻
+            uint64_t t3 = (uint64_t)esp_timer_get_time();
+            memcpy(req->data + offsetof(udp_ctrl_sync_t, t3_us), &t3, sizeof(t3));
+        }
+        struct iovec iov[2] = {
+            { .iov_base = req->data, .iov_len = req->len },
+            { .iov_base = (void *)req->ext, .iov_len = req->ext_len },
+        };
+        struct msghdr msg = {
+            .msg_name = &req->dest,
+            .msg_namelen = sizeof(req->dest),
+            .msg_iov = iov,
+            .msg_iovlen = req->ext_len ? 2 : 1,
+        };
+        sent = sendmsg(udp_socket, &msg, 0);
+        err = errno;
+        wifi_pace_done(req->len + req->ext_len, (pacer_prio_t)req->prio, sent);
+    }
+    if (sent < 0) {
+        sendq_stats.errors++;
+    }
+    
+    if (done) {
+        taskENTER_CRITICAL(&send_done_lock);
+        done->result = sent;
+        if (sent < 0) {
+            done->err = err;
+        } else {
+            done->sent_count++;
+        }
+        bool last = --done->pending == 0;
+        taskEXIT_CRITICAL(&send_done_lock);
+        if (last) {
+            xSemaphoreGive(done->sem);
+        }
+        // 通知发出后才清除，调用者释放槽位时不会有迟到的通知
+        taskENTER_CRITICAL(&send_done_lock);
+        done->sending = false;
+        taskEXIT_CRITICAL(&send_done_lock);
+    }
+}
+
+// 发送队列中的全部请求（只在发送任务中调用），返回是否发送了请求。
+// 每取一个普通请求前先清空控制队列，控制包最多等待正在发送的一个请求
+static bool wifi_sendq_drain(void)
+{
+    bool any = false;
+    wifi_send_req_t req;
+    uint32_t depth = mpsc_count(&send_queue) + mpsc_count(&ctrl_send_queue);
+    if (depth > sendq_stats.max_depth) {
+        sendq_stats.max_depth = depth;
+    }
+    while (mpsc_pop(&ctrl_send_queue, &req) || mpsc_pop(&send_queue, &req)) {
+        wifi_sendq_send(&req);
+        any = true;
+    }
+    return any;
+}
+
+// 发送一帧给一个订阅者（只在发送任务中调用，不持有tx_mutex），返回sendmsg的结果
+static int wifi_tx_send_frame(wifi_tx_packet_t *pkt, struct sockaddr_in *addr, uint8_t version)
+{
+    // 帧头与共享帧数据分两段发送，无需为每个订阅者再拷贝
+    struct iovec iov[2];
+    if (version >= UDP_FRAME_VERSION_2) {
+        iov[0].iov_base = pkt->v2_hdr;
+        iov[0].iov_len = sizeof(pkt->v2_hdr);
+    } else {
+        iov[0].iov_base = pkt->v1_hdr;
+        iov[0].iov_len = sizeof(pkt->v1_hdr);
+    }
+    iov[1].iov_base = pkt->data;
+    iov[1].iov_len = pkt->len;
+    struct msghdr msg = {
+        .msg_name = addr,
+        .msg_namelen = sizeof(*addr),
+        .msg_iov = iov,
+        .msg_iovlen = 2,
+    };
+    
+    // 整帧是一个数据报（由协议栈IP分片），按关键帧优先级申请令牌，等待超时则丢弃本帧；
+    // 等待期间继续处理发送请求
+    size_t frame_bytes = iov[0].iov_len + iov[1].iov_len;
+    if (!wifi_pace_wait(frame_bytes, PACER_PRIO_KEYFRAME, WIFI_PACE_FRAME_WAIT_MS)) {
+        return -1;
+    }
+    wifi_sendq_drain();
+    int64_t now = esp_timer_get_time();
+    uint32_t wait_us = (uint32_t)(now - pkt->queued_us);
+    sendq_stats.frames++;
+    frame_wait_sum_us += wait_us;
+    sendq_stats.frame_avg_wait_us = (uint32_t)(frame_wait_sum_us / sendq_stats.frames);
+    if (wait_us > sendq_stats.frame_max_wait_us) {
+        sendq_stats.frame_max_wait_us = wait_us;
+    }
+    int sent = sendmsg(udp_socket, &msg, 0);
+    wifi_pace_done(frame_bytes, PACER_PRIO_KEYFRAME, sent);
+    
+    int64_t resume_us = resume_start_us;
+    if (sent >= 0 && resume_us) {
+        // 重新获取IP到第一帧发出
+        resume_start_us = 0;
+        uint32_t resume_ms = (uint32_t)((esp_timer_get_time() - resume_us) / 1000);
+        reconnect_stats.last_resume_ms = resume_ms;
+        if (resume_ms > reconnect_stats.max_resume_ms) {
+            reconnect_stats.max_resume_ms = resume_ms;
+        }
+        ESP_LOGI(TAG, "First frame after reconnect: %lu ms", resume_ms);
+    }
+    return sent;
+}
+
+// 发送任务：socket的唯一发送者。先处理其他任务的发送请求（控制应答、预录导出等），
+// 再轮询各订阅者队列，每轮每个订阅者发送一帧，慢订阅者不会阻塞其他订阅者。
+// 每轮只在取帧和归还时各持有一次tx_mutex，发送期间不持锁
+static void wifi_tx_task(void *arg)
+{
+    ESP_LOGI(TAG, "TX task started");
+    
+    typedef struct {
+        wifi_subscriber_t *sub;
+        wifi_tx_packet_t *pkt;
+        struct sockaddr_in addr;
+        uint8_t version;
+        int sent;
+    } wifi_tx_item_t;
+    wifi_tx_item_t batch[WIFI_MAX_SUBSCRIBERS];
+    
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        
+        bool sent_any;
+        do {
+            if (flush_pending) {
+                flush_pending = false;
+                wifi_flush_tx_queues();
+            }
+            if (rebind_pending) {
+                rebind_pending = false;
+                if (!wifi_udp_rebind()) {
+                    rebind_pending = true;  // 上一个旧socket还没被控制任务关闭，下次唤醒时重试
+                }
+            }
+            sent_any = wifi_sendq_drain();
+            
+            int count = 0;
+            xSemaphoreTake(tx_mutex, portMAX_DELAY);
+            for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+                wifi_subscriber_t *sub = &subscribers[i];
+                if (!sub->active || sub->queue_count == 0) {
+                    continue;
+                }
+                wifi_tx_item_t *item = &batch[count++];
+                item->sub = sub;
+                item->pkt = sub->queue[sub->queue_head];
+                item->addr = sub->addr;
+                item->version = sub->version;
+                sub->queue_head = (sub->queue_head + 1) % WIFI_SUB_QUEUE_DEPTH;
+                sub->queue_count--;
+            }
+            xSemaphoreGive(tx_mutex);
+            if (count == 0) {
+                continue;
+            }
+            
+            for (int n = 0; n < count; n++) {
+                batch[n].sent = wifi_tx_send_frame(batch[n].pkt, &batch[n].addr, batch[n].version);
+            }
+            
+            xSemaphoreTake(tx_mutex, portMAX_DELAY);
+            for (int n = 0; n < count; n++) {
+                if (batch[n].sent < 0) {
+                    batch[n].sub->frames_dropped++;
+                } else {
+                    batch[n].sub->frames_sent++;
+                }
+                wifi_packet_release_locked(batch[n].pkt);
+            }
+            xSemaphoreGive(tx_mutex);
+            sent_any = true;
+        } while (sent_any);
+    }
+}
+
+// 应答时钟同步PING：填入设备接收时间后交给发送任务原路返回，t3在实际发送前填入
+static void wifi_handle_ping(const udp_ctrl_sync_t* ping, int64_t rx_time_us,
+                             const struct sockaddr_in* from)
+{
+    wifi_send_req_t req = {
+        .dest = *from,
+        .len = sizeof(udp_ctrl_sync_t),
+        .prio = PACER_PRIO_CONTROL,
+        .flags = WIFI_SEND_STAMP_T3,
+    };
+    udp_ctrl_sync_t *pong = (udp_ctrl_sync_t *)req.data;
+    *pong = *ping;
+    pong->hdr.type = UDP_CTRL_PONG;
+    pong->t2_us = (uint64_t)rx_time_us;
+    
+    // 控制包不等待令牌
+    wifi_pace_wait(sizeof(*pong), PACER_PRIO_CONTROL, 0);
+    if (!wifi_sendq_push(&req)) {
+        return;  // 丢弃本次同步，接收端会继续发送PING
+    }
+    
+    stats_sync_pings++;
+}
+
+// 处理接收端发来的控制包
+static void wifi_handle_ctrl(const udp_ctrl_t* ctrl, size_t len, int64_t rx_time_us,
+                             const struct sockaddr_in* from)
+{
+    if (len < sizeof(udp_ctrl_t) || ctrl->magic != UDP_CTRL_MAGIC) {
+        return;
+    }
+    
+    switch (ctrl->type) {
+        case UDP_CTRL_HELLO:
+            wifi_handle_hello(ctrl, len, from);
+            break;
+        case UDP_CTRL_PING:
+            if (len >= sizeof(udp_ctrl_sync_t)) {
+                wifi_handle_ping((const udp_ctrl_sync_t*)ctrl, rx_time_us, from);
+            }
+            break;
+        default:
+            if (ctrl_handler) {
+                ctrl_handler(ctrl, len);
+            } else {
+                ESP_LOGD(TAG, "Unknown control packet type: %d", ctrl->type);
+            }
+            break;
+    }
+}
+
+// 控制包接收任务
+static void wifi_ctrl_task(void *arg)
+{
+    uint8_t rx_buf[64];
+    
+    ESP_LOGI(TAG, "Control task started");
+    
+    while (1) {
+        // 发送任务重建socket后换下的旧socket：本任务此时不在recvfrom中，可以关闭
+        int retired = retired_socket;
+        if (retired >= 0) {
+            close(retired);
+            retired_socket = -1;
+        }
+        
+        int sock = udp_socket;
+        if (sock < 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sock, rx_buf, sizeof(rx_buf), 0, (struct sockaddr*)&from, &from_len);
+        int64_t rx_time_us = esp_timer_get_time();  // t2: 收到后立即取时间
+        if (len > 0) {
+            wifi_handle_ctrl((const udp_ctrl_t*)rx_buf, len, rx_time_us, &from);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            vTaskDelay(pdMS_TO_TICKS(100));  // socket正在重建
+        }
+        
+        // 接收端消失后回退到v1，保证旧接收端接管时仍能解析
+        wifi_expire_subscribers();
+    }
+}
+
+// 创建UDP socket：允许广播，绑定固定端口，设置收发超时
+static int wifi_udp_socket_open(uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create UDP socket: %s", strerror(errno));
+        return -1;
+    }
     
     // 设置广播权限
     int broadcast = 1;
-    if (setsockopt(udp_socket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast)) < 0) {
+    if (setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast)) < 0) {
         ESP_LOGE(TAG, "Failed to set broadcast permission: %s", strerror(errno));
-        close(udp_socket);
-        udp_socket = -1;
-        return false;
+        close(sock);
+        return -1;
+    }
+    
+    // 重建socket时旧socket在控制任务关闭前仍绑定着同一端口（需要CONFIG_LWIP_SO_REUSE）
+    int reuse = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0) {
+        ESP_LOGW(TAG, "Failed to set SO_REUSEADDR: %s", strerror(errno));
+    }
+    
+    // 绑定固定端口，接收端可直接向该端口发送控制包
+    struct sockaddr_in local_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
+        ESP_LOGW(TAG, "Failed to bind UDP port %d: %s", port, strerror(errno));
     }
     
     // ESP32 WiFi协议栈不支持设置SO_SNDBUF，跳过此设置
@@ -197,10 +1059,159 @@ bool wifi_udp_broadcast_init(uint16_t port)
     struct timeval timeout;
     timeout.tv_sec = 0;
     timeout.tv_usec = 10000; // 10ms
-    if (setsockopt(udp_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
         ESP_LOGW(TAG, "Failed to set send timeout: %s", strerror(errno));
     }
     
+    // 控制包接收超时，让控制任务周期性检查状态
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000; // 100ms
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        ESP_LOGW(TAG, "Failed to set receive timeout: %s", strerror(errno));
+    }
+    return sock;
+}
+
+// 重建UDP socket（重连后IP可能已变化，或端口改变），订阅者表保留，接收端的HELLO会继续刷新。
+// 在发送任务中调用：发送任务是socket唯一的发送者，在两次发送之间换fd，发送路径上不需要加锁。
+// 控制任务可能正阻塞在旧socket的recvfrom上（lwip的UDP socket不支持shutdown()唤醒），
+// 旧fd交给控制任务在下一次recvfrom之前关闭（最迟在100ms接收超时后）；没有控制任务时直接关闭。
+// 上一个旧fd还没关闭时返回false，稍后重试
+static bool wifi_udp_rebind(void)
+{
+    if (retired_socket >= 0) {
+        return false;
+    }
+    int sock = wifi_udp_socket_open(udp_port);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to rebind UDP socket on port %d", udp_port);
+        return false;
+    }
+    int old = udp_socket;
+    udp_socket = sock;
+    if (old >= 0) {
+        if (ctrl_task_handle) {
+            retired_socket = old;
+        } else {
+            close(old);
+        }
+    }
+    return true;
+}
+
+// 请求重建socket（在事件任务中调用），由发送任务在两次发送之间执行
+static void wifi_udp_request_rebind(void)
+{
+    if (udp_socket < 0) {
+        return;  // socket还没创建
+    }
+    if (tx_task_handle) {
+        rebind_pending = true;
+        xTaskNotifyGive(tx_task_handle);
+    } else {
+        // 发送任务和控制任务都还没创建，没有其他任务在使用socket
+        close(udp_socket);
+        udp_socket = wifi_udp_socket_open(udp_port);
+    }
+}
+
+bool wifi_udp_broadcast_init(uint16_t port)
+{
+    if (!send_done_slots[0].sem) {
+        for (int i = 0; i < WIFI_SEND_DONE_SLOTS; i++) {
+            send_done_slots[i].sem = xSemaphoreCreateBinaryStatic(&send_done_slots[i].sem_buf);
+        }
+    }
+    
+    // 创建UDP socket；已创建时（更换端口）交给发送任务重建
+    udp_port = port;
+    if (udp_socket >= 0) {
+        wifi_udp_request_rebind();
+    } else {
+        udp_socket = wifi_udp_socket_open(port);
+        if (udp_socket < 0) {
+            return false;
+        }
+    }
+    
+    // 共享帧缓冲和订阅者表（只初始化一次）
+    if (!tx_mutex) {
+        tx_mutex = xSemaphoreCreateMutex();
+        if (!tx_mutex) {
+            ESP_LOGE(TAG, "Failed to create TX mutex");
+            close(udp_socket);
+            udp_socket = -1;
+            return false;
+        }
+        for (int i = 0; i < WIFI_TX_POOL_SIZE; i++) {
+            tx_pool[i].data = heap_caps_malloc(MAX_FRAME_SIZE, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+            if (!tx_pool[i].data) {
+                ESP_LOGE(TAG, "Memory for TX pool is not enough");
+                close(udp_socket);
+                udp_socket = -1;
+                return false;
+            }
+        }
+        
+        mpsc_init(&send_queue, sendq_cells, WIFI_SENDQ_DEPTH, sizeof(wifi_send_req_t));
+        mpsc_init(&ctrl_send_queue, ctrl_sendq_cells, WIFI_CTRL_SENDQ_DEPTH, sizeof(wifi_send_req_t));
+        sendq_stats.capacity = WIFI_SENDQ_DEPTH + WIFI_CTRL_SENDQ_DEPTH;
+        
+        taskENTER_CRITICAL(&pacer_lock);
+        pacer_init(&wifi_pacer, NULL, esp_timer_get_time());
+        pacer_set_enabled(&wifi_pacer, pacing_enabled);
+        if (link_capacity_kbps[link_profile]) {
+            pacer_set_capacity(&wifi_pacer, link_capacity_kbps[link_profile]);
+        }
+        pacer_ready = true;
+        taskEXIT_CRITICAL(&pacer_lock);
+    }
+    
+    // 默认目的地址作为常驻订阅者，旧接收端无需发送HELLO
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    wifi_subscriber_t *default_sub = wifi_subscriber_get_locked(&broadcast_addr, true);
+    if (default_sub) {
+        default_sub->is_static = true;
+    }
+    xSemaphoreGive(tx_mutex);
+    
+    if (!tx_task_handle) {
+        BaseType_t ret = xTaskCreatePinnedToCore(
+            wifi_tx_task,
+            "wifi_tx",
+            3 * 1024,
+            NULL,
+            5,
+            &tx_task_handle,
+            0
+        );
+        if (ret != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create TX task");
+            tx_task_handle = NULL;
+            close(udp_socket);
+            udp_socket = -1;
+            return false;
+        }
+    }
+    sendq_ready = true;
+    
+    // 创建控制包接收任务（只创建一次，socket重建后继续使用）
+    if (!ctrl_task_handle) {
+        BaseType_t ret = xTaskCreatePinnedToCore(
+            wifi_ctrl_task,
+            "wifi_ctrl",
+            3 * 1024,
+            NULL,
+            4,
+            &ctrl_task_handle,
+            0
+        );
+        if (ret != pdPASS) {
+            ESP_LOGW(TAG, "Failed to create control task, staying on frame header v1");
+            ctrl_task_handle = NULL;
+        }
+    }
+    
     ESP_LOGI(TAG, "UDP broadcast initialized on port %d", port);
     return true;
 }
@@ -208,22 +1219,32 @@ bool wifi_udp_broadcast_init(uint16_t port)
 int wifi_udp_send(const void* data, size_t len)
 {
     if (udp_socket < 0 || !wifi_connected) {
-        ESP_LOGE(TAG, "UDP send failed: socket=%d, connected=%d", udp_socket, wifi_connected);
+        // 断线期间由重连状态机统计，不逐包报错
+        ESP_LOGD(TAG, "UDP send skipped: socket=%d, connected=%d", udp_socket, wifi_connected);
         return -1;
     }
     
-    if (xSemaphoreTake(wifi_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-        ESP_LOGE(TAG, "UDP send failed: mutex timeout");
+    if (!wifi_pace_wait(len, PACER_PRIO_NORMAL, WIFI_PACE_FRAME_WAIT_MS)) {
+        ESP_LOGD(TAG, "UDP send dropped: pacing timeout");
         return -1;
     }
     
-    int sent = sendto(udp_socket, data, len, 0, 
-                      (struct sockaddr*)&broadcast_addr, sizeof(broadcast_addr));
-    
-    xSemaphoreGive(wifi_mutex);
+    // 交给发送任务发送，等待结果（数据不拷贝）
+    uint8_t slot = wifi_send_done_alloc();
+    wifi_send_req_t req = {
+        .dest = broadcast_addr,
+        .ext = data,
+        .ext_len = len,
+        .prio = PACER_PRIO_NORMAL,
+    };
+    wifi_sendq_push_done(&req, slot);
+    int sent = -1;
+    int err = 0;
+    bool complete = wifi_send_done_wait(slot, NULL, &sent, &err);
     
     if (sent < 0) {
-        ESP_LOGE(TAG, "UDP send failed: %s (errno=%d)", strerror(errno), errno);
+        ESP_LOGE(TAG, "UDP send failed: %s (errno=%d)",
+                 err ? strerror(err) : (complete ? "send queue full" : "send timeout"), err);
         ESP_LOGE(TAG, "Socket state: fd=%d, connected=%d", udp_socket, wifi_connected);
         ESP_LOGE(TAG, "Target: %d.%d.%d.%d:%d", 
                  (broadcast_addr.sin_addr.s_addr >> 0) & 0xFF,
@@ -243,6 +1264,384 @@ bool wifi_is_connected(void)
     return wifi_connected;
 }
 
+bool wifi_get_reconnect_stats(wifi_reconnect_stats_t* stats)
+{
+    if (!stats) {
+        return false;
+    }
+    
+    *stats = reconnect_stats;
+    stats->state = conn_state;
+    stats->channel = ap_channel;
+    if (conn_state == WIFI_STATE_RECONNECTING && outage_start_us) {
+        stats->current_outage_ms = (uint32_t)((esp_timer_get_time() - outage_start_us) / 1000);
+    }
+    return true;
+}
+
+bool wifi_set_power_save(bool enable)
+{
+    // 关闭modem sleep后射频一直接收，省去等待信标唤醒的延迟（几十到上百毫秒）
+    link_power_save = enable;
+    esp_err_t err = esp_wifi_set_ps(wifi_link_ps_mode());
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set WiFi power save: %s", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// 按当前配置的实测吞吐设置发送速率（未探测过的配置保持当前速率）
+static void wifi_pacer_apply_capacity(void)
+{
+    uint32_t capacity = link_capacity_kbps[link_profile];
+    if (!capacity) {
+        return;
+    }
+    taskENTER_CRITICAL(&pacer_lock);
+    if (pacer_ready) {
+        pacer_set_capacity(&wifi_pacer, capacity);
+    }
+    taskEXIT_CRITICAL(&pacer_lock);
+    ESP_LOGI(TAG, "Pacing capacity: %lu kbps", capacity);
+}
+
+bool wifi_set_link_profile(wifi_link_profile_t profile)
+{
+    if (profile >= WIFI_LINK_MAX) {
+        return false;
+    }
+    
+    const wifi_link_config_t *prev = &link_configs[link_profile];
+    const wifi_link_config_t *link = &link_configs[profile];
+    link_profile = profile;
+    if (!wifi_started) {
+        return true;  // wifi_init_sta() 中生效
+    }
+    
+    esp_err_t err = ESP_OK;
+    bool reconnect = prev->protocol != link->protocol || prev->bandwidth != link->bandwidth;
+    if (reconnect && conn_state == WIFI_STATE_CONNECTED) {
+        // 断开后再改协议集/带宽：断开事件处理中设置新参数并重连，重新关联时按新参数协商
+        link_reconfiguring = true;
+        wifi_connected = false;
+        err = esp_wifi_disconnect();
+        if (err != ESP_OK) {
+            link_reconfiguring = false;
+        }
+    } else if (reconnect) {
+        // 未连接：直接设置，正在进行的重连按新参数关联
+        err = wifi_link_apply_phy(link);
+    }
+    if (err == ESP_OK) {
+        err = wifi_link_apply_radio(link);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to apply link profile %s: %s", link->name, esp_err_to_name(err));
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "Link profile: %s%s", link->name, reconnect ? " (reconnecting)" : "");
+    wifi_pacer_apply_capacity();
+    return true;
+}
+
+wifi_link_profile_t wifi_get_link_profile(void)
+{
+    return link_profile;
+}
+
+const char* wifi_link_profile_name(wifi_link_profile_t profile)
+{
+    if (profile >= WIFI_LINK_MAX) {
+        return "unknown";
+    }
+    return link_configs[profile].name;
+}
+
+bool wifi_get_link_status(wifi_link_status_t* status)
+{
+    if (!status || !wifi_started) {
+        return false;
+    }
+    
+    memset(status, 0, sizeof(*status));
+    status->profile = link_profile;
+    status->name = link_configs[link_profile].name;
+    
+    wifi_ps_type_t ps = WIFI_PS_NONE;
+    esp_wifi_get_ps(&ps);
+    status->ps_mode = ps == WIFI_PS_NONE ? "none" : (ps == WIFI_PS_MIN_MODEM ? "min-modem" : "max-modem");
+    wifi_bandwidth_t bw;
+    if (esp_wifi_get_bandwidth(WIFI_IF_STA, &bw) == ESP_OK) {
+        status->bandwidth = bw == WIFI_BW_HT40 ? 40 : 20;
+    }
+    esp_wifi_get_protocol(WIFI_IF_STA, &status->protocol);
+    esp_wifi_get_max_tx_power(&status->tx_power_qdbm);
+    status->phy_mode = wifi_link_phy_mode(&status->rssi);
+    return true;
+}
+
+// 链路探测的ping统计（回调在ping任务中执行）
+typedef struct {
+    wifi_link_probe_t *result;
+    uint64_t rtt_sum_ms;
+    SemaphoreHandle_t done;
+} wifi_probe_ping_t;
+
+static void wifi_probe_ping_success(esp_ping_handle_t hdl, void *args)
+{
+    wifi_probe_ping_t *ctx = args;
+    uint32_t rtt_ms;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_TIMEGAP, &rtt_ms, sizeof(rtt_ms));
+    ctx->result->pings++;
+    ctx->rtt_sum_ms += rtt_ms;
+    if (rtt_ms > ctx->result->max_rtt_ms) {
+        ctx->result->max_rtt_ms = rtt_ms;
+    }
+}
+
+static void wifi_probe_ping_end(esp_ping_handle_t hdl, void *args)
+{
+    xSemaphoreGive(((wifi_probe_ping_t*)args)->done);
+}
+
+// ping网关测量往返延迟（下行包在modem sleep下要等AP的信标才能收到）
+static void wifi_probe_ping(wifi_link_probe_t *result)
+{
+    esp_netif_ip_info_t ip_info;
+    if (esp_netif_get_ip_info(sta_netif, &ip_info) != ESP_OK || ip_info.gw.addr == 0) {
+        return;
+    }
+    
+    wifi_probe_ping_t ctx = {
+        .result = result,
+        .done = xSemaphoreCreateBinary(),
+    };
+    if (!ctx.done) {
+        return;
+    }
+    
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    ip_addr_set_ip4_u32(&config.target_addr, ip_info.gw.addr);
+    config.count = WIFI_LINK_PROBE_PINGS;
+    config.interval_ms = 100;
+    config.timeout_ms = 1000;
+    esp_ping_callbacks_t cbs = {
+        .cb_args = &ctx,
+        .on_ping_success = wifi_probe_ping_success,
+        .on_ping_end = wifi_probe_ping_end,
+    };
+    
+    esp_ping_handle_t ping;
+    if (esp_ping_new_session(&config, &cbs, &ping) == ESP_OK) {
+        esp_ping_start(ping);
+        uint32_t wait_ms = WIFI_LINK_PROBE_PINGS * (config.interval_ms + config.timeout_ms) + 1000;
+        if (xSemaphoreTake(ctx.done, pdMS_TO_TICKS(wait_ms)) != pdTRUE) {
+            esp_ping_stop(ping);
+        }
+        esp_ping_delete_session(ping);
+    }
+    vSemaphoreDelete(ctx.done);
+    
+    if (result->pings > 0) {
+        result->avg_rtt_ms = (uint32_t)(ctx.rtt_sum_ms / result->pings);
+    }
+}
+
+bool wifi_link_probe(wifi_link_profile_t profile, uint32_t duration_ms, wifi_link_probe_t* result)
+{
+    if (!result || profile >= WIFI_LINK_MAX || !wifi_started) {
+        return false;
+    }
+    
+    memset(result, 0, sizeof(*result));
+    result->profile = profile;
+    result->name = link_configs[profile].name;
+    if (!wifi_set_link_profile(profile)) {
+        return false;
+    }
+    
+    // 切换协议集/带宽后等待重新连接
+    for (int i = 0; i < 100 && !wifi_connected; i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (!wifi_connected) {
+        ESP_LOGW(TAG, "Link probe %s: not connected", result->name);
+        return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(500));  // 等待速率自适应稳定
+    result->phy_mode = wifi_link_phy_mode(&result->rssi);
+    
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    uint8_t *payload = calloc(1, WIFI_LINK_PROBE_PAYLOAD);  // 魔数为0，接收端直接丢弃
+    if (sock < 0 || !payload) {
+        ESP_LOGE(TAG, "Link probe %s: no socket/memory", result->name);
+        if (sock >= 0) {
+            close(sock);
+        }
+        free(payload);
+        return false;
+    }
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 10000 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in dest = broadcast_addr;
+    
+#if CONFIG_PM_ENABLE
+    // 探测期间锁定CPU最高频率，结果不受动态调频影响
+    esp_pm_lock_handle_t pm_lock = NULL;
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "wifi_probe", &pm_lock) == ESP_OK) {
+        esp_pm_lock_acquire(pm_lock);
+    }
+#endif
+    
+    // 饱和发送：驱动发送缓冲区满时sendto失败，成功交给协议栈的字节数即受空口速率限制的吞吐
+    uint64_t bytes = 0;
+    uint64_t send_sum_us = 0;
+    int64_t start = esp_timer_get_time();
+    int64_t end = start + (int64_t)duration_ms * 1000;
+    int64_t last_yield = start;
+    int64_t now = start;
+    while (now < end) {
+        int sent = sendto(sock, payload, WIFI_LINK_PROBE_PAYLOAD, 0, (struct sockaddr*)&dest, sizeof(dest));
+        int64_t t = esp_timer_get_time();
+        uint32_t send_us = (uint32_t)(t - now);
+        if (sent < 0) {
+            result->failed++;
+            vTaskDelay(1);  // 缓冲区满，等待空口发送
+            t = esp_timer_get_time();
+            last_yield = t;
+        } else {
+            result->packets++;
+            bytes += sent;
+            send_sum_us += send_us;
+            if (send_us > result->max_send_us) {
+                result->max_send_us = send_us;
+            }
+            if (t - last_yield >= 100000) {
+                vTaskDelay(1);  // 让出CPU，避免空闲任务看门狗超时
+                t = esp_timer_get_time();
+                last_yield = t;
+            }
+        }
+        now = t;
+    }
+    int64_t elapsed_us = now - start;
+    
+    close(sock);
+    free(payload);
+    
+    if (elapsed_us > 0) {
+        result->goodput_kbps = (uint32_t)(bytes * 8 * 1000 / elapsed_us);
+        link_capacity_kbps[profile] = result->goodput_kbps;
+        wifi_pacer_apply_capacity();
+    }
+    if (result->packets > 0) {
+        result->avg_send_us = (uint32_t)(send_sum_us / result->packets);
+    }
+    
+    wifi_probe_ping(result);
+    
+#if CONFIG_PM_ENABLE
+    if (pm_lock) {
+        esp_pm_lock_release(pm_lock);
+        esp_pm_lock_delete(pm_lock);
+    }
+#endif
+    
+    ESP_LOGI(TAG, "Link probe %-14s: %s, RSSI %d dBm, goodput %lu kbps, send avg %lu us (max %lu us), "
+             "RTT avg %lu ms (max %lu ms, %lu/%d pings), %lu failed",
+             result->name, result->phy_mode, result->rssi, result->goodput_kbps,
+             result->avg_send_us, result->max_send_us, result->avg_rtt_ms, result->max_rtt_ms,
+             result->pings, WIFI_LINK_PROBE_PINGS, result->failed);
+    return true;
+}
+
+void wifi_set_pacing(bool enable)
+{
+    pacing_enabled = enable;
+    taskENTER_CRITICAL(&pacer_lock);
+    if (pacer_ready) {
+        pacer_set_enabled(&wifi_pacer, enable);
+    }
+    taskEXIT_CRITICAL(&pacer_lock);
+    ESP_LOGI(TAG, "UDP pacing %s", enable ? "on" : "off");
+}
+
+bool wifi_pace_wait(size_t bytes, pacer_prio_t prio, uint32_t max_wait_ms)
+{
+    if (!pacer_ready) {
+        return true;
+    }
+    
+    const int64_t start = esp_timer_get_time();
+    const int64_t deadline = start + (int64_t)max_wait_ms * 1000;
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        taskENTER_CRITICAL(&pacer_lock);
+        uint32_t wait_us = pacer_reserve(&wifi_pacer, bytes, prio, now);
+        bool timeout = wait_us > 0 && now + wait_us > deadline;
+        if (wait_us == 0 || timeout) {
+            pacer_note_wait(&wifi_pacer, (uint32_t)(now - start), timeout);
+        }
+        taskEXIT_CRITICAL(&pacer_lock);
+        
+        if (wait_us == 0) {
+            return true;
+        }
+        if (timeout) {
+            return false;
+        }
+        // 系统节拍10ms，不足一个节拍也休眠一个节拍：醒来时令牌够连续发送一批，相当于按节拍分批发送
+        const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+        const TickType_t ticks = (wait_us + tick_us - 1) / tick_us;
+        if (xTaskGetCurrentTaskHandle() == tx_task_handle) {
+            // 发送任务等待帧令牌时，有新的发送请求就提前醒来处理（控制应答不排在大帧后面）
+            ulTaskNotifyTake(pdTRUE, ticks);
+            wifi_sendq_drain();
+        } else {
+            vTaskDelay(ticks);
+        }
+    }
+}
+
+void wifi_pace_done(size_t bytes, pacer_prio_t prio, int sent)
+{
+    if (!pacer_ready) {
+        return;
+    }
+    
+    // 驱动发送缓冲区用完时lwip返回ENOMEM（设置了发送超时则为EAGAIN）
+    bool backpressure = sent < 0 && (errno == ENOMEM || errno == EAGAIN || errno == EWOULDBLOCK);
+    taskENTER_CRITICAL(&pacer_lock);
+    pacer_complete(&wifi_pacer, sent < 0 && !backpressure ? 0 : bytes, prio, backpressure, esp_timer_get_time());
+    taskEXIT_CRITICAL(&pacer_lock);
+}
+
+bool wifi_get_pacer_stats(pacer_stats_t* stats)
+{
+    if (!stats || !pacer_ready) {
+        return false;
+    }
+    
+    taskENTER_CRITICAL(&pacer_lock);
+    pacer_get_stats(&wifi_pacer, stats);
+    taskEXIT_CRITICAL(&pacer_lock);
+    return true;
+}
+
+bool wifi_get_sendq_stats(wifi_sendq_stats_t* stats)
+{
+    if (!stats || !sendq_ready) {
+        return false;
+    }
+    
+    *stats = sendq_stats;
+    stats->depth = mpsc_count(&send_queue) + mpsc_count(&ctrl_send_queue);
+    stats->full = atomic_load(&send_queue.full) + atomic_load(&ctrl_send_queue.full);
+    return true;
+}
+
 char* wifi_get_local_ip(void)
 {
     esp_netif_ip_info_t ip_info;
@@ -259,45 +1658,266 @@ char* wifi_get_local_ip(void)
     return ip_str;
 }
 
-bool wifi_send_camera_frame(const uint8_t* frame_data, size_t frame_size, uint16_t frame_id)
+bool wifi_send_camera_frame(const wifi_frame_desc_t* frame, uint32_t frame_id)
 {
-    if (!frame_data || frame_size == 0 || udp_socket < 0) {
+    if (!frame || !frame->data || frame->len == 0 || udp_socket < 0 || !tx_mutex) {
         return false;
     }
     
-    // 检查帧大小是否超过限制
-    if (frame_size > MAX_FRAME_SIZE) {
-        ESP_LOGW(TAG, "Frame too large: %d bytes (max: %d)", frame_size, MAX_FRAME_SIZE);
+    // 检查帧大小是否超过限制（ROI裁剪的帧按紧凑排列计算）
+    size_t len = wifi_frame_packed_size(frame);
+    if (len > MAX_FRAME_SIZE) {
+        ESP_LOGW(TAG, "Frame too large: %d bytes (max: %d)", len, MAX_FRAME_SIZE);
         return false;
     }
     
-    // 准备完整的UDP数据包
-    static uint8_t packet_buffer[UDP_PACKET_SIZE];
+    // 确定本帧需要发送的订阅者（按各自的抽帧比）
+    bool wanted[WIFI_MAX_SUBSCRIBERS] = {0};
+    int wanted_count = 0;
+    wifi_tx_packet_t *pkt = NULL;
+    
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        wifi_subscriber_t *sub = &subscribers[i];
+        // v1帧头没有格式字段，只能发送RGB565
+        if (frame->format != UDP_FMT_RGB565 && sub->version < UDP_FRAME_VERSION_2) {
+            continue;
+        }
+        if (sub->active && (sub->frame_counter++ % sub->frame_divider) == 0) {
+            wanted[i] = true;
+            wanted_count++;
+        }
+    }
+    if (wanted_count > 0) {
+        for (int i = 0; i < WIFI_TX_POOL_SIZE; i++) {
+            if (tx_pool[i].refs == 0) {
+                pkt = &tx_pool[i];
+                pkt->refs = 1;  // 填充期间占用
+                break;
+            }
+        }
+        if (!pkt) {
+            for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+                if (wanted[i]) {
+                    subscribers[i].frames_dropped++;
+                }
+            }
+        }
+    }
+    xSemaphoreGive(tx_mutex);
+    
+    if (wanted_count == 0) {
+        return true;  // 本帧所有订阅者都抽掉了
+    }
+    if (!pkt) {
+        ESP_LOGD(TAG, "TX pool exhausted, dropping frame %lu", frame_id);
+        return false;
+    }
     
-    // 使用结构体构建包头以确保正确的字节序和对齐
-    udp_frame_t* frame = (udp_frame_t*)packet_buffer;
-    frame->magic = UDP_MAGIC_NUMBER;  // 0x5056
-    frame->width = 160;               // QQVGA宽度
-    frame->height = 120;              // QQVGA高度
+    // 使用结构体构建包头以确保正确的字节序和对齐，两个版本的帧头各生成一次
+    udp_frame_t v1;
+    v1.magic = UDP_MAGIC_NUMBER;  // 0x5056
+    v1.width = frame->width;
+    v1.height = frame->height;
+    memcpy(pkt->v1_hdr, &v1, sizeof(pkt->v1_hdr));
     
-    // 复制图像数据
-    memcpy(frame->data, frame_data, frame_size);
+    udp_frame_v2_t v2;
+    v2.magic = UDP_MAGIC_NUMBER;
+    v2.width = frame->width;
+    v2.height = frame->height;
+    v2.version = UDP_FRAME_VERSION_2;
+    v2.header_size = sizeof(pkt->v2_hdr);
+    v2.seq = frame_id;
+    v2.timestamp_us = (uint64_t)frame->timestamp_us;
+    v2.format = frame->format;
+    v2.flags = frame->flags;
+    v2.stride = (len == frame->len) ? frame->stride : len / frame->height;
+    v2.device_id = device_id;
+    memcpy(pkt->v2_hdr, &v2, sizeof(pkt->v2_hdr));
     
-    // 发送完整帧
-    size_t total_size = sizeof(udp_frame_t) - 1 + frame_size;  // 头部(6字节) + 图像数据
-    int sent = wifi_udp_send(packet_buffer, total_size);
+    // 复制图像数据（所有订阅者共享这一份）
+    pkt->len = wifi_frame_copy_packed(frame, pkt->data);
+    pkt->queued_us = esp_timer_get_time();
     
-    if (sent < 0) {
-        ESP_LOGW(TAG, "Failed to send frame %d", frame_id);
-        return false;
+    // 放入各订阅者的发送队列，队列满时丢弃该订阅者最旧的帧
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    pkt->refs = 0;
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        wifi_subscriber_t *sub = &subscribers[i];
+        if (!wanted[i] || !sub->active) {
+            continue;
+        }
+        if (sub->queue_count == WIFI_SUB_QUEUE_DEPTH) {
+            wifi_packet_release_locked(sub->queue[sub->queue_head]);
+            sub->queue_head = (sub->queue_head + 1) % WIFI_SUB_QUEUE_DEPTH;
+            sub->queue_count--;
+            sub->frames_dropped++;
+        }
+        sub->queue[(sub->queue_head + sub->queue_count) % WIFI_SUB_QUEUE_DEPTH] = pkt;
+        sub->queue_count++;
+        pkt->refs++;
     }
+    xSemaphoreGive(tx_mutex);
+    
+    xTaskNotifyGive(tx_task_handle);
     
     // 更新统计信息
-    wifi_update_stats(1, frame_size);
+    wifi_update_stats(wanted_count, len * wanted_count);
     
     return true;
 }
 
+int wifi_send_recorded_frame(const wifi_frame_desc_t* frame, uint32_t seq)
+{
+    if (!frame || !frame->data || frame->len == 0 || frame->len > MAX_FRAME_SIZE || udp_socket < 0 || !tx_mutex) {
+        return -1;
+    }
+    
+    udp_frame_v2_t v2;
+    v2.magic = UDP_MAGIC_NUMBER;
+    v2.width = frame->width;
+    v2.height = frame->height;
+    v2.version = UDP_FRAME_VERSION_2;
+    v2.header_size = sizeof(udp_frame_v2_t) - 1;
+    v2.seq = seq;
+    v2.timestamp_us = (uint64_t)frame->timestamp_us;
+    v2.format = frame->format;
+    v2.flags = frame->flags | UDP_FLAG_RECORDED;
+    v2.stride = frame->stride;
+    v2.device_id = device_id;
+    
+    // 复制目的地址后释放锁，发送期间不阻塞实时流
+    struct sockaddr_in dest[WIFI_MAX_SUBSCRIBERS];
+    int dest_count = 0;
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active && subscribers[i].version >= UDP_FRAME_VERSION_2) {
+            dest[dest_count++] = subscribers[i].addr;
+        }
+    }
+    xSemaphoreGive(tx_mutex);
+    
+    // 每个目的地址一个请求，帧头内联、帧数据不拷贝；返回时发送任务已不再读取帧数据（调用者随后会复用缓冲区）
+    uint8_t slot = wifi_send_done_alloc();
+    for (int i = 0; i < dest_count && slot != WIFI_SEND_DONE_NONE; i++) {
+        // 后台优先级：令牌不足时等待，为实时流留出半个桶（等待过久时由节奏控制优先放行）
+        size_t bytes = v2.header_size + frame->len;
+        if (!wifi_pace_wait(bytes, PACER_PRIO_BULK, WIFI_PACE_BULK_WAIT_MS)) {
+            continue;
+        }
+        wifi_send_req_t req = {
+            .dest = dest[i],
+            .ext = frame->data,
+            .ext_len = frame->len,
+            .len = v2.header_size,
+            .prio = PACER_PRIO_BULK,
+        };
+        memcpy(req.data, &v2, v2.header_size);
+        wifi_sendq_push_done(&req, slot);
+    }
+    int sent_count = 0;
+    wifi_send_done_wait(slot, &sent_count, NULL, NULL);
+    return sent_count;
+}
+
+void wifi_set_ctrl_handler(wifi_ctrl_handler_t handler)
+{
+    ctrl_handler = handler;
+}
+
+// 每行有效字节数，0表示该格式不按行存储（JPEG/平面YUV420总是紧凑排列）
+static size_t wifi_frame_row_bytes(const wifi_frame_desc_t* frame)
+{
+    switch (frame->format) {
+        case UDP_FMT_RGB565:
+        case UDP_FMT_YUV422:
+            return (size_t)frame->width * 2;
+        case UDP_FMT_GRAY:
+            return frame->width;
+        default:
+            return 0;
+    }
+}
+
+size_t wifi_frame_packed_size(const wifi_frame_desc_t* frame)
+{
+    size_t row = wifi_frame_row_bytes(frame);
+    if (row == 0 || frame->stride == row) {
+        return frame->len;
+    }
+    return row * frame->height;
+}
+
+size_t wifi_frame_copy_packed(const wifi_frame_desc_t* frame, uint8_t* dst)
+{
+    size_t row = wifi_frame_row_bytes(frame);
+    if (row == 0 || frame->stride == row) {
+        memcpy(dst, frame->data, frame->len);
+        return frame->len;
+    }
+    
+    const uint8_t *src = frame->data;
+    for (int y = 0; y < frame->height; y++) {
+        memcpy(dst, src, row);
+        dst += row;
+        src += frame->stride;
+    }
+    return row * frame->height;
+}
+
+void wifi_set_device_id(uint32_t id)
+{
+    device_id = id;
+}
+
+uint32_t wifi_get_device_id(void)
+{
+    return device_id;
+}
+
+uint8_t wifi_get_frame_version(void)
+{
+    uint8_t version = UDP_FRAME_VERSION_1;
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active && subscribers[i].version > version) {
+            version = subscribers[i].version;
+        }
+    }
+    return version;
+}
+
+int wifi_get_subscribers(wifi_subscriber_info_t* info, int max_count)
+{
+    if (!info || !tx_mutex) {
+        return 0;
+    }
+    
+    int count = 0;
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_MAX_SUBSCRIBERS && count < max_count; i++) {
+        const wifi_subscriber_t *sub = &subscribers[i];
+        if (!sub->active) {
+            continue;
+        }
+        info[count].ip = sub->addr.sin_addr.s_addr;
+        info[count].port = ntohs(sub->addr.sin_port);
+        info[count].version = sub->version;
+        info[count].frame_divider = sub->frame_divider;
+        info[count].is_static = sub->is_static;
+        info[count].frames_sent = sub->frames_sent;
+        info[count].frames_dropped = sub->frames_dropped;
+        count++;
+    }
+    xSemaphoreGive(tx_mutex);
+    
+    return count;
+}
+
+uint32_t wifi_get_sync_count(void)
+{
+    return stats_sync_pings;
+}
+
 bool wifi_get_info(wifi_info_t* info)
 {
     if (!info || !wifi_connected) {
@@ -3,7 +3,9 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/socket.h>
+#include "pacer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,7 +17,7 @@ typedef struct {
     char password[64];
 } wifi_credentials_t;
 
-// 简化的UDP数据包结构 - 直接发送完整帧
+// 简化的UDP数据包结构 - 直接发送完整帧（v1，旧接收端使用）
 typedef struct __attribute__((packed)) {
     uint16_t magic;         // 魔数 0xFPFV
     uint16_t width;         // 图像宽度
@@ -23,10 +25,119 @@ typedef struct __attribute__((packed)) {
     uint8_t  data[1];       // 图像数据起始位置
 } udp_frame_t;
 
+// v2帧头 - 前6字节与v1兼容，旧接收端按v1解析时会因帧长不符而丢弃
+// 新字段只追加在末尾：接收端按header_size定位图像数据，旧v2接收端自动跳过不认识的字段
+typedef struct __attribute__((packed)) {
+    uint16_t magic;         // 魔数 0x5056
+    uint16_t width;         // 实际图像宽度
+    uint16_t height;        // 实际图像高度
+    uint8_t  version;       // 帧头版本 (UDP_FRAME_VERSION_2)
+    uint8_t  header_size;   // 帧头长度（字节），接收端据此定位图像数据
+    uint32_t seq;           // 帧序号，用于检测丢帧/乱序
+    uint64_t timestamp_us;  // 采集时间戳（设备时钟，微秒）
+    uint8_t  format;        // 像素格式/编码 (udp_pixel_format_t)
+    uint8_t  flags;         // 标志位 (UDP_FLAG_*)
+    uint16_t stride;        // 每行字节数
+    uint32_t device_id;     // 设备ID（多摄像头汇聚时区分来源），header_size >= UDP_FRAME_V2_ID_SIZE 时有效
+    uint8_t  data[1];       // 图像数据起始位置
+} udp_frame_v2_t;
+
+// 控制包（接收端 -> 设备），与帧数据共用同一UDP端口
+typedef struct __attribute__((packed)) {
+    uint16_t magic;         // 魔数 UDP_CTRL_MAGIC
+    uint8_t  type;          // 控制包类型 (udp_ctrl_type_t)
+    uint8_t  version;       // HELLO: 接收端支持的最高帧头版本
+} udp_ctrl_t;
+
+// HELLO控制包（扩展字段可选，旧接收端只发送4字节udp_ctrl_t）
+typedef struct __attribute__((packed)) {
+    udp_ctrl_t hdr;         // type = UDP_CTRL_HELLO
+    uint8_t  frame_divider; // 抽帧比：每N帧接收1帧，0/1表示全帧率
+} udp_ctrl_hello_t;
+
+// 时钟同步包（NTP式四时间戳），PING由接收端发出，设备填入t2/t3后以PONG原样返回
+typedef struct __attribute__((packed)) {
+    udp_ctrl_t hdr;         // type = UDP_CTRL_PING / UDP_CTRL_PONG
+    uint32_t seq;           // PING序号，接收端用于匹配
+    uint64_t t1_us;         // 接收端发送时间（接收端时钟）
+    uint64_t t2_us;         // 设备接收时间（设备时钟，与帧timestamp_us同源）
+    uint64_t t3_us;         // 设备发送时间（设备时钟）
+} udp_ctrl_sync_t;
+
+// ROI控制包：设置区域（帧像素坐标），width/height为0表示取消ROI
+typedef struct __attribute__((packed)) {
+    udp_ctrl_t hdr;         // type = UDP_CTRL_ROI
+    uint8_t  target;        // 作用路径位掩码：1=FPV, 2=LCD
+    uint8_t  reserved;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} udp_ctrl_roi_t;
+
+// 预录导出控制包：把触发前pre_event_ms内的预录帧以 UDP_FLAG_RECORDED 帧发回
+typedef struct __attribute__((packed)) {
+    udp_ctrl_t hdr;         // type = UDP_CTRL_DUMP
+    uint16_t pre_event_ms;  // 导出触发前多长时间的帧，0表示使用设备配置
+} udp_ctrl_dump_t;
+
+// 像素格式/编码
+typedef enum {
+    UDP_FMT_RGB565 = 0,     // RGB565，字节序见 UDP_FLAG_BIG_ENDIAN
+    UDP_FMT_JPEG   = 1,     // JPEG
+    UDP_FMT_GRAY   = 2,     // 8位灰度
+    UDP_FMT_YUV422 = 3,     // YUYV
+    UDP_FMT_YUV420 = 4,     // 平面I420：Y(w*h) | U(w/2*h/2) | V(w/2*h/2)，stride为亮度行字节数
+} udp_pixel_format_t;
+
+// 控制包类型
+typedef enum {
+    UDP_CTRL_HELLO = 1,     // 版本协商，同时作为保活
+    UDP_CTRL_PING  = 2,     // 时钟同步请求（接收端 -> 设备）
+    UDP_CTRL_PONG  = 3,     // 时钟同步应答（设备 -> 接收端）
+    UDP_CTRL_ROI   = 4,     // 设置ROI/数字变焦（udp_ctrl_roi_t）
+    UDP_CTRL_DUMP  = 5,     // 导出预录帧（udp_ctrl_dump_t）
+} udp_ctrl_type_t;
+
+#define UDP_FLAG_BIG_ENDIAN 0x01    // 16位像素为大端字节序（esp32-camera输出的RGB565）
+#define UDP_FLAG_KEYFRAME   0x02    // 关键帧（完整帧总是关键帧）
+#define UDP_FLAG_MOTION     0x04    // 设备端运动检测处于运动状态
+#define UDP_FLAG_RECORDED   0x08    // 预录导出帧（seq为预录序号，不属于实时流）
+
+#define UDP_FRAME_VERSION_1 1
+#define UDP_FRAME_VERSION_2 2
+#define UDP_FRAME_VERSION_MAX UDP_FRAME_VERSION_2
+#define UDP_FRAME_V2_BASE_SIZE 24   // 不含device_id的v2帧头长度（旧固件），接收端据此兼容
+#define UDP_FRAME_V2_ID_SIZE 28     // 含device_id的v2帧头长度
+
 #define UDP_MAGIC_NUMBER 0x5056
+#define UDP_CTRL_MAGIC 0x5043
 #define UDP_PORT 8888
+#define UDP_HELLO_TIMEOUT_MS 5000   // 超过该时间未收到HELLO则回退到v1帧头/移除订阅者
+#define WIFI_MAX_SUBSCRIBERS 4      // 订阅者上限（含默认目的地址）
+#define WIFI_SUB_QUEUE_DEPTH 2      // 每个订阅者的发送队列深度，满了丢弃该订阅者最旧的帧
+#define WIFI_TX_POOL_SIZE 3         // 共享帧缓冲数量（所有订阅者共用，每帧只拷贝一次）
+#define WIFI_SENDQ_DEPTH 32         // 发送请求队列容量（无锁，2的幂），其他任务经该队列交给发送任务发送
+#define WIFI_CTRL_SENDQ_DEPTH 8     // 控制包请求队列容量（2的幂），发送任务优先处理
+#define WIFI_SENDQ_INLINE_SIZE 64   // 请求内联数据上限（控制包、帧头），更大的数据按指针传递
+#define WIFI_SEND_WAIT_MS 500       // 同步发送（wifi_udp_send、预录导出）等待发送任务完成的上限
 #define MAX_FRAME_SIZE (160 * 120 * 2)  // QQVGA RGB565 = 38400字节
-#define UDP_PACKET_SIZE (sizeof(udp_frame_t) + MAX_FRAME_SIZE - 1)  // 完整包大小
+#define UDP_PACKET_SIZE (sizeof(udp_frame_v2_t) + MAX_FRAME_SIZE - 1)  // 完整包大小
+
+// 待发送帧描述（由摄像头帧缓冲区填充）
+typedef struct {
+    const uint8_t *data;    // 图像数据
+    size_t len;             // 数据长度
+    uint16_t width;         // 图像宽度
+    uint16_t height;        // 图像高度
+    uint16_t stride;        // 每行字节数
+    uint8_t format;         // 像素格式 (udp_pixel_format_t)
+    uint8_t flags;          // 标志位 (UDP_FLAG_*)
+    int64_t timestamp_us;   // 采集时间戳（微秒）
+} wifi_frame_desc_t;
+
+// 控制包回调：设备组件处理wifi组件不认识的控制包类型（在控制任务中调用，应尽快返回）
+typedef void (*wifi_ctrl_handler_t)(const udp_ctrl_t* ctrl, size_t len);
 
 /**
  * @brief 初始化WiFi STA模式
@@ -48,6 +159,7 @@ bool wifi_udp_broadcast_init(uint16_t port);
  * @param data 数据指针
  * @param len 数据长度
  * @return 发送的字节数，-1表示失败
+ * @note 交给发送任务发送（数据不拷贝），发送完成后返回
  */
 int wifi_udp_send(const void* data, size_t len);
 
@@ -57,6 +169,180 @@ int wifi_udp_send(const void* data, size_t len);
  */
 bool wifi_is_connected(void);
 
+// 连接状态
+typedef enum {
+    WIFI_STATE_CONNECTING = 0,  // 首次连接
+    WIFI_STATE_CONNECTED,       // 已获取IP
+    WIFI_STATE_RECONNECTING,    // 断线重连中（立即重试或退避等待）
+} wifi_conn_state_t;
+
+// 断线重连统计
+typedef struct {
+    wifi_conn_state_t state;
+    uint16_t last_reason;       // 最近一次断开原因（wifi_err_reason_t）
+    uint8_t channel;            // 缓存的AP信道，重连时先只扫描该信道
+    uint32_t outages;           // 获取IP后断线的次数
+    uint32_t attempts;          // 累计重连尝试次数
+    uint32_t current_outage_ms; // 正在进行的断线已持续时间
+    uint32_t last_outage_ms;    // 最近一次断线到重新获取IP
+    uint32_t max_outage_ms;
+    uint32_t total_outage_ms;
+    uint32_t last_resume_ms;    // 重新获取IP到第一帧发出
+    uint32_t max_resume_ms;
+} wifi_reconnect_stats_t;
+
+/**
+ * @brief 获取断线重连统计
+ * @param stats 统计信息输出
+ * @return true 成功，false 参数错误
+ */
+bool wifi_get_reconnect_stats(wifi_reconnect_stats_t* stats);
+
+/**
+ * @brief 设置WiFi省电模式（功耗管理在空闲/停止档位调用）
+ * @param enable true 至少使用modem sleep（WIFI_PS_MIN_MODEM），false 恢复当前链路配置的省电模式
+ * @return true 成功，false 失败（WiFi未启动）
+ */
+bool wifi_set_power_save(bool enable);
+
+// 链路配置：省电模式、带宽、协议集（决定可用的PHY速率）、最大发射功率
+typedef enum {
+    WIFI_LINK_LOW_LATENCY = 0,      // 低延迟：关闭modem sleep，HT20，11b/g/n，最大发射功率（默认）
+    WIFI_LINK_MAX_RANGE,            // 最远距离：只用11b（DSSS/CCK 1~11Mbps，接收灵敏度最高），HT20，最大发射功率
+    WIFI_LINK_MAX_THROUGHPUT,       // 最大吞吐：关闭modem sleep，HT40（AP支持时最高150Mbps），11b/g/n
+    WIFI_LINK_POWER_SAVE,           // 省电：WIFI_PS_MAX_MODEM，HT20，发射功率11dBm
+    WIFI_LINK_MAX,
+} wifi_link_profile_t;
+
+#define WIFI_LINK_PROBE_PAYLOAD 1400    // 探测包负载（不超过MTU，不分片）
+#define WIFI_LINK_PROBE_PINGS 20        // 每个配置向网关发送的ping次数（测量往返延迟）
+
+// 当前链路状态
+typedef struct {
+    wifi_link_profile_t profile;
+    const char *name;
+    const char *ps_mode;        // 实际省电模式："none"/"min-modem"/"max-modem"
+    uint8_t bandwidth;          // 配置的带宽：20或40（MHz）
+    uint8_t protocol;           // 协议集位掩码（WIFI_PROTOCOL_11B/11G/11N）
+    int8_t tx_power_qdbm;       // 最大发射功率（0.25dBm单位）
+    const char *phy_mode;       // 与AP协商的PHY模式："11b"/"11g"/"HT20"/"HT40"，未连接时为"-"
+    int8_t rssi;                // 信号强度（dBm），未连接时为0
+} wifi_link_status_t;
+
+// 链路探测结果
+typedef struct {
+    wifi_link_profile_t profile;
+    const char *name;
+    const char *phy_mode;       // 探测时协商的PHY模式
+    int8_t rssi;
+    uint32_t packets;           // 成功交给协议栈的探测包数
+    uint32_t failed;            // 发送失败次数（缓冲区不足/超时）
+    uint32_t goodput_kbps;      // 发送端有效吞吐（协议栈接受的UDP负载，饱和发送时受空口速率限制）
+    uint32_t avg_send_us;       // 单次sendto平均耗时
+    uint32_t max_send_us;
+    uint32_t pings;             // 收到应答的ping数
+    uint32_t avg_rtt_ms;        // 到网关的平均往返延迟（modem sleep时下行要等信标，明显变大）
+    uint32_t max_rtt_ms;
+} wifi_link_probe_t;
+
+/**
+ * @brief 选择链路配置
+ * @param profile 配置
+ * @return true 成功，false 失败
+ * @note 可在 wifi_init_sta() 之前调用（初始化时生效）；运行中切换协议集或带宽会断开并重连AP
+ */
+bool wifi_set_link_profile(wifi_link_profile_t profile);
+
+/**
+ * @brief 获取当前链路配置
+ * @return 配置
+ */
+wifi_link_profile_t wifi_get_link_profile(void);
+
+/**
+ * @brief 获取链路配置名称
+ * @param profile 配置
+ * @return 名称字符串
+ */
+const char* wifi_link_profile_name(wifi_link_profile_t profile);
+
+/**
+ * @brief 读取实际生效的链路参数和协商结果
+ * @param status 状态输出
+ * @return true 成功，false 失败（WiFi未初始化）
+ */
+bool wifi_get_link_status(wifi_link_status_t* status);
+
+/**
+ * @brief 链路探测：切换到该配置，向默认目的地址饱和发送UDP探测包统计吞吐和发送耗时，再ping网关测往返延迟
+ * @param profile 配置
+ * @param duration_ms 吞吐测试时长
+ * @param result 结果输出
+ * @return true 成功，false 失败（未连接或重连超时）
+ * @note 探测包魔数为0，接收端会直接丢弃；应在视频流启动之前调用，测试后保持该配置
+ *       测得的吞吐作为该配置的链路容量，之后切换到该配置时据此设置发送节奏控制的速率
+ */
+bool wifi_link_probe(wifi_link_profile_t profile, uint32_t duration_ms, wifi_link_probe_t* result);
+
+// 发送节奏控制：所有UDP发送路径共用一个令牌桶（见pacer.h），各路径的优先级
+#define WIFI_PACE_FRAME_WAIT_MS 100     // FPV帧最多等待令牌的时间，超时丢弃本帧（不阻塞其他订阅者太久）
+#define WIFI_PACE_BULK_WAIT_MS 1000     // 预录导出最多等待令牌的时间
+
+/**
+ * @brief 开启/关闭发送节奏控制（默认开启），关闭时仍统计发送和缓冲区不足次数，用于对比
+ * @param enable 是否开启
+ */
+void wifi_set_pacing(bool enable);
+
+/**
+ * @brief 发送前申请令牌，不足时按令牌桶速率休眠等待
+ * @param bytes 将要发送的字节数
+ * @param prio 优先级
+ * @param max_wait_ms 最长等待时间，0表示不等待
+ * @return true 可以发送，false 超时（调用者应丢弃该数据）
+ */
+bool wifi_pace_wait(size_t bytes, pacer_prio_t prio, uint32_t max_wait_ms);
+
+/**
+ * @brief 记录一次发送结果（sendto/sendmsg的返回值），发送缓冲区不足时降低速率
+ * @param bytes 发送的字节数
+ * @param prio 优先级
+ * @param sent 发送函数的返回值，<0时读取errno判断是否为缓冲区不足
+ */
+void wifi_pace_done(size_t bytes, pacer_prio_t prio, int sent);
+
+/**
+ * @brief 获取节奏控制统计
+ * @param stats 统计输出
+ * @return true 成功，false 失败（未初始化）
+ */
+bool wifi_get_pacer_stats(pacer_stats_t* stats);
+
+// 发送队列统计：发送任务是socket唯一的发送者，其他任务的请求经无锁队列交给它
+typedef struct {
+    uint32_t capacity;          // 两个队列的总容量
+    uint32_t depth;             // 当前队列长度（含控制包队列）
+    uint32_t max_depth;         // 发送任务取请求时看到的最大队列长度
+    uint32_t full;              // 队列满被拒绝的请求数
+    uint32_t requests;          // 已发送的请求数
+    uint32_t errors;            // 发送失败的请求数
+    uint32_t timeouts;          // 同步发送等待超过WIFI_SEND_WAIT_MS的次数
+    uint32_t cancelled;         // 调用者超时后作废、未发送的请求数
+    uint32_t avg_wait_us;       // 请求入队到发送的平均时间
+    uint32_t max_wait_us;
+    uint32_t ctrl_max_wait_us;  // 控制包入队到发送的最大时间
+    uint32_t frames;            // 发送的FPV帧数（各订阅者分别计）
+    uint32_t frame_avg_wait_us; // FPV帧放入订阅者队列到发送的平均时间
+    uint32_t frame_max_wait_us;
+} wifi_sendq_stats_t;
+
+/**
+ * @brief 获取发送队列统计
+ * @param stats 统计输出
+ * @return true 成功，false 失败（未初始化）
+ */
+bool wifi_get_sendq_stats(wifi_sendq_stats_t* stats);
+
 /**
  * @brief 获取本地IP地址
  * @return IP地址字符串，需要调用者释放
@@ -65,12 +351,85 @@ char* wifi_get_local_ip(void);
 
 /**
  * @brief 发送摄像头帧数据
- * @param frame_data 帧数据指针
- * @param frame_size 帧大小
- * @param frame_id 帧ID
+ * @param frame 帧描述（尺寸、格式、时间戳取自实际帧缓冲区）
+ * @param frame_id 帧序号
  * @return true 成功，false 失败
  */
-bool wifi_send_camera_frame(const uint8_t* frame_data, size_t frame_size, uint16_t frame_id);
+bool wifi_send_camera_frame(const wifi_frame_desc_t* frame, uint32_t frame_id);
+
+/**
+ * @brief 直接发送一帧预录导出帧（v2帧头带 UDP_FLAG_RECORDED），只发给v2订阅者
+ * @param frame 帧描述（数据需紧凑排列）
+ * @param seq 预录序号
+ * @return 成功发送的订阅者数量，-1表示失败
+ * @note 不经过实时流的订阅者队列：交给发送任务发送（帧数据不拷贝），全部发送完才返回，由调用者控制速率
+ */
+int wifi_send_recorded_frame(const wifi_frame_desc_t* frame, uint32_t seq);
+
+/**
+ * @brief 设置v2帧头中的设备ID（多摄像头汇聚时接收端按ID区分来源）
+ * @param id 设备ID，0表示使用STA MAC地址后4字节（默认）
+ * @note 可在 wifi_init_sta() 之前调用
+ */
+void wifi_set_device_id(uint32_t id);
+
+/**
+ * @brief 获取v2帧头中的设备ID
+ * @return 设备ID，WiFi初始化前且未设置时为0
+ */
+uint32_t wifi_get_device_id(void);
+
+/**
+ * @brief 获取订阅者中协商到的最高帧头版本
+ * @return UDP_FRAME_VERSION_1 或 UDP_FRAME_VERSION_2
+ */
+uint8_t wifi_get_frame_version(void);
+
+/**
+ * @brief 获取已应答的时钟同步PING数量
+ * @return PING计数
+ */
+uint32_t wifi_get_sync_count(void);
+
+// 订阅者信息
+typedef struct {
+    uint32_t ip;            // 订阅者IP（网络字节序）
+    uint16_t port;          // 订阅者端口
+    uint8_t version;        // 协商的帧头版本
+    uint8_t frame_divider;  // 抽帧比
+    bool is_static;         // 是否为默认目的地址（不会过期）
+    uint32_t frames_sent;   // 已发送帧数
+    uint32_t frames_dropped;// 队列满/缓冲不足丢弃的帧数
+} wifi_subscriber_info_t;
+
+/**
+ * @brief 获取订阅者列表
+ * @param info 订阅者信息输出数组
+ * @param max_count 数组长度
+ * @return 订阅者数量
+ */
+int wifi_get_subscribers(wifi_subscriber_info_t* info, int max_count);
+
+/**
+ * @brief 注册控制包回调（处理HELLO/PING以外的控制包）
+ * @param handler 回调函数，NULL取消注册
+ */
+void wifi_set_ctrl_handler(wifi_ctrl_handler_t handler);
+
+/**
+ * @brief 计算帧紧凑排列（去掉行尾stride填充）后的字节数
+ * @param frame 帧描述
+ * @return 字节数
+ */
+size_t wifi_frame_packed_size(const wifi_frame_desc_t* frame);
+
+/**
+ * @brief 按行拷贝帧数据并去掉stride填充（ROI裁剪后的帧只在这里拷贝一次）
+ * @param frame 帧描述
+ * @param dst 目标缓冲区，至少 wifi_frame_packed_size() 字节
+ * @return 拷贝的字节数
+ */
+size_t wifi_frame_copy_packed(const wifi_frame_desc_t* frame, uint8_t* dst);
 
 // WiFi信息结构体
 typedef struct {
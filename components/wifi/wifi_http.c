@@ -0,0 +1,478 @@
+#include "wifi_http.h"
+#include "esp_log.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "img_converters.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "wifi_http";
+
+#define PART_BOUNDARY "fpvframe"
+static const char *STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
+static const char *STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
+static const char *STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
+
+// 共享JPEG帧 - 每帧只编码一次，所有客户端引用同一份数据，最后一个使用者释放
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    uint32_t seq;
+    int refs;
+} shared_jpeg_t;
+
+// 客户端任务参数
+typedef struct {
+    httpd_req_t *req;
+    int slot;
+} stream_client_t;
+
+static httpd_handle_t server = NULL;
+static SemaphoreHandle_t stream_mutex = NULL;
+static TaskHandle_t encoder_task_handle = NULL;
+static TaskHandle_t client_tasks[WIFI_HTTP_MAX_CLIENTS];
+static bool client_used[WIFI_HTTP_MAX_CLIENTS];
+static shared_jpeg_t *latest_jpeg = NULL;
+static uint32_t jpeg_seq = 0;
+static volatile bool stream_running = false;
+
+// 采集任务 -> 编码任务的原始帧暂存区
+static uint8_t *raw_buf = NULL;
+static size_t raw_capacity = 0;
+static wifi_frame_desc_t raw_desc;
+static volatile bool raw_busy = false;
+
+static wifi_http_stats_t stream_stats;
+
+// 快照回调（由摄像头组件注册）
+static wifi_http_snapshot_take_t snapshot_take = NULL;
+static wifi_http_snapshot_release_t snapshot_release = NULL;
+
+// 释放共享帧引用
+static void stream_release(shared_jpeg_t *frame)
+{
+    if (!frame) {
+        return;
+    }
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    bool last = (--frame->refs == 0);
+    xSemaphoreGive(stream_mutex);
+
+    if (last) {
+        free(frame->buf);
+        free(frame);
+    }
+}
+
+// 获取比last_seq更新的共享帧引用，没有新帧时返回NULL
+static shared_jpeg_t* stream_acquire_latest(uint32_t last_seq)
+{
+    shared_jpeg_t *frame = NULL;
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    if (latest_jpeg && latest_jpeg->seq != last_seq) {
+        frame = latest_jpeg;
+        frame->refs++;
+    }
+    xSemaphoreGive(stream_mutex);
+
+    return frame;
+}
+
+static pixformat_t stream_pixformat(uint8_t format)
+{
+    switch (format) {
+        case UDP_FMT_GRAY:
+            return PIXFORMAT_GRAYSCALE;
+        case UDP_FMT_YUV422:
+            return PIXFORMAT_YUV422;
+        case UDP_FMT_RGB565:
+        default:
+            return PIXFORMAT_RGB565;
+    }
+}
+
+// JPEG编码任务：每个新帧编码一次，然后通知所有客户端
+static void stream_encoder_task(void *arg)
+{
+    ESP_LOGI(TAG, "Stream encoder task started");
+
+    while (stream_running) {
+        if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)) || !raw_busy) {
+            continue;
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        uint8_t *jpg_buf = NULL;
+        size_t jpg_len = 0;
+        bool ok;
+
+        if (raw_desc.format == UDP_FMT_JPEG) {
+            // 传感器已输出JPEG，直接复制
+            jpg_buf = malloc(raw_desc.len);
+            ok = (jpg_buf != NULL);
+            if (ok) {
+                memcpy(jpg_buf, raw_buf, raw_desc.len);
+                jpg_len = raw_desc.len;
+            }
+        } else {
+            ok = fmt2jpg(raw_buf, raw_desc.len, raw_desc.width, raw_desc.height,
+                         stream_pixformat(raw_desc.format), WIFI_HTTP_JPEG_QUALITY,
+                         &jpg_buf, &jpg_len);
+        }
+        raw_busy = false;  // 暂存区可以接收下一帧
+
+        if (!ok) {
+            ESP_LOGW(TAG, "JPEG encode failed");
+            free(jpg_buf);
+            continue;
+        }
+
+        shared_jpeg_t *frame = malloc(sizeof(shared_jpeg_t));
+        if (!frame) {
+            free(jpg_buf);
+            continue;
+        }
+        frame->buf = jpg_buf;
+        frame->len = jpg_len;
+        frame->seq = ++jpeg_seq;
+        frame->refs = 1;  // latest_jpeg持有的引用
+
+        stream_stats.frames_encoded++;
+        stream_stats.encode_time_us = (uint32_t)(esp_timer_get_time() - start_time);
+
+        // 替换最新帧并唤醒所有客户端
+        xSemaphoreTake(stream_mutex, portMAX_DELAY);
+        shared_jpeg_t *old = latest_jpeg;
+        latest_jpeg = frame;
+        for (int i = 0; i < WIFI_HTTP_MAX_CLIENTS; i++) {
+            if (client_tasks[i]) {
+                xTaskNotifyGive(client_tasks[i]);
+            }
+        }
+        xSemaphoreGive(stream_mutex);
+
+        stream_release(old);
+    }
+
+    ESP_LOGI(TAG, "Stream encoder task stopped");
+    encoder_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+// 发送一帧MJPEG分段
+static esp_err_t stream_send_frame(httpd_req_t *req, const shared_jpeg_t *frame)
+{
+    char part[64];
+
+    esp_err_t err = httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
+    if (err == ESP_OK) {
+        int len = snprintf(part, sizeof(part), STREAM_PART, (unsigned int)frame->len);
+        err = httpd_resp_send_chunk(req, part, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, (const char *)frame->buf, frame->len);
+    }
+    return err;
+}
+
+// 释放客户端槽位
+static void stream_release_slot(int slot)
+{
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    client_tasks[slot] = NULL;
+    client_used[slot] = false;
+    stream_stats.clients--;
+    xSemaphoreGive(stream_mutex);
+}
+
+// 客户端任务：每个浏览器一个任务，慢客户端只会跳帧，不会阻塞编码器和其他客户端
+static void stream_client_task(void *arg)
+{
+    stream_client_t *client = (stream_client_t *)arg;
+    httpd_req_t *req = client->req;
+    uint32_t last_seq = 0;
+    bool first_frame = true;
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    client_tasks[client->slot] = xTaskGetCurrentTaskHandle();
+    xSemaphoreGive(stream_mutex);
+
+    ESP_LOGI(TAG, "Stream client %d connected", client->slot);
+
+    httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    while (stream_running) {
+        // 多次通知会合并为一次，期间错过的帧直接跳过
+        if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000))) {
+            continue;
+        }
+
+        shared_jpeg_t *frame = stream_acquire_latest(last_seq);
+        if (!frame) {
+            continue;
+        }
+
+        if (!first_frame && frame->seq - last_seq > 1) {
+            stream_stats.frames_dropped += frame->seq - last_seq - 1;
+        }
+        last_seq = frame->seq;
+        first_frame = false;
+
+        esp_err_t err = stream_send_frame(req, frame);
+        stream_release(frame);
+
+        if (err != ESP_OK) {
+            ESP_LOGI(TAG, "Stream client %d disconnected", client->slot);
+            break;
+        }
+        stream_stats.frames_sent++;
+    }
+
+    httpd_req_async_handler_complete(req);
+    stream_release_slot(client->slot);
+
+    free(client);
+    vTaskDelete(NULL);
+}
+
+// GET /stream 处理函数：分配客户端槽位后转交给独立任务，释放HTTP服务器任务
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    int slot = -1;
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_HTTP_MAX_CLIENTS; i++) {
+        if (!client_used[i]) {
+            client_used[i] = true;
+            stream_stats.clients++;
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(stream_mutex);
+
+    if (slot < 0) {
+        ESP_LOGW(TAG, "Too many stream clients");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "Too many clients", HTTPD_RESP_USE_STRLEN);
+    }
+
+    stream_client_t *client = malloc(sizeof(stream_client_t));
+    httpd_req_t *async_req = NULL;
+    if (!client || httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start async stream handler");
+        free(client);
+        stream_release_slot(slot);
+        return ESP_FAIL;
+    }
+    client->req = async_req;
+    client->slot = slot;
+
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        stream_client_task,
+        "http_client",
+        4 * 1024,
+        client,
+        4,
+        NULL,
+        0
+    );
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create stream client task");
+        httpd_req_async_handler_complete(async_req);
+        free(client);
+        stream_release_slot(slot);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+// GET /snapshot：拍摄一张高分辨率JPEG并整张返回（在httpd任务中阻塞，视频流客户端各有独立任务不受影响）
+static esp_err_t snapshot_handler(httpd_req_t *req)
+{
+    // 取本地副本，发送期间回调被注销也能正确释放
+    wifi_http_snapshot_take_t take = snapshot_take;
+    wifi_http_snapshot_release_t release = snapshot_release;
+    if (!take) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Snapshot not available");
+        return ESP_FAIL;
+    }
+
+    wifi_http_snapshot_t snapshot;
+    if (!take(&snapshot, WIFI_HTTP_SNAPSHOT_TIMEOUT_MS)) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Snapshot failed");
+        return ESP_FAIL;
+    }
+
+    char size[16];
+    snprintf(size, sizeof(size), "%ux%u", snapshot.width, snapshot.height);
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=snapshot.jpg");
+    httpd_resp_set_hdr(req, "X-Snapshot-Size", size);
+    esp_err_t err = httpd_resp_send(req, (const char *)snapshot.data, snapshot.len);
+
+    if (release) {
+        release();
+    }
+    return err;
+}
+
+bool wifi_http_stream_start(uint16_t port)
+{
+    if (server) {
+        ESP_LOGW(TAG, "HTTP stream server already running");
+        return true;
+    }
+
+    if (!stream_mutex) {
+        stream_mutex = xSemaphoreCreateMutex();
+        if (!stream_mutex) {
+            ESP_LOGE(TAG, "Failed to create stream mutex");
+            return false;
+        }
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.ctrl_port = port + 1;
+    config.max_open_sockets = WIFI_HTTP_MAX_CLIENTS + 2;  // 额外用于拒绝多余客户端和快照请求
+    config.send_wait_timeout = WIFI_HTTP_SEND_TIMEOUT_S;
+    config.lru_purge_enable = true;
+    config.core_id = 0;
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start HTTP server: %s", esp_err_to_name(err));
+        server = NULL;
+        return false;
+    }
+
+    const httpd_uri_t stream_uri = {
+        .uri = "/stream",
+        .method = HTTP_GET,
+        .handler = stream_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &stream_uri);
+
+    const httpd_uri_t snapshot_uri = {
+        .uri = "/snapshot",
+        .method = HTTP_GET,
+        .handler = snapshot_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &snapshot_uri);
+
+    stream_running = true;
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        stream_encoder_task,
+        "http_encoder",
+        4 * 1024,
+        NULL,
+        4,
+        &encoder_task_handle,
+        0
+    );
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create stream encoder task");
+        stream_running = false;
+        httpd_stop(server);
+        server = NULL;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "HTTP MJPEG stream started on port %d (GET /stream)", port);
+    return true;
+}
+
+bool wifi_http_stream_stop(void)
+{
+    if (!server) {
+        ESP_LOGW(TAG, "HTTP stream server not running");
+        return true;
+    }
+
+    ESP_LOGI(TAG, "Stopping HTTP stream server...");
+
+    stream_running = false;
+    if (encoder_task_handle) {
+        xTaskNotifyGive(encoder_task_handle);
+    }
+
+    // 等待客户端任务退出（每个任务最多阻塞一次发送超时）
+    for (int i = 0; i < (WIFI_HTTP_SEND_TIMEOUT_S + 1) * 10 && stream_stats.clients > 0; i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    httpd_stop(server);
+    server = NULL;
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    shared_jpeg_t *old = latest_jpeg;
+    latest_jpeg = NULL;
+    xSemaphoreGive(stream_mutex);
+    stream_release(old);
+
+    ESP_LOGI(TAG, "HTTP stream server stopped");
+    return true;
+}
+
+void wifi_http_set_snapshot_handler(wifi_http_snapshot_take_t take, wifi_http_snapshot_release_t release)
+{
+    snapshot_take = take;
+    snapshot_release = release;
+}
+
+void wifi_http_stream_publish(const wifi_frame_desc_t* frame)
+{
+    // 没有观看者时不做任何拷贝/编码
+    if (!stream_running || stream_stats.clients == 0 || !frame || !frame->data) {
+        return;
+    }
+
+    // 编码器还在处理上一帧，直接跳过，保证采集任务不被阻塞
+    if (raw_busy) {
+        stream_stats.frames_skipped++;
+        return;
+    }
+
+    size_t len = wifi_frame_packed_size(frame);
+    if (len > raw_capacity) {
+        heap_caps_free(raw_buf);
+        raw_buf = heap_caps_malloc(len, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        raw_capacity = raw_buf ? len : 0;
+        if (!raw_buf) {
+            ESP_LOGE(TAG, "Memory for stream frame is not enough");
+            return;
+        }
+    }
+
+    // fmt2jpg要求紧凑排列，ROI裁剪的帧在这里去掉stride
+    raw_desc = *frame;
+    raw_desc.len = wifi_frame_copy_packed(frame, raw_buf);
+    if (raw_desc.len != frame->len) {
+        raw_desc.stride = raw_desc.len / frame->height;
+    }
+    raw_desc.data = raw_buf;
+    raw_busy = true;
+
+    xTaskNotifyGive(encoder_task_handle);
+}
+
+bool wifi_http_stream_get_stats(wifi_http_stats_t* stats)
+{
+    if (!stats) {
+        return false;
+    }
+
+    *stats = stream_stats;
+    return true;
+}
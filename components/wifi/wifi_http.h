@@ -0,0 +1,81 @@
+#ifndef WIFI_HTTP_H
+#define WIFI_HTTP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// WiFi HTTP 视频流头文件
+// 设备端直接提供MJPEG流，浏览器无需经过Python中转
+
+#define WIFI_HTTP_PORT 80
+#define WIFI_HTTP_MAX_CLIENTS 4          // 同时观看的浏览器数量上限
+#define WIFI_HTTP_JPEG_QUALITY 80        // RGB565帧编码JPEG的质量
+#define WIFI_HTTP_SEND_TIMEOUT_S 2       // 单次发送超时，超过则断开该客户端
+
+#define WIFI_HTTP_SNAPSHOT_TIMEOUT_MS 5000   // 等待高分辨率快照的超时
+
+// 高分辨率快照（JPEG）
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+} wifi_http_snapshot_t;
+
+// 快照回调：take阻塞直到快照完成并保持数据有效，发送完成后调用release
+typedef bool (*wifi_http_snapshot_take_t)(wifi_http_snapshot_t* snapshot, uint32_t timeout_ms);
+typedef void (*wifi_http_snapshot_release_t)(void);
+
+// HTTP视频流统计信息
+typedef struct {
+    uint8_t clients;            // 当前客户端数
+    uint32_t frames_encoded;    // 已编码帧数（每帧只编码一次，所有客户端共享）
+    uint32_t frames_skipped;    // 编码器忙时跳过的采集帧数
+    uint32_t frames_sent;       // 所有客户端累计发送帧数
+    uint32_t frames_dropped;    // 慢客户端跳过的帧数
+    uint32_t encode_time_us;    // 最近一帧编码耗时
+} wifi_http_stats_t;
+
+/**
+ * @brief 启动HTTP MJPEG视频流服务器（GET /stream）
+ * @param port HTTP端口
+ * @return true 成功，false 失败
+ */
+bool wifi_http_stream_start(uint16_t port);
+
+/**
+ * @brief 停止HTTP视频流服务器
+ * @return true 成功，false 失败
+ */
+bool wifi_http_stream_stop(void);
+
+/**
+ * @brief 发布一帧到HTTP视频流（在采集任务中调用，不阻塞）
+ * @param frame 帧描述，函数返回后即可归还帧缓冲区
+ */
+void wifi_http_stream_publish(const wifi_frame_desc_t* frame);
+
+/**
+ * @brief 注册快照回调，启用 GET /snapshot（通过TCP可靠传输整张JPEG）
+ * @param take 拍摄快照
+ * @param release 释放快照数据
+ */
+void wifi_http_set_snapshot_handler(wifi_http_snapshot_take_t take, wifi_http_snapshot_release_t release);
+
+/**
+ * @brief 获取HTTP视频流统计信息
+ * @param stats 统计信息输出
+ * @return true 成功，false 失败
+ */
+bool wifi_http_stream_get_stats(wifi_http_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WIFI_HTTP_H
@@ -0,0 +1,95 @@
+// FPV主机接收程序：用 host/fpvrx.c 接收设备视频流，帧写入共享内存供其他程序读取
+//
+// 编译:
+//   gcc -O2 -Wall -I host/include -I components/wifi -o fpv_rx host/fpv_rx.c host/fpvrx.c -lrt
+// 运行:
+//   ./fpv_rx [设备IP] [共享内存名称] [每批数据报数]
+//   python3 python/fpv_shm.py /fpv          # 另一个终端：numpy零拷贝读取并用OpenCV显示
+//
+// 发送HELLO订阅视频流（未指定设备IP时使用第一个帧来源）并发送时钟同步PING，
+// 每5秒输出每秒数据报数、帧数、丢帧/乱序和本进程CPU占用。
+
+#include "fpvrx.h"
+#include "esp_log.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static const char *TAG = "fpv_rx";
+
+#define STATS_INTERVAL_US 5000000
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t cpu_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+    fpvrx_config_t config = {
+        .device_ip = argc > 1 ? argv[1] : NULL,
+        .shm_name = argc > 2 ? argv[2] : "/fpv",
+        .batch = argc > 3 ? (uint32_t)atoi(argv[3]) : FPVRX_DEFAULT_BATCH,
+        .frame_divider = 1,
+    };
+    fpvrx_t *rx = fpvrx_open(&config);
+    if (!rx) {
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    fpvrx_stats_t last = { 0 };
+    int64_t last_time = now_us();
+    int64_t last_cpu = cpu_us();
+    while (running) {
+        if (fpvrx_poll(rx, 100) < 0) {
+            break;
+        }
+        int64_t now = now_us();
+        if (now - last_time < STATS_INTERVAL_US) {
+            continue;
+        }
+        fpvrx_stats_t stats;
+        fpvrx_get_stats(rx, &stats);
+        int64_t cpu = cpu_us();
+        double sec = (now - last_time) / 1e6;
+        uint64_t packets = stats.packets - last.packets;
+        uint64_t batches = stats.batches - last.batches;
+        uint64_t frames = stats.frames - last.frames;
+        ESP_LOGI(TAG, "%.0f pkt/s, %.1f fps, %.2f MB/s, %.1f pkt/batch, lost %llu, reordered %llu, bad %llu, overflow %llu, "
+                 "recorded %llu, decode %.0f us/frame, CPU %.1f%%",
+                 packets / sec, frames / sec, (stats.bytes - last.bytes) / sec / 1e6,
+                 batches ? (double)packets / batches : 0.0, (unsigned long long)stats.frames_lost,
+                 (unsigned long long)stats.frames_reordered, (unsigned long long)stats.bad_packets,
+                 (unsigned long long)stats.rx_overflow,
+                 (unsigned long long)stats.recorded,
+                 frames ? (stats.decode_ns - last.decode_ns) / 1e3 / frames : 0.0,
+                 (cpu - last_cpu) / 1e4 / sec);
+        last = stats;
+        last_time = now;
+        last_cpu = cpu;
+    }
+
+    fpvrx_close(rx);
+    return 0;
+}
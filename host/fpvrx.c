@@ -0,0 +1,669 @@
+#define _GNU_SOURCE
+#include "fpvrx.h"
+#include "esp_log.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *TAG = "fpvrx";
+
+#define FPVRX_ALIGN(x) (((x) + 63) & ~(size_t)63)
+#define FPVRX_V2_HEADER_SIZE UDP_FRAME_V2_BASE_SIZE   // 旧固件没有device_id字段
+#define FPVRX_V1_HEADER_SIZE offsetof(udp_frame_t, data)
+#define FPVRX_RCVBUF (64 * 1024 * 1024)     // 与Python接收端一致，实际上限受net.core.rmem_max限制
+#define FPVRX_CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+#define FPVRX_BATCH_BYTES (256 * 1024)      // 一批数据报总量上限，批内数据在解码前仍留在L2缓存中
+
+struct fpvrx {
+    fpvrx_config_t config;
+    char shm_name[64];
+    int sock;
+    struct sockaddr_in device;
+    bool device_known;
+
+    // 输出区域：共享内存（或shm_name为NULL时的匿名映射）
+    uint8_t *region;
+    size_t region_size;
+    fpvrx_shm_header_t *header;
+    uint8_t *scratch;               // 预录导出帧的解码缓冲区（不发布到共享内存）
+
+    // recvmmsg批量接收缓冲区
+    uint32_t batch;
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    struct sockaddr_in *addrs;
+    uint8_t *buffers;
+    uint8_t *controls;              // 每个数据报的控制消息缓冲区（SO_RXQ_OVFL）
+    uint32_t max_len;               // 收到过的最大数据报，用于按字节数限制每批数量
+
+    // 序号跟踪（仅v2帧头）
+    bool have_seq;
+    uint32_t last_seq;
+
+    // HELLO/PING
+    uint32_t ping_seq;
+    int64_t next_hello_us;
+    int64_t next_ping_us;
+
+    fpvrx_stats_t stats;
+    fpvrx_frame_cb_t cb;
+    void *cb_ctx;
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 本线程CPU时间（纳秒），解码耗时不计入被其他线程抢占的时间
+static int64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline fpvrx_slot_t *slot_at(const fpvrx_shm_header_t *header, uint32_t index)
+{
+    return (fpvrx_slot_t *)((uint8_t *)header + header->header_size + (size_t)index * header->slot_size);
+}
+
+static inline uint8_t *slot_data(fpvrx_slot_t *slot)
+{
+    return (uint8_t *)slot + FPVRX_ALIGN(sizeof(fpvrx_slot_t));
+}
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+void fpvrx_decode_rgb565(const uint8_t *src, size_t src_stride, uint16_t width, uint16_t height,
+                         bool big_endian, uint8_t *dst)
+{
+    // 与Python接收端相同的展开方式（分量左移补零），两边解码结果逐字节一致
+    for (uint16_t y = 0; y < height; y++) {
+        const uint8_t *s = src + (size_t)y * src_stride;
+        uint8_t *d = dst + (size_t)y * width * 3;
+        if (big_endian) {
+            for (uint16_t x = 0; x < width; x++, s += 2, d += 3) {
+                uint16_t v = (uint16_t)((s[0] << 8) | s[1]);
+                d[0] = (uint8_t)((v & 0x1F) << 3);
+                d[1] = (uint8_t)(((v >> 5) & 0x3F) << 2);
+                d[2] = (uint8_t)((v >> 11) << 3);
+            }
+        } else {
+            for (uint16_t x = 0; x < width; x++, s += 2, d += 3) {
+                uint16_t v = (uint16_t)(s[0] | (s[1] << 8));
+                d[0] = (uint8_t)((v & 0x1F) << 3);
+                d[1] = (uint8_t)(((v >> 5) & 0x3F) << 2);
+                d[2] = (uint8_t)((v >> 11) << 3);
+            }
+        }
+    }
+}
+
+// 按格式计算负载应有的长度，JPEG等变长格式返回0
+static size_t payload_size(uint8_t format, uint16_t width, uint16_t height, uint16_t stride)
+{
+    switch (format) {
+    case UDP_FMT_RGB565:
+    case UDP_FMT_YUV422:
+    case UDP_FMT_GRAY:
+        return (size_t)stride * height;
+    case UDP_FMT_YUV420:
+        return (size_t)width * height + 2 * ((size_t)(width / 2) * (height / 2));
+    default:
+        return 0;
+    }
+}
+
+// 解析帧头并校验长度，成功时填好slot元数据（generation除外）并返回负载指针
+static const uint8_t *parse_frame(const uint8_t *data, size_t len, fpvrx_slot_t *meta)
+{
+    if (len < FPVRX_V1_HEADER_SIZE || read_u16(data) != UDP_MAGIC_NUMBER) {
+        return NULL;
+    }
+    uint16_t width = read_u16(data + offsetof(udp_frame_t, width));
+    uint16_t height = read_u16(data + offsetof(udp_frame_t, height));
+    memset(meta, 0, sizeof(*meta));
+    meta->width = width;
+    meta->height = height;
+
+    // v1帧：头部后紧跟大端RGB565整帧
+    if (len == FPVRX_V1_HEADER_SIZE + (size_t)width * height * 2) {
+        meta->version = UDP_FRAME_VERSION_1;
+        meta->format = UDP_FMT_RGB565;
+        meta->flags = UDP_FLAG_BIG_ENDIAN;
+        meta->stride = width * 2;
+        meta->len = (uint32_t)(len - FPVRX_V1_HEADER_SIZE);
+        return data + FPVRX_V1_HEADER_SIZE;
+    }
+
+    if (len < FPVRX_V2_HEADER_SIZE) {
+        return NULL;
+    }
+    // 帧头含device_id时一起读出，旧固件的24字节帧头device_id为0
+    udp_frame_v2_t hdr = { 0 };
+    bool has_id = data[offsetof(udp_frame_v2_t, header_size)] >= UDP_FRAME_V2_ID_SIZE && len >= UDP_FRAME_V2_ID_SIZE;
+    memcpy(&hdr, data, has_id ? UDP_FRAME_V2_ID_SIZE : FPVRX_V2_HEADER_SIZE);
+    if (hdr.version < UDP_FRAME_VERSION_2 || hdr.header_size < FPVRX_V2_HEADER_SIZE || hdr.header_size > len) {
+        return NULL;
+    }
+    meta->version = hdr.version;
+    meta->seq = hdr.seq;
+    meta->timestamp_us = hdr.timestamp_us;
+    meta->format = hdr.format;
+    meta->flags = hdr.flags;
+    meta->stride = hdr.stride;
+    meta->device_id = hdr.device_id;
+    meta->len = (uint32_t)(len - hdr.header_size);
+
+    size_t expected = payload_size(hdr.format, width, height, hdr.stride);
+    if (hdr.format == UDP_FMT_JPEG) {
+        if (meta->len == 0) {
+            return NULL;
+        }
+    } else if (expected == 0 || meta->len != expected) {
+        return NULL;
+    }
+    if (hdr.format == UDP_FMT_RGB565 && hdr.stride < width * 2) {
+        return NULL;
+    }
+    return data + hdr.header_size;
+}
+
+// 负载写入输出缓冲区（RGB565解码为BGR24），返回false表示放不下
+static bool output_frame(fpvrx_t *rx, fpvrx_slot_t *meta, const uint8_t *payload, uint8_t *dst)
+{
+    size_t capacity = rx->header->slot_data_size;
+    if (meta->format == UDP_FMT_RGB565 && !rx->config.raw_rgb565) {
+        size_t size = (size_t)meta->width * meta->height * 3;
+        if (size > capacity) {
+            return false;
+        }
+        int64_t start = thread_cpu_ns();
+        fpvrx_decode_rgb565(payload, meta->stride, meta->width, meta->height,
+                            meta->flags & UDP_FLAG_BIG_ENDIAN, dst);
+        rx->stats.decode_ns += thread_cpu_ns() - start;
+        meta->format = FPVRX_FMT_BGR24;
+        meta->channels = 3;
+        meta->stride = meta->width * 3;
+        meta->len = (uint32_t)size;
+        return true;
+    }
+    if (meta->len > capacity) {
+        return false;
+    }
+    memcpy(dst, payload, meta->len);
+    meta->channels = meta->format == UDP_FMT_GRAY ? 1 : 0;
+    return true;
+}
+
+// 根据序号统计丢帧/乱序（与Python接收端相同的规则）
+static void track_sequence(fpvrx_t *rx, uint32_t seq)
+{
+    if (rx->have_seq) {
+        uint32_t gap = seq - rx->last_seq;
+        if (gap == 0 || gap > 0x7FFFFFFF) {
+            // 序号回退：乱序或重复，丢弃的帧已计入丢失，这里回补
+            rx->stats.frames_reordered++;
+            if (rx->stats.frames_lost > 0) {
+                rx->stats.frames_lost--;
+            }
+            return;
+        }
+        rx->stats.frames_lost += gap - 1;
+    }
+    rx->have_seq = true;
+    rx->last_seq = seq;
+}
+
+static void publish_frame(fpvrx_t *rx, const fpvrx_slot_t *meta, const uint8_t *payload)
+{
+    fpvrx_shm_header_t *header = rx->header;
+    uint64_t generation = header->frames_published + 1;
+    fpvrx_slot_t *slot = slot_at(header, (uint32_t)((generation - 1) % header->slot_count));
+
+    // 先标记正在写入，读取方据此发现数据被覆盖
+    __atomic_store_n(&slot->generation, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    fpvrx_slot_t out = *meta;
+    if (!output_frame(rx, &out, payload, slot_data(slot))) {
+        rx->stats.bad_packets++;
+        return;
+    }
+    out.generation = 0;
+    *slot = out;
+    __atomic_store_n(&slot->generation, generation, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->frames_published, generation, __ATOMIC_RELEASE);
+    rx->stats.frames++;
+
+    if (rx->cb) {
+        rx->cb(slot, slot_data(slot), rx->cb_ctx);
+    }
+}
+
+static void handle_ctrl(fpvrx_t *rx, const uint8_t *data, size_t len, int64_t recv_us)
+{
+    rx->stats.ctrl_packets++;
+    if (len < sizeof(udp_ctrl_sync_t) || data[offsetof(udp_ctrl_t, type)] != UDP_CTRL_PONG) {
+        return;
+    }
+    udp_ctrl_sync_t pong;
+    memcpy(&pong, data, sizeof(pong));
+    fpvrx_shm_header_t *header = rx->header;
+    fpvrx_sync_sample_t *sample = &header->sync[header->sync_count % FPVRX_SYNC_SAMPLES];
+    sample->t1_us = pong.t1_us;
+    sample->t2_us = pong.t2_us;
+    sample->t3_us = pong.t3_us;
+    sample->t4_us = (uint64_t)recv_us;
+    __atomic_store_n(&header->sync_count, header->sync_count + 1, __ATOMIC_RELEASE);
+}
+
+static void handle_datagram(fpvrx_t *rx, const uint8_t *data, size_t len, const struct sockaddr_in *from,
+                            int64_t recv_us)
+{
+    rx->stats.packets++;
+    rx->stats.bytes += len;
+
+    if (rx->device_known && rx->config.device_ip && from->sin_addr.s_addr != rx->device.sin_addr.s_addr) {
+        rx->stats.bad_packets++;    // 不是期望的设备
+        return;
+    }
+    if (len >= sizeof(udp_ctrl_t) && read_u16(data) == UDP_CTRL_MAGIC) {
+        handle_ctrl(rx, data, len, recv_us);
+        return;
+    }
+
+    fpvrx_slot_t meta;
+    const uint8_t *payload = parse_frame(data, len, &meta);
+    if (!payload) {
+        rx->stats.bad_packets++;
+        return;
+    }
+    if (!rx->device_known) {
+        rx->device = *from;
+        rx->device_known = true;
+        ESP_LOGI(TAG, "Device %s:%u", inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+    }
+    meta.recv_us = (uint64_t)recv_us;
+
+    // 预录导出帧不属于实时流：不参与序号统计，只交给回调
+    if (meta.flags & UDP_FLAG_RECORDED) {
+        rx->stats.recorded++;
+        if (!output_frame(rx, &meta, payload, rx->scratch)) {
+            rx->stats.bad_packets++;
+            return;
+        }
+        if (rx->cb) {
+            rx->cb(&meta, rx->scratch, rx->cb_ctx);
+        }
+        return;
+    }
+
+    if (meta.version >= UDP_FRAME_VERSION_2) {
+        track_sequence(rx, meta.seq);
+    }
+    publish_frame(rx, &meta, payload);
+}
+
+static void send_ctrl(fpvrx_t *rx, int64_t now)
+{
+    if (rx->config.no_ctrl || !rx->device_known) {
+        return;
+    }
+    if (now >= rx->next_hello_us) {
+        udp_ctrl_hello_t hello = {
+            .hdr = { .magic = UDP_CTRL_MAGIC, .type = UDP_CTRL_HELLO, .version = UDP_FRAME_VERSION_MAX },
+            .frame_divider = rx->config.frame_divider,
+        };
+        if (sendto(rx->sock, &hello, sizeof(hello), 0, (struct sockaddr *)&rx->device, sizeof(rx->device)) < 0) {
+            ESP_LOGD(TAG, "HELLO failed: %s", strerror(errno));
+        }
+        rx->next_hello_us = now + FPVRX_HELLO_INTERVAL_MS * 1000;
+    }
+    if (now >= rx->next_ping_us) {
+        udp_ctrl_sync_t ping = {
+            .hdr = { .magic = UDP_CTRL_MAGIC, .type = UDP_CTRL_PING, .version = UDP_FRAME_VERSION_MAX },
+            .seq = ++rx->ping_seq,
+            .t1_us = (uint64_t)now,
+        };
+        if (sendto(rx->sock, &ping, sizeof(ping), 0, (struct sockaddr *)&rx->device, sizeof(rx->device)) < 0) {
+            ESP_LOGD(TAG, "PING failed: %s", strerror(errno));
+        }
+        rx->next_ping_us = now + FPVRX_PING_INTERVAL_MS * 1000;
+    }
+}
+
+static bool open_region(fpvrx_t *rx, uint32_t slots)
+{
+    size_t header_size = FPVRX_ALIGN(sizeof(fpvrx_shm_header_t));
+    size_t slot_size = FPVRX_ALIGN(sizeof(fpvrx_slot_t)) + FPVRX_ALIGN(FPVRX_SLOT_DATA_SIZE);
+    rx->region_size = header_size + slot_size * slots;
+
+    void *base;
+    if (rx->shm_name[0]) {
+        int fd = shm_open(rx->shm_name, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            ESP_LOGE(TAG, "shm_open %s failed: %s", rx->shm_name, strerror(errno));
+            return false;
+        }
+        if (ftruncate(fd, (off_t)rx->region_size) < 0) {
+            ESP_LOGE(TAG, "ftruncate %s failed: %s", rx->shm_name, strerror(errno));
+            close(fd);
+            shm_unlink(rx->shm_name);
+            return false;
+        }
+        base = mmap(NULL, rx->region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        base = mmap(NULL, rx->region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (base == MAP_FAILED) {
+        ESP_LOGE(TAG, "mmap failed: %s", strerror(errno));
+        if (rx->shm_name[0]) {
+            shm_unlink(rx->shm_name);
+        }
+        return false;
+    }
+    rx->region = base;
+    memset(rx->region, 0, rx->region_size);
+
+    // 头部最后写魔数，读取方看到魔数时其他字段已初始化
+    fpvrx_shm_header_t *header = base;
+    header->version = FPVRX_SHM_VERSION;
+    header->header_size = (uint32_t)header_size;
+    header->slot_count = slots;
+    header->slot_size = (uint32_t)slot_size;
+    header->slot_data_size = FPVRX_SLOT_DATA_SIZE;
+    header->writer_pid = (uint32_t)getpid();
+    __atomic_store_n(&header->magic, FPVRX_SHM_MAGIC, __ATOMIC_RELEASE);
+    rx->header = header;
+    return true;
+}
+
+fpvrx_t *fpvrx_open(const fpvrx_config_t *config)
+{
+    fpvrx_t *rx = calloc(1, sizeof(*rx));
+    if (!rx) {
+        return NULL;
+    }
+    rx->config = *config;
+    rx->sock = -1;
+    rx->batch = config->batch ? config->batch : FPVRX_DEFAULT_BATCH;
+    if (rx->batch > FPVRX_MAX_BATCH) {
+        rx->batch = FPVRX_MAX_BATCH;
+    }
+    uint32_t slots = config->slots ? config->slots : FPVRX_DEFAULT_SLOTS;
+    if (config->shm_name) {
+        snprintf(rx->shm_name, sizeof(rx->shm_name), "%s%s", config->shm_name[0] == '/' ? "" : "/",
+                 config->shm_name);
+    }
+
+    rx->msgs = calloc(rx->batch, sizeof(*rx->msgs));
+    rx->iov = calloc(rx->batch, sizeof(*rx->iov));
+    rx->addrs = calloc(rx->batch, sizeof(*rx->addrs));
+    rx->buffers = malloc((size_t)rx->batch * FPVRX_DATAGRAM_SIZE);
+    rx->controls = calloc(rx->batch, FPVRX_CONTROL_SIZE);
+    rx->scratch = malloc(FPVRX_SLOT_DATA_SIZE);
+    if (!rx->msgs || !rx->iov || !rx->addrs || !rx->buffers || !rx->controls || !rx->scratch ||
+        !open_region(rx, slots)) {
+        fpvrx_close(rx);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < rx->batch; i++) {
+        rx->iov[i].iov_base = rx->buffers + (size_t)i * FPVRX_DATAGRAM_SIZE;
+        rx->iov[i].iov_len = FPVRX_DATAGRAM_SIZE;
+        rx->msgs[i].msg_hdr.msg_iov = &rx->iov[i];
+        rx->msgs[i].msg_hdr.msg_iovlen = 1;
+        rx->msgs[i].msg_hdr.msg_name = &rx->addrs[i];
+        rx->msgs[i].msg_hdr.msg_control = rx->controls + (size_t)i * FPVRX_CONTROL_SIZE;
+    }
+
+    rx->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx->sock < 0) {
+        ESP_LOGE(TAG, "socket failed: %s", strerror(errno));
+        fpvrx_close(rx);
+        return NULL;
+    }
+    // 接收缓冲区：请求值受net.core.rmem_max限制，读回实际大小，太小时突发会被内核丢弃
+    int rcvbuf = FPVRX_RCVBUF;
+    setsockopt(rx->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    socklen_t optlen = sizeof(rcvbuf);
+    if (getsockopt(rx->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen) == 0) {
+        rx->stats.rcvbuf = (uint32_t)rcvbuf;
+        if (rcvbuf < FPVRX_RCVBUF) {
+            ESP_LOGW(TAG, "Receive buffer limited to %d KB (raise net.core.rmem_max to %d KB)", rcvbuf / 1024,
+                     FPVRX_RCVBUF / 1024);
+        }
+    }
+    // 每个数据报附带内核因接收缓冲区满丢弃的累计数
+    int ovfl = 1;
+    if (setsockopt(rx->sock, SOL_SOCKET, SO_RXQ_OVFL, &ovfl, sizeof(ovfl)) < 0) {
+        ESP_LOGW(TAG, "SO_RXQ_OVFL not supported, receive overflow not counted");
+    }
+    int reuse = 1;
+    setsockopt(rx->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config->port ? config->port : UDP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (config->bind_ip && inet_pton(AF_INET, config->bind_ip, &addr.sin_addr) != 1) {
+        ESP_LOGE(TAG, "Invalid bind address %s", config->bind_ip);
+        fpvrx_close(rx);
+        return NULL;
+    }
+    if (bind(rx->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "bind port %u failed: %s", ntohs(addr.sin_port), strerror(errno));
+        fpvrx_close(rx);
+        return NULL;
+    }
+
+    if (config->device_ip) {
+        rx->device.sin_family = AF_INET;
+        rx->device.sin_port = htons(UDP_PORT);
+        if (inet_pton(AF_INET, config->device_ip, &rx->device.sin_addr) != 1) {
+            ESP_LOGE(TAG, "Invalid device address %s", config->device_ip);
+            fpvrx_close(rx);
+            return NULL;
+        }
+        rx->device_known = true;
+    }
+
+    ESP_LOGI(TAG, "Listening on port %u, batch %u, %u slots x %u bytes%s%s", ntohs(addr.sin_port), rx->batch,
+             slots, rx->header->slot_size, rx->shm_name[0] ? ", shm " : "", rx->shm_name);
+    return rx;
+}
+
+void fpvrx_set_callback(fpvrx_t *rx, fpvrx_frame_cb_t cb, void *ctx)
+{
+    rx->cb = cb;
+    rx->cb_ctx = ctx;
+}
+
+int fpvrx_poll(fpvrx_t *rx, int timeout_ms)
+{
+    int64_t now = now_us();
+    send_ctrl(rx, now);
+
+    // 等待时间不超过下一次HELLO/PING
+    int wait_ms = timeout_ms;
+    if (!rx->config.no_ctrl && rx->device_known) {
+        int64_t next = rx->next_ping_us < rx->next_hello_us ? rx->next_ping_us : rx->next_hello_us;
+        int64_t until = (next - now + 999) / 1000;
+        if (until < wait_ms) {
+            wait_ms = until > 0 ? (int)until : 0;
+        }
+    }
+
+    struct pollfd pfd = { .fd = rx->sock, .events = POLLIN };
+    int ready = poll(&pfd, 1, wait_ms);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        ESP_LOGE(TAG, "poll failed: %s", strerror(errno));
+        return -1;
+    }
+    if (ready == 0) {
+        send_ctrl(rx, now_us());
+        return 0;
+    }
+
+    // 大数据报时少取几个：整批拷贝超出L2后，解码时再读一遍的开销超过省下的系统调用
+    uint32_t batch = rx->batch;
+    if (rx->max_len && batch > FPVRX_BATCH_BYTES / rx->max_len) {
+        batch = FPVRX_BATCH_BYTES / rx->max_len > 1 ? FPVRX_BATCH_BYTES / rx->max_len : 1;
+    }
+    for (uint32_t i = 0; i < batch; i++) {
+        rx->msgs[i].msg_hdr.msg_namelen = sizeof(rx->addrs[i]);
+        rx->msgs[i].msg_hdr.msg_controllen = FPVRX_CONTROL_SIZE;
+        rx->msgs[i].msg_len = 0;
+    }
+    int n = recvmmsg(rx->sock, rx->msgs, batch, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        ESP_LOGE(TAG, "recvmmsg failed: %s", strerror(errno));
+        return -1;
+    }
+    // 同一批数据报共用一个接收时间戳（批内相隔不超过一次系统调用）
+    int64_t recv_us = now_us();
+    rx->stats.batches++;
+    for (int i = 0; i < n; i++) {
+        if (rx->msgs[i].msg_len > rx->max_len) {
+            rx->max_len = rx->msgs[i].msg_len;
+        }
+        handle_datagram(rx, rx->iov[i].iov_base, rx->msgs[i].msg_len, &rx->addrs[i], recv_us);
+    }
+    // 丢弃计数是累计值（只在有丢弃后出现），取本批最后一个数据报的
+    struct msghdr *last = &rx->msgs[n - 1].msg_hdr;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(last); cmsg; cmsg = CMSG_NXTHDR(last, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t dropped;
+            memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+            rx->stats.rx_overflow = dropped;
+        }
+    }
+
+    fpvrx_shm_header_t *header = rx->header;
+    header->packets = rx->stats.packets;
+    header->bytes = rx->stats.bytes;
+    header->frames_lost = rx->stats.frames_lost;
+    header->frames_reordered = rx->stats.frames_reordered;
+    header->bad_packets = rx->stats.bad_packets;
+    send_ctrl(rx, recv_us);
+    return n;
+}
+
+void fpvrx_get_stats(const fpvrx_t *rx, fpvrx_stats_t *stats)
+{
+    *stats = rx->stats;
+}
+
+void fpvrx_close(fpvrx_t *rx)
+{
+    if (!rx) {
+        return;
+    }
+    if (rx->sock >= 0) {
+        close(rx->sock);
+    }
+    if (rx->region) {
+        munmap(rx->region, rx->region_size);
+        if (rx->shm_name[0]) {
+            shm_unlink(rx->shm_name);
+        }
+    }
+    free(rx->msgs);
+    free(rx->iov);
+    free(rx->addrs);
+    free(rx->buffers);
+    free(rx->controls);
+    free(rx->scratch);
+    free(rx);
+}
+
+bool fpvrx_reader_open(fpvrx_reader_t *reader, const char *shm_name)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s", shm_name[0] == '/' ? "" : "/", shm_name);
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = shm_open(name, O_RDONLY, 0);
+    if (reader->fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(reader->fd, &st) < 0 || (size_t)st.st_size < sizeof(fpvrx_shm_header_t)) {
+        close(reader->fd);
+        return false;
+    }
+    reader->size = (size_t)st.st_size;
+    reader->base = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (reader->base == MAP_FAILED) {
+        close(reader->fd);
+        return false;
+    }
+    const fpvrx_shm_header_t *header = reader->base;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != FPVRX_SHM_MAGIC ||
+        header->version != FPVRX_SHM_VERSION ||
+        (size_t)header->header_size + (size_t)header->slot_count * header->slot_size > reader->size) {
+        ESP_LOGE(TAG, "%s is not a compatible frame ring", name);
+        fpvrx_reader_close(reader);
+        return false;
+    }
+    reader->header = header;
+    return true;
+}
+
+const fpvrx_slot_t *fpvrx_reader_latest(const fpvrx_reader_t *reader, uint64_t *generation, const uint8_t **data)
+{
+    const fpvrx_shm_header_t *header = reader->header;
+    uint64_t published = __atomic_load_n(&header->frames_published, __ATOMIC_ACQUIRE);
+    if (published == 0) {
+        return NULL;
+    }
+    fpvrx_slot_t *slot = slot_at(header, (uint32_t)((published - 1) % header->slot_count));
+    uint64_t gen = __atomic_load_n(&slot->generation, __ATOMIC_ACQUIRE);
+    if (gen == 0) {
+        return NULL;    // 写入方正在覆盖该slot（读取方落后一整圈）
+    }
+    *generation = gen;
+    *data = slot_data(slot);
+    return slot;
+}
+
+bool fpvrx_reader_valid(const fpvrx_slot_t *slot, uint64_t generation)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->generation, __ATOMIC_RELAXED) == generation;
+}
+
+void fpvrx_reader_close(fpvrx_reader_t *reader)
+{
+    if (reader->base && reader->base != MAP_FAILED) {
+        munmap(reader->base, reader->size);
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    reader->base = NULL;
+    reader->header = NULL;
+    reader->fd = -1;
+}
@@ -0,0 +1,211 @@
+#ifndef FPVRX_H
+#define FPVRX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// FPV主机接收库头文件（Linux）
+// 帧头定义直接使用 components/wifi/wifi.h；recvmmsg批量接收，整帧校验、序号跟踪、RGB565解码为BGR24，
+// 把完整帧写入POSIX共享内存环形缓冲区（/dev/shm/<名称>），Python（python/fpv_shm.py，numpy视图）、
+// OpenCV工具和录制程序直接映射读取，不再拷贝。同时代替Python接收端发送HELLO和时钟同步PING。
+//
+// 设备每帧发送一个UDP数据报，由IP层分片/重组，接收端收到的总是整帧或收不到；
+// 这里的"重组"是按帧头校验长度、格式和序号，把数据报整理成带元数据的帧。
+//
+// 共享内存布局（所有字段为本机字节序，Python端按同样布局解析）：
+//   fpvrx_shm_header_t | slot 0 | slot 1 | ... （每个slot为 fpvrx_slot_t + 数据区，64字节对齐）
+// 写入顺序：slot.generation置0 -> 写数据和元数据 -> slot.generation置为帧号 -> header.frames_published加1
+// 读取方：读generation（非0）-> 使用数据 -> 再读generation，两次相同说明读取期间没有被覆盖
+
+#define FPVRX_SHM_MAGIC 0x52565046          // "FPVR"
+#define FPVRX_SHM_VERSION 1
+#define FPVRX_DEFAULT_SLOTS 8
+#define FPVRX_DEFAULT_BATCH 16              // 每次recvmmsg最多接收的数据报数
+#define FPVRX_MAX_BATCH 64
+#define FPVRX_DATAGRAM_SIZE 65536
+#define FPVRX_SLOT_DATA_SIZE (FPVRX_DATAGRAM_SIZE / 2 * 3)  // 每个slot数据区：最大数据报按RGB565解码为BGR24后的大小
+#define FPVRX_SYNC_SAMPLES 16               // 共享内存中保留的最近时钟同步样本数
+#define FPVRX_HELLO_INTERVAL_MS 1000
+#define FPVRX_PING_INTERVAL_MS 200
+
+// 共享内存中的输出格式：RGB565解码为BGR24，其他格式（灰度、I420、JPEG）原样输出，沿用udp_pixel_format_t的值
+#define FPVRX_FMT_BGR24 0x80
+
+// 时钟同步样本（微秒），t1/t4为本机CLOCK_MONOTONIC（与Python time.monotonic()同源），t2/t3为设备时钟
+typedef struct {
+    uint64_t t1_us;
+    uint64_t t2_us;
+    uint64_t t3_us;
+    uint64_t t4_us;
+} fpvrx_sync_sample_t;
+
+// 共享内存头（写入方维护，读取方只读）
+typedef struct {
+    uint32_t magic;                 // FPVRX_SHM_MAGIC
+    uint32_t version;               // FPVRX_SHM_VERSION
+    uint32_t header_size;           // 头部大小（64字节对齐），第一个slot的偏移
+    uint32_t slot_count;
+    uint32_t slot_size;             // 每个slot的字节数（含fpvrx_slot_t，64字节对齐）
+    uint32_t slot_data_size;        // 每个slot数据区容量
+    uint32_t writer_pid;
+    uint32_t reserved;
+    uint64_t frames_published;      // 已发布的帧数，最新帧在slot (frames_published - 1) % slot_count
+    uint64_t packets;               // 收到的数据报数
+    uint64_t bytes;
+    uint64_t frames_lost;           // 按v2序号统计
+    uint64_t frames_reordered;
+    uint64_t bad_packets;           // 无法解析/长度不符/不支持的格式
+    uint64_t sync_count;            // 收到的PONG数，最新样本在 sync[(sync_count - 1) % FPVRX_SYNC_SAMPLES]
+    fpvrx_sync_sample_t sync[FPVRX_SYNC_SAMPLES];
+} fpvrx_shm_header_t;
+
+// 每个slot的帧元数据，数据区紧随其后
+typedef struct {
+    uint64_t generation;            // 帧号（从1开始），0表示正在写入
+    uint64_t recv_us;               // 本机接收时间（CLOCK_MONOTONIC）
+    uint64_t timestamp_us;          // 设备采集时间戳（v1帧为0）
+    uint32_t seq;                   // 设备帧序号（v1帧为0）
+    uint32_t len;                   // 数据区有效字节数
+    uint16_t width;
+    uint16_t height;
+    uint16_t stride;                // 数据区每行字节数
+    uint8_t format;                 // FPVRX_FMT_BGR24 或 udp_pixel_format_t
+    uint8_t flags;                  // UDP_FLAG_*
+    uint8_t version;                // 帧头版本
+    uint8_t channels;               // BGR24为3，灰度为1，其他为0
+    uint8_t reserved[2];
+    uint32_t device_id;             // 帧头中的设备ID（v1帧和旧固件为0）
+} fpvrx_slot_t;
+
+// 接收配置
+typedef struct {
+    const char *bind_ip;            // NULL表示0.0.0.0
+    uint16_t port;                  // 0表示UDP_PORT
+    const char *device_ip;          // HELLO/PING目的地址，NULL表示使用第一个帧来源
+    const char *shm_name;           // 共享内存名称（如"/fpv"），NULL表示不输出共享内存
+    uint32_t slots;                 // 0表示FPVRX_DEFAULT_SLOTS
+    uint32_t batch;                 // 每次recvmmsg的数据报数上限（大数据报时按总字节数减少），1相当于逐个recvfrom，0表示默认值
+    uint8_t frame_divider;          // HELLO中请求的抽帧比
+    bool raw_rgb565;                // true时RGB565不解码，原样输出
+    bool no_ctrl;                   // true时不发送HELLO/PING（测试用）
+} fpvrx_config_t;
+
+// 接收统计
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t batches;               // recvmmsg调用次数（返回数据的）
+    uint64_t frames;                // 发布的帧数
+    uint64_t frames_lost;
+    uint64_t frames_reordered;
+    uint64_t recorded;              // 预录导出帧（UDP_FLAG_RECORDED，不发布到共享内存，由回调处理）
+    uint64_t bad_packets;
+    uint64_t ctrl_packets;
+    uint64_t decode_ns;             // RGB565解码累计CPU时间
+    uint64_t rx_overflow;           // 接收缓冲区满被内核丢弃的数据报（SO_RXQ_OVFL，不支持时为0）
+    uint32_t rcvbuf;                // 实际生效的接收缓冲区大小（字节）
+} fpvrx_stats_t;
+
+typedef struct fpvrx fpvrx_t;
+
+// 帧回调（在 fpvrx_poll() 中调用）：slot和data指向共享内存（或内部缓冲区），回调返回后可能被覆盖
+typedef void (*fpvrx_frame_cb_t)(const fpvrx_slot_t *slot, const uint8_t *data, void *ctx);
+
+/**
+ * @brief 创建接收端：绑定UDP端口，创建共享内存环形缓冲区
+ * @param config 配置
+ * @return 接收端，NULL表示失败
+ */
+fpvrx_t *fpvrx_open(const fpvrx_config_t *config);
+
+/**
+ * @brief 设置帧回调（实时帧和预录导出帧都会回调，可用flags区分）
+ * @param rx 接收端
+ * @param cb 回调，NULL取消
+ * @param ctx 回调参数
+ */
+void fpvrx_set_callback(fpvrx_t *rx, fpvrx_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief 等待并处理一批数据报（poll + recvmmsg），到时发送HELLO/PING
+ * @param rx 接收端
+ * @param timeout_ms 没有数据时最长等待时间
+ * @return 处理的数据报数，0表示超时，-1表示错误
+ */
+int fpvrx_poll(fpvrx_t *rx, int timeout_ms);
+
+/**
+ * @brief 获取接收统计
+ * @param rx 接收端
+ * @param stats 统计输出
+ */
+void fpvrx_get_stats(const fpvrx_t *rx, fpvrx_stats_t *stats);
+
+/**
+ * @brief 关闭接收端，删除共享内存
+ * @param rx 接收端
+ */
+void fpvrx_close(fpvrx_t *rx);
+
+/**
+ * @brief RGB565解码为BGR24
+ * @param src RGB565数据
+ * @param src_stride 源每行字节数
+ * @param width 宽
+ * @param height 高
+ * @param big_endian 源为大端字节序（UDP_FLAG_BIG_ENDIAN）
+ * @param dst BGR24输出（width * 3 字节每行）
+ */
+void fpvrx_decode_rgb565(const uint8_t *src, size_t src_stride, uint16_t width, uint16_t height,
+                         bool big_endian, uint8_t *dst);
+
+// 共享内存读取端（C工具使用，Python见python/fpv_shm.py）
+typedef struct {
+    int fd;
+    void *base;
+    size_t size;
+    const fpvrx_shm_header_t *header;
+} fpvrx_reader_t;
+
+/**
+ * @brief 映射已存在的共享内存（只读）
+ * @param reader 读取端
+ * @param shm_name 共享内存名称
+ * @return true 成功，false 不存在或格式不符
+ */
+bool fpvrx_reader_open(fpvrx_reader_t *reader, const char *shm_name);
+
+/**
+ * @brief 取最新一帧
+ * @param reader 读取端
+ * @param generation 输出该帧的帧号，使用完后传给 fpvrx_reader_valid() 检查
+ * @param data 输出数据区指针（指向共享内存，不拷贝）
+ * @return 帧元数据，NULL表示还没有帧
+ */
+const fpvrx_slot_t *fpvrx_reader_latest(const fpvrx_reader_t *reader, uint64_t *generation, const uint8_t **data);
+
+/**
+ * @brief 检查读取期间该slot是否被覆盖
+ * @param slot 帧元数据
+ * @param generation fpvrx_reader_latest() 返回的帧号
+ * @return true 数据有效
+ */
+bool fpvrx_reader_valid(const fpvrx_slot_t *slot, uint64_t generation);
+
+/**
+ * @brief 解除映射
+ * @param reader 读取端
+ */
+void fpvrx_reader_close(fpvrx_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FPVRX_H
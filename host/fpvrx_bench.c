@@ -0,0 +1,320 @@
+// FPV主机接收库性能测试：回环地址上发送v2 RGB565帧，用 host/fpvrx.c 接收、解码并写入共享内存
+//
+// 编译:
+//   gcc -O2 -Wall -I host/include -I components/wifi -o fpvrx_bench host/fpvrx_bench.c host/fpvrx.c -lpthread -lrt
+// 运行:
+//   ./fpvrx_bench [每轮秒数] [宽] [高] [每秒数据报数] [每次突发的数据报数]
+//
+// 发送线程按固定平均速率（默认每秒4000个，约130路30fps摄像头）发送整帧数据报，每次连续发出一组
+// （默认16个，相当于设备发送任务在令牌桶放行时一次发完多个订阅者/多台设备的帧），组间按速率等待。
+// 接收端分别以每批1个（相当于逐个recvfrom）和每批16个数据报运行，输出每秒数据报数、MB/s、
+// 每次recvmmsg取到的数据报数、丢失比例（其中内核因接收缓冲区满丢弃的数量来自SO_RXQ_OVFL）、
+// 接收线程每个数据报的CPU时间，以及扣除解码后的接收开销（系统调用、组帧、写共享内存）。
+// 丢失超过1%判为失败：说明接收端跟不上该速率，或接收缓冲区太小（受net.core.rmem_max限制）。
+// 突发不少于2个时，批量接收平均每次应取到2个以上数据报；数据报不超过8KB（系统调用开销占主导）时，
+// 每个数据报的接收开销应至少比逐个接收低10%，更大的数据报以拷贝为主，只要求不比逐个接收高出15%以上
+// （此时接收库按字节数限制每批数量，见 FPVRX_BATCH_BYTES）。
+// 最后用共享内存读取端取最新帧，检查元数据和解码后的像素是否正确。
+// 宽高较小时（如 32 24）数据报很小，系统调用开销占主导，批量接收的差别最明显。
+
+#define _GNU_SOURCE
+#include "fpvrx.h"
+#include "esp_log.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *TAG = "fpvrx_bench";
+
+#define BENCH_PORT 18888
+#define BENCH_SHM "/fpvrx_bench"
+#define BENCH_RATE 4000             // 默认每秒发送的数据报数
+#define BENCH_BURST 16              // 默认每次连续发送的数据报数
+#define BENCH_MAX_LOSS 0.01         // 允许的丢失比例
+#define BENCH_MIN_PER_CALL 2.0      // 突发时批量接收每次recvmmsg至少平均取到的数据报数
+#define BENCH_SMALL_DATAGRAM 8192   // 不超过该大小时要求批量接收明显降低开销
+#define BENCH_MIN_GAIN 0.9          // 小数据报批量接收的接收开销不超过逐个接收的比例
+#define BENCH_MAX_REGRESSION 1.15   // 大数据报批量接收的接收开销不超过逐个接收的比例
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint32_t rate;                  // 每秒数据报数
+    uint32_t burst;                 // 每次连续发送的数据报数
+    volatile int running;
+    uint64_t sent;
+} sender_t;
+
+// 一轮的结果，用于比较逐个接收和批量接收
+typedef struct {
+    double per_call;                // 每次recvmmsg取到的数据报数
+    double cpu_us;                  // 每个数据报的接收线程CPU时间
+    double rx_us;                   // 扣除解码后的接收开销
+} run_result_t;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t thread_cpu_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+// 测试图案：小端RGB565，像素值由坐标和帧序号决定
+static uint16_t pattern(uint16_t x, uint16_t y, uint16_t width, uint32_t seq)
+{
+    return (uint16_t)(x + y * width + seq * 31);
+}
+
+static void *sender_task(void *ctx)
+{
+    sender_t *s = (sender_t *)ctx;
+    size_t header_size = offsetof(udp_frame_v2_t, data);
+    size_t len = header_size + (size_t)s->width * s->height * 2;
+    uint8_t *packet = malloc(len);
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int sndbuf = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(BENCH_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    udp_frame_v2_t *hdr = (udp_frame_v2_t *)packet;
+    hdr->magic = UDP_MAGIC_NUMBER;
+    hdr->width = s->width;
+    hdr->height = s->height;
+    hdr->version = UDP_FRAME_VERSION_2;
+    hdr->header_size = (uint8_t)header_size;
+    hdr->format = UDP_FMT_RGB565;
+    hdr->flags = UDP_FLAG_KEYFRAME;
+    hdr->stride = s->width * 2;
+    hdr->device_id = 1;
+
+    // 每组数据报预先生成，用一次sendmmsg连续发出（接收端被唤醒前整组已进入接收缓冲区）；
+    // 按绝对时间定时，睡眠误差不会累积
+    uint8_t **packets = malloc(s->burst * sizeof(uint8_t *));
+    struct mmsghdr *msgs = calloc(s->burst, sizeof(*msgs));
+    struct iovec *iov = calloc(s->burst, sizeof(*iov));
+    for (uint32_t i = 0; i < s->burst; i++) {
+        packets[i] = i == 0 ? packet : malloc(len);
+        memcpy(packets[i], packet, header_size);
+        iov[i].iov_base = packets[i];
+        iov[i].iov_len = len;
+        msgs[i].msg_hdr.msg_name = &dest;
+        msgs[i].msg_hdr.msg_namelen = sizeof(dest);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    long period_ns = (long)(1000000000LL * s->burst / s->rate);
+    uint32_t seq = 0;
+    while (s->running) {
+        for (uint32_t i = 0; i < s->burst; i++) {
+            udp_frame_v2_t *h = (udp_frame_v2_t *)packets[i];
+            h->seq = seq + i;
+            uint8_t *p = packets[i] + header_size;
+            for (uint16_t y = 0; y < s->height; y++) {
+                for (uint16_t x = 0; x < s->width; x++, p += 2) {
+                    uint16_t v = pattern(x, y, s->width, seq + i);
+                    p[0] = (uint8_t)v;
+                    p[1] = (uint8_t)(v >> 8);
+                }
+            }
+        }
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        uint64_t timestamp = (uint64_t)now_us();
+        for (uint32_t i = 0; i < s->burst; i++) {
+            ((udp_frame_v2_t *)packets[i])->timestamp_us = timestamp;
+        }
+        int n = sendmmsg(sock, msgs, s->burst, 0);
+        if (n > 0) {
+            s->sent += (uint64_t)n;
+        }
+        seq += s->burst;
+    }
+    for (uint32_t i = 1; i < s->burst; i++) {
+        free(packets[i]);
+    }
+    free(packets);
+    free(msgs);
+    free(iov);
+    close(sock);
+    free(packet);
+    return NULL;
+}
+
+// 用共享内存读取端检查最新帧，返回错误数
+static int check_shm(uint16_t width, uint16_t height)
+{
+    fpvrx_reader_t reader;
+    if (!fpvrx_reader_open(&reader, BENCH_SHM)) {
+        ESP_LOGE(TAG, "Cannot attach %s", BENCH_SHM);
+        return 1;
+    }
+    int errors = 0;
+    uint64_t generation;
+    const uint8_t *data;
+    const fpvrx_slot_t *slot = fpvrx_reader_latest(&reader, &generation, &data);
+    if (!slot) {
+        ESP_LOGE(TAG, "No frame in shared memory");
+        errors++;
+    } else if (slot->format != FPVRX_FMT_BGR24 || slot->width != width || slot->height != height ||
+               slot->len != (uint32_t)width * height * 3 || slot->channels != 3 || slot->device_id != 1) {
+        ESP_LOGE(TAG, "Bad slot metadata: format 0x%02x %ux%u len %u device %u", slot->format, slot->width,
+                 slot->height, slot->len, slot->device_id);
+        errors++;
+    } else {
+        for (uint16_t y = 0; y < height && errors < 5; y++) {
+            for (uint16_t x = 0; x < width && errors < 5; x++) {
+                uint16_t v = pattern(x, y, width, slot->seq);
+                const uint8_t *bgr = data + ((size_t)y * width + x) * 3;
+                if (bgr[0] != (uint8_t)((v & 0x1F) << 3) || bgr[1] != (uint8_t)(((v >> 5) & 0x3F) << 2) ||
+                    bgr[2] != (uint8_t)((v >> 11) << 3)) {
+                    ESP_LOGE(TAG, "Pixel (%u,%u) of frame %u decoded wrong", x, y, slot->seq);
+                    errors++;
+                }
+            }
+        }
+        if (!fpvrx_reader_valid(slot, generation)) {
+            ESP_LOGE(TAG, "Slot overwritten while idle");
+            errors++;
+        }
+    }
+    printf("shm: %llu frames published, latest seq %u, %s\n",
+           (unsigned long long)reader.header->frames_published, slot ? slot->seq : 0, errors ? "BAD" : "ok");
+    fpvrx_reader_close(&reader);
+    return errors;
+}
+
+// 运行一轮，返回错误数
+static int run(uint32_t batch, int seconds, uint16_t width, uint16_t height, uint32_t rate, uint32_t burst,
+               run_result_t *result)
+{
+    fpvrx_config_t config = {
+        .bind_ip = "127.0.0.1",
+        .port = BENCH_PORT,
+        .shm_name = BENCH_SHM,
+        .batch = batch,
+        .no_ctrl = true,
+    };
+    fpvrx_t *rx = fpvrx_open(&config);
+    if (!rx) {
+        return 1;
+    }
+
+    sender_t sender = { .width = width, .height = height, .rate = rate, .burst = burst, .running = 1 };
+    pthread_t thread;
+    int64_t start = now_us();
+    int64_t cpu_start = thread_cpu_us();
+    pthread_create(&thread, NULL, sender_task, &sender);
+
+    int errors = 0;
+    int64_t stop = start + (int64_t)seconds * 1000000;
+    while (now_us() < stop) {
+        if (fpvrx_poll(rx, 100) < 0) {
+            errors++;
+            break;
+        }
+    }
+    sender.running = 0;
+    pthread_join(thread, NULL);
+    while (fpvrx_poll(rx, 50) > 0) {
+        // 收完缓冲区中剩余的数据报
+    }
+    int64_t elapsed = now_us() - start;
+    int64_t cpu = thread_cpu_us() - cpu_start;
+
+    fpvrx_stats_t stats;
+    fpvrx_get_stats(rx, &stats);
+    errors += check_shm(width, height);
+    fpvrx_close(rx);
+
+    double sec = elapsed / 1e6;
+    double loss = sender.sent ? (double)(sender.sent - stats.packets) / sender.sent : 1.0;
+    result->per_call = stats.batches ? (double)stats.packets / stats.batches : 0.0;
+    result->cpu_us = stats.packets ? (double)cpu / stats.packets : 0.0;
+    result->rx_us = stats.packets ? (cpu - stats.decode_ns / 1e3) / stats.packets : 0.0;
+    printf("batch %2u: %.0f datagrams/s, %.1f MB/s, %.2f per recvmmsg, %llu/%llu received (%.2f%% lost, "
+           "%llu receive buffer overflow), %.2f us CPU/datagram (receive %.2f us, decode %.2f us), "
+           "lost frames by seq %llu, bad %llu\n",
+           batch, stats.packets / sec, stats.bytes / sec / 1e6, result->per_call, (unsigned long long)stats.packets,
+           (unsigned long long)sender.sent, 100.0 * loss, (unsigned long long)stats.rx_overflow, result->cpu_us,
+           result->rx_us, stats.frames ? stats.decode_ns / 1e3 / stats.frames : 0.0,
+           (unsigned long long)stats.frames_lost, (unsigned long long)stats.bad_packets);
+    if (stats.frames == 0 || stats.bad_packets) {
+        errors++;
+    }
+    if (loss > BENCH_MAX_LOSS) {
+        ESP_LOGE(TAG, "Lost %.2f%% of datagrams at %u/s (limit %.0f%%, receive buffer %u KB)", 100.0 * loss, rate,
+                 100.0 * BENCH_MAX_LOSS, stats.rcvbuf / 1024);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int width = argc > 2 ? atoi(argv[2]) : 160;
+    int height = argc > 3 ? atoi(argv[3]) : 120;
+    int rate = argc > 4 ? atoi(argv[4]) : BENCH_RATE;
+    int burst = argc > 5 ? atoi(argv[5]) : BENCH_BURST;
+    if (seconds < 1 || width < 1 || height < 1 || rate < 1 || burst < 1 || burst > rate ||
+        offsetof(udp_frame_v2_t, data) + (size_t)width * height * 2 > 65507) {
+        ESP_LOGE(TAG, "Usage: %s [seconds] [width] [height] [datagrams/s] [burst]; frame must fit in one UDP datagram",
+                 argv[0]);
+        return 1;
+    }
+
+    printf("%dx%d RGB565 frames, %zu-byte datagrams, %d/s in bursts of %d, %d s per run\n", width, height,
+           offsetof(udp_frame_v2_t, data) + (size_t)width * height * 2, rate, burst, seconds);
+    int errors = 0;
+    run_result_t single, batched;
+    errors += run(1, seconds, (uint16_t)width, (uint16_t)height, (uint32_t)rate, (uint32_t)burst, &single);
+    errors += run(FPVRX_DEFAULT_BATCH, seconds, (uint16_t)width, (uint16_t)height, (uint32_t)rate, (uint32_t)burst,
+                  &batched);
+
+    // 有突发时批次应当填充，且批量接收的每数据报开销（扣除与批量无关的解码）应低于逐个接收
+    size_t datagram = offsetof(udp_frame_v2_t, data) + (size_t)width * height * 2;
+    if (burst >= 2) {
+        printf("batch %u vs 1: %.2f datagrams per syscall, receive %.2f -> %.2f us/datagram (%.0f%%), "
+               "total %.2f -> %.2f us/datagram\n", FPVRX_DEFAULT_BATCH, batched.per_call, single.rx_us,
+               batched.rx_us, single.rx_us > 0 ? 100.0 * batched.rx_us / single.rx_us : 0.0, single.cpu_us,
+               batched.cpu_us);
+        if (batched.per_call < BENCH_MIN_PER_CALL) {
+            ESP_LOGE(TAG, "Batches did not fill: %.2f datagrams per recvmmsg (need %.1f)", batched.per_call,
+                     BENCH_MIN_PER_CALL);
+            errors++;
+        }
+        double limit = datagram <= BENCH_SMALL_DATAGRAM ? BENCH_MIN_GAIN : BENCH_MAX_REGRESSION;
+        if (batched.rx_us > single.rx_us * limit) {
+            ESP_LOGE(TAG, "Batched receive %.2f us/datagram is above %.0f%% of single receive %.2f us",
+                     batched.rx_us, 100.0 * limit, single.rx_us);
+            errors++;
+        }
+    }
+
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// 帧统计主机基准测试：用合成QQVGA帧驱动 components/camera/fstats.c
+//
+// 编译:
+//   gcc -O2 -Wall -I host/include -I components/wifi -I components/camera -o fstats_bench host/fstats_bench.c components/camera/fstats.c components/camera/motion.c
+// 运行:
+//   ./fstats_bench [帧数] [宽] [高]
+//
+// 输出不同抽样间隔的每帧耗时，并检查：平均亮度与逐像素计算一致、模糊帧和遮挡帧被正确识别。
+// 设备端实际耗时见主程序每5秒输出的 "Stats" 日志。
+
+#include "fstats.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "fstats_bench";
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 16;
+}
+
+static void put_gray(uint8_t *buf, int width, int x, int y, int level)
+{
+    // 灰色RGB565（大端），5/6bit分量
+    uint16_t v = (uint16_t)(((level >> 3) << 11) | ((level >> 2) << 5) | (level >> 3));
+    buf[(y * width + x) * 2] = v >> 8;
+    buf[(y * width + x) * 2 + 1] = v & 0xFF;
+}
+
+// 棋盘纹理加噪声，blur为真时做5x5盒式模糊，level_scale缩放整体亮度（百分比）
+static void synth_frame(uint8_t *buf, int width, int height, bool blur, int level_scale)
+{
+    int *levels = malloc(sizeof(int) * width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int level = ((x / 6 + y / 6) & 1) ? 60 : 200;
+            level += (int)(rng_next() % 9) - 4;
+            levels[y * width + x] = level * level_scale / 100;
+        }
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int level = levels[y * width + x];
+            if (blur) {
+                int sum = 0, n = 0;
+                for (int dy = -2; dy <= 2; dy++) {
+                    for (int dx = -2; dx <= 2; dx++) {
+                        int sx = x + dx, sy = y + dy;
+                        if (sx >= 0 && sx < width && sy >= 0 && sy < height) {
+                            sum += levels[sy * width + sx];
+                            n++;
+                        }
+                    }
+                }
+                level = sum / n;
+            }
+            put_gray(buf, width, x, y, level < 0 ? 0 : (level > 255 ? 255 : level));
+        }
+    }
+    free(levels);
+}
+
+// 逐样本计算平均亮度（不用SWAR），用于核对
+static uint8_t scalar_mean(const wifi_frame_desc_t *frame, int step)
+{
+    uint32_t sum = 0, n = 0;
+    for (int y = 0; y + step <= frame->height; y += step) {
+        for (int x = 0; x + step <= frame->width; x += step) {
+            const uint8_t *p = frame->data + (size_t)y * frame->stride + x * 2;
+            uint16_t v = (uint16_t)((p[0] << 8) | p[1]);
+            sum += (77 * ((v >> 11) << 3) + 150 * (((v >> 5) & 0x3F) << 2) + 29 * ((v & 0x1F) << 3)) >> 8;
+            n++;
+        }
+    }
+    return (uint8_t)(sum / n);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 1000;
+    int width = argc > 2 ? atoi(argv[2]) : 160;
+    int height = argc > 3 ? atoi(argv[3]) : 120;
+
+    const size_t len = (size_t)width * height * 2;
+    uint8_t *sharp = malloc(len);
+    uint8_t *blurred = malloc(len);
+    uint8_t *dark = malloc(len);
+    if (!sharp || !blurred || !dark) {
+        ESP_LOGE(TAG, "Out of memory");
+        return 1;
+    }
+    synth_frame(sharp, width, height, false, 100);
+    synth_frame(blurred, width, height, true, 100);
+    synth_frame(dark, width, height, false, 3);
+
+    wifi_frame_desc_t frame = {
+        .data = sharp, .len = len, .width = width, .height = height, .stride = width * 2,
+        .format = UDP_FMT_RGB565, .flags = UDP_FLAG_BIG_ENDIAN,
+    };
+    static fstats_t fs;
+    fstats_result_t result;
+
+    printf("Frame %dx%d, %d frames\n", width, height, frames);
+    const uint8_t steps[] = { 1, 2, 4 };
+    bool mean_ok = true;
+    for (int i = 0; i < 3; i++) {
+        fstats_init(&fs, steps[i]);
+        int64_t t0 = now_us();
+        for (int f = 0; f < frames; f++) {
+            fstats_process(&fs, &frame, &result);
+        }
+        double t = (double)(now_us() - t0) / frames;
+        uint8_t expect = scalar_mean(&frame, steps[i]);
+        mean_ok = mean_ok && result.mean == expect;
+        printf("  step %d: %6.1f us/frame, %5lu samples, mean %d (scalar %d), p5/p50/p95 %d/%d/%d, sharpness %lu\n",
+               steps[i], t, (unsigned long)result.samples, result.mean, expect,
+               result.p5, result.p50, result.p95, (unsigned long)result.sharpness);
+    }
+
+    // 默认抽样间隔：先用清晰帧建立参考值，再送入模糊帧和暗帧
+    fstats_init(&fs, 0);
+    for (int f = 0; f < FSTATS_WARMUP_FRAMES + 8; f++) {
+        fstats_process(&fs, &frame, &result);
+    }
+    bool sharp_ok = !result.blurred && !result.obstructed;
+    frame.data = blurred;
+    fstats_process(&fs, &frame, &result);
+    bool blur_ok = result.blurred && !result.obstructed;
+    printf("  blurred frame: sharpness %lu (ref %lu)\n", (unsigned long)result.sharpness, (unsigned long)result.sharpness_ref);
+    frame.data = dark;
+    fstats_process(&fs, &frame, &result);
+    bool dark_ok = result.obstructed;
+    printf("  dark frame: mean %d, p5/p95 %d/%d\n", result.mean, result.p5, result.p95);
+
+    printf("  mean matches scalar: %s, sharp: %s, blur detected: %s, obstruction detected: %s\n",
+           mean_ok ? "PASS" : "FAIL", sharp_ok ? "PASS" : "FAIL",
+           blur_ok ? "PASS" : "FAIL", dark_ok ? "PASS" : "FAIL");
+
+    free(sharp);
+    free(blurred);
+    free(dark);
+    return (mean_ok && sharp_ok && blur_ok && dark_ok) ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+// 运动检测主机基准测试：用合成QQVGA帧驱动 components/camera/motion.c
+//
+// 编译:
+//   gcc -O2 -Wall -I host/include -I components/wifi -I components/camera -o motion_bench host/motion_bench.c components/camera/motion.c
+// 运行:
+//   ./motion_bench [帧数] [宽] [高]
+//
+// 输出各阶段每帧耗时（降采样、SWAR帧差与逐字节帧差对比、完整检测），并检查运动事件是否按预期触发。
+// 完整检测的平均、P99和最大单帧耗时都不能超过预算。单帧耗时用本线程CPU时间（主机上被其他进程抢占的时间不计入），
+// 同一帧序列检测3遍，每帧取最小值：偶发的中断/虚拟机抖动被滤掉，由帧内容决定的慢帧（如运动帧的连通域标记）保留。
+// 设备端实际耗时见主程序每5秒输出的 "Motion" 日志（esp_timer 计时）。
+
+#include "motion.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "motion_bench";
+
+#define MOTION_BUDGET_US 2000   // QQVGA单帧预算
+#define MOTION_PASSES 3         // 单帧耗时取最小值的遍数
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 本线程CPU时间（纳秒）
+static int64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 16;
+}
+
+// 生成带噪声的静态纹理背景，moving为真时叠加一个移动的亮块（大端RGB565）
+static void synth_frame(uint8_t *buf, int width, int height, uint32_t frame_no, bool moving)
+{
+    const int box = width / 6;
+    const int bx = (int)(frame_no * 3) % (width - box);
+    const int by = height / 3;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int level = ((x / 8 + y / 8) & 1) ? 12 : 20;    // 棋盘纹理（5bit）
+            level += (int)(rng_next() % 3) - 1;              // 传感器噪声
+            if (moving && x >= bx && x < bx + box && y >= by && y < by + box) {
+                level = 31;
+            }
+            uint16_t v = (uint16_t)((level << 11) | ((level * 2) << 5) | level);
+            buf[(y * width + x) * 2] = v >> 8;
+            buf[(y * width + x) * 2 + 1] = v & 0xFF;
+        }
+    }
+}
+
+static void absdiff_scalar(const uint8_t *a, const uint8_t *b, uint8_t *out, int n)
+{
+    for (int i = 0; i < n; i++) {
+        out[i] = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+}
+
+// 穷举所有字节对，确认SWAR帧差与逐字节实现一致
+static bool verify_absdiff(void)
+{
+    uint8_t a[256], b[256], out[256], ref[256];
+    for (int i = 0; i < 256; i++) {
+        a[i] = (uint8_t)i;
+    }
+    for (int j = 0; j < 256; j++) {
+        for (int i = 0; i < 256; i++) {
+            b[i] = (uint8_t)((i * 7 + j) & 0xFF);
+        }
+        motion_absdiff(a, b, out, 256);
+        absdiff_scalar(a, b, ref, 256);
+        if (memcmp(out, ref, sizeof(ref)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 3000;
+    int width = argc > 2 ? atoi(argv[2]) : 160;
+    int height = argc > 3 ? atoi(argv[3]) : 120;
+
+    if (frames <= 0 || width < MOTION_SCALE || height < MOTION_SCALE) {
+        ESP_LOGE(TAG, "Usage: %s [frames] [width] [height]", argv[0]);
+        return 1;
+    }
+    if (!verify_absdiff()) {
+        ESP_LOGE(TAG, "SWAR absdiff mismatch");
+        return 1;
+    }
+
+    // 预生成静止/运动两段帧，计时只包含检测本身
+    const int distinct = 64;
+    const size_t frame_size = (size_t)width * height * 2;
+    uint8_t *buf = malloc(frame_size * distinct);
+    int64_t *frame_ns = malloc(sizeof(int64_t) * frames);
+    static motion_detector_t md;
+    if (!buf || !frame_ns) {
+        ESP_LOGE(TAG, "Out of memory");
+        return 1;
+    }
+    for (int i = 0; i < distinct; i++) {
+        synth_frame(buf + frame_size * i, width, height, i, i >= distinct / 2);
+    }
+
+    wifi_frame_desc_t desc = {
+        .len = frame_size,
+        .width = width,
+        .height = height,
+        .stride = width * 2,
+        .format = UDP_FMT_RGB565,
+        .flags = UDP_FLAG_BIG_ENDIAN,
+    };
+    const int cells = (width / MOTION_SCALE) * (height / MOTION_SCALE);
+    uint8_t luma[MOTION_MAX_CELLS], diff[MOTION_MAX_CELLS];
+
+    // 降采样
+    int64_t t0 = now_us();
+    for (int f = 0; f < frames; f++) {
+        desc.data = buf + frame_size * (f % distinct);
+        motion_downsample_luma(&desc, luma);
+    }
+    int64_t t_down = now_us() - t0;
+
+    // 帧差：SWAR与逐字节对比
+    const int reps = 100;
+    t0 = now_us();
+    for (int f = 0; f < frames * reps; f++) {
+        motion_absdiff(luma, md.background_u8, diff, cells);
+        __asm__ volatile("" ::: "memory");
+    }
+    int64_t t_swar = now_us() - t0;
+    t0 = now_us();
+    for (int f = 0; f < frames * reps; f++) {
+        absdiff_scalar(luma, md.background_u8, diff, cells);
+        __asm__ volatile("" ::: "memory");
+    }
+    int64_t t_scalar = now_us() - t0;
+
+    // 完整检测（前半段静止，后半段运动），每遍从头开始，事件和平均耗时取第一遍
+    motion_result_t result;
+    uint32_t starts = 0, ends = 0, max_score = 0;
+    int64_t t_full = 0;
+    for (int pass = 0; pass < MOTION_PASSES; pass++) {
+        motion_init(&md, NULL);
+        t0 = now_us();
+        for (int f = 0; f < frames; f++) {
+            desc.data = buf + frame_size * (f % distinct);
+            int64_t t1 = thread_cpu_ns();
+            motion_process(&md, &desc, &result);
+            int64_t dt = thread_cpu_ns() - t1;
+            if (pass == 0 || dt < frame_ns[f]) {
+                frame_ns[f] = dt;
+            }
+            if (pass == 0) {
+                starts += result.event == MOTION_EVENT_START;
+                ends += result.event == MOTION_EVENT_END;
+                if (result.score > max_score) {
+                    max_score = result.score;
+                }
+            }
+        }
+        if (pass == 0) {
+            t_full = now_us() - t0;
+        }
+    }
+
+    double full_avg = (double)t_full / frames;
+    qsort(frame_ns, frames, sizeof(frame_ns[0]), compare_i64);
+    double p99 = frame_ns[(frames - 1) * 99 / 100] / 1e3;
+    double worst = frame_ns[frames - 1] / 1e3;
+    bool in_budget = full_avg < MOTION_BUDGET_US && p99 < MOTION_BUDGET_US && worst < MOTION_BUDGET_US;
+    printf("Frame %dx%d -> %d cells, %d frames\n", width, height, cells, frames);
+    printf("  downsample      %8.2f us/frame\n", (double)t_down / frames);
+    printf("  absdiff (SWAR)  %8.3f us/frame\n", (double)t_swar / frames / reps);
+    printf("  absdiff (byte)  %8.3f us/frame\n", (double)t_scalar / frames / reps);
+    printf("  motion_process  %8.2f us/frame (CPU p99 %.1f us, worst %.1f us), budget %d us: %s\n",
+           full_avg, p99, worst, MOTION_BUDGET_US, in_budget ? "PASS" : "FAIL");
+    printf("  events: %u start / %u end, max score %u/1000, last boxes %u\n",
+           starts, ends, max_score, result.box_count);
+    for (int i = 0; i < result.box_count; i++) {
+        printf("    box %d: %u,%u %ux%u (%u cells)\n", i, result.boxes[i].x, result.boxes[i].y,
+               result.boxes[i].width, result.boxes[i].height, result.boxes[i].cells);
+    }
+
+    free(frame_ns);
+    free(buf);
+    return (in_budget && starts > 0) ? 0 : 1;
+}
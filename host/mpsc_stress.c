@@ -0,0 +1,233 @@
+// 无锁发送队列主机压力测试：多个生产者线程并发写入 components/wifi/mpsc.c，单个消费者线程读出
+//
+// 编译:
+//   gcc -O2 -Wall -I host/include -I components/wifi -o mpsc_stress host/mpsc_stress.c components/wifi/mpsc.c -lpthread
+// 运行:
+//   ./mpsc_stress [生产者数] [每个生产者的元素数] [队列容量]
+//
+// 元素带64字节内联数据（与设备端发送请求大小相近），检查：没有丢失、没有重复、
+// 每个生产者的元素按顺序到达、内容没有被并发写坏。队列满时生产者让出CPU后重试。
+// 同样的负载再用互斥锁保护的环形队列跑一遍，对比每秒入队数和队列满次数。
+// 设备端统计见主程序每5秒输出的 "Send Queue" 日志。
+
+#include "mpsc.h"
+#include "esp_log.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "mpsc_stress";
+
+#define MAX_PRODUCERS 16
+#define MAX_CAPACITY 4096
+#define ITEM_DATA 64
+
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+    uint32_t check;
+    uint8_t data[ITEM_DATA];
+} item_t;
+
+// 对比用：互斥锁保护的环形队列
+typedef struct {
+    pthread_mutex_t lock;
+    item_t *items;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t full;
+} locked_queue_t;
+
+typedef struct {
+    bool use_lock;
+    mpsc_queue_t mpsc;
+    locked_queue_t locked;
+    uint32_t per_producer;
+    volatile int producers_done;
+} bench_t;
+
+typedef struct {
+    bench_t *bench;
+    uint32_t id;
+} producer_arg_t;
+
+static uint8_t cells[MAX_CAPACITY * MPSC_CELL_SIZE(sizeof(item_t))] __attribute__((aligned(4)));
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t item_check(const item_t *item)
+{
+    uint32_t h = item->producer * 2654435761u ^ item->seq;
+    for (int i = 0; i < ITEM_DATA; i++) {
+        h = h * 31 + item->data[i];
+    }
+    return h;
+}
+
+static bool locked_push(locked_queue_t *q, const item_t *item)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = q->head - q->tail < q->capacity;
+    if (ok) {
+        q->items[q->head % q->capacity] = *item;
+        q->head++;
+    } else {
+        q->full++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static bool locked_pop(locked_queue_t *q, item_t *item)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = q->head != q->tail;
+    if (ok) {
+        *item = q->items[q->tail % q->capacity];
+        q->tail++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static void *producer_task(void *ctx)
+{
+    producer_arg_t *arg = (producer_arg_t *)ctx;
+    bench_t *b = arg->bench;
+
+    for (uint32_t seq = 0; seq < b->per_producer; seq++) {
+        item_t item = { .producer = arg->id, .seq = seq };
+        for (int i = 0; i < ITEM_DATA; i++) {
+            item.data[i] = (uint8_t)(seq * 7 + arg->id + i);
+        }
+        item.check = item_check(&item);
+        while (!(b->use_lock ? locked_push(&b->locked, &item) : mpsc_push(&b->mpsc, &item))) {
+            sched_yield();  // 队列满，等待消费者
+        }
+    }
+    __atomic_fetch_add(&b->producers_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// 运行一轮，返回错误数
+static int run(bench_t *b, int producers, uint32_t capacity)
+{
+    static uint32_t next_seq[MAX_PRODUCERS];
+    memset(next_seq, 0, sizeof(next_seq));
+    b->producers_done = 0;
+    if (b->use_lock) {
+        pthread_mutex_init(&b->locked.lock, NULL);
+        b->locked.items = calloc(capacity, sizeof(item_t));
+        b->locked.capacity = capacity;
+        b->locked.head = b->locked.tail = b->locked.full = 0;
+    } else if (!mpsc_init(&b->mpsc, cells, capacity, sizeof(item_t))) {
+        ESP_LOGE(TAG, "mpsc_init failed");
+        return 1;
+    }
+
+    pthread_t threads[MAX_PRODUCERS];
+    producer_arg_t args[MAX_PRODUCERS];
+    int64_t start = now_us();
+    for (int i = 0; i < producers; i++) {
+        args[i].bench = b;
+        args[i].id = i;
+        pthread_create(&threads[i], NULL, producer_task, &args[i]);
+    }
+
+    // 消费者：主线程
+    uint64_t total = (uint64_t)producers * b->per_producer;
+    uint64_t received = 0;
+    uint32_t max_depth = 0;
+    int errors = 0;
+    item_t item;
+    while (received < total) {
+        bool ok = b->use_lock ? locked_pop(&b->locked, &item) : mpsc_pop(&b->mpsc, &item);
+        if (!ok) {
+            if (__atomic_load_n(&b->producers_done, __ATOMIC_ACQUIRE) == producers &&
+                (b->use_lock ? b->locked.head == b->locked.tail : mpsc_count(&b->mpsc) == 0)) {
+                break;
+            }
+            sched_yield();  // 队列为空，让生产者运行（单核主机上也能推进）
+            continue;
+        }
+        if (!b->use_lock) {
+            uint32_t depth = mpsc_count(&b->mpsc) + 1;
+            if (depth > max_depth) {
+                max_depth = depth;
+            }
+        }
+        received++;
+        if (item.producer >= (uint32_t)producers || item.check != item_check(&item)) {
+            if (errors++ < 5) {
+                ESP_LOGE(TAG, "Corrupted item: producer %u seq %u", item.producer, item.seq);
+            }
+            continue;
+        }
+        if (item.seq != next_seq[item.producer]) {
+            if (errors++ < 5) {
+                ESP_LOGE(TAG, "Producer %u: expected seq %u, got %u", item.producer,
+                         next_seq[item.producer], item.seq);
+            }
+        }
+        next_seq[item.producer] = item.seq + 1;
+    }
+    int64_t elapsed = now_us() - start;
+
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (received != total) {
+        ESP_LOGE(TAG, "Received %llu of %llu items", (unsigned long long)received, (unsigned long long)total);
+        errors++;
+    }
+
+    uint32_t full = b->use_lock ? b->locked.full : atomic_load(&b->mpsc.full);
+    printf("%-7s: %llu items in %lld ms, %.2f M items/s, queue full %u times",
+           b->use_lock ? "mutex" : "mpsc", (unsigned long long)received, (long long)(elapsed / 1000),
+           elapsed ? received / (double)elapsed : 0.0, full);
+    if (!b->use_lock) {
+        printf(", max depth %u/%u", max_depth, capacity);
+    }
+    printf(", %d errors\n", errors);
+
+    if (b->use_lock) {
+        free(b->locked.items);
+        pthread_mutex_destroy(&b->locked.lock);
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    uint32_t per_producer = argc > 2 ? (uint32_t)atoi(argv[2]) : 200000;
+    uint32_t capacity = argc > 3 ? (uint32_t)atoi(argv[3]) : 32;
+    if (producers < 1 || producers > MAX_PRODUCERS || capacity < 2 || capacity > MAX_CAPACITY ||
+        (capacity & (capacity - 1))) {
+        ESP_LOGE(TAG, "Producers must be 1..%d, capacity a power of 2 up to %d", MAX_PRODUCERS, MAX_CAPACITY);
+        return 1;
+    }
+
+    printf("%d producers x %u items, capacity %u, %zu-byte items\n", producers, per_producer, capacity,
+           sizeof(item_t));
+
+    static bench_t bench;
+    bench.per_producer = per_producer;
+    int errors = 0;
+    bench.use_lock = false;
+    errors += run(&bench, producers, capacity);
+    bench.use_lock = true;
+    errors += run(&bench, producers, capacity);
+
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
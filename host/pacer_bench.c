@@ -0,0 +1,518 @@
+// 发送节奏控制主机仿真：用模拟的WiFi发送缓冲区和空口驱动 components/wifi/pacer.c
+//
+// 编译:
+//   gcc -O2 -Wall -Wextra -I host/include -I components/wifi -o pacer_bench host/pacer_bench.c components/wifi/pacer.c
+// 运行:
+//   ./pacer_bench [秒数] [空口速率Mbps]
+//
+// 模拟设备端的发送路径（虚拟时间，10ms系统节拍）：
+//   发送任务（wifi_tx，socket唯一的发送者）：先处理请求队列，再发送FPV帧
+//     FPV：每帧一个38KB数据报（IP分片为27片），订阅者队列深度2，关键帧优先级
+//     请求队列：控制应答和预录导出；sendmsg把数据拷贝进pbuf需要时间，期间后面的请求只能等待
+//   捕获任务：每帧28个RTP包（自己的socket），等待令牌超过一帧间隔则丢弃本帧剩余部分
+//   控制任务：每200ms收到一个PING（相位随机），应答放入请求队列，不等待令牌
+//   预录导出任务：第5/30秒各触发导出90帧，发给2个v2订阅者：每帧对每个目的地址等待后台令牌（最多1秒）并入队，
+//     等全部发送完成后按导出速率休眠
+// 驱动有32个发送缓冲区，空口逐片发送；缓冲区不足时sendto失败（ENOMEM），已入队的分片白白占用空口。
+// 依次运行：不控制节奏、控制节奏但所有发送共用一个FIFO（控制应答排在它之前产生的FPV帧、RTP包和导出请求之后，
+// 与单个请求队列时一样）、控制节奏且控制应答单独排队优先发送，
+// 比较发送缓冲区不足次数、完整送达的帧数和各类数据的延迟（导出帧从交给发送任务算起）。
+// 以下任一不满足则返回1（只检查最后一种）：
+//   控制应答全部送达，最大延迟不超过上限（驱动发送缓冲区全满时排空的时间 + 一次大数据报的拷贝时间），
+//   且不到共用FIFO时的一半。驱动按FIFO逐片发送，已交给驱动的分片无法插队，上限是软件能做到的下限
+//   预录导出送达数不少于保底份额的90%：链路满载时每个导出数据报最多等待PACER_BULK_MAX_WAIT_MS
+// 设备端统计见主程序每5秒输出的 "Pacer" 和 "Send Queue" 日志。
+
+#include "pacer.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "pacer_bench";
+
+#define STEP_US 10
+#define TICK_US 10000               // FreeRTOS节拍（CONFIG_FREERTOS_HZ=100）
+#define TX_BUFFERS 32               // CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM
+#define FRAGMENT 1472               // IP分片负载
+#define AIR_OVERHEAD_US 80          // 每片的竞争/前导/ACK开销
+#define FRAME_INTERVAL_US 33333
+#define FPV_BYTES (38400 + 22)
+#define RTP_PACKETS 28
+#define RTP_BYTES 1400
+#define CTRL_INTERVAL_US 200000
+#define CTRL_BYTES 40
+#define DUMP_FRAMES 90
+#define DUMP_TRIGGER1_US 5000000    // 两次触发导出的时间
+#define DUMP_TRIGGER2_US 30000000
+#define FPV_QUEUE_DEPTH 2
+#define DUMP_RATE_KBPS 2000         // prerec_default_config.dump_rate_kbps
+#define DUMP_DESTS 2                // 导出发给每个v2订阅者（如实时观看 + 录像）
+#define COPY_BYTES_PER_US 40        // sendmsg拷贝进pbuf的速度（从PSRAM读取约40MB/s）
+#define REQ_QUEUE_DEPTH 32          // WIFI_SENDQ_DEPTH
+#define BULK_WAIT_US 1000000        // WIFI_PACE_BULK_WAIT_MS：导出等待令牌超时则跳过该目的地址
+
+enum { SRC_FPV = 0, SRC_RTP, SRC_CTRL, SRC_DUMP, SRC_MAX };
+static const char *src_names[SRC_MAX] = { "FPV", "RTP", "Ctrl", "Dump" };
+static const pacer_prio_t src_prio[SRC_MAX] = {
+    PACER_PRIO_KEYFRAME, PACER_PRIO_NORMAL, PACER_PRIO_CONTROL, PACER_PRIO_BULK
+};
+
+// 驱动发送缓冲区中的一个分片
+typedef struct {
+    int src;
+    int bytes;
+    bool last;                      // 帧的最后一片（RTP为本帧最后一包的最后一片）
+    int64_t created_us;             // 数据报产生时间
+    bool deliverable;               // 数据报全部分片都已入队
+} fragment_t;
+
+typedef struct {
+    fragment_t ring[TX_BUFFERS];
+    int head;
+    int count;
+    int64_t busy_until;             // 当前分片发送完成时间
+    bool busy;
+    double rate_mbps;
+} link_t;
+
+// 每个数据源的统计
+typedef struct {
+    uint32_t offered;               // 产生的帧/包数
+    uint32_t delivered;             // 完整送达的帧/包数
+    uint32_t backpressure;          // 发送缓冲区不足
+    uint32_t dropped;               // 队列满或超过等待期限丢弃
+    uint64_t latency_sum_us;        // 产生到最后一片发送完成
+    uint32_t latency_max_us;
+} src_stats_t;
+
+// 发送任务的请求队列（控制应答、预录导出）
+typedef struct {
+    int src;
+    int bytes;
+    int64_t created_us;
+} request_t;
+
+typedef struct {
+    request_t items[REQ_QUEUE_DEPTH];
+    int head;
+    int count;
+} req_queue_t;
+
+typedef struct {
+    link_t link;
+    pacer_t pacer;
+    src_stats_t stats[SRC_MAX];
+    bool control_first;             // 控制应答单独排队，发送任务先处理
+    req_queue_t ctrl_queue;
+    req_queue_t queue;              // 共用FIFO时控制应答也放在这里
+    int64_t tx_busy_until;          // 发送任务正在sendmsg（拷贝数据）
+    int dump_done;                  // 已发送的导出请求数（完成通知）
+} sim_t;
+
+static bool req_push(req_queue_t *q, int src, int bytes, int64_t created_us)
+{
+    if (q->count == REQ_QUEUE_DEPTH) {
+        return false;
+    }
+    request_t *r = &q->items[(q->head + q->count) % REQ_QUEUE_DEPTH];
+    r->src = src;
+    r->bytes = bytes;
+    r->created_us = created_us;
+    q->count++;
+    return true;
+}
+
+static const request_t *req_peek(const req_queue_t *q)
+{
+    return q->count ? &q->items[q->head] : NULL;
+}
+
+static bool req_pop(req_queue_t *q, request_t *r)
+{
+    if (q->count == 0) {
+        return false;
+    }
+    *r = q->items[q->head];
+    q->head = (q->head + 1) % REQ_QUEUE_DEPTH;
+    q->count--;
+    return true;
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static int link_free(const link_t *l)
+{
+    return TX_BUFFERS - l->count;
+}
+
+// 模拟sendto：分片逐个放入发送缓冲区，缓冲区不足时返回false（前面的分片已入队）
+static bool link_send(sim_t *s, int src, int bytes, bool frame_end, int64_t created_us)
+{
+    link_t *l = &s->link;
+    int frags = (bytes + FRAGMENT - 1) / FRAGMENT;
+    bool ok = frags <= link_free(l);
+    int n = ok ? frags : link_free(l);
+    for (int i = 0; i < n; i++) {
+        fragment_t *f = &l->ring[(l->head + l->count) % TX_BUFFERS];
+        f->src = src;
+        f->bytes = (i + 1 < frags) ? FRAGMENT : bytes - FRAGMENT * (frags - 1);
+        f->last = frame_end && (i + 1 == frags);
+        f->created_us = created_us;
+        f->deliverable = ok;
+        l->count++;
+    }
+    return ok;
+}
+
+static void link_step(sim_t *s, int64_t now)
+{
+    link_t *l = &s->link;
+    if (l->busy && now >= l->busy_until) {
+        fragment_t *f = &l->ring[l->head];
+        l->head = (l->head + 1) % TX_BUFFERS;
+        l->count--;
+        l->busy = false;
+        // RTP遇到失败会丢弃本帧剩余的包，最后一包能入队说明整帧完整
+        if (f->last && f->deliverable) {
+            src_stats_t *st = &s->stats[f->src];
+            uint32_t latency = (uint32_t)(now - f->created_us);
+            st->delivered++;
+            st->latency_sum_us += latency;
+            if (latency > st->latency_max_us) {
+                st->latency_max_us = latency;
+            }
+        }
+    }
+    if (!l->busy && l->count > 0) {
+        const fragment_t *f = &l->ring[l->head];
+        l->busy_until = now + AIR_OVERHEAD_US + (int64_t)(f->bytes * 8 / l->rate_mbps);
+        l->busy = true;
+    }
+}
+
+// 发送者（模拟一个任务）：有待发送项时按令牌等待，等待按系统节拍取整
+typedef struct {
+    int src;
+    int64_t ready_us;               // 休眠到该时间
+    int64_t wait_start_us;          // 开始等待令牌的时间（0表示未等待）
+    int pending;                    // 待发送项数
+    int64_t created[4 * DUMP_FRAMES];   // 各待发送项的产生时间（FIFO）
+    int64_t deadline_us;            // RTP：本帧剩余包的发送期限
+    int rtp_index;                  // RTP：本帧下一个包序号
+} sender_t;
+
+static int64_t next_tick(int64_t t)
+{
+    return (t / TICK_US + 1) * TICK_US;
+}
+
+static bool sender_push(sender_t *snd, int64_t created)
+{
+    if (snd->pending == (int)(sizeof(snd->created) / sizeof(snd->created[0]))) {
+        return false;
+    }
+    snd->created[snd->pending++] = created;
+    return true;
+}
+
+static void sender_pop(sender_t *snd)
+{
+    memmove(snd->created, snd->created + 1, sizeof(snd->created[0]) * (snd->pending - 1));
+    snd->pending--;
+}
+
+static void sender_step(sim_t *s, sender_t *snd, int64_t now)
+{
+    while (snd->pending > 0 && now >= snd->ready_us) {
+        int bytes = snd->src == SRC_FPV || snd->src == SRC_DUMP ? FPV_BYTES :
+                    (snd->src == SRC_RTP ? RTP_BYTES : CTRL_BYTES);
+        pacer_prio_t prio = src_prio[snd->src];
+        src_stats_t *st = &s->stats[snd->src];
+
+        if (snd->src == SRC_RTP && now > snd->deadline_us) {
+            // 超过一帧间隔仍未发完，丢弃本帧剩余部分
+            st->dropped++;
+            if (snd->wait_start_us) {
+                pacer_note_wait(&s->pacer, (uint32_t)(now - snd->wait_start_us), true);
+            }
+            snd->pending = 0;
+            snd->wait_start_us = 0;
+            break;
+        }
+
+        uint32_t wait = pacer_reserve(&s->pacer, bytes, prio, now);
+        if (wait > 0) {
+            if (!snd->wait_start_us) {
+                snd->wait_start_us = now;
+            }
+            snd->ready_us = next_tick(now + wait - 1);
+            break;
+        }
+        if (snd->wait_start_us) {
+            pacer_note_wait(&s->pacer, (uint32_t)(now - snd->wait_start_us), false);
+            snd->wait_start_us = 0;
+        }
+
+        bool frame_end = snd->src != SRC_RTP || snd->rtp_index == RTP_PACKETS - 1;
+        bool ok = link_send(s, snd->src, bytes, frame_end, snd->created[0]);
+        pacer_complete(&s->pacer, bytes, prio, !ok, now);
+        if (!ok) {
+            st->backpressure++;
+        }
+        if (snd->src == SRC_RTP) {
+            snd->rtp_index++;
+            if (!ok) {
+                snd->pending = 0;  // rtp_send_frame 遇到失败丢弃本帧剩余部分
+                break;
+            }
+        }
+        sender_pop(snd);
+    }
+}
+
+// 共用FIFO时，控制应答要等在它之前产生、仍在排队的FPV帧和RTP包都发出（或丢弃）后才能发送；
+// 排在它前面的导出请求由FIFO顺序保证
+static bool fifo_blocked(const sim_t *s, const sender_t *fpv, const sender_t *rtp)
+{
+    const request_t *head = req_peek(&s->queue);
+    if (s->control_first || !head || head->src != SRC_CTRL) {
+        return false;
+    }
+    return (fpv->pending > 0 && fpv->created[0] <= head->created_us) ||
+           (rtp->pending > 0 && rtp->created[0] <= head->created_us);
+}
+
+// 发送任务：先处理请求队列（控制应答单独排队时先取控制应答），没有请求时按令牌发送FPV帧；
+// 每次sendmsg按数据量占用发送任务一段时间，期间新的请求只能排队
+static void tx_task_step(sim_t *s, sender_t *fpv, const sender_t *rtp, int64_t now)
+{
+    while (now >= s->tx_busy_until) {
+        request_t req;
+        if ((s->control_first && req_pop(&s->ctrl_queue, &req)) || (!fifo_blocked(s, fpv, rtp) && req_pop(&s->queue, &req))) {
+            // 请求的令牌由调用者申请（控制应答不等待）
+            bool ok = link_send(s, req.src, req.bytes, true, req.created_us);
+            pacer_complete(&s->pacer, req.bytes, src_prio[req.src], !ok, now);
+            if (!ok) {
+                s->stats[req.src].backpressure++;
+            }
+            if (req.src == SRC_DUMP) {
+                s->dump_done++;
+            }
+            s->tx_busy_until = now + req.bytes / COPY_BYTES_PER_US;
+            continue;
+        }
+
+        if (fpv->pending == 0 || now < fpv->ready_us) {
+            break;
+        }
+        uint32_t wait = pacer_reserve(&s->pacer, FPV_BYTES, PACER_PRIO_KEYFRAME, now);
+        if (wait > 0) {
+            // 等待帧令牌期间收到请求会提前醒来处理
+            if (!fpv->wait_start_us) {
+                fpv->wait_start_us = now;
+            }
+            fpv->ready_us = next_tick(now + wait - 1);
+            break;
+        }
+        if (fpv->wait_start_us) {
+            pacer_note_wait(&s->pacer, (uint32_t)(now - fpv->wait_start_us), false);
+            fpv->wait_start_us = 0;
+        }
+        bool ok = link_send(s, SRC_FPV, FPV_BYTES, true, fpv->created[0]);
+        pacer_complete(&s->pacer, FPV_BYTES, PACER_PRIO_KEYFRAME, !ok, now);
+        if (!ok) {
+            s->stats[SRC_FPV].backpressure++;
+        }
+        sender_pop(fpv);
+        s->tx_busy_until = now + FPV_BYTES / COPY_BYTES_PER_US;
+    }
+}
+
+// 预录导出任务：每帧对每个目的地址等待后台令牌后入队，全部发送完成再按导出速率休眠
+// （camera_prerec_task / wifi_send_recorded_frame）
+typedef struct {
+    int backlog;                    // 待导出的帧数
+    int64_t ready_us;
+    int64_t wait_start_us;
+    int queued;                     // 本帧已入队的目的地址数
+} dump_task_t;
+
+static void dump_task_step(sim_t *s, dump_task_t *d, int64_t now)
+{
+    if (d->queued == DUMP_DESTS) {
+        if (s->dump_done < DUMP_DESTS) {
+            return;
+        }
+        d->queued = 0;
+        s->dump_done = 0;
+        d->backlog--;
+        // 限速：kbit/s 等于 bit/ms
+        d->ready_us = next_tick(now + (int64_t)FPV_BYTES * 8 * 1000 / DUMP_RATE_KBPS - 1);
+        return;
+    }
+    while (d->backlog > 0 && d->queued < DUMP_DESTS && now >= d->ready_us) {
+        uint32_t wait = pacer_reserve(&s->pacer, FPV_BYTES, PACER_PRIO_BULK, now);
+        if (wait > 0 && (!d->wait_start_us || now + wait - d->wait_start_us <= BULK_WAIT_US)) {
+            if (!d->wait_start_us) {
+                d->wait_start_us = now;
+            }
+            d->ready_us = next_tick(now + wait - 1);
+            return;
+        }
+        if (d->wait_start_us) {
+            pacer_note_wait(&s->pacer, (uint32_t)(now - d->wait_start_us), wait > 0);
+            d->wait_start_us = 0;
+        }
+        if (wait > 0) {
+            // 等待超时，跳过该目的地址
+            s->stats[SRC_DUMP].dropped++;
+            s->dump_done++;
+        } else if (!req_push(&s->queue, SRC_DUMP, FPV_BYTES, now)) {
+            s->stats[SRC_DUMP].dropped++;
+            s->dump_done++;  // 入队失败也算完成，调用者不会等待
+        }
+        d->queued++;
+    }
+}
+
+static void run(bool paced, bool control_first, int seconds, double rate_mbps, src_stats_t out[SRC_MAX])
+{
+    sim_t s;
+    memset(&s, 0, sizeof(s));
+    s.link.rate_mbps = rate_mbps;
+    s.control_first = control_first;
+    rng_state = 1;
+    pacer_init(&s.pacer, NULL, 0);
+    // 按链路探测的有效吞吐设置速率（空口速率扣除每片开销）
+    double per_frag_us = AIR_OVERHEAD_US + FRAGMENT * 8 / rate_mbps;
+    pacer_set_capacity(&s.pacer, (uint32_t)(FRAGMENT * 8 * 1000 / per_frag_us));
+    pacer_set_enabled(&s.pacer, paced);
+
+    sender_t fpv;
+    sender_t rtp;
+    dump_task_t dump;
+    memset(&fpv, 0, sizeof(fpv));
+    memset(&rtp, 0, sizeof(rtp));
+    memset(&dump, 0, sizeof(dump));
+    fpv.src = SRC_FPV;
+    rtp.src = SRC_RTP;
+
+    const int64_t end = (int64_t)seconds * 1000000;
+    int64_t next_frame = 0;
+    int64_t ctrl_slot = 0;
+    int64_t next_ctrl = rng_next() % FRAME_INTERVAL_US;
+    for (int64_t now = 0; now < end; now += STEP_US) {
+        if (now >= next_frame) {
+            next_frame += FRAME_INTERVAL_US;
+            // FPV：订阅者队列满时丢弃最旧的帧
+            s.stats[SRC_FPV].offered++;
+            if (fpv.pending == FPV_QUEUE_DEPTH) {
+                sender_pop(&fpv);
+                s.stats[SRC_FPV].dropped++;
+            }
+            sender_push(&fpv, now);
+            // RTP：捕获任务发送本帧，上一帧未发完的部分丢弃
+            s.stats[SRC_RTP].offered++;
+            if (rtp.pending > 0) {
+                s.stats[SRC_RTP].dropped++;
+            }
+            rtp.pending = 0;
+            rtp.rtp_index = 0;
+            rtp.deadline_us = now + FRAME_INTERVAL_US;
+            for (int i = 0; i < RTP_PACKETS; i++) {
+                sender_push(&rtp, now);
+            }
+        }
+        if (now >= next_ctrl) {
+            // PING的到达时刻与帧无关：每个周期内随机相位
+            ctrl_slot += CTRL_INTERVAL_US;
+            next_ctrl = ctrl_slot + rng_next() % FRAME_INTERVAL_US;
+            s.stats[SRC_CTRL].offered++;
+            if (!req_push(control_first ? &s.ctrl_queue : &s.queue, SRC_CTRL, CTRL_BYTES, now)) {
+                s.stats[SRC_CTRL].dropped++;
+            }
+        }
+        if (now == DUMP_TRIGGER1_US || now == DUMP_TRIGGER2_US) {
+            s.stats[SRC_DUMP].offered += DUMP_FRAMES * DUMP_DESTS;
+            dump.backlog += DUMP_FRAMES;
+        }
+
+        // 优先级高的任务先运行
+        tx_task_step(&s, &fpv, &rtp, now);
+        sender_step(&s, &rtp, now);
+        dump_task_step(&s, &dump, now);
+        link_step(&s, now);
+    }
+
+    pacer_stats_t ps;
+    pacer_get_stats(&s.pacer, &ps);
+    const pacer_counter_t *c = paced ? &ps.paced : &ps.unpaced;
+    printf("%s: %lu sends, %lu backpressure (%.1f%%), %.2f Mbps, final rate %lu kbps, %lu decreases, "
+           "waits %lu (avg %lu us, max %lu us, %lu timed out), %lu bulk boosts\n",
+           !paced ? "unpaced             " : (control_first ? "paced, control first" : "paced, shared FIFO  "),
+           (unsigned long)c->sends, (unsigned long)c->backpressure,
+           c->sends ? 100.0 * c->backpressure / c->sends : 0.0, c->bytes * 8.0 / seconds / 1e6,
+           (unsigned long)ps.rate_kbps, (unsigned long)ps.decreases,
+           (unsigned long)ps.waits, (unsigned long)ps.avg_wait_us, (unsigned long)ps.max_wait_us,
+           (unsigned long)ps.drops, (unsigned long)ps.bulk_boosts);
+    for (int i = 0; i < SRC_MAX; i++) {
+        const src_stats_t *st = &s.stats[i];
+        printf("  %-4s: offered %5lu, delivered %5lu (%5.1f%%), backpressure %4lu, dropped %4lu, latency avg %6lu us, max %6lu us\n",
+               src_names[i], (unsigned long)st->offered, (unsigned long)st->delivered,
+               st->offered ? 100.0 * st->delivered / st->offered : 0.0,
+               (unsigned long)st->backpressure, (unsigned long)st->dropped,
+               (unsigned long)(st->delivered ? st->latency_sum_us / st->delivered : 0), (unsigned long)st->latency_max_us);
+    }
+    memcpy(out, s.stats, sizeof(s.stats));
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 60;
+    double rate_mbps = argc > 2 ? atof(argv[2]) : 36.0;
+    if (seconds <= 0 || rate_mbps <= 0) {
+        ESP_LOGE(TAG, "Usage: %s [seconds] [air rate Mbps]", argv[0]);
+        return 1;
+    }
+
+    // 控制应答延迟上限：驱动发送缓冲区全满时排空的时间，加上发送任务正在拷贝的一个大数据报
+    double per_frag_us = AIR_OVERHEAD_US + FRAGMENT * 8 / rate_mbps;
+    uint32_t ctrl_bound_us = (uint32_t)(TX_BUFFERS * per_frag_us) + FPV_BYTES / COPY_BYTES_PER_US;
+
+    // 导出保底：每个数据报最多等待PACER_BULK_MAX_WAIT_MS（按节拍取整）就优先放行，每帧发完后按导出速率休眠
+    const int64_t dump_frame_us = DUMP_DESTS * (PACER_BULK_MAX_WAIT_MS * 1000 + TICK_US) +
+                                  (int64_t)FPV_BYTES * 8 * 1000 / DUMP_RATE_KBPS + TICK_US;
+    int64_t dump_active_us = (int64_t)seconds * 1000000 - DUMP_TRIGGER1_US;
+    uint32_t dump_floor = dump_active_us > 0 ? (uint32_t)(dump_active_us / dump_frame_us) * DUMP_DESTS : 0;
+
+    printf("Simulating %d s, air rate %.1f Mbps, %d TX buffers, %d us tick\n", seconds, rate_mbps, TX_BUFFERS, TICK_US);
+    src_stats_t unpaced[SRC_MAX], fifo[SRC_MAX], first[SRC_MAX];
+    run(false, false, seconds, rate_mbps, unpaced);
+    run(true, false, seconds, rate_mbps, fifo);
+    run(true, true, seconds, rate_mbps, first);
+
+    // 控制应答：单独排队时全部送达、不超过上限，且明显低于共用FIFO（不到一半）
+    const src_stats_t *ctrl = &first[SRC_CTRL];
+    bool ctrl_ok = ctrl->delivered == ctrl->offered && ctrl->latency_max_us <= ctrl_bound_us &&
+                   ctrl->latency_max_us * 2 <= fifo[SRC_CTRL].latency_max_us;
+    printf("control latency max: shared FIFO %lu us, control first %lu us (bound %lu us), delivered %lu/%lu: %s\n",
+           (unsigned long)fifo[SRC_CTRL].latency_max_us, (unsigned long)ctrl->latency_max_us,
+           (unsigned long)ctrl_bound_us, (unsigned long)ctrl->delivered, (unsigned long)ctrl->offered,
+           ctrl_ok ? "PASS" : "FAIL");
+
+    // 预录导出：链路满载时也要按保底份额推进（允许10%的节拍误差）
+    const src_stats_t *dump = &first[SRC_DUMP];
+    uint32_t dump_min = dump_floor < dump->offered ? dump_floor : dump->offered;
+    bool dump_ok = dump->delivered * 10 >= dump_min * 9;
+    printf("dump delivered %lu/%lu (guaranteed share %lu): %s\n",
+           (unsigned long)dump->delivered, (unsigned long)dump->offered, (unsigned long)dump_min,
+           dump_ok ? "PASS" : "FAIL");
+    return (ctrl_ok && dump_ok) ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+// 采集流水线主机压力测试：用模拟帧缓冲池反复启动/停止 components/camera/pipeline.c
+//
+// 编译:
+//   gcc -O2 -Wall -Wextra -I host/include -I components/wifi -I components/camera -o pipeline_stress host/pipeline_stress.c components/camera/pipeline.c -lpthread
+// 运行:
+//   ./pipeline_stress [启停次数] [帧缓冲数]
+//
+// 帧源模拟 esp_camera_fb_get：固定数量的缓冲区，取帧按帧间隔阻塞，池空时超时返回NULL。
+// 每次以随机时长运行后停止，检查：所有缓冲区都已归还、没有重复归还、停止耗时有界、
+// 多次启停后堆内存没有增长。设备端统计见主程序每5秒输出的 "Pipeline" 日志。
+
+#include "pipeline.h"
+#include "esp_log.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *TAG = "pipeline_stress";
+
+#define MAX_BUFFERS 8
+#define FRAME_INTERVAL_US 500       // 模拟帧间隔
+#define GET_TIMEOUT_US 20000        // 池空时取帧超时（对应驱动的取帧超时）
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t returned;
+    int count;
+    bool in_use[MAX_BUFFERS];
+    int frames[MAX_BUFFERS];        // 缓冲区内容：序号
+    int free_count;
+    uint32_t double_puts;
+    uint32_t consumed;
+} frame_pool_t;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *pool_get(void *ctx)
+{
+    frame_pool_t *pool = (frame_pool_t *)ctx;
+    usleep(FRAME_INTERVAL_US);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += GET_TIMEOUT_US * 1000L;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->free_count == 0) {
+        if (pthread_cond_timedwait(&pool->returned, &pool->lock, &deadline) != 0) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+    }
+    void *frame = NULL;
+    for (int i = 0; i < pool->count; i++) {
+        if (!pool->in_use[i]) {
+            pool->in_use[i] = true;
+            pool->free_count--;
+            frame = &pool->frames[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return frame;
+}
+
+static void pool_put(void *ctx, void *frame)
+{
+    frame_pool_t *pool = (frame_pool_t *)ctx;
+    int i = (int)((int *)frame - pool->frames);
+    pthread_mutex_lock(&pool->lock);
+    if (i < 0 || i >= pool->count || !pool->in_use[i]) {
+        pool->double_puts++;
+    } else {
+        pool->in_use[i] = false;
+        pool->free_count++;
+        pthread_cond_signal(&pool->returned);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// 捕获任务中的处理：每3帧有1帧不交给消费者（模拟只发送不显示的帧）
+static bool pool_process(void *ctx, void *frame)
+{
+    (void)ctx;
+    int *seq = (int *)frame;
+    (*seq)++;
+    return (*seq % 3) != 0;
+}
+
+// 消费者：模拟LCD刷新耗时，比帧间隔慢，使队列经常满
+static void pool_consume(void *ctx, void *frame)
+{
+    (void)frame;
+    frame_pool_t *pool = (frame_pool_t *)ctx;
+    __atomic_add_fetch(&pool->consumed, 1, __ATOMIC_RELAXED);
+    usleep(FRAME_INTERVAL_US * 3);
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 16;
+}
+
+int main(int argc, char **argv)
+{
+    int cycles = argc > 1 ? atoi(argv[1]) : 2000;
+    int buffers = argc > 2 ? atoi(argv[2]) : 2;
+    if (buffers < 1 || buffers > MAX_BUFFERS) {
+        ESP_LOGE(TAG, "Buffer count must be 1..%d", MAX_BUFFERS);
+        return 1;
+    }
+
+    static frame_pool_t pool;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.returned, NULL);
+    pool.count = buffers;
+    pool.free_count = buffers;
+
+    static pipeline_t pipeline;
+    pipeline_config_t config = {
+        .get = pool_get,
+        .put = pool_put,
+        .process = pool_process,
+        .consume = pool_consume,
+        .ctx = &pool,
+        .queue_len = 1,
+        .capture_name = "capture",
+        .consumer_name = "consumer",
+        .capture_core = -1,
+        .consumer_core = -1,
+    };
+
+    printf("%d start/stop cycles, %d buffers\n", cycles, buffers);
+
+    // 先运行几次，让libc/pthread的一次性分配（线程栈缓存、TLS等）发生在基线之前
+    for (int c = 0; c < 16; c++) {
+        pipeline_start(&pipeline, &config);
+        usleep(5000);
+        pipeline_stop(&pipeline);
+    }
+    struct mallinfo2 heap_before = mallinfo2();
+
+    bool pool_ok = true;
+    bool stop_ok = true;
+    uint64_t stop_total_us = 0;
+    int64_t t0 = now_us();
+    for (int c = 0; c < cycles; c++) {
+        // 交替有/无消费者，模拟LCD开关切换
+        config.consume = (c & 1) ? NULL : pool_consume;
+        if (!pipeline_start(&pipeline, &config)) {
+            ESP_LOGE(TAG, "Start failed at cycle %d", c);
+            stop_ok = false;
+            break;
+        }
+        // 0~8ms随机运行时间，包括刚启动立即停止
+        uint32_t run_us = rng_next() % 8000;
+        if (run_us > 0) {
+            usleep(run_us);
+        }
+        if (!pipeline_stop(&pipeline)) {
+            stop_ok = false;
+        }
+        stop_total_us += pipeline.stats.last_stop_us;
+        pthread_mutex_lock(&pool.lock);
+        if (pool.free_count != pool.count) {
+            ESP_LOGE(TAG, "Cycle %d: %d buffers not returned", c, pool.count - pool.free_count);
+            pool_ok = false;
+        }
+        pthread_mutex_unlock(&pool.lock);
+        if (!pool_ok || !stop_ok) {
+            break;
+        }
+    }
+    double elapsed_ms = (double)(now_us() - t0) / 1000;
+
+    struct mallinfo2 heap_after = mallinfo2();
+    long heap_growth = (long)heap_after.uordblks - (long)heap_before.uordblks;
+
+    pipeline_stats_t stats;
+    pipeline_get_stats(&pipeline, &stats);
+    printf("  %lu starts, %lu stops in %.0f ms, stop avg %.0f us, max %lu us\n",
+           (unsigned long)stats.starts, (unsigned long)stats.stops, elapsed_ms,
+           (double)stop_total_us / (cycles ? cycles : 1), (unsigned long)stats.max_stop_us);
+    printf("  frames %lu, forwarded %lu, consumed %lu, dropped %lu, drained on stop %lu\n",
+           (unsigned long)stats.frames, (unsigned long)stats.forwarded, (unsigned long)pool.consumed,
+           (unsigned long)stats.dropped, (unsigned long)stats.drained);
+    printf("  outstanding %ld, leaks %lu, stop timeouts %lu, double puts %lu, heap growth %ld bytes\n",
+           (long)stats.outstanding, (unsigned long)stats.leaks, (unsigned long)stats.stop_timeouts,
+           (unsigned long)pool.double_puts, heap_growth);
+
+    // 停止耗时上限：取帧超时 + 交给消费者的超时 + 一次消费耗时，再留出调度余量
+    const uint32_t stop_bound_us = GET_TIMEOUT_US + PIPELINE_FORWARD_TIMEOUT_MS * 1000 + FRAME_INTERVAL_US * 3 + 20000;
+    bool count_ok = stats.starts == stats.stops && stats.forwarded + stats.dropped <= stats.frames;
+    bool leak_ok = pool_ok && stats.outstanding == 0 && stats.leaks == 0 && pool.double_puts == 0;
+    bool bound_ok = stop_ok && stats.stop_timeouts == 0 && stats.max_stop_us <= stop_bound_us;
+    bool heap_ok = heap_growth <= 0;
+
+    printf("  all buffers returned: %s, stop within %lu us: %s, counters consistent: %s, no heap growth: %s\n",
+           leak_ok ? "PASS" : "FAIL", (unsigned long)stop_bound_us, bound_ok ? "PASS" : "FAIL",
+           count_ok ? "PASS" : "FAIL", heap_ok ? "PASS" : "FAIL");
+    return (leak_ok && bound_ok && count_ok && heap_ok) ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+// 像素格式转换主机基准测试：用合成帧驱动 components/camera/pixfmt.c
+//
+// 编译:
+//   gcc -O2 -Wall -Wextra -I host/include -I components/wifi -I components/camera -o pixfmt_bench host/pixfmt_bench.c components/camera/pixfmt.c
+// 运行:
+//   ./pixfmt_bench [帧数] [宽] [高]
+//
+// 检查：RGB565（大端/小端）和YUV422转换为Y8、YUV420的结果与逐像素实现一致，覆盖多种宽高和行填充
+// （包括奇数字节的stride，源数据不按4字节对齐）；分两个条带转换的结果与整帧一致；
+// 奇数宽高和目标缓冲区不足时拒绝转换。然后输出各转换与逐像素实现的每帧耗时。
+
+#include "pixfmt.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "pixfmt_bench";
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 16;
+}
+
+// 随机像素（含全0/全1的极值），行填充字节也填随机值，转换不应读取它们
+static void synth_frame(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint32_t r = rng_next();
+        buf[i] = (r & 0x700) == 0 ? 0x00 : ((r & 0x700) == 0x100 ? 0xFF : (uint8_t)r);
+    }
+}
+
+// 逐像素实现（与pixfmt.c的公式相同，不用SWAR）
+static void scalar_rgb(const wifi_frame_desc_t *src, int x, int y, int *r, int *g, int *b)
+{
+    const uint8_t *p = src->data + (size_t)y * src->stride + x * 2;
+    uint16_t v = (src->flags & UDP_FLAG_BIG_ENDIAN) ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+    *r = (v >> 8) & 0xF8;
+    *g = (v >> 3) & 0xFC;
+    *b = (v << 3) & 0xF8;
+}
+
+static void scalar_convert(const wifi_frame_desc_t *src, uint8_t dst_format, uint8_t *dst)
+{
+    const int w = src->width;
+    const int h = src->height;
+    uint8_t *u_plane = dst + (size_t)w * h;
+    uint8_t *v_plane = u_plane + (size_t)(w / 2) * (h / 2);
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const uint8_t *p = src->data + (size_t)y * src->stride + x * 2;
+            int luma;
+            if (src->format == UDP_FMT_YUV422) {
+                luma = p[0];  // YUYV：每个像素的第一个字节是亮度
+            } else {
+                int r, g, b;
+                scalar_rgb(src, x, y, &r, &g, &b);
+                luma = dst_format == UDP_FMT_GRAY ? (77 * r + 150 * g + 29 * b + 128) >> 8
+                                                  : ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            }
+            dst[(size_t)y * w + x] = (uint8_t)luma;
+        }
+    }
+    if (dst_format != UDP_FMT_YUV420) {
+        return;
+    }
+
+    for (int y = 0; y < h; y += 2) {
+        for (int x = 0; x < w; x += 2) {
+            size_t i = (size_t)(y / 2) * (w / 2) + x / 2;
+            if (src->format == UDP_FMT_YUV422) {
+                const uint8_t *p0 = src->data + (size_t)y * src->stride + x * 2;
+                const uint8_t *p1 = p0 + src->stride;
+                u_plane[i] = (uint8_t)((p0[1] + p1[1] + 1) >> 1);
+                v_plane[i] = (uint8_t)((p0[3] + p1[3] + 1) >> 1);
+                continue;
+            }
+            int rs = 0, gs = 0, bs = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int r, g, b;
+                    scalar_rgb(src, x + dx, y + dy, &r, &g, &b);
+                    rs += r;
+                    gs += g;
+                    bs += b;
+                }
+            }
+            int r = rs >> 2, g = gs >> 2, b = bs >> 2;
+            u_plane[i] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v_plane[i] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+typedef struct {
+    uint8_t format;
+    uint8_t flags;
+    const char *name;
+} src_kind_t;
+
+static const src_kind_t src_kinds[] = {
+    { UDP_FMT_RGB565, UDP_FLAG_BIG_ENDIAN, "RGB565 BE" },
+    { UDP_FMT_RGB565, 0, "RGB565 LE" },
+    { UDP_FMT_YUV422, 0, "YUV422" },
+};
+static const uint8_t dst_formats[] = { UDP_FMT_GRAY, UDP_FMT_YUV420 };
+
+// 一种组合：整帧转换、两个条带转换都与逐像素实现逐字节比较
+static bool check_case(const src_kind_t *kind, uint8_t dst_format, int width, int height, int pad)
+{
+    const int stride = width * 2 + pad;
+    const size_t src_len = (size_t)stride * height;
+    const size_t size = pixfmt_frame_size(dst_format, width, height);
+    uint8_t *src_buf = malloc(src_len + 1);
+    uint8_t *out = malloc(size);
+    uint8_t *ref = malloc(size);
+    if (!src_buf || !out || !ref) {
+        ESP_LOGE(TAG, "Out of memory");
+        exit(1);
+    }
+    synth_frame(src_buf, src_len + 1);
+
+    // 源数据从奇数地址开始，检查非对齐读取
+    wifi_frame_desc_t src = {
+        .data = src_buf + 1, .len = src_len, .width = width, .height = height, .stride = stride,
+        .format = kind->format, .flags = kind->flags | UDP_FLAG_KEYFRAME,
+    };
+    wifi_frame_desc_t desc;
+    scalar_convert(&src, dst_format, ref);
+
+    bool ok = pixfmt_convert(&src, dst_format, out, size, &desc) && memcmp(out, ref, size) == 0 &&
+              desc.data == out && desc.len == size && desc.format == dst_format && desc.stride == width &&
+              !(desc.flags & UDP_FLAG_BIG_ENDIAN) && (desc.flags & UDP_FLAG_KEYFRAME);
+
+    // 在中间的偶数行切成两个条带
+    int split = (height / 2) & ~1;
+    memset(out, 0xA5, size);
+    if (pixfmt_convert_begin(&src, dst_format, out, size, &desc)) {
+        pixfmt_convert_rows(&src, dst_format, out, split, height);
+        pixfmt_convert_rows(&src, dst_format, out, 0, split);
+        ok = ok && memcmp(out, ref, size) == 0;
+    } else {
+        ok = false;
+    }
+
+    if (!ok) {
+        printf("  MISMATCH: %s -> %d, %dx%d, stride %d\n", kind->name, dst_format, width, height, stride);
+    }
+    free(src_buf);
+    free(out);
+    free(ref);
+    return ok;
+}
+
+// 奇数宽高、缓冲区不足、不支持的格式都应拒绝
+static bool check_rejects(void)
+{
+    static uint8_t src_buf[64 * 64 * 2];
+    static uint8_t dst[64 * 64 * 2];
+    wifi_frame_desc_t desc;
+    const int sizes[][2] = { { 33, 32 }, { 32, 33 }, { 1, 2 }, { 15, 15 } };
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t d = 0; d < sizeof(dst_formats); d++) {
+            wifi_frame_desc_t src = {
+                .data = src_buf, .len = sizeof(src_buf), .width = sizes[i][0], .height = sizes[i][1],
+                .stride = sizes[i][0] * 2, .format = UDP_FMT_RGB565,
+            };
+            ok = ok && !pixfmt_convert(&src, dst_formats[d], dst, sizeof(dst), &desc);
+        }
+    }
+
+    wifi_frame_desc_t src = {
+        .data = src_buf, .len = sizeof(src_buf), .width = 64, .height = 64, .stride = 128, .format = UDP_FMT_RGB565,
+    };
+    ok = ok && !pixfmt_convert(&src, UDP_FMT_YUV420, dst, pixfmt_frame_size(UDP_FMT_YUV420, 64, 64) - 1, &desc);
+    ok = ok && !pixfmt_convert(&src, UDP_FMT_RGB565, dst, sizeof(dst), &desc);
+    src.format = UDP_FMT_GRAY;
+    ok = ok && !pixfmt_convert(&src, UDP_FMT_YUV420, dst, sizeof(dst), &desc);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 1000;
+    int width = argc > 2 ? atoi(argv[2]) : 160;
+    int height = argc > 3 ? atoi(argv[3]) : 120;
+    if (frames <= 0 || width < 2 || height < 2 || (width & 1) || (height & 1)) {
+        ESP_LOGE(TAG, "Usage: %s [frames] [even width] [even height]", argv[0]);
+        return 1;
+    }
+
+    // 正确性：各格式组合 x 宽高 x 行填充（0/1/3/6字节）
+    const int widths[] = { 2, 4, 6, 34, 160 };
+    const int heights[] = { 2, 4, 6, 120 };
+    const int pads[] = { 0, 1, 3, 6 };
+    int cases = 0, failed = 0;
+    for (size_t k = 0; k < sizeof(src_kinds) / sizeof(src_kinds[0]); k++) {
+        for (size_t d = 0; d < sizeof(dst_formats); d++) {
+            for (size_t wi = 0; wi < sizeof(widths) / sizeof(widths[0]); wi++) {
+                for (size_t hi = 0; hi < sizeof(heights) / sizeof(heights[0]); hi++) {
+                    for (size_t pi = 0; pi < sizeof(pads) / sizeof(pads[0]); pi++) {
+                        cases++;
+                        failed += !check_case(&src_kinds[k], dst_formats[d], widths[wi], heights[hi], pads[pi]);
+                    }
+                }
+            }
+        }
+    }
+    bool rejects_ok = check_rejects();
+
+    // 性能：整帧转换与逐像素实现对比
+    const size_t src_len = (size_t)width * height * 2;
+    uint8_t *src_buf = malloc(src_len);
+    uint8_t *dst = malloc(src_len);
+    if (!src_buf || !dst) {
+        ESP_LOGE(TAG, "Out of memory");
+        return 1;
+    }
+    synth_frame(src_buf, src_len);
+    printf("Frame %dx%d, %d frames\n", width, height, frames);
+    for (size_t k = 0; k < sizeof(src_kinds) / sizeof(src_kinds[0]); k++) {
+        for (size_t d = 0; d < sizeof(dst_formats); d++) {
+            wifi_frame_desc_t src = {
+                .data = src_buf, .len = src_len, .width = width, .height = height, .stride = width * 2,
+                .format = src_kinds[k].format, .flags = src_kinds[k].flags,
+            };
+            wifi_frame_desc_t desc;
+            int64_t t0 = now_us();
+            for (int f = 0; f < frames; f++) {
+                pixfmt_convert(&src, dst_formats[d], dst, src_len, &desc);
+                __asm__ volatile("" ::: "memory");
+            }
+            double t_swar = (double)(now_us() - t0) / frames;
+            t0 = now_us();
+            for (int f = 0; f < frames; f++) {
+                scalar_convert(&src, dst_formats[d], dst);
+                __asm__ volatile("" ::: "memory");
+            }
+            double t_scalar = (double)(now_us() - t0) / frames;
+            printf("  %-9s -> %-6s %7.1f us/frame (per-pixel %7.1f us)\n", src_kinds[k].name,
+                   dst_formats[d] == UDP_FMT_GRAY ? "Y8" : "YUV420", t_swar, t_scalar);
+        }
+    }
+
+    printf("  %d cases match per-pixel reference: %s, odd sizes/small buffer rejected: %s\n",
+           cases, failed == 0 ? "PASS" : "FAIL", rejects_ok ? "PASS" : "FAIL");
+    free(src_buf);
+    free(dst);
+    return (failed == 0 && rejects_ok) ? 0 : 1;
+}
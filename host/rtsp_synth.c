@@ -0,0 +1,93 @@
+// RTSP/RTP 主机测试程序：用合成帧源驱动 components/wifi 的 rtp.c / rtsp.c
+//
+// 编译:
+//   gcc -O2 -Wall -I host/include -I components/wifi -o rtsp_synth host/rtsp_synth.c components/wifi/rtp.c components/wifi/rtsp.c
+// 运行:
+//   ./rtsp_synth [端口] [宽] [高] [fps]
+//   ffprobe -rtsp_transport udp rtsp://127.0.0.1:8554/stream
+//   ffplay rtsp://127.0.0.1:8554/stream
+
+#include "rtsp.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "rtsp_synth";
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 生成移动彩条（大端RGB565，与esp32-camera输出一致）
+static void synth_frame(uint8_t *buf, int width, int height, uint32_t frame_no)
+{
+    static const uint16_t bars[8] = {
+        0xFFFF, 0xFFE0, 0x07FF, 0x07E0, 0xF81F, 0xF800, 0x001F, 0x0000
+    };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint16_t v = bars[(((x + frame_no) * 8) / width) % 8];
+            if (y >= height - 8 && x < (int)(frame_no % width)) {
+                v = 0xFFFF;  // 底部进度条，便于肉眼确认帧在更新
+            }
+            buf[(y * width + x) * 2] = v >> 8;
+            buf[(y * width + x) * 2 + 1] = v & 0xFF;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int port = argc > 1 ? atoi(argv[1]) : RTSP_PORT;
+    int width = argc > 2 ? atoi(argv[2]) : 160;
+    int height = argc > 3 ? atoi(argv[3]) : 120;
+    int fps = argc > 4 ? atoi(argv[4]) : 30;
+
+    uint8_t *buf = malloc((size_t)width * height * 2);
+    if (!buf || !rtsp_server_init(port)) {
+        return 1;
+    }
+
+    const int64_t interval_us = 1000000 / fps;
+    int64_t next_frame = now_us();
+    int64_t last_report = next_frame;
+    uint32_t frame_no = 0;
+
+    while (1) {
+        int64_t wait_us = next_frame - now_us();
+        rtsp_server_poll(wait_us > 0 ? (int)(wait_us / 1000) : 0);
+        if (now_us() < next_frame) {
+            continue;
+        }
+        next_frame += interval_us;
+
+        synth_frame(buf, width, height, frame_no++);
+        wifi_frame_desc_t desc = {
+            .data = buf,
+            .len = (size_t)width * height * 2,
+            .width = width,
+            .height = height,
+            .stride = width * 2,
+            .format = UDP_FMT_RGB565,
+            .flags = UDP_FLAG_BIG_ENDIAN | UDP_FLAG_KEYFRAME,
+            .timestamp_us = now_us(),
+        };
+        int64_t start = now_us();
+        rtsp_server_send_frame(&desc);
+        int64_t cost = now_us() - start;
+
+        if (now_us() - last_report >= 1000000) {
+            rtsp_stats_t stats;
+            rtsp_server_get_stats(&stats);
+            ESP_LOGI(TAG, "sessions=%d playing=%d multicast=%d frames=%u packets=%u bytes=%u errors=%u send=%lldus",
+                     stats.sessions, stats.playing, stats.multicast_viewers, stats.frames_sent,
+                     stats.packets_sent, stats.bytes_sent, stats.send_errors, (long long)cost);
+            last_report = now_us();
+        }
+    }
+}
@@ -2,12 +2,37 @@
 #include "camera.h"
 #include "uart.h"
 #include "lcd.h"
+#include "i2c_bus.h"
 #include "wifi.h"
+#include "wifi_http.h"
+#include "rtsp.h"
+#include "stripe.h"
+#include "power.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_camera.h"
 
+// 传感器预设（camera_profile_t），低延迟图传可改为 CAMERA_PROFILE_LOW_LATENCY
+#define CAMERA_FPV_PROFILE CAMERA_PROFILE_DEFAULT
+
+// 为1时启动前依次测试所有预设的实际帧率和采集延迟（不处理/模拟每帧50ms处理各一轮）
+#define CAMERA_PROFILE_BENCHMARK 0
+#define CAMERA_PROFILE_BENCHMARK_FRAMES 150
+
+// WiFi链路配置（wifi_link_profile_t），远距离可改为 WIFI_LINK_MAX_RANGE
+#define WIFI_FPV_LINK_PROFILE WIFI_LINK_LOW_LATENCY
+
+// 为1时连接后依次探测所有链路配置的吞吐、发送耗时和到网关的往返延迟
+#define WIFI_LINK_PROBE 0
+#define WIFI_LINK_PROBE_MS 3000
+
+// 为0时关闭UDP发送节奏控制（仍统计发送缓冲区不足次数，用于对比）
+#define WIFI_UDP_PACING 1
+
+// v2帧头中的设备ID（多摄像头汇聚时区分来源），0表示使用STA MAC地址后4字节
+#define FPV_DEVICE_ID 0
+
 void app_main(void)
 {
     ESP_LOGI("main", "ESP32 Camera System Starting...");
@@ -38,7 +63,8 @@ void app_main(void)
         .enable_fps_monitor = true,      // 保留帧率监控
         .enable_capture_task = true,     // 启用捕获任务为FPV提供数据
         .xclk_freq_hz = 24000000,       // 24MHz时钟（立创例程验证稳定）
-        .frame_size = FRAMESIZE_QQVGA    // 160x120分辨率（实际工作分辨率）
+        .frame_size = FRAMESIZE_QQVGA,   // 160x120分辨率（实际工作分辨率）
+        .stream_format = CAMERA_STREAM_RGB565  // Y8/YUV420可将每帧负载减半或更少
     };
     
     // 选择FPV模式配置
@@ -50,13 +76,31 @@ void app_main(void)
         return;
     }
     
+    // 选择传感器预设（XCLK、帧缓冲区数量、取帧模式、曝光上限）
+    camera_set_profile(CAMERA_FPV_PROFILE);
+    
     // 初始化摄像头组件（摄像头会使用已初始化的I2C总线和配置）
     if (!camera_init()) {
         ESP_LOGE("main", "Camera initialization failed");
         return;
     }
     
+#if CAMERA_PROFILE_BENCHMARK
+    // 预设基准测试：GRAB_WHEN_EMPTY在处理慢于传感器时会取到排队的旧帧，GRAB_LATEST总是取最新帧
+    const uint32_t bench_work_ms[] = {0, 50};
+    for (int w = 0; w < 2; w++) {
+        for (int p = 0; p < CAMERA_PROFILE_MAX; p++) {
+            camera_profile_bench_t bench;
+            camera_benchmark_profile((camera_profile_t)p, CAMERA_PROFILE_BENCHMARK_FRAMES, bench_work_ms[w], &bench);
+        }
+    }
+    camera_set_profile(CAMERA_FPV_PROFILE);
+#endif
+    
     // 初始化WiFi组件（用于FPV图传）
+    wifi_set_link_profile(WIFI_FPV_LINK_PROFILE);
+    wifi_set_pacing(WIFI_UDP_PACING);
+    wifi_set_device_id(FPV_DEVICE_ID);
     if (!wifi_init_sta(WIFI_SSID, WIFI_PASSWORD)) {
         ESP_LOGE("main", "WiFi initialization failed");
         return;
@@ -77,6 +121,18 @@ void app_main(void)
     }
     ESP_LOGI("main", "WiFi connected successfully!");
     
+#if WIFI_LINK_PROBE
+    // 链路探测：每个配置饱和发送UDP并ping网关，比较省电模式、带宽、协议集和发射功率的影响
+    for (int p = 0; p < WIFI_LINK_MAX; p++) {
+        wifi_link_probe_t probe;
+        wifi_link_probe((wifi_link_profile_t)p, WIFI_LINK_PROBE_MS, &probe);
+    }
+    wifi_set_link_profile(WIFI_FPV_LINK_PROFILE);
+    for (int i = 0; i < 100 && !wifi_is_connected(); i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+#endif
+    
     // 启动摄像头功能（根据配置自动启动相应模块）
     if (!camera_start()) {
         ESP_LOGE("main", "Failed to start camera");
@@ -90,12 +146,28 @@ void app_main(void)
         return;
     }
     
+    // 启动设备端MJPEG视频流（浏览器直接访问 http://<设备IP>/stream）
+    if (!wifi_http_stream_start(WIFI_HTTP_PORT)) {
+        ESP_LOGW("main", "HTTP stream server failed to start, UDP FPV only");
+    }
+    
+    // 启动RTSP服务器（VLC/ffmpeg/NVR: rtsp://<设备IP>:8554/stream）
+    if (!rtsp_server_start(RTSP_PORT)) {
+        ESP_LOGW("main", "RTSP server failed to start");
+    }
+    
+    // 启动预录（PSRAM保留最近几秒的帧，运动/远程命令触发时导出给接收端）
+    if (!camera_prerec_start(NULL)) {
+        ESP_LOGW("main", "Pre-record failed to start");
+    }
+    
     ESP_LOGI("main", "FPV Camera system started successfully!");
-    ESP_LOGI("main", "Current config: LCD=%d, FPS=%d, Capture=%d, Clock=%lu", 
+    ESP_LOGI("main", "Current config: LCD=%d, FPS=%d, Capture=%d, Clock=%lu, Profile=%s", 
                selected_config.enable_lcd_display,
                selected_config.enable_fps_monitor, 
                selected_config.enable_capture_task,
-               selected_config.xclk_freq_hz);
+               camera_get_config()->xclk_freq_hz,
+               camera_profile_name(camera_get_profile()));
     
     // 获取WiFi信息用于显示
     wifi_info_t wifi_info;
@@ -116,6 +188,172 @@ void app_main(void)
         if (wifi_get_stats(&frames_sent, &packets_sent, &bytes_sent, &fps)) {
             ESP_LOGI("main", "FPV Status - FPS: %.1f, Frames: %lu, Packets: %lu, Throughput: %.2f Mbps", 
                        fps, frames_sent, packets_sent, (float)bytes_sent * 8 / 5000 / 1000000);
+            ESP_LOGI("main", "FPV Link - Header: v%d, Clock sync pings: %lu",
+                       wifi_get_frame_version(), wifi_get_sync_count());
+        }
+        
+        // 获取WiFi链路参数（省电模式、带宽、协商的PHY模式、发射功率、信号强度）
+        wifi_link_status_t link_status;
+        if (wifi_get_link_status(&link_status)) {
+            ESP_LOGI("main", "WiFi Link - Profile: %s, PHY: %s, BW: %d MHz, PS: %s, TX power: %d.%02d dBm, RSSI: %d dBm",
+                       link_status.name, link_status.phy_mode, link_status.bandwidth, link_status.ps_mode,
+                       link_status.tx_power_qdbm / 4, link_status.tx_power_qdbm % 4 * 25, link_status.rssi);
+        }
+        
+        // 获取发送节奏控制统计（开启/关闭时的发送缓冲区不足次数、等待令牌的时间）
+        pacer_stats_t pacer_stats;
+        if (wifi_get_pacer_stats(&pacer_stats)) {
+            const pacer_counter_t *c = pacer_stats.enabled ? &pacer_stats.paced : &pacer_stats.unpaced;
+            ESP_LOGI("main", "Pacer - %s, Rate: %lu kbps, Sends: %lu, Backpressure: %lu, Waits: %lu (avg %lu us, max %lu us), Timeouts: %lu, Decreases: %lu, Bulk boosts: %lu",
+                       pacer_stats.enabled ? "on" : "off", pacer_stats.rate_kbps, c->sends, c->backpressure,
+                       pacer_stats.waits, pacer_stats.avg_wait_us, pacer_stats.max_wait_us,
+                       pacer_stats.drops, pacer_stats.decreases, pacer_stats.bulk_boosts);
+        }
+        
+        // 获取发送队列统计（其他任务交给发送任务的请求：队列长度、入队到发送的时间）
+        wifi_sendq_stats_t sendq_stats;
+        if (wifi_get_sendq_stats(&sendq_stats)) {
+            ESP_LOGI("main", "Send Queue - Depth: %lu/%lu (max %lu), Requests: %lu, Full: %lu, Errors: %lu, Timeouts: %lu (cancelled %lu), Wait: avg %lu us (max %lu us, control %lu us), Frame wait: avg %lu us (max %lu us)",
+                       sendq_stats.depth, sendq_stats.capacity, sendq_stats.max_depth, sendq_stats.requests,
+                       sendq_stats.full, sendq_stats.errors, sendq_stats.timeouts, sendq_stats.cancelled,
+                       sendq_stats.avg_wait_us, sendq_stats.max_wait_us, sendq_stats.ctrl_max_wait_us,
+                       sendq_stats.frame_avg_wait_us, sendq_stats.frame_max_wait_us);
+        }
+        
+        // 获取断线重连统计（断线时长、重新获取IP到第一帧发出的时间）
+        wifi_reconnect_stats_t reconnect_stats;
+        if (wifi_get_reconnect_stats(&reconnect_stats) && reconnect_stats.outages > 0) {
+            ESP_LOGI("main", "WiFi Reconnect - %s, Outages: %lu, Attempts: %lu, Last outage: %lu ms (max %lu ms, total %lu ms), First frame: %lu ms (max %lu ms), Reason: %d",
+                       reconnect_stats.state == WIFI_STATE_CONNECTED ? "connected" : "reconnecting",
+                       reconnect_stats.outages, reconnect_stats.attempts,
+                       reconnect_stats.state == WIFI_STATE_RECONNECTING ? reconnect_stats.current_outage_ms : reconnect_stats.last_outage_ms,
+                       reconnect_stats.max_outage_ms, reconnect_stats.total_outage_ms,
+                       reconnect_stats.last_resume_ms, reconnect_stats.max_resume_ms, reconnect_stats.last_reason);
+        }
+        
+        // 各订阅者的发送/丢弃统计
+        wifi_subscriber_info_t subs[WIFI_MAX_SUBSCRIBERS];
+        int sub_count = wifi_get_subscribers(subs, WIFI_MAX_SUBSCRIBERS);
+        for (int i = 0; i < sub_count; i++) {
+            ESP_LOGI("main", "FPV Subscriber %d.%d.%d.%d:%d - v%d, 1/%d frames, Sent: %lu, Dropped: %lu%s",
+                       (int)(subs[i].ip & 0xFF), (int)((subs[i].ip >> 8) & 0xFF),
+                       (int)((subs[i].ip >> 16) & 0xFF), (int)((subs[i].ip >> 24) & 0xFF),
+                       subs[i].port, subs[i].version, subs[i].frame_divider,
+                       subs[i].frames_sent, subs[i].frames_dropped, subs[i].is_static ? " (default)" : "");
+        }
+        
+        // 获取HTTP视频流统计信息
+        wifi_http_stats_t http_stats;
+        if (wifi_http_stream_get_stats(&http_stats) && http_stats.clients > 0) {
+            ESP_LOGI("main", "HTTP Stream - Clients: %d, Encoded: %lu, Sent: %lu, Dropped: %lu, Encode: %lu us",
+                       http_stats.clients, http_stats.frames_encoded, http_stats.frames_sent,
+                       http_stats.frames_dropped, http_stats.encode_time_us);
+        }
+        
+        // 获取RTSP/RTP统计信息
+        rtsp_stats_t rtsp_stats;
+        if (rtsp_server_get_stats(&rtsp_stats) && (rtsp_stats.playing || rtsp_stats.multicast_viewers)) {
+            ESP_LOGI("main", "RTSP - Unicast: %d, Multicast: %d, Frames: %lu, Packets: %lu, Errors: %lu",
+                       rtsp_stats.playing, rtsp_stats.multicast_viewers, rtsp_stats.frames_sent,
+                       rtsp_stats.packets_sent, rtsp_stats.send_errors);
+        }
+        
+        // 获取运动检测统计信息
+        camera_motion_stats_t motion_stats;
+        if (camera_get_motion_stats(&motion_stats) && motion_stats.enabled) {
+            ESP_LOGI("main", "Motion - %s, Score: %d, Boxes: %d, Events: %lu, Gated: %lu, Time: %lu us (max %lu us)",
+                       motion_stats.active ? "active" : "idle", motion_stats.score, motion_stats.box_count,
+                       motion_stats.events, motion_stats.frames_gated,
+                       motion_stats.process_time_us, motion_stats.max_process_time_us);
+        }
+        
+        // 获取帧统计信息（亮度分布、清晰度、自动曝光）
+        camera_frame_stats_t frame_stats;
+        if (camera_get_frame_stats(&frame_stats) && frame_stats.enabled && frame_stats.frames > 0) {
+            ESP_LOGI("main", "Stats - Mean: %d, Metered: %d, P5/P50/P95: %d/%d/%d, Sharpness: %lu (ref %lu)%s%s, Time: %lu us (max %lu us)",
+                       frame_stats.result.mean, frame_stats.metered_luma,
+                       frame_stats.result.p5, frame_stats.result.p50, frame_stats.result.p95,
+                       frame_stats.result.sharpness, frame_stats.result.sharpness_ref,
+                       frame_stats.result.blurred ? ", BLURRED" : "",
+                       frame_stats.result.obstructed ? ", OBSTRUCTED" : "",
+                       frame_stats.process_time_us, frame_stats.max_process_time_us);
+            if (frame_stats.ae_enabled) {
+                ESP_LOGI("main", "AE - Exposure: %d, Gain: %d.%02dx, Updates: %lu, Errors: %lu",
+                           frame_stats.ae_exposure, frame_stats.ae_gain_x16 / 16, frame_stats.ae_gain_x16 % 16 * 100 / 16,
+                           frame_stats.ae_updates, frame_stats.ae_errors);
+            }
+        }
+        
+        // 获取各功耗档位的帧率、处理延迟和估计电流
+        power_stats_t power_stats;
+        if (power_get_stats(&power_stats)) {
+            ESP_LOGI("main", "Power - Profile: %s, PM: %s, Transitions: %lu, Avg est.: %d mA",
+                       power_state_name(power_stats.state), power_stats.pm_enabled ? "on" : "off",
+                       power_stats.transitions, power_stats.avg_current_ma);
+            for (int i = 0; i < POWER_STATE_MAX; i++) {
+                const power_profile_stats_t *p = &power_stats.profiles[i];
+                if (p->time_ms == 0) {
+                    continue;
+                }
+                ESP_LOGI("main", "Power %-9s - CPU: %d MHz, Time: %lu s, FPS: %lu.%lu, Latency: %lu us (max %lu us), Est.: %d mA",
+                           power_state_name((power_state_t)i), p->cpu_mhz, p->time_ms / 1000,
+                           p->fps_x10 / 10, p->fps_x10 % 10, p->avg_latency_us, p->max_latency_us, p->est_current_ma);
+            }
+        }
+        
+        // 获取I2C总线统计信息（PCA9557和摄像头寄存器写入）
+        i2c_bus_stats_t bus_stats;
+        i2c_bus_get_stats(&bus_stats);
+        ESP_LOGI("main", "I2C - Transactions: %lu, Writes: %lu, Reads: %lu, Skipped: %lu, Errors: %lu, Busy: %lu us, Batch: %lu us (max %lu us), Max wait: %lu us",
+                   bus_stats.transactions, bus_stats.writes, bus_stats.reads, bus_stats.skipped, bus_stats.errors,
+                   bus_stats.busy_us, bus_stats.last_batch_us, bus_stats.max_batch_us, bus_stats.max_wait_us);
+        
+        // 获取采集流水线统计信息（停止耗时、未归还的帧缓冲区）
+        pipeline_stats_t pipe_stats;
+        if (camera_get_pipeline_stats(&pipe_stats) && pipe_stats.starts > 0) {
+            ESP_LOGI("main", "Pipeline - Frames: %lu, LCD: %lu (dropped %lu), Outstanding: %ld, Restarts: %lu, Last stop: %lu us (max %lu us), Leaks: %lu",
+                       pipe_stats.frames, pipe_stats.forwarded, pipe_stats.dropped, pipe_stats.outstanding,
+                       pipe_stats.stops, pipe_stats.last_stop_us, pipe_stats.max_stop_us, pipe_stats.leaks);
+        }
+        
+        // 获取ISP后处理统计信息
+        camera_isp_stats_t isp_stats;
+        if (camera_get_isp_stats(&isp_stats) && isp_stats.enabled) {
+            ESP_LOGI("main", "ISP - Frames: %lu, Skipped: %lu, Sharpen: %s, Time: %lu us (max %lu us)",
+                       isp_stats.frames, isp_stats.frames_skipped, isp_stats.sharpen ? "on" : "off",
+                       isp_stats.process_time_us, isp_stats.max_process_time_us);
+        }
+        
+        // 获取双核分条带处理统计信息（加速比 = 单核耗时 / 双核耗时）
+        for (int i = 0; i < STRIPE_STAGE_MAX; i++) {
+            stripe_stage_stats_t stripe_stats;
+            if (stripe_get_stats(i, &stripe_stats) && stripe_stats.calls > 0) {
+                ESP_LOGI("main", "Stripe %s - Single: %lu us, Split: %lu us, Speedup: %d.%02dx, Split calls: %lu/%lu, Using: %s",
+                           stripe_stats.name, stripe_stats.single_us, stripe_stats.split_us,
+                           stripe_stats.speedup_x100 / 100, stripe_stats.speedup_x100 % 100,
+                           stripe_stats.split_calls, stripe_stats.calls,
+                           stripe_stats.split_preferred ? "dual-core" : "single-core");
+            }
+        }
+        
+        // 获取预录统计信息
+        camera_prerec_stats_t prerec_stats;
+        if (camera_get_prerec_stats(&prerec_stats) && prerec_stats.enabled) {
+            ESP_LOGI("main", "PreRec - Memory: %lu KB, Used: %lu KB, Frames: %d (%lu ms), Dropped: %lu, Write: %lu us, Triggers: %lu, Dumped: %lu frames%s",
+                       prerec_stats.memory_bytes / 1024, prerec_stats.used_bytes / 1024,
+                       prerec_stats.frames_retained, prerec_stats.retained_ms, prerec_stats.frames_dropped,
+                       prerec_stats.record_time_us, prerec_stats.triggers, prerec_stats.frames_dumped,
+                       prerec_stats.dumping ? " (dumping)" : "");
+        }
+        
+        // 获取快照统计信息
+        camera_snapshot_stats_t snapshot_stats;
+        if (camera_get_snapshot_stats(&snapshot_stats) && snapshot_stats.count > 0) {
+            ESP_LOGI("main", "Snapshot - Count: %lu, Failures: %lu, Last: %dx%d %lu bytes in %lu ms, Gap: %lu ms / %lu frames (max %lu ms), Restore failures: %lu",
+                       snapshot_stats.count, snapshot_stats.failures, snapshot_stats.last_width,
+                       snapshot_stats.last_height, snapshot_stats.last_size, snapshot_stats.last_capture_ms,
+                       snapshot_stats.last_gap_ms, snapshot_stats.last_gap_frames, snapshot_stats.max_gap_ms,
+                       snapshot_stats.restore_failures);
         }
         
         // 获取摄像头帧率（如果启用了监控）
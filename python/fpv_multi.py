@@ -0,0 +1,358 @@
+#!/usr/bin/env python3
+"""
+ESP32 FPV 多摄像头汇聚接收
+一个UDP端口同时接收多台设备的视频流，按帧头中的设备ID（旧固件按来源地址）分流，
+每路独立统计序号/丢帧、时钟同步和时延，并各自输出Web视频流；另外合成一路网格画面
+"""
+
+import argparse
+import math
+import socket
+import threading
+import time
+from collections import deque
+
+import cv2
+import numpy as np
+
+from fpv_receiver import (
+    FPVReceiver, MjpegBroadcaster, ClockSync, logger, now_us, percentiles, frame_payload_size,
+    CTRL_HEADER, HELLO_PACKET, SYNC_PACKET, UDP_CTRL_MAGIC, UDP_CTRL_HELLO, UDP_CTRL_PING, UDP_CTRL_PONG,
+    UDP_FRAME_VERSION_MAX, UDP_FLAG_MOTION, UDP_FLAG_RECORDED, UDP_PORT, HELLO_INTERVAL, PING_INTERVAL,
+    LATENCY_WINDOW, FRAME_WIDTH, FRAME_HEIGHT,
+)
+
+MAX_SOURCES = 64            # 自动接纳的来源数上限，超过后新来源的帧丢弃并计入 rejected_sources
+SOURCE_TIMEOUT = 5.0        # 秒，超过该时间没有帧的来源标记为离线（保留统计，不再发HELLO/PING）
+MOSAIC_FPS = 15             # 网格画面合成帧率
+MOSAIC_SIZE = (960, 720)    # 网格画面Web输出尺寸
+
+
+class SourceStream:
+    """一路视频流（一台设备）的接收状态"""
+
+    def __init__(self, key: str, device_id, addr):
+        self.key = key
+        self.device_id = device_id
+        self.addr = addr
+        self.clock_sync = ClockSync()
+        self.last_seq = None
+        self.latency_deltas = deque(maxlen=LATENCY_WINDOW)
+        self.capture_to_receive = deque(maxlen=LATENCY_WINDOW)
+        self.last_hello_time = 0.0
+        self.last_ping_time = 0.0
+        self.ping_seq = 0
+        self.last_frame_time = time.time()
+        self.fps_frames = 0
+        self.fps_time = time.time()
+        self.frame = None           # 最新解码帧
+        self.frame_id = 0           # 已解码帧数，网格合成据此判断是否有新帧
+        self.mjpeg = MjpegBroadcaster()
+        self.stats = {
+            'frames_received': 0,
+            'bytes': 0,
+            'fps': 0.0,
+            'header_version': 0,
+            'frames_lost': 0,
+            'frames_reordered': 0,
+            'one_way_latency_ms': 0.0,
+            'motion_active': False,
+            'recorded_frames': 0,
+        }
+
+    @property
+    def online(self) -> bool:
+        return time.time() - self.last_frame_time < SOURCE_TIMEOUT
+
+    def track(self, header: dict, size: int, recv_us: float):
+        """统计帧数/字节数/帧率，根据序号统计丢帧/乱序，根据采集时间戳计算时延"""
+        now = time.time()
+        self.last_frame_time = now
+        self.stats['frames_received'] += 1
+        self.stats['bytes'] += size
+        self.stats['header_version'] = header['version']
+        self.stats['motion_active'] = bool(header['flags'] & UDP_FLAG_MOTION)
+        self.fps_frames += 1
+        if now - self.fps_time >= 1.0:
+            self.stats['fps'] = self.fps_frames / (now - self.fps_time)
+            self.fps_frames = 0
+            self.fps_time = now
+
+        seq = header['seq']
+        if seq is None:
+            return
+        if self.last_seq is not None:
+            gap = (seq - self.last_seq) & 0xFFFFFFFF
+            if gap == 0 or gap > 0x7FFFFFFF:
+                # 序号回退：乱序或重复，丢弃的帧已计入丢失，这里回补
+                self.stats['frames_reordered'] += 1
+                self.stats['frames_lost'] = max(0, self.stats['frames_lost'] - 1)
+                return
+            self.stats['frames_lost'] += gap - 1
+        self.last_seq = seq
+
+        # 每台设备的时钟各自同步
+        if self.clock_sync.synced:
+            capture_us = self.clock_sync.device_to_host_us(header['timestamp_us'])
+            self.capture_to_receive.append(recv_us - capture_us)
+            self.stats['one_way_latency_ms'] = (recv_us - capture_us) / 1000.0
+            return
+        delta_us = recv_us - header['timestamp_us']
+        self.latency_deltas.append(delta_us)
+        self.stats['one_way_latency_ms'] = (delta_us - min(self.latency_deltas)) / 1000.0
+
+    def get_stats(self) -> dict:
+        stats = self.stats.copy()
+        stats['device_id'] = self.device_id
+        stats['addr'] = f"{self.addr[0]}:{self.addr[1]}"
+        stats['online'] = self.online
+        stats['clock_sync'] = self.clock_sync.get_state()
+        stats['latency_ms'] = {'capture_to_receive': percentiles(list(self.capture_to_receive))}
+        if self.mjpeg.running:
+            stats['mjpeg'] = self.mjpeg.get_state()
+        return stats
+
+
+class MultiFPVReceiver(FPVReceiver):
+    """多摄像头汇聚接收器：单个socket接收所有设备，按来源分流
+
+    设备由 devices 列出（主动发送HELLO订阅），也可以是已把本机配置为目标地址的设备，
+    收到帧后自动接纳。每路的HELLO/PING发往该路帧的来源地址，PONG按来源地址找回对应的流。
+    抖动缓冲和本地窗口不用于多路模式，帧收到后直接解码。
+    """
+
+    def __init__(self, bind_ip: str = '0.0.0.0', port: int = UDP_PORT, devices=(),
+                 frame_divider: int = 1, decode: bool = True, max_sources: int = MAX_SOURCES):
+        super().__init__(bind_ip=bind_ip, port=port, enable_gpu=False, display_window=False,
+                         esp32_ip=None, frame_divider=frame_divider, jitter_max_ms=0)
+        self.devices = list(devices)        # 主动订阅的设备IP
+        self.decode = decode                # False时只统计不解码（纯接收负载测试）
+        self.max_sources = max_sources
+        self.sources = {}                   # key -> SourceStream
+        self.addr_index = {}                # 来源地址 -> SourceStream
+        self.sources_lock = threading.Lock()
+        self.last_device_hello = 0.0
+        self.mjpeg = MjpegBroadcaster(size=MOSAIC_SIZE)  # 网格画面
+        self.stats['bad_packets'] = 0
+        self.stats['rejected_sources'] = 0
+        self.stats['bytes'] = 0
+
+    def start(self):
+        super().start()
+        if self.decode:
+            self.mosaic_thread = threading.Thread(target=self._mosaic_loop, daemon=True)
+            self.mosaic_thread.start()
+        logger.info(f"多路接收: 订阅设备 {', '.join(self.devices) or '无（等待设备推流）'}")
+
+    def stop(self):
+        super().stop()
+        with self.sources_lock:
+            for source in self.sources.values():
+                source.mjpeg.stop()
+
+    def add_device(self, ip: str):
+        """增加主动订阅的设备"""
+        if ip and ip not in self.devices:
+            self.devices.append(ip)
+
+    @staticmethod
+    def source_key(device_id, addr) -> str:
+        """设备ID非0时按设备ID区分（设备换IP后仍是同一路），否则按来源地址"""
+        if device_id:
+            return f"{device_id:08x}"
+        return f"{addr[0]}:{addr[1]}"
+
+    def _get_source(self, header: dict, addr):
+        key = self.source_key(header['device_id'], addr)
+        with self.sources_lock:
+            source = self.sources.get(key)
+            if source is None:
+                if len(self.sources) >= self.max_sources:
+                    self.stats['rejected_sources'] += 1
+                    return None
+                source = SourceStream(key, header['device_id'], addr)
+                if self.decode:
+                    source.mjpeg.start()
+                self.sources[key] = source
+                logger.info(f"新视频流 {key} 来自 {addr[0]}:{addr[1]}，共 {len(self.sources)} 路")
+            if source.addr != addr:
+                # 同一设备ID换了地址（重连/DHCP），控制包改发新地址
+                self.addr_index.pop(source.addr, None)
+                source.addr = addr
+            self.addr_index[addr] = source
+            return source
+
+    def _send_ctrl(self):
+        """给每路在线的流发送HELLO保活和时钟同步PING，给尚未出现的订阅设备发送HELLO"""
+        now = time.time()
+        hello = HELLO_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_HELLO, UDP_FRAME_VERSION_MAX, self.frame_divider)
+        with self.sources_lock:
+            sources = list(self.sources.values())
+        known_ips = {source.addr[0] for source in sources if source.online}
+        targets = []
+        if now - self.last_device_hello >= HELLO_INTERVAL:
+            self.last_device_hello = now
+            targets += [(hello, (ip, UDP_PORT)) for ip in self.devices if ip not in known_ips]
+        for source in sources:
+            if not source.online:
+                continue
+            if now - source.last_hello_time >= HELLO_INTERVAL:
+                source.last_hello_time = now
+                targets.append((hello, source.addr))
+            if now - source.last_ping_time >= PING_INTERVAL:
+                source.last_ping_time = now
+                source.ping_seq = (source.ping_seq + 1) & 0xFFFFFFFF
+                targets.append((SYNC_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_PING, UDP_FRAME_VERSION_MAX,
+                                                 source.ping_seq, int(now_us()), 0, 0), source.addr))
+        for packet, target in targets:
+            try:
+                self.socket.sendto(packet, target)
+            except OSError as e:
+                logger.debug(f"发送控制包到 {target} 失败: {e}")
+
+    def _receive_loop(self):
+        """接收所有来源的数据包并按来源分流"""
+        while self.running:
+            self._send_ctrl()
+            try:
+                data, addr = self.socket.recvfrom(65536)
+            except socket.timeout:
+                continue
+            except OSError as e:
+                logger.debug(f"接收错误: {e}")
+                continue
+            recv_us = now_us()
+            try:
+                self._handle_packet(data, addr, recv_us)
+            except Exception as e:
+                logger.error(f"处理来自 {addr} 的数据包错误: {e}")
+
+    def _handle_packet(self, data: bytes, addr, recv_us: float):
+        if len(data) >= CTRL_HEADER.size:
+            magic, ctrl_type, _ = CTRL_HEADER.unpack_from(data)
+            if magic == UDP_CTRL_MAGIC:
+                source = self.addr_index.get(addr)
+                if source and ctrl_type == UDP_CTRL_PONG and len(data) >= SYNC_PACKET.size:
+                    _, _, _, _, t1, t2, t3 = SYNC_PACKET.unpack_from(data)
+                    source.clock_sync.add_sample(t1, t2, t3, recv_us)
+                return
+
+        header, frame_data = self._parse_header(data)
+        if header is None or len(frame_data) != frame_payload_size(header['format'], header['width'],
+                                                                    header['height']):
+            self.stats['bad_packets'] += 1
+            return
+        source = self._get_source(header, addr)
+        if source is None:
+            return
+        self.stats['bytes'] += len(data)
+        if header['flags'] & UDP_FLAG_RECORDED:
+            source.stats['recorded_frames'] += 1
+            return
+        source.track(header, len(data), recv_us)
+        self.stats['frames_received'] += 1
+        self.stats['fps_frames'] += 1
+        self._update_total_fps()
+
+        if self.decode:
+            frame = self._decode_frame(frame_data, header['width'], header['height'], header['format'])
+            if frame is not None:
+                source.frame = frame
+                source.frame_id += 1
+                if source.mjpeg.clients:
+                    source.mjpeg.submit(frame)  # 没有观看者的流不编码，N路时编码是主要开销
+
+    def _update_total_fps(self):
+        now = time.time()
+        if now - self.stats['last_fps_time'] >= 1.0:
+            self.stats['fps'] = self.stats['fps_frames'] / (now - self.stats['last_fps_time'])
+            self.stats['last_fps_time'] = now
+            self.stats['fps_frames'] = 0
+
+    def _mosaic_loop(self):
+        """按固定帧率把各路最新帧拼成网格，只在有新帧时编码"""
+        last_ids = {}
+        while self.running:
+            time.sleep(1.0 / MOSAIC_FPS)
+            with self.sources_lock:
+                sources = sorted(self.sources.values(), key=lambda s: s.key)
+            ids = {s.key: s.frame_id for s in sources}
+            if not sources or ids == last_ids or not self.mjpeg.clients:
+                continue
+            last_ids = ids
+            self.mjpeg.submit(self._compose_mosaic(sources))
+
+    @staticmethod
+    def _compose_mosaic(sources) -> np.ndarray:
+        cols = math.ceil(math.sqrt(len(sources)))
+        rows = math.ceil(len(sources) / cols)
+        mosaic = np.zeros((rows * FRAME_HEIGHT, cols * FRAME_WIDTH, 3), dtype=np.uint8)
+        for i, source in enumerate(sources):
+            y, x = (i // cols) * FRAME_HEIGHT, (i % cols) * FRAME_WIDTH
+            tile = mosaic[y:y + FRAME_HEIGHT, x:x + FRAME_WIDTH]
+            frame = source.frame
+            if frame is not None:
+                if frame.shape[:2] != (FRAME_HEIGHT, FRAME_WIDTH):
+                    frame = cv2.resize(frame, (FRAME_WIDTH, FRAME_HEIGHT), interpolation=cv2.INTER_AREA)
+                tile[:] = frame
+            label = source.key if source.online else f"{source.key} offline"
+            cv2.putText(tile, label, (3, 12), cv2.FONT_HERSHEY_SIMPLEX, 0.35, (0, 255, 0), 1, cv2.LINE_AA)
+        return mosaic
+
+    def get_sources(self) -> list:
+        with self.sources_lock:
+            return sorted(self.sources)
+
+    def generate_source_frames(self, key: str):
+        """单路的MJPEG生成器，来源不存在时返回None"""
+        with self.sources_lock:
+            source = self.sources.get(key)
+        if source is None:
+            return None
+        return source.mjpeg.stream()
+
+    def get_stats(self) -> dict:
+        """汇总统计和每路统计"""
+        stats = super().get_stats()
+        with self.sources_lock:
+            sources = list(self.sources.values())
+        stats['sources'] = {source.key: source.get_stats() for source in sources}
+        stats['source_count'] = len(sources)
+        stats['online_sources'] = sum(1 for source in sources if source.online)
+        stats['frames_lost'] = sum(source.stats['frames_lost'] for source in sources)
+        stats['frames_reordered'] = sum(source.stats['frames_reordered'] for source in sources)
+        return stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description='ESP32 FPV 多摄像头汇聚接收')
+    parser.add_argument('--ip', default='0.0.0.0', help='绑定IP地址')
+    parser.add_argument('--port', type=int, default=UDP_PORT, help='监听端口')
+    parser.add_argument('--devices', default='', help='主动订阅的设备IP，逗号分隔（也接收主动推流的设备）')
+    parser.add_argument('--frame-divider', type=int, default=1, help='抽帧比，设备每N帧向本接收端发送1帧')
+    parser.add_argument('--no-decode', action='store_true', help='只统计不解码')
+    args = parser.parse_args()
+
+    receiver = MultiFPVReceiver(bind_ip=args.ip, port=args.port,
+                                devices=[ip for ip in args.devices.split(',') if ip],
+                                frame_divider=args.frame_divider, decode=not args.no_decode)
+    receiver.start()
+    try:
+        while receiver.running:
+            time.sleep(5.0)
+            stats = receiver.get_stats()
+            logger.info(f"{stats['online_sources']}/{stats['source_count']} 路在线, 总计 {stats['fps']:.1f} fps, "
+                        f"坏包 {stats['bad_packets']}")
+            for key, s in stats['sources'].items():
+                latency = s['latency_ms']['capture_to_receive']
+                logger.info(f"  {key} ({s['addr']}): {s['fps']:.1f} fps, 丢失 {s['frames_lost']}, "
+                            f"乱序 {s['frames_reordered']}, 采集->接收 p50 {latency.get('p50', '-')}ms "
+                            f"p99 {latency.get('p99', '-')}ms")
+    except KeyboardInterrupt:
+        logger.info("接收到中断信号")
+    finally:
+        receiver.stop()
+
+
+if __name__ == '__main__':
+    main()
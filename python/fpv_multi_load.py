@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+多摄像头汇聚负载测试
+发送进程在回环地址上模拟N台设备（各自的源地址 127.0.1.x、设备ID和时钟偏移），按目标帧率发送v2 RGB565帧，
+并像设备一样应答PING；本进程运行 MultiFPVReceiver，输出每路帧率、丢帧、采集->接收时延p50/p99，
+以及总吞吐和接收进程CPU占用。每路时钟偏移不同，时延只有在各路时钟同步都正确时才会接近真实值。
+
+用法: python3 fpv_multi_load.py [--cameras 8] [--fps 30] [--seconds 10] [--grid-viewers 1] [--no-decode]
+"""
+
+import argparse
+import multiprocessing
+import select
+import socket
+import sys
+import threading
+import time
+
+import numpy as np
+
+from fpv_multi import MultiFPVReceiver
+from fpv_receiver import (
+    V2_HEADER, V2_DEVICE_ID, V2_ID_HEADER_SIZE, SYNC_PACKET, CTRL_HEADER, UDP_MAGIC, UDP_CTRL_MAGIC,
+    UDP_CTRL_PING, UDP_CTRL_PONG, UDP_FRAME_VERSION_2, UDP_FMT_RGB565, UDP_FLAG_KEYFRAME,
+    FRAME_WIDTH, FRAME_HEIGHT, UDP_PORT,
+)
+
+LOAD_PORT = 18888               # 接收端端口，避免与真实接收端冲突
+DEVICE_ID_BASE = 0xE5320000
+CLOCK_OFFSET_US = 1000000000    # 模拟设备之间的时钟偏移（每台相差该值的整数倍）
+
+
+def device_addr(index: int):
+    return (f"127.0.1.{index + 1}", UDP_PORT)
+
+
+def sender(cameras: int, fps: float, seconds: float, port: int, ready):
+    """模拟设备：每台一个socket，帧的发送时刻在各台之间错开"""
+    socks = []
+    for i in range(cameras):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 4 * 1024 * 1024)
+        sock.bind(device_addr(i))
+        sock.setblocking(False)
+        socks.append(sock)
+    by_fd = {sock.fileno(): i for i, sock in enumerate(socks)}
+    dest = ('127.0.0.1', port)
+
+    # 每台一个固定图案，只更新帧头
+    payload_size = FRAME_WIDTH * FRAME_HEIGHT * 2
+    packets = []
+    for i in range(cameras):
+        packet = bytearray(V2_ID_HEADER_SIZE + payload_size)
+        pixels = (np.arange(FRAME_WIDTH * FRAME_HEIGHT, dtype=np.uint16) * (i + 1)).astype('>u2')
+        packet[V2_ID_HEADER_SIZE:] = pixels.tobytes()
+        packets.append(packet)
+
+    def device_us(i: int) -> int:
+        return int(time.monotonic() * 1e6) + (i + 1) * CLOCK_OFFSET_US
+
+    ready.set()
+    period = 1.0 / fps
+    start = time.monotonic()
+    seq = [0] * cameras
+    next_send = [start + period * i / cameras for i in range(cameras)]
+    while time.monotonic() - start < seconds:
+        now = time.monotonic()
+        for i in range(cameras):
+            if now < next_send[i]:
+                continue
+            next_send[i] += period
+            packet = packets[i]
+            V2_HEADER.pack_into(packet, 0, UDP_MAGIC, FRAME_WIDTH, FRAME_HEIGHT, UDP_FRAME_VERSION_2,
+                                V2_ID_HEADER_SIZE, seq[i], device_us(i), UDP_FMT_RGB565,
+                                UDP_FLAG_KEYFRAME, FRAME_WIDTH * 2)
+            V2_DEVICE_ID.pack_into(packet, V2_HEADER.size, DEVICE_ID_BASE + i)
+            seq[i] += 1
+            try:
+                socks[i].sendto(packet, dest)
+            except BlockingIOError:
+                pass
+
+        # 控制包：应答PING（t2=t3=设备时钟），HELLO只需收下
+        timeout = max(0.0, min(next_send) - time.monotonic())
+        readable, _, _ = select.select(socks, [], [], timeout)
+        for sock in readable:
+            i = by_fd[sock.fileno()]
+            while True:
+                try:
+                    data, addr = sock.recvfrom(2048)
+                except BlockingIOError:
+                    break
+                if len(data) < SYNC_PACKET.size or CTRL_HEADER.unpack_from(data)[:2] != (UDP_CTRL_MAGIC, UDP_CTRL_PING):
+                    continue
+                _, _, version, ping_seq, t1, _, _ = SYNC_PACKET.unpack_from(data)
+                t = device_us(i)
+                sock.sendto(SYNC_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_PONG, version, ping_seq, t1, t, t), addr)
+    for sock in socks:
+        sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='多摄像头汇聚负载测试')
+    parser.add_argument('--cameras', type=int, default=8, help='模拟设备数')
+    parser.add_argument('--fps', type=float, default=30.0, help='每台设备帧率')
+    parser.add_argument('--seconds', type=float, default=10.0, help='测试时长（秒）')
+    parser.add_argument('--warmup', type=float, default=2.0, help='预热时长（秒），等待时钟同步，不计入统计')
+    parser.add_argument('--no-decode', action='store_true', help='接收端只统计不解码')
+    parser.add_argument('--grid-viewers', type=int, default=1, help='模拟的网格画面观看者数（/video_feed）')
+    parser.add_argument('--max-p99-ms', type=float, help='判定通过的采集->接收p99上限，默认一个帧间隔')
+    args = parser.parse_args()
+    max_p99_ms = args.max_p99_ms or 1000.0 / args.fps
+
+    receiver = MultiFPVReceiver(bind_ip='127.0.0.1', port=LOAD_PORT, decode=not args.no_decode)
+    receiver.start()
+    viewed = [0] * args.grid_viewers
+
+    def viewer(index: int):
+        for _ in receiver.mjpeg.stream():
+            viewed[index] += 1
+
+    for i in range(args.grid_viewers if not args.no_decode else 0):
+        threading.Thread(target=viewer, args=(i,), daemon=True).start()
+    ready = multiprocessing.Event()
+    proc = multiprocessing.Process(target=sender, daemon=True,
+                                   args=(args.cameras, args.fps, args.warmup + args.seconds + 0.5, LOAD_PORT, ready))
+    proc.start()
+    ready.wait()
+    time.sleep(args.warmup)
+
+    # 预热后清空时延窗口，只统计稳定阶段
+    begin = receiver.get_stats()
+    for source in list(receiver.sources.values()):
+        source.capture_to_receive.clear()
+    viewed_start = list(viewed)
+    cpu_start = time.process_time()
+    time.sleep(args.seconds)
+    cpu = time.process_time() - cpu_start
+    grid_fps = [(v - v0) / args.seconds for v, v0 in zip(viewed, viewed_start)]
+    end = receiver.get_stats()
+    receiver.stop()
+    proc.join()
+
+    failures = 0
+    print(f"{args.cameras} cameras x {args.fps:.0f} fps, {FRAME_WIDTH}x{FRAME_HEIGHT} RGB565, "
+          f"{'decode + per-stream MJPEG + grid' if not args.no_decode else 'no decode'}, {args.seconds:.0f} s")
+    for key, s in sorted(end['sources'].items()):
+        before = begin['sources'].get(key, {'frames_received': 0, 'frames_lost': 0})
+        frames = s['frames_received'] - before['frames_received']
+        lost = s['frames_lost'] - before['frames_lost']
+        fps = frames / args.seconds
+        latency = s['latency_ms']['capture_to_receive']
+        ok = (fps >= args.fps * 0.95 and lost <= frames * 0.01 and
+              s['clock_sync']['synced'] and latency.get('p99', 1e9) <= max_p99_ms)
+        failures += not ok
+        print(f"  {key} {s['addr']:>16s}: {fps:5.1f} fps, lost {lost}, reordered {s['frames_reordered']}, "
+              f"capture->receive p50 {latency.get('p50', '-')} ms p99 {latency.get('p99', '-')} ms"
+              f"{'' if ok else '  <-- FAIL'}")
+    if len(end['sources']) != args.cameras:
+        print(f"  expected {args.cameras} streams, got {len(end['sources'])}")
+        failures += 1
+    total_bytes = end['bytes'] - begin['bytes']
+    print(f"total: {(end['frames_received'] - begin['frames_received']) / args.seconds:.1f} fps, "
+          f"{total_bytes / args.seconds / 1e6:.2f} MB/s, bad packets {end['bad_packets']}, "
+          f"receiver CPU {100.0 * cpu / args.seconds:.1f}%"
+          + (f", grid viewers {min(grid_fps):.1f} fps" if grid_fps and not args.no_decode else ""))
+    print("PASS" if failures == 0 else "FAIL")
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -12,7 +12,11 @@ import numpy as np
 import cv2
 import queue
 import argparse
+import heapq
 import logging
+import os
+import urllib.request
+from collections import deque
 
 # 尝试导入CUDA支持
 try:
@@ -44,14 +48,342 @@ FRAME_HEIGHT = 120   # QQVGA（实际工作分辨率）
 PIXEL_FORMAT = 'RGB565'
 MAX_FRAME_SIZE = FRAME_WIDTH * FRAME_HEIGHT * 2  # RGB565 = 2 bytes per pixel
 
+# 帧头定义（与 components/wifi/wifi.h 保持一致）
+UDP_PORT = 8888
+UDP_CTRL_MAGIC = 0x5043
+UDP_CTRL_HELLO = 1
+UDP_FRAME_VERSION_1 = 1
+UDP_FRAME_VERSION_2 = 2
+UDP_FRAME_VERSION_MAX = UDP_FRAME_VERSION_2
+V1_HEADER = struct.Struct('<HHH')              # magic, width, height
+V2_HEADER = struct.Struct('<HHHBBIQBBH')       # + version, header_size, seq, timestamp_us, format, flags, stride
+V2_DEVICE_ID = struct.Struct('<I')             # 紧随v2基本帧头的设备ID，header_size >= V2_ID_HEADER_SIZE 时存在
+V2_ID_HEADER_SIZE = V2_HEADER.size + V2_DEVICE_ID.size
+CTRL_HEADER = struct.Struct('<HBB')            # magic, type, version
+HELLO_PACKET = struct.Struct('<HBBB')          # ctrl header + frame_divider
+SYNC_PACKET = struct.Struct('<HBBIQQQ')        # ctrl header + seq, t1_us, t2_us, t3_us
+UDP_CTRL_PING = 2
+UDP_CTRL_PONG = 3
+UDP_CTRL_ROI = 4
+UDP_CTRL_DUMP = 5
+DUMP_PACKET = struct.Struct('<HBBH')           # ctrl header + pre_event_ms
+ROI_PACKET = struct.Struct('<HBBBBHHHH')     # ctrl header + target, reserved, x, y, width, height
+ROI_TARGET_FPV = 0x01
+ROI_TARGET_LCD = 0x02
+ROI_TARGET_ALL = 0x03
+UDP_FMT_RGB565 = 0
+UDP_FMT_JPEG = 1
+UDP_FMT_GRAY = 2      # Y8
+UDP_FMT_YUV420 = 4    # 平面I420: Y | U | V
+UDP_FLAG_BIG_ENDIAN = 0x01
+UDP_FLAG_KEYFRAME = 0x02
+UDP_FLAG_MOTION = 0x04
+UDP_FLAG_RECORDED = 0x08  # 预录导出帧
+HELLO_INTERVAL = 1.0   # 秒，设备5秒未收到HELLO会回退到v1
+LATENCY_WINDOW = 300   # 单向时延基线窗口（帧）
+PING_INTERVAL = 0.2    # 秒，时钟同步PING间隔
+SYNC_WINDOW = 64       # 时钟同步样本窗口
+SYNC_MIN_SAMPLES = 4   # 少于该样本数时认为未同步
+HTTP_PORT = 80         # 设备HTTP服务端口（/stream, /snapshot）
+SNAPSHOT_TIMEOUT = 10.0  # 秒，快照需要切换传感器模式
+JITTER_MAX_DELAY_MS = 50   # 抖动缓冲播放延迟上限（FPV），0表示收到即显示
+JITTER_WINDOW = 128        # 传输时延窗口（帧），约4秒
+JITTER_PERCENTILE = 95     # 播放延迟覆盖该百分位的到达抖动
+JITTER_DECAY = 32          # 目标延迟下降时每帧只回落差值的1/N，避免来回振荡
+JITTER_MAX_FRAMES = 8      # 缓冲帧数上限
+MJPEG_SIZE = (640, 480)    # Web视频流输出尺寸
+MJPEG_QUALITY = 85
+
+
+def frame_payload_size(fmt: int, width: int, height: int) -> int:
+    """按像素格式计算一帧负载字节数，不支持的格式返回0"""
+    if fmt == UDP_FMT_RGB565:
+        return width * height * 2
+    if fmt == UDP_FMT_GRAY:
+        return width * height
+    if fmt == UDP_FMT_YUV420:
+        return width * height + 2 * ((width // 2) * (height // 2))
+    return 0
+
+
+def now_us() -> float:
+    """本机单调时钟（微秒），时钟同步与时延统计统一使用"""
+    return time.monotonic() * 1e6
+
+
+def percentiles(samples, points=(50, 90, 99)) -> dict:
+    """计算百分位数（毫秒），样本为空时返回空字典"""
+    if not samples:
+        return {}
+    ordered = sorted(samples)
+    result = {}
+    for p in points:
+        index = min(len(ordered) - 1, int(round(p / 100.0 * (len(ordered) - 1))))
+        result[f'p{p}'] = round(ordered[index] / 1000.0, 2)
+    return result
+
+
+class ClockSync:
+    """NTP式时钟同步：持续估计设备时钟相对本机时钟的偏移和漂移"""
+    
+    def __init__(self, window: int = SYNC_WINDOW):
+        self.samples = deque(maxlen=window)  # (本机时间, 偏移, RTT)，单位微秒
+        self.offset_us = 0.0    # 参考时刻的偏移（设备时钟 - 本机时钟）
+        self.drift = 0.0        # 偏移变化率（微秒/微秒）
+        self.ref_us = 0.0       # 参考时刻（本机时钟）
+        self.rtt_us = 0.0
+    
+    @property
+    def synced(self) -> bool:
+        return len(self.samples) >= SYNC_MIN_SAMPLES
+    
+    def add_sample(self, t1: float, t2: float, t3: float, t4: float):
+        """加入一次PING/PONG交换的四个时间戳"""
+        rtt = (t4 - t1) - (t3 - t2)
+        offset = ((t2 - t1) + (t3 - t4)) / 2.0
+        self.samples.append(((t1 + t4) / 2.0, offset, rtt))
+        self.rtt_us = rtt
+        self._fit()
+    
+    def _fit(self):
+        # 只使用RTT最小的一半样本，排队时延最小的交换偏移估计最准
+        best = sorted(self.samples, key=lambda s: s[2])[:max(1, len(self.samples) // 2)]
+        n = len(best)
+        self.ref_us = sum(s[0] for s in best) / n
+        self.offset_us = sum(s[1] for s in best) / n
+        if n < 2:
+            self.drift = 0.0
+            return
+        # 最小二乘拟合 偏移 = offset_us + drift * (t - ref_us)
+        sxx = sum((s[0] - self.ref_us) ** 2 for s in best)
+        sxy = sum((s[0] - self.ref_us) * (s[1] - self.offset_us) for s in best)
+        self.drift = sxy / sxx if sxx > 0 else 0.0
+    
+    def device_to_host_us(self, device_us: float) -> float:
+        """将设备时钟时间换算到本机时钟"""
+        host_us = device_us - self.offset_us
+        return device_us - (self.offset_us + self.drift * (host_us - self.ref_us))
+    
+    def get_state(self) -> dict:
+        return {
+            'synced': self.synced,
+            'samples': len(self.samples),
+            'offset_ms': round(self.offset_us / 1000.0, 3),
+            'drift_ppm': round(self.drift * 1e6, 2),
+            'rtt_ms': round(self.rtt_us / 1000.0, 3),
+        }
+
+class JitterBuffer:
+    """自适应抖动缓冲：按设备采集时间戳排序，等到 采集时间 + 最小传输时延 + 播放延迟 再输出
+
+    传输时延 = 接收时间 - 采集时间戳（两个时钟的差，含未知偏移），窗口内最小值作为基线，
+    超出基线部分的百分位数即到达抖动，播放延迟取该值（不超过上限）：抖动大时多缓冲换平滑，
+    抖动小时延迟自动回落。晚于已播放帧到达的帧丢弃，乱序到达的帧在缓冲内重新排序。
+    """
+    
+    def __init__(self, max_delay_ms: float = JITTER_MAX_DELAY_MS, window: int = JITTER_WINDOW):
+        self.max_delay_us = max_delay_ms * 1000.0
+        self.cond = threading.Condition()
+        self.heap = []                          # (采集时间戳, 序号, 帧)
+        self.transits = deque(maxlen=window)    # 传输时延（微秒）
+        self.base_us = 0.0                      # 窗口内最小传输时延
+        self.delay_us = 0.0                     # 当前播放延迟
+        self.target_us = 0.0                    # 按抖动分布计算的目标延迟（截断前）
+        self.jitter_us = 0.0                    # 到达抖动（RFC 3550 式平滑）
+        self.playout_jitter_us = 0.0            # 播放间隔与采集间隔之差（平滑），衡量显示是否均匀
+        self.last_transit = None
+        self.last_played_ts = None
+        self.last_play_us = None
+        self.counters = {'buffered': 0, 'played': 0, 'late': 0, 'skipped': 0, 'reordered': 0, 'overflow': 0}
+    
+    def push(self, timestamp_us: int, seq: int, recv_us: float, item) -> bool:
+        """放入一帧，返回False表示来得太晚（比已播放的帧还早）已丢弃"""
+        with self.cond:
+            transit = recv_us - timestamp_us
+            if self.last_transit is not None:
+                self.jitter_us += (abs(transit - self.last_transit) - self.jitter_us) / 16.0
+            self.last_transit = transit
+            self.transits.append(transit)
+            self.base_us = min(self.transits)
+            
+            extra = sorted(t - self.base_us for t in self.transits)
+            self.target_us = extra[min(len(extra) - 1, len(extra) * JITTER_PERCENTILE // 100)]
+            target = min(self.target_us, self.max_delay_us)
+            if target >= self.delay_us:
+                self.delay_us = target      # 抖动变大立即跟上
+            else:
+                self.delay_us -= (self.delay_us - target) / JITTER_DECAY
+            
+            if self.last_played_ts is not None and timestamp_us <= self.last_played_ts:
+                self.counters['late'] += 1
+                return False
+            if self.heap and timestamp_us < max(entry[0] for entry in self.heap):
+                self.counters['reordered'] += 1
+            heapq.heappush(self.heap, (timestamp_us, seq, item))
+            if len(self.heap) > JITTER_MAX_FRAMES:
+                heapq.heappop(self.heap)
+                self.counters['overflow'] += 1
+            self.counters['buffered'] += 1
+            self.cond.notify()
+            return True
+    
+    def pop(self, timeout: float):
+        """等待下一帧到播放时间后返回；同时有多帧到期时只返回最新的（其余计为跳过），超时返回None"""
+        deadline = time.monotonic() + timeout
+        with self.cond:
+            while True:
+                now = now_us()
+                if self.heap:
+                    due = self.heap[0][0] + self.base_us + self.delay_us
+                    if now >= due:
+                        timestamp_us, _, item = heapq.heappop(self.heap)
+                        while self.heap and self.heap[0][0] + self.base_us + self.delay_us <= now:
+                            timestamp_us, _, item = heapq.heappop(self.heap)
+                            self.counters['skipped'] += 1
+                        self._record_play(timestamp_us, now)
+                        return item
+                    wait = min((due - now) / 1e6, deadline - time.monotonic())
+                else:
+                    wait = deadline - time.monotonic()
+                if wait <= 0:
+                    return None
+                self.cond.wait(wait)
+    
+    def _record_play(self, timestamp_us: int, now: float):
+        if self.last_play_us is not None:
+            d = (now - self.last_play_us) - (timestamp_us - self.last_played_ts)
+            self.playout_jitter_us += (abs(d) - self.playout_jitter_us) / 16.0
+        self.last_play_us = now
+        self.last_played_ts = timestamp_us
+        self.counters['played'] += 1
+    
+    def get_state(self) -> dict:
+        """当前选择的延迟/平滑折中"""
+        with self.cond:
+            state = dict(self.counters)
+            state.update({
+                'delay_ms': round(self.delay_us / 1000.0, 1),
+                'target_ms': round(self.target_us / 1000.0, 1),
+                'max_delay_ms': round(self.max_delay_us / 1000.0, 1),
+                'capped': self.target_us > self.max_delay_us,
+                'arrival_jitter_ms': round(self.jitter_us / 1000.0, 2),
+                'playout_jitter_ms': round(self.playout_jitter_us / 1000.0, 2),
+                'depth': len(self.heap),
+            })
+            return state
+
+class MjpegBroadcaster:
+    """Web视频流：每个新帧只缩放+JPEG编码一次，通过条件变量分发给所有 /video_feed 客户端
+
+    编码线程只处理最新提交的帧（编码跟不上时中间帧被替换）；每个客户端只记住自己发到第几帧，
+    醒来后直接取最新编码结果，慢客户端跳过中间帧而不是排队，不会拖慢编码或其他客户端。
+    """
+    
+    def __init__(self, size=MJPEG_SIZE, quality: int = MJPEG_QUALITY, on_encoded=None):
+        self.size = size
+        self.quality = quality
+        self.on_encoded = on_encoded    # 每帧编码完成后回调（参数为采集时间），用于采集->显示时延统计
+        self.cond = threading.Condition()
+        self.running = False
+        self.thread = None
+        self.pending = None             # 等待编码的最新帧 (图像, 采集时间)
+        self.frame_id = 0               # 已编码帧数，客户端据此判断有没有新帧
+        self.chunk = None               # 最新一帧的multipart数据
+        self.clients = 0
+        self.encode_us = 0.0
+        self.counters = {'submitted': 0, 'replaced': 0, 'encoded': 0, 'sent': 0, 'client_skipped': 0}
+    
+    def start(self):
+        self.running = True
+        self.thread = threading.Thread(target=self._encode_loop, daemon=True)
+        self.thread.start()
+    
+    def stop(self):
+        with self.cond:
+            self.running = False
+            self.cond.notify_all()
+    
+    def submit(self, frame: np.ndarray, capture_us: float = None):
+        """提交一帧解码后的图像（不拷贝，调用者之后不能修改该数组）"""
+        with self.cond:
+            if self.pending is not None:
+                self.counters['replaced'] += 1
+            self.pending = (frame, capture_us)
+            self.counters['submitted'] += 1
+            self.cond.notify_all()
+    
+    def _encode_loop(self):
+        while self.running:
+            with self.cond:
+                while self.running and self.pending is None:
+                    self.cond.wait(0.1)
+                if not self.running:
+                    return
+                frame, capture_us = self.pending
+                self.pending = None
+            
+            # 在锁外编码（OpenCV执行时释放GIL），期间新提交的帧会替换pending
+            start = now_us()
+            try:
+                enlarged = cv2.resize(frame, self.size, interpolation=cv2.INTER_NEAREST)
+                ok, buffer = cv2.imencode('.jpg', enlarged, [cv2.IMWRITE_JPEG_QUALITY, self.quality])
+            except Exception as e:
+                logger.error(f"视频帧编码错误: {e}")
+                continue
+            if not ok:
+                logger.error("JPEG编码失败")
+                continue
+            chunk = b'--frame\r\nContent-Type: image/jpeg\r\n\r\n' + buffer.tobytes() + b'\r\n'
+            
+            with self.cond:
+                self.chunk = chunk
+                self.frame_id += 1
+                self.counters['encoded'] += 1
+                self.encode_us += now_us() - start
+                self.cond.notify_all()
+            if self.on_encoded:
+                self.on_encoded(capture_us)
+    
+    def stream(self):
+        """单个客户端的multipart生成器，每个新编码帧最多发送一次"""
+        with self.cond:
+            self.clients += 1
+            last_id = self.frame_id - 1 if self.chunk is not None else self.frame_id  # 新客户端先收到当前帧
+        try:
+            while self.running:
+                with self.cond:
+                    if self.frame_id == last_id:
+                        self.cond.wait(1.0)
+                        if self.frame_id == last_id:
+                            continue
+                    # 慢客户端：发送上一帧期间编码的帧直接跳过
+                    self.counters['client_skipped'] += self.frame_id - last_id - 1
+                    last_id = self.frame_id
+                    chunk = self.chunk
+                    self.counters['sent'] += 1
+                yield chunk
+        finally:
+            with self.cond:
+                self.clients -= 1
+    
+    def get_state(self) -> dict:
+        with self.cond:
+            state = dict(self.counters)
+            state['clients'] = self.clients
+            state['encode_ms'] = round(self.encode_us / max(1, self.counters['encoded']) / 1000.0, 2)
+            return state
+
 class FPVReceiver:
     """简化的FPV接收器"""
     
     def __init__(self, bind_ip: str = '0.0.0.0', port: int = 8888, 
-                 enable_gpu: bool = True, display_window: bool = True, esp32_ip: str = '192.168.1.100'):
+                 enable_gpu: bool = True, display_window: bool = True, esp32_ip: str = '192.168.1.100',
+                 frame_divider: int = 1, dump_dir: str = None, jitter_max_ms: float = JITTER_MAX_DELAY_MS):
         self.bind_ip = bind_ip
         self.port = port
         self.esp32_ip = esp32_ip  # 新增ESP32 IP配置
+        self.frame_divider = max(1, min(255, frame_divider))  # 设备对本接收端每N帧发送1帧
+        self.dump_dir = dump_dir  # 预录导出帧保存目录
         # 强制禁用GPU以确保稳定性
         self.enable_gpu = False
         self.display_window = display_window
@@ -63,8 +395,12 @@ class FPVReceiver:
         # 帧队列
         self.frame_queue = queue.Queue(maxsize=1)  # 只保留最新帧
         
+        # 抖动缓冲（仅v2帧头有采集时间戳，v1帧收到即显示）
+        self.jitter = JitterBuffer(jitter_max_ms) if jitter_max_ms > 0 else None
+        
         # Web视频流相关
         self.current_frame = None
+        self.mjpeg = MjpegBroadcaster(on_encoded=self._record_display)
         
         # 统计信息
         self.stats = {
@@ -72,9 +408,31 @@ class FPVReceiver:
             'frames_dropped': 0,
             'fps': 0.0,
             'last_fps_time': time.time(),
-            'fps_frames': 0
+            'fps_frames': 0,
+            'header_version': UDP_FRAME_VERSION_1,
+            'frames_lost': 0,
+            'frames_reordered': 0,
+            'one_way_latency_ms': 0.0,
+            'motion_active': False,
+            'max_frame_gap_ms': 0.0,
+            'recorded_frames': 0,
         }
         
+        # 序号/时延跟踪（仅v2帧头可用）
+        self.last_seq = None
+        self.last_timestamp_us = None
+        self.latency_deltas = deque(maxlen=LATENCY_WINDOW)
+        self.last_hello_time = 0.0
+        self.device_addr = None
+        
+        # 时钟同步与端到端时延（采集->接收，采集->显示）
+        self.clock_sync = ClockSync()
+        self.ping_seq = 0
+        self.last_ping_time = 0.0
+        self.capture_to_receive = deque(maxlen=LATENCY_WINDOW)
+        self.capture_to_display = deque(maxlen=LATENCY_WINDOW)
+        self.current_frame_capture_us = None
+        
         logger.info(f"FPV接收器初始化完成 - 分辨率: {FRAME_WIDTH}x{FRAME_HEIGHT}")
         logger.info(f"GPU加速: {'启用' if self.enable_gpu else '禁用'}")
     
@@ -85,7 +443,7 @@ class FPVReceiver:
             self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
             self.socket.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 64*1024*1024)  # 64MB接收缓冲区
             self.socket.bind((self.bind_ip, self.port))
-            self.socket.setblocking(False)
+            self.socket.settimeout(0.1)  # 阻塞等待数据，超时后回到循环发送HELLO/PING，不空转
             
             self.running = True
             
@@ -93,6 +451,15 @@ class FPVReceiver:
             self.receive_thread = threading.Thread(target=self._receive_loop, daemon=True)
             self.receive_thread.start()
             
+            # 启动播放线程（按抖动缓冲的播放时间交给显示/Web）
+            if self.jitter:
+                self.playout_thread = threading.Thread(target=self._playout_loop, daemon=True)
+                self.playout_thread.start()
+            
+            # 启动Web视频流编码线程
+            if not self.display_window:
+                self.mjpeg.start()
+            
             # 启动显示线程
             if self.display_window:
                 self.display_thread = threading.Thread(target=self._display_loop, daemon=True)
@@ -108,66 +475,242 @@ class FPVReceiver:
     def stop(self):
         """停止接收器"""
         self.running = False
+        self.mjpeg.stop()
         if self.socket:
             self.socket.close()
         logger.info("FPV接收器已停止")
     
+    def _send_hello(self):
+        """发送HELLO控制包，注册为订阅者并协商帧头版本和抽帧比（同时作为保活）"""
+        now = time.time()
+        if now - self.last_hello_time < HELLO_INTERVAL:
+            return
+        self.last_hello_time = now
+        target = self.device_addr or (self.esp32_ip, UDP_PORT)
+        try:
+            self.socket.sendto(HELLO_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_HELLO, UDP_FRAME_VERSION_MAX,
+                                                 self.frame_divider), target)
+        except OSError as e:
+            logger.debug(f"发送HELLO失败: {e}")
+    
+    def set_roi(self, x: int = 0, y: int = 0, width: int = 0, height: int = 0, target: int = ROI_TARGET_FPV):
+        """设置设备端ROI（帧像素坐标），宽高为0恢复全幅；ROI_TARGET_ALL时设备优先用传感器窗口做数字变焦"""
+        target_addr = self.device_addr or (self.esp32_ip, UDP_PORT)
+        packet = ROI_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_ROI, 0, target, 0, x, y, width, height)
+        try:
+            self.socket.sendto(packet, target_addr)
+            logger.info(f"设置ROI: target=0x{target:x}, {x},{y} {width}x{height}")
+        except OSError as e:
+            logger.warning(f"发送ROI失败: {e}")
+    
+    def fetch_snapshot(self, path: str) -> bool:
+        """通过HTTP /snapshot 获取一张高分辨率JPEG（TCP传输，不受UDP丢包影响）并保存"""
+        url = f"http://{self.esp32_ip}:{HTTP_PORT}/snapshot"
+        start = time.time()
+        try:
+            with urllib.request.urlopen(url, timeout=SNAPSHOT_TIMEOUT) as resp:
+                data = resp.read()
+                size = resp.headers.get('X-Snapshot-Size', '?')
+        except OSError as e:
+            logger.warning(f"获取快照失败: {e}")
+            return False
+        with open(path, 'wb') as f:
+            f.write(data)
+        logger.info(f"快照已保存: {path}, {size}, {len(data)} 字节, 耗时 {(time.time() - start) * 1000:.0f}ms")
+        return True
+    
+    def trigger_dump(self, pre_event_ms: int = 0):
+        """请求设备导出预录帧（触发前pre_event_ms毫秒，0使用设备配置）"""
+        target_addr = self.device_addr or (self.esp32_ip, UDP_PORT)
+        packet = DUMP_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_DUMP, 0, pre_event_ms)
+        try:
+            self.socket.sendto(packet, target_addr)
+            logger.info(f"请求导出预录帧: {pre_event_ms or '默认'}ms")
+        except OSError as e:
+            logger.warning(f"发送导出请求失败: {e}")
+    
+    def _save_recorded(self, header: dict, frame_data: bytes):
+        """保存预录导出帧（不参与实时显示和丢帧统计）"""
+        self.stats['recorded_frames'] += 1
+        if not self.dump_dir:
+            return
+        os.makedirs(self.dump_dir, exist_ok=True)
+        name = os.path.join(self.dump_dir, f"{header['seq']:06d}_{header['timestamp_us']}")
+        if header['format'] == UDP_FMT_JPEG:
+            with open(name + '.jpg', 'wb') as f:
+                f.write(frame_data)
+            return
+        frame = self._decode_frame(frame_data, header['width'], header['height'], header['format'])
+        if frame is not None:
+            cv2.imwrite(name + '.png', frame)
+    
+    def _send_ping(self):
+        """发送时钟同步PING"""
+        now = time.time()
+        if now - self.last_ping_time < PING_INTERVAL:
+            return
+        self.last_ping_time = now
+        target = self.device_addr or (self.esp32_ip, UDP_PORT)
+        self.ping_seq = (self.ping_seq + 1) & 0xFFFFFFFF
+        packet = SYNC_PACKET.pack(UDP_CTRL_MAGIC, UDP_CTRL_PING, UDP_FRAME_VERSION_MAX,
+                                  self.ping_seq, int(now_us()), 0, 0)
+        try:
+            self.socket.sendto(packet, target)
+        except OSError as e:
+            logger.debug(f"发送PING失败: {e}")
+    
+    def _handle_ctrl(self, data: bytes, recv_us: float) -> bool:
+        """处理设备发来的控制包，返回是否为控制包"""
+        if len(data) < CTRL_HEADER.size:
+            return False
+        magic, ctrl_type, _ = CTRL_HEADER.unpack_from(data)
+        if magic != UDP_CTRL_MAGIC:
+            return False
+        if ctrl_type == UDP_CTRL_PONG and len(data) >= SYNC_PACKET.size:
+            _, _, _, _, t1, t2, t3 = SYNC_PACKET.unpack_from(data)
+            self.clock_sync.add_sample(t1, t2, t3, recv_us)
+        return True
+    
+    def _parse_header(self, data: bytes):
+        """解析帧头，返回 (header dict, 图像数据)；无法解析时返回 (None, None)"""
+        if len(data) < V1_HEADER.size:
+            return None, None
+        magic, width, height = V1_HEADER.unpack_from(data)
+        if magic != UDP_MAGIC:
+            return None, None
+        
+        # v1帧: 头部后紧跟完整RGB565图像
+        if len(data) == V1_HEADER.size + width * height * 2:
+            return {'version': UDP_FRAME_VERSION_1, 'width': width, 'height': height,
+                    'seq': None, 'timestamp_us': None, 'format': UDP_FMT_RGB565,
+                    'flags': UDP_FLAG_BIG_ENDIAN, 'stride': width * 2, 'device_id': None}, data[V1_HEADER.size:]
+        
+        if len(data) < V2_HEADER.size:
+            return None, None
+        (_, _, _, version, header_size, seq, timestamp_us,
+         fmt, flags, stride) = V2_HEADER.unpack_from(data)
+        if version < UDP_FRAME_VERSION_2 or header_size < V2_HEADER.size or header_size > len(data):
+            return None, None
+        # 旧固件的v2帧头没有设备ID
+        device_id = V2_DEVICE_ID.unpack_from(data, V2_HEADER.size)[0] if header_size >= V2_ID_HEADER_SIZE else None
+        return {'version': version, 'width': width, 'height': height, 'seq': seq,
+                'timestamp_us': timestamp_us, 'format': fmt, 'flags': flags,
+                'stride': stride, 'device_id': device_id}, data[header_size:]
+    
+    def _track_sequence(self, header: dict, recv_us: float):
+        """根据序号统计丢帧/乱序，根据采集时间戳估计单向时延"""
+        seq = header['seq']
+        if seq is None:
+            return
+        if self.last_seq is not None:
+            gap = (seq - self.last_seq) & 0xFFFFFFFF
+            if gap == 0 or gap > 0x7FFFFFFF:
+                # 序号回退：乱序或重复，丢弃的帧已计入丢失，这里回补
+                self.stats['frames_reordered'] += 1
+                self.stats['frames_lost'] = max(0, self.stats['frames_lost'] - 1)
+                return
+            self.stats['frames_lost'] += gap - 1
+        self.last_seq = seq
+        
+        # 采集间隔（设备时钟），快照切换传感器模式时会出现明显的中断
+        if self.last_timestamp_us is not None:
+            gap_ms = (header['timestamp_us'] - self.last_timestamp_us) / 1000.0
+            self.stats['max_frame_gap_ms'] = max(self.stats['max_frame_gap_ms'], gap_ms)
+        self.last_timestamp_us = header['timestamp_us']
+        
+        # 时钟已同步时得到真实采集->接收时延
+        if self.clock_sync.synced:
+            capture_us = self.clock_sync.device_to_host_us(header['timestamp_us'])
+            header['capture_host_us'] = capture_us
+            self.capture_to_receive.append(recv_us - capture_us)
+            self.stats['one_way_latency_ms'] = (recv_us - capture_us) / 1000.0
+            return
+        
+        # 未同步时以窗口内最小值为基线得到相对单向时延
+        delta_us = recv_us - header['timestamp_us']
+        self.latency_deltas.append(delta_us)
+        self.stats['one_way_latency_ms'] = (delta_us - min(self.latency_deltas)) / 1000.0
+    
     def _receive_loop(self):
         """接收数据包的主循环"""
         print(f"🔍 开始监听UDP数据包，期望来自ESP32 ({self.esp32_ip})...")
         while self.running:
+            self._send_hello()
+            self._send_ping()
             try:
                 data, addr = self.socket.recvfrom(65536)  # 最大UDP包大小
+                recv_us = now_us()
                 
-                # 打印接收到的数据包信息（调试用）
-                print(f"📦 收到UDP包: 来源 {addr}, 大小 {len(data)} 字节")
+                logger.debug(f"收到UDP包: 来源 {addr}, 大小 {len(data)} 字节")
                 
                 # 检查是否来自期望的ESP32 IP（允许广播）
                 if addr[0] != self.esp32_ip and addr[0] != "255.255.255.255":
-                    print(f"⚠️ 数据包来源不匹配: 期望 {self.esp32_ip} 或广播, 实际 {addr[0]}")
+                    logger.debug(f"数据包来源不匹配: 期望 {self.esp32_ip} 或广播, 实际 {addr[0]}")
+                    continue
+                self.device_addr = addr
+                
+                # 控制包（时钟同步应答等）
+                if self._handle_ctrl(data, recv_us):
                     continue
                 
                 # 解析包头
-                if len(data) < 6:  # 最小包头大小
-                    print(f"⚠️ 数据包太小: {len(data)} 字节")
+                if len(data) < V1_HEADER.size:  # 最小包头大小
+                    logger.debug(f"数据包太小: {len(data)} 字节")
                     continue
                 
                 try:
-                    magic, width, height = struct.unpack('<HHH', data[:6])
-                    print(f"🔍 包头解析: 魔数=0x{magic:04X}, 宽度={width}, 高度={height}")
+                    header, frame_data = self._parse_header(data)
+                    if header is None:
+                        logger.debug(f"无法解析包头: 大小 {len(data)} 字节")
+                        continue
+                    width, height = header['width'], header['height']
+                    logger.debug(f"包头解析: v{header['version']}, 宽度={width}, 高度={height}, 序号={header['seq']}")
                     
-                    if magic != UDP_MAGIC:
-                        print(f"⚠️ 魔数不匹配: 期望0x{UDP_MAGIC:04X}, 实际0x{magic:04X}")
+                    if header['flags'] & UDP_FLAG_RECORDED:
+                        self._save_recorded(header, frame_data)
                         continue
-                    if width != FRAME_WIDTH or height != FRAME_HEIGHT:
-                        print(f"⚠️ 分辨率不匹配: 期望{FRAME_WIDTH}x{FRAME_HEIGHT}, 实际{width}x{height}")
+                    
+                    expected_size = frame_payload_size(header['format'], width, height)
+                    if expected_size == 0:
+                        logger.debug(f"不支持的像素格式: {header['format']}")
                         continue
                     
-                    # 获取图像数据
-                    frame_data = data[6:]
-                    if len(frame_data) != MAX_FRAME_SIZE:
-                        print(f"⚠️ 帧大小不匹配: 期望{MAX_FRAME_SIZE}, 实际{len(frame_data)}")
+                    if len(frame_data) != expected_size:
+                        logger.debug(f"帧大小不匹配: 期望{expected_size}, 实际{len(frame_data)}")
                         continue
                     
+                    self.stats['header_version'] = header['version']
+                    self.stats['motion_active'] = bool(header['flags'] & UDP_FLAG_MOTION)
+                    self._track_sequence(header, recv_us)
+                    
                     # 处理帧
-                    self._process_frame(frame_data)
-                    print(f"✅ 成功接收帧: {len(frame_data)} 字节")
+                    item = (frame_data, width, height, header.get('capture_host_us'), header['format'])
+                    if self.jitter and header['timestamp_us'] is not None:
+                        if not self.jitter.push(header['timestamp_us'], header['seq'], recv_us, item):
+                            self.stats['frames_dropped'] += 1
+                        continue
+                    self._process_frame(*item)
+                    logger.debug(f"成功接收帧: {len(frame_data)} 字节")
                     
                 except struct.error as e:
-                    print(f"⚠️ 包头解析错误: {e}")
+                    logger.debug(f"包头解析错误: {e}")
                     continue
                 
+            except socket.timeout:
+                continue  # 超时内没有数据
             except socket.error as e:
-                continue  # 非阻塞socket的正常行为
+                logger.debug(f"接收错误: {e}")
+                continue
             except Exception as e:
                 logger.error(f"接收数据包错误: {e}")
     
-    def _process_frame(self, frame_data: bytes):
+    def _process_frame(self, frame_data: bytes, width: int = FRAME_WIDTH, height: int = FRAME_HEIGHT,
+                       capture_us: float = None, fmt: int = UDP_FMT_RGB565):
         """处理接收到的完整帧"""
         try:
             # 如果是Web模式且有Web解码函数，直接调用
             if hasattr(self, '_web_decode_and_display') and not self.display_window:
-                self._web_decode_and_display(0, frame_data)
+                self._web_decode_and_display(0, frame_data, width, height, capture_us, fmt)
                 self.stats['frames_received'] += 1
                 self.stats['fps_frames'] += 1
                 return
@@ -180,7 +723,7 @@ class FPVReceiver:
                 except queue.Empty:
                     pass
             
-            self.frame_queue.put(frame_data)
+            self.frame_queue.put((frame_data, width, height, capture_us, fmt))
             self.stats['frames_received'] += 1
             self.stats['fps_frames'] += 1
             
@@ -192,12 +735,19 @@ class FPVReceiver:
         except Exception as e:
             logger.error(f"处理帧错误: {e}")
     
+    def _playout_loop(self):
+        """按抖动缓冲给出的播放时间输出帧"""
+        while self.running:
+            item = self.jitter.pop(timeout=0.1)
+            if item is not None:
+                self._process_frame(*item)
+    
     def _display_loop(self):
         """显示循环"""
         while self.running:
             try:
-                frame_data = self.frame_queue.get(timeout=0.1)
-                frame = self._decode_rgb565(frame_data)
+                frame_data, width, height, capture_us, fmt = self.frame_queue.get(timeout=0.1)
+                frame = self._decode_frame(frame_data, width, height, fmt)
                 
                 if frame is not None:
                     # 更新FPS统计
@@ -205,6 +755,7 @@ class FPVReceiver:
                     
                     # 显示帧
                     cv2.imshow('FPV Camera', frame)
+                    self._record_display(capture_us)
                     if cv2.waitKey(1) & 0xFF == ord('q'):
                         self.running = False
                 
@@ -213,26 +764,56 @@ class FPVReceiver:
             except Exception as e:
                 logger.error(f"显示帧错误: {e}")
     
-    def _decode_rgb565(self, frame_data: bytes) -> np.ndarray:
+    def _decode_frame(self, frame_data: bytes, width: int, height: int, fmt: int = UDP_FMT_RGB565) -> np.ndarray:
+        """按帧头中的像素格式解码为BGR图像"""
+        if fmt == UDP_FMT_GRAY:
+            return self._decode_gray(frame_data, width, height)
+        if fmt == UDP_FMT_YUV420:
+            return self._decode_yuv420(frame_data, width, height)
+        return self._decode_rgb565(frame_data, width, height)
+    
+    def _decode_gray(self, frame_data: bytes, width: int, height: int) -> np.ndarray:
+        """解码Y8灰度数据"""
+        try:
+            if len(frame_data) != width * height:
+                return None
+            gray = np.frombuffer(frame_data, dtype=np.uint8).reshape(height, width)
+            return cv2.cvtColor(gray, cv2.COLOR_GRAY2BGR)
+        except Exception as e:
+            logger.error(f"灰度解码错误: {e}")
+            return None
+    
+    def _decode_yuv420(self, frame_data: bytes, width: int, height: int) -> np.ndarray:
+        """解码平面YUV420（I420，BT.601有限范围）数据"""
+        try:
+            if len(frame_data) != frame_payload_size(UDP_FMT_YUV420, width, height):
+                return None
+            yuv = np.frombuffer(frame_data, dtype=np.uint8).reshape(height * 3 // 2, width)
+            return cv2.cvtColor(yuv, cv2.COLOR_YUV2BGR_I420)
+        except Exception as e:
+            logger.error(f"YUV420解码错误: {e}")
+            return None
+    
+    def _decode_rgb565(self, frame_data: bytes, width: int = FRAME_WIDTH, height: int = FRAME_HEIGHT) -> np.ndarray:
         """解码RGB565数据"""
         try:
-            if len(frame_data) != MAX_FRAME_SIZE:
+            if len(frame_data) != width * height * 2:
                 return None
             
             if self.enable_gpu:
-                return self._decode_rgb565_gpu(frame_data)
+                return self._decode_rgb565_gpu(frame_data, width, height)
             else:
-                return self._decode_rgb565_cpu(frame_data)
+                return self._decode_rgb565_cpu(frame_data, width, height)
                 
         except Exception as e:
             logger.error(f"解码帧错误: {e}")
             return None
     
-    def _decode_rgb565_cpu(self, frame_data: bytes) -> np.ndarray:
+    def _decode_rgb565_cpu(self, frame_data: bytes, width: int = FRAME_WIDTH, height: int = FRAME_HEIGHT) -> np.ndarray:
         """CPU解码RGB565数据 - 第一版方法（能看清楚图像）"""
         try:
-            if len(frame_data) != MAX_FRAME_SIZE:
-                logger.error(f"帧数据大小错误: {len(frame_data)}, 期望: {MAX_FRAME_SIZE}")
+            if len(frame_data) != width * height * 2:
+                logger.error(f"帧数据大小错误: {len(frame_data)}, 期望: {width * height * 2}")
                 return None
             
             # 第一版解码方法：大端序RGB565解码
@@ -247,7 +828,7 @@ class FPVReceiver:
             rgb = np.stack([r, g, b], axis=-1)
             
             # 重塑为图像尺寸
-            rgb = rgb.reshape(FRAME_HEIGHT, FRAME_WIDTH, 3)
+            rgb = rgb.reshape(height, width, 3)
             
             # 转换为BGR供OpenCV使用
             bgr = cv2.cvtColor(rgb, cv2.COLOR_RGB2BGR)
@@ -258,13 +839,13 @@ class FPVReceiver:
             logger.error(f"CPU解码错误: {e}")
             return None
     
-    def _decode_rgb565_gpu(self, frame_data: bytes) -> np.ndarray:
+    def _decode_rgb565_gpu(self, frame_data: bytes, width: int = FRAME_WIDTH, height: int = FRAME_HEIGHT) -> np.ndarray:
         """GPU加速解码RGB565数据"""
         try:
             # 检查CuPy是否真正可用
             if not CUDA_AVAILABLE:
                 logger.warning("CuPy不可用，回退到CPU解码")
-                return self._decode_rgb565_cpu(frame_data)
+                return self._decode_rgb565_cpu(frame_data, width, height)
             
             # 将数据传输到GPU
             rgb565_gpu = cp.frombuffer(frame_data, dtype=cp.uint16)
@@ -276,7 +857,7 @@ class FPVReceiver:
             
             # 合并为RGB图像
             rgb_gpu = cp.stack([r, g, b], axis=-1)
-            rgb_gpu = rgb_gpu.reshape(FRAME_HEIGHT, FRAME_WIDTH, 3)
+            rgb_gpu = rgb_gpu.reshape(height, width, 3)
             
             # 传回CPU
             rgb = cp.asnumpy(rgb_gpu).astype(np.uint8)
@@ -286,7 +867,7 @@ class FPVReceiver:
         except Exception as e:
             logger.error(f"GPU解码错误: {e}")
             logger.info("回退到CPU解码")
-            return self._decode_rgb565_cpu(frame_data)
+            return self._decode_rgb565_cpu(frame_data, width, height)
     
     def _update_fps(self):
         """更新FPS统计"""
@@ -299,16 +880,23 @@ class FPVReceiver:
             # 打印统计信息
             logger.info(f"FPS: {self.stats['fps']:.1f}, "
                        f"接收帧: {self.stats['frames_received']}, "
-                       f"丢弃帧: {self.stats['frames_dropped']}")
+                       f"丢弃帧: {self.stats['frames_dropped']}, "
+                       f"丢失帧: {self.stats['frames_lost']}, "
+                       f"单向时延: {self.stats['one_way_latency_ms']:.1f}ms"
+                       + (f", 播放延迟: {self.jitter.delay_us / 1000.0:.1f}ms" if self.jitter else ""))
     
-    def _web_decode_and_display(self, frame_num: int, frame_data: bytes):
+    def _web_decode_and_display(self, frame_num: int, frame_data: bytes,
+                                width: int = FRAME_WIDTH, height: int = FRAME_HEIGHT,
+                                capture_us: float = None, fmt: int = UDP_FMT_RGB565):
         """Web模式下的解码和显示"""
         try:
-            # 解码RGB565数据
-            frame = self._decode_rgb565(frame_data)
+            # 按像素格式解码
+            frame = self._decode_frame(frame_data, width, height, fmt)
             if frame is not None:
                 # 存储当前帧用于Web流
-                self.current_frame = frame.copy()
+                self.current_frame = frame
+                self.current_frame_capture_us = capture_us
+                self.mjpeg.submit(frame, capture_us)
                 
                 # 更新Web模式下的FPS统计
                 self.stats['frames_received'] += 1
@@ -323,41 +911,27 @@ class FPVReceiver:
             print(f"❌ Web解码错误: {e}")
     
     def _generate_frames(self):
-        """生成MJPEG帧"""
-        frame_count = 0
-        while True:
-            if self.current_frame is not None:
-                try:
-                    # 放大视频帧到更大的尺寸
-                    enlarged_frame = cv2.resize(self.current_frame, (640, 480), 
-                                            interpolation=cv2.INTER_NEAREST)
-                    
-                    # 将OpenCV图像转换为JPEG
-                    ret, buffer = cv2.imencode('.jpg', enlarged_frame, 
-                                            [cv2.IMWRITE_JPEG_QUALITY, 85])
-                    if ret:
-                        frame = buffer.tobytes()
-                        
-                        # 生成MJPEG流
-                        mjpeg_frame = (b'--frame\r\n'
-                                     b'Content-Type: image/jpeg\r\n\r\n' + frame + b'\r\n')
-                        yield mjpeg_frame
-                        
-                        # 每100帧打印一次状态
-                        frame_count += 1
-                        if frame_count % 100 == 0:
-                            print(f"🎥 已生成 {frame_count} 帧视频流 (放大到640x480)")
-                    else:
-                        print("❌ JPEG编码失败")
-                        
-                except Exception as e:
-                    print(f"❌ 视频帧生成错误: {e}")
-            
-            time.sleep(0.033)  # ~30 FPS
+        """生成MJPEG帧（每个 /video_feed 客户端一个生成器，共享同一个编码结果）"""
+        yield from self.mjpeg.stream()
+    
+    def _record_display(self, capture_us: float):
+        """记录采集->显示时延（需时钟已同步）"""
+        if capture_us is not None:
+            self.capture_to_display.append(now_us() - capture_us)
     
     def get_stats(self) -> dict:
         """获取统计信息"""
-        return self.stats.copy()
+        stats = self.stats.copy()
+        stats['clock_sync'] = self.clock_sync.get_state()
+        stats['latency_ms'] = {
+            'capture_to_receive': percentiles(list(self.capture_to_receive)),
+            'capture_to_display': percentiles(list(self.capture_to_display)),
+        }
+        if self.jitter:
+            stats['jitter_buffer'] = self.jitter.get_state()
+        if self.mjpeg.running:
+            stats['mjpeg'] = self.mjpeg.get_state()
+        return stats
 
 def main():
     """主函数"""
@@ -366,6 +940,15 @@ def main():
     parser.add_argument('--port', type=int, default=8888, help='监听端口')
     parser.add_argument('--no-gpu', action='store_true', help='禁用GPU加速')
     parser.add_argument('--no-display', action='store_true', help='禁用显示窗口')
+    parser.add_argument('--esp32-ip', default='192.168.1.100', help='ESP32设备IP（发送HELLO订阅视频流）')
+    parser.add_argument('--roi', help='设备端ROI，格式 x,y,宽,高（帧像素坐标）')
+    parser.add_argument('--roi-target', choices=['fpv', 'lcd', 'all'], default='fpv', help='ROI作用路径')
+    parser.add_argument('--frame-divider', type=int, default=1, help='抽帧比，设备每N帧向本接收端发送1帧')
+    parser.add_argument('--dump', type=int, metavar='MS', help='启动后请求设备导出触发前MS毫秒的预录帧（0使用设备配置）')
+    parser.add_argument('--dump-dir', default='prerec', help='预录导出帧保存目录')
+    parser.add_argument('--jitter-max-ms', type=float, default=JITTER_MAX_DELAY_MS,
+                        help='抖动缓冲播放延迟上限（毫秒），0表示收到即显示')
+    parser.add_argument('--snapshot', metavar='FILE', help='启动后通过HTTP获取一张高分辨率快照保存到FILE')
     
     args = parser.parse_args()
     
@@ -374,13 +957,31 @@ def main():
         bind_ip=args.ip,
         port=args.port,
         enable_gpu=not args.no_gpu,
-        display_window=not args.no_display
+        display_window=not args.no_display,
+        esp32_ip=args.esp32_ip,
+        frame_divider=args.frame_divider,
+        dump_dir=args.dump_dir,
+        jitter_max_ms=args.jitter_max_ms
     )
     
     try:
         # 启动接收器
         receiver.start()
         
+        if args.roi:
+            x, y, w, h = (int(v) for v in args.roi.split(','))
+            target = {'fpv': ROI_TARGET_FPV, 'lcd': ROI_TARGET_LCD, 'all': ROI_TARGET_ALL}[args.roi_target]
+            receiver.set_roi(x, y, w, h, target)
+        
+        if args.dump is not None:
+            time.sleep(HELLO_INTERVAL)  # 导出帧只发给已订阅的v2接收端
+            receiver.trigger_dump(args.dump)
+        
+        if args.snapshot:
+            receiver.fetch_snapshot(args.snapshot)
+            time.sleep(0.5)  # 等待恢复后的第一帧到达
+            logger.info(f"最大帧间隔: {receiver.stats['max_frame_gap_ms']:.0f}ms")
+        
         # 主循环
         while receiver.running:
             time.sleep(0.1)
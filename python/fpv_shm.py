@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""
+ESP32 FPV 共享内存帧读取
+读取 host/fpv_rx（host/fpvrx.c）写入的共享内存环形缓冲区，帧数据以numpy视图返回，不拷贝
+布局与 host/fpvrx.h 保持一致
+"""
+
+import argparse
+import logging
+import mmap
+import os
+import struct
+import time
+import numpy as np
+
+from fpv_receiver import ClockSync, UDP_FMT_GRAY, UDP_FMT_YUV420
+
+logger = logging.getLogger(__name__)
+
+# 共享内存布局（与 host/fpvrx.h 保持一致，本机字节序）
+FPVRX_SHM_MAGIC = 0x52565046        # "FPVR"
+FPVRX_SHM_VERSION = 1
+FPVRX_FMT_BGR24 = 0x80
+FPVRX_SYNC_SAMPLES = 16
+SHM_HEADER = struct.Struct('=8I7Q')     # magic, version, header_size, slot_count, slot_size, slot_data_size,
+                                        # writer_pid, reserved, frames_published, packets, bytes, frames_lost,
+                                        # frames_reordered, bad_packets, sync_count
+SYNC_SAMPLE = struct.Struct('=4Q')      # t1_us, t2_us, t3_us, t4_us
+SLOT = struct.Struct('=3Q2I3H4B2xI')    # generation, recv_us, timestamp_us, seq, len, width, height, stride,
+                                        # format, flags, version, channels, device_id
+GENERATION = struct.Struct('=Q')
+SLOT_DATA_OFFSET = 64                   # fpvrx_slot_t 按64字节对齐后的大小
+
+
+class FrameRing:
+    """共享内存帧环形缓冲区读取端（只读映射）"""
+
+    def __init__(self, name: str = '/fpv'):
+        path = '/dev/shm/' + name.lstrip('/')
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self.mm = mmap.mmap(fd, 0, prot=mmap.PROT_READ)
+        finally:
+            os.close(fd)
+        header = SHM_HEADER.unpack_from(self.mm)
+        (magic, version, self.header_size, self.slot_count, self.slot_size,
+         self.slot_data_size, self.writer_pid) = header[:7]
+        if magic != FPVRX_SHM_MAGIC or version != FPVRX_SHM_VERSION:
+            self.mm.close()
+            raise ValueError(f"{path} 不是兼容的帧缓冲区")
+        if self.header_size + self.slot_count * self.slot_size > len(self.mm):
+            self.mm.close()
+            raise ValueError(f"{path} 大小不符")
+        self.last_generation = 0
+
+    def close(self):
+        try:
+            self.mm.close()
+        except BufferError:
+            pass  # 仍有numpy视图引用映射，随进程退出释放
+
+    def stats(self) -> dict:
+        """写入方的接收统计"""
+        (_, _, _, _, _, _, _, _, published, packets, nbytes, lost,
+         reordered, bad, sync_count) = SHM_HEADER.unpack_from(self.mm)
+        return {'frames_published': published, 'packets': packets, 'bytes': nbytes,
+                'frames_lost': lost, 'frames_reordered': reordered, 'bad_packets': bad,
+                'sync_count': sync_count}
+
+    def sync_samples(self) -> list:
+        """最近的时钟同步样本 (t1, t2, t3, t4)，按时间先后排列"""
+        sync_count = SHM_HEADER.unpack_from(self.mm)[-1]
+        first = max(0, sync_count - FPVRX_SYNC_SAMPLES)
+        return [SYNC_SAMPLE.unpack_from(self.mm, SHM_HEADER.size + (i % FPVRX_SYNC_SAMPLES) * SYNC_SAMPLE.size)
+                for i in range(first, sync_count)]
+
+    def _slot_offset(self, generation: int) -> int:
+        return self.header_size + ((generation - 1) % self.slot_count) * self.slot_size
+
+    def latest(self):
+        """取最新一帧，返回 (元数据dict, numpy视图)；没有新帧或正在写入时返回 (None, None)
+
+        视图直接指向共享内存，使用完后用 valid() 检查期间是否被覆盖，需要长期保存时先 copy()
+        """
+        published = SHM_HEADER.unpack_from(self.mm)[8]
+        if published == 0 or published == self.last_generation:
+            return None, None
+        offset = self._slot_offset(published)
+        (generation, recv_us, timestamp_us, seq, length, width, height, stride,
+         fmt, flags, version, channels, device_id) = SLOT.unpack_from(self.mm, offset)
+        if generation == 0 or length > self.slot_data_size:
+            return None, None
+        data = np.frombuffer(self.mm, dtype=np.uint8, count=length, offset=offset + SLOT_DATA_OFFSET)
+        if fmt == FPVRX_FMT_BGR24:
+            frame = data.reshape(height, width, 3)
+        elif fmt == UDP_FMT_GRAY and stride * height == length:
+            frame = data.reshape(height, stride)[:, :width]
+        elif fmt == UDP_FMT_YUV420 and width * height * 3 // 2 == length:
+            frame = data.reshape(height * 3 // 2, width)
+        else:
+            frame = data
+        meta = {'generation': generation, 'offset': offset, 'recv_us': recv_us, 'timestamp_us': timestamp_us,
+                'seq': seq, 'width': width, 'height': height, 'stride': stride, 'format': fmt,
+                'flags': flags, 'version': version, 'channels': channels, 'device_id': device_id}
+        self.last_generation = generation
+        return meta, frame
+
+    def valid(self, meta: dict) -> bool:
+        """检查读取期间该帧是否被写入方覆盖"""
+        return GENERATION.unpack_from(self.mm, meta['offset'])[0] == meta['generation']
+
+
+def main():
+    """共享内存帧显示示例"""
+    import cv2
+
+    parser = argparse.ArgumentParser(description='ESP32 FPV 共享内存帧读取')
+    parser.add_argument('name', nargs='?', default='/fpv', help='共享内存名称（host/fpv_rx 的第二个参数）')
+    parser.add_argument('--no-display', action='store_true', help='不显示，只输出统计')
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+
+    ring = FrameRing(args.name)
+    clock_sync = ClockSync()
+    sync_seen = 0
+    frames = torn = 0
+    latency_ms = 0.0
+    last_report = time.monotonic()
+    try:
+        while True:
+            meta, frame = ring.latest()
+            if meta is None:
+                time.sleep(0.002)
+                continue
+
+            # 时钟同步样本由接收程序写入，这里复用Python接收端的拟合
+            sync_count = ring.stats()['sync_count']
+            if sync_count != sync_seen:
+                for sample in ring.sync_samples()[-(sync_count - sync_seen):]:
+                    clock_sync.add_sample(*sample)
+                sync_seen = sync_count
+            if clock_sync.synced and meta['timestamp_us']:
+                latency_ms = (meta['recv_us'] - clock_sync.device_to_host_us(meta['timestamp_us'])) / 1000.0
+
+            if not args.no_display and meta['format'] in (FPVRX_FMT_BGR24, UDP_FMT_GRAY):
+                cv2.imshow('FPV (shm)', frame)
+                if cv2.waitKey(1) & 0xFF == ord('q'):
+                    break
+            if ring.valid(meta):
+                frames += 1
+            else:
+                torn += 1
+
+            now = time.monotonic()
+            if now - last_report >= 5.0:
+                stats = ring.stats()
+                logger.info(f"{frames / (now - last_report):.1f} fps, 覆盖 {torn}, 丢帧 {stats['frames_lost']}, "
+                            f"乱序 {stats['frames_reordered']}, 采集->接收 {latency_ms:.1f}ms")
+                frames = torn = 0
+                last_report = now
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if not args.no_display:
+            cv2.destroyAllWindows()
+        ring.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Web视频流负载测试
+在进程内模拟多个 /video_feed 客户端，比较每客户端各自缩放+编码（旧实现）和
+MjpegBroadcaster 每帧只编码一次的CPU占用，输出每增加一个观看者的CPU增量；
+最后加入一个慢客户端，检查它只跳帧、不影响其他客户端的帧率
+
+用法: python3 mjpeg_load.py [--seconds 5] [--viewers 1,2,4,8] [--fps 30]
+"""
+
+import argparse
+import threading
+import time
+import numpy as np
+import cv2
+
+from fpv_receiver import FRAME_WIDTH, FRAME_HEIGHT, MJPEG_SIZE, MJPEG_QUALITY, MjpegBroadcaster
+
+
+def legacy_stream(source, running):
+    """旧实现：每个客户端每33ms各自缩放并编码当前帧"""
+    while running.is_set():
+        frame = source['frame']
+        if frame is not None:
+            enlarged = cv2.resize(frame, MJPEG_SIZE, interpolation=cv2.INTER_NEAREST)
+            ok, buffer = cv2.imencode('.jpg', enlarged, [cv2.IMWRITE_JPEG_QUALITY, MJPEG_QUALITY])
+            if ok:
+                yield b'--frame\r\nContent-Type: image/jpeg\r\n\r\n' + buffer.tobytes() + b'\r\n'
+        time.sleep(0.033)
+
+
+def make_frame(i: int) -> np.ndarray:
+    """移动的渐变图案，避免JPEG编码退化成常数图像"""
+    x = np.arange(FRAME_WIDTH, dtype=np.uint16)
+    y = np.arange(FRAME_HEIGHT, dtype=np.uint16)[:, None]
+    frame = np.empty((FRAME_HEIGHT, FRAME_WIDTH, 3), dtype=np.uint8)
+    frame[:, :, 0] = (x + i * 3) & 0xFF
+    frame[:, :, 1] = (y * 2 + i) & 0xFF
+    frame[:, :, 2] = ((x ^ y) + i * 5) & 0xFF
+    return frame
+
+
+def run(mode: str, viewers: int, seconds: float, fps: float, slow_delay: float = 0.0) -> dict:
+    """运行一轮，返回CPU占用和每个客户端收到的帧数"""
+    running = threading.Event()
+    running.set()
+    source = {'frame': None}
+    broadcaster = MjpegBroadcaster()
+    if mode == 'shared':
+        broadcaster.start()
+
+    received = [0] * viewers
+
+    def client(index: int):
+        stream = broadcaster.stream() if mode == 'shared' else legacy_stream(source, running)
+        delay = slow_delay if index == viewers - 1 else 0.0
+        for _ in stream:
+            received[index] += 1
+            if delay:
+                time.sleep(delay)   # 模拟带宽很差的浏览器
+            if not running.is_set():
+                break
+
+    threads = [threading.Thread(target=client, args=(i,), daemon=True) for i in range(viewers)]
+    for t in threads:
+        t.start()
+
+    # 帧源：与接收端相同，解码后的帧交给Web输出
+    cpu_start = time.process_time()
+    wall_start = time.monotonic()
+    i = 0
+    while time.monotonic() - wall_start < seconds:
+        frame = make_frame(i)
+        source['frame'] = frame
+        broadcaster.submit(frame)
+        i += 1
+        time.sleep(max(0.0, wall_start + i / fps - time.monotonic()))
+    cpu = time.process_time() - cpu_start
+    wall = time.monotonic() - wall_start
+
+    running.clear()
+    broadcaster.stop()
+    for t in threads:
+        t.join(timeout=1.0)
+    result = {'cpu_pct': 100.0 * cpu / wall, 'frames': i, 'received': [r / wall for r in received]}
+    if mode == 'shared':
+        result['state'] = broadcaster.get_state()
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Web视频流负载测试')
+    parser.add_argument('--seconds', type=float, default=5.0, help='每轮时长（秒）')
+    parser.add_argument('--viewers', default='1,2,4,8', help='观看者数量列表')
+    parser.add_argument('--fps', type=float, default=30.0, help='源帧率')
+    args = parser.parse_args()
+    counts = [int(v) for v in args.viewers.split(',')]
+
+    for mode in ('legacy', 'shared'):
+        base = None
+        for viewers in counts:
+            result = run(mode, viewers, args.seconds, args.fps)
+            if base is None:
+                base = (viewers, result['cpu_pct'])
+            per_viewer = ((result['cpu_pct'] - base[1]) / (viewers - base[0])) if viewers > base[0] else 0.0
+            fps = result['received']
+            print(f"{mode:6s} {viewers:2d} viewers: CPU {result['cpu_pct']:5.1f}%, "
+                  f"{per_viewer:+5.1f}% per extra viewer, client fps {min(fps):.1f}-{max(fps):.1f}")
+
+    viewers = max(2, counts[-1])
+    result = run('shared', viewers, args.seconds, args.fps, slow_delay=0.2)
+    fps = result['received']
+    state = result['state']
+    print(f"shared {viewers:2d} viewers with 1 slow client: CPU {result['cpu_pct']:5.1f}%, "
+          f"normal clients {min(fps[:-1]):.1f}-{max(fps[:-1]):.1f} fps, slow client {fps[-1]:.1f} fps, "
+          f"encoded {state['encoded']}/{result['frames']}, skipped by clients {state['client_skipped']}, "
+          f"encode {state['encode_ms']} ms/frame")
+
+
+if __name__ == '__main__':
+    main()
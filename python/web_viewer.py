@@ -9,6 +9,7 @@ import threading
 import time
 import logging
 from fpv_receiver import FPVReceiver
+from fpv_multi import MultiFPVReceiver
 import cv2
 
 # 配置日志
@@ -18,12 +19,13 @@ logger = logging.getLogger(__name__)
 class WebViewer:
     """简化的Web查看器类"""
     
-    def __init__(self, host='0.0.0.0', port=5000):
+    def __init__(self, host='0.0.0.0', port=5000, devices=None):
         self.host = host
         self.port = port
         self.app = Flask(__name__)
         self.receiver = None
         self.current_esp32_ip = '192.168.1.100'
+        self.devices = devices  # 不为None时使用多摄像头汇聚接收（主页显示网格画面）
         
         # 启动后台接收器
         self._start_background_receiver()
@@ -35,13 +37,16 @@ class WebViewer:
         """启动后台接收器"""
         try:
             # 创建接收器（后台模式）
-            self.receiver = FPVReceiver(
-                bind_ip='0.0.0.0',
-                port=8888,
-                enable_gpu=False,
-                display_window=False,  # 后台模式
-                esp32_ip=self.current_esp32_ip
-            )
+            if self.devices is not None:
+                self.receiver = MultiFPVReceiver(bind_ip='0.0.0.0', port=8888, devices=self.devices)
+            else:
+                self.receiver = FPVReceiver(
+                    bind_ip='0.0.0.0',
+                    port=8888,
+                    enable_gpu=False,
+                    display_window=False,  # 后台模式
+                    esp32_ip=self.current_esp32_ip
+                )
             
             # 启动接收器
             self.receiver.start()
@@ -67,7 +72,10 @@ class WebViewer:
                 
                 # 更新ESP32 IP地址
                 self.current_esp32_ip = esp32_ip
-                self.receiver.esp32_ip = esp32_ip
+                if isinstance(self.receiver, MultiFPVReceiver):
+                    self.receiver.add_device(esp32_ip)  # 多路模式下增加一台设备
+                else:
+                    self.receiver.esp32_ip = esp32_ip
                 
                 logger.info(f"ESP32 IP地址已更新为: {esp32_ip}")
                 
@@ -89,6 +97,28 @@ class WebViewer:
             return Response(self.receiver._generate_frames(),
                            mimetype='multipart/x-mixed-replace; boundary=frame')
         
+        @self.app.route('/video_feed/<key>')
+        def source_video_feed(key):
+            """多路模式下单台设备的视频流"""
+            if not isinstance(self.receiver, MultiFPVReceiver):
+                return jsonify({'error': '未启用多路接收'}), 404
+            stream = self.receiver.generate_source_frames(key)
+            if stream is None:
+                return jsonify({'error': f'没有视频流 {key}'}), 404
+            return Response(stream, mimetype='multipart/x-mixed-replace; boundary=frame')
+        
+        @self.app.route('/grid')
+        def grid():
+            """多路模式下每台设备一格的页面"""
+            return render_template('grid.html')
+        
+        @self.app.route('/sources')
+        def get_sources():
+            """多路模式下每路视频流的统计"""
+            if not isinstance(self.receiver, MultiFPVReceiver):
+                return jsonify({})
+            return jsonify(self.receiver.get_stats()['sources'])
+        
         @self.app.route('/stats')
         def get_stats():
             """获取统计信息"""
@@ -123,11 +153,15 @@ def main():
     parser = argparse.ArgumentParser(description='ESP32 FPV Camera Web Viewer')
     parser.add_argument('--host', default='0.0.0.0', help='Web服务器主机地址')
     parser.add_argument('--port', type=int, default=5000, help='Web服务器端口')
+    parser.add_argument('--multi', action='store_true', help='多摄像头汇聚接收，主页显示网格画面，/grid 每台一格')
+    parser.add_argument('--devices', default='', help='多路模式下主动订阅的设备IP，逗号分隔')
     
     args = parser.parse_args()
+    devices = [ip for ip in args.devices.split(',') if ip]
     
     # 创建并运行Web查看器
-    web_viewer = WebViewer(host=args.host, port=args.port)
+    web_viewer = WebViewer(host=args.host, port=args.port,
+                           devices=devices if args.multi or devices else None)
     
     try:
         web_viewer.run()